@@ -0,0 +1,304 @@
+#include "resource_monitor.h"
+#include "process_watcher.h"
+#include "process_classifier.h"
+#include "procfs.h"
+#include "report.h"
+#include "fixture.h"
+#include "top_k.h"
+#include <docopt.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+
+namespace fs = std::filesystem;
+
+static const char USAGE[] =
+R"(采集器基准测试，结果以JSON输出
+
+Usage:
+  res_monitor_bench [--pids <list>] [--no-live] [--fixture-dir <dir>] [--min-time <ms>] [--output <file>]
+  res_monitor_bench (-h | --help)
+
+Options:
+  --pids <list>        合成目录的进程数，逗号分隔 [默认: 1000,10000,100000]
+  --no-live            不测试本机的/proc和/sys
+  --fixture-dir <dir>  合成目录的位置 [默认: /tmp/res_monitor_bench]
+  --min-time <ms>      每项测试的最短运行时间(毫秒) [默认: 200]
+  --output <file>      JSON输出文件，默认输出到标准输出
+  -h --help            显示帮助信息
+)";
+
+struct BenchResult {
+    std::string source;
+    size_t pids;
+    std::string name;
+    uint64_t iterations;
+    double nsPerOp;
+    double allocsPerOp;
+    double syscallsPerOp;
+    double bytesReadPerOp;
+    bool perPid;
+};
+
+class BenchRunner {
+public:
+    BenchRunner(std::string source, size_t pids, std::chrono::milliseconds minTime)
+        : source_(std::move(source)), pids_(pids), minTime_(minTime) {}
+
+    void run(const std::string &name, bool perPid, const std::function<void()> &op) {
+        op();   // 预热，同时建立采集器的基准值
+
+        auto &io = procfs::ioCounters();
+        auto ioBefore = io;
+        auto allocsBefore = threadAllocations();
+        auto start = std::chrono::steady_clock::now();
+        auto deadline = start + minTime_;
+        uint64_t iterations = 0;
+        do {
+            op();
+            ++iterations;
+        } while (std::chrono::steady_clock::now() < deadline || iterations < 3);
+        auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        BenchResult result;
+        result.source = source_;
+        result.pids = pids_;
+        result.name = name;
+        result.iterations = iterations;
+        result.nsPerOp = elapsed / iterations;
+        result.allocsPerOp = double(threadAllocations() - allocsBefore) / iterations;
+        result.syscallsPerOp = double(io.syscalls() - ioBefore.syscalls()) / iterations;
+        result.bytesReadPerOp = double(io.bytesRead - ioBefore.bytesRead) / iterations;
+        result.perPid = perPid;
+        results_.push_back(result);
+
+        std::cerr << fmt::format("{:>16} {:>7} {:<14} {:>14.0f} ns/op {:>10.1f} ns/pid {:>10.1f} allocs {:>10.1f} syscalls\n",
+            source_, pids_, name, result.nsPerOp, perPid && pids_ ? result.nsPerOp / pids_ : 0.0,
+            result.allocsPerOp, result.syscallsPerOp);
+    }
+
+    std::vector<BenchResult> &results() { return results_; }
+
+private:
+    std::string source_;
+    size_t pids_;
+    std::chrono::milliseconds minTime_;
+    std::vector<BenchResult> results_;
+};
+
+static void benchSource(const std::string &source, const MonitorEnvironment &environment,
+                        std::chrono::milliseconds minTime, std::vector<BenchResult> &out) {
+    std::vector<int> pids;
+    procfs::listPids(environment.procRoot.c_str(), pids);
+    BenchRunner runner(source, pids.size(), minTime);
+
+    std::string buffer;
+    auto pidPath = [&](int pid, const char *name) {
+        return fmt::format("{}/{}/{}", environment.procRoot, pid, name);
+    };
+
+    // 预先读入各进程的文件，单独测量解析开销
+    auto preload = [&](const char *name) {
+        std::vector<std::string> texts;
+        for (int pid : pids) {
+            if (procfs::readFile(pidPath(pid, name).c_str(), buffer)) texts.push_back(buffer);
+        }
+        return texts;
+    };
+    auto statTexts = preload("stat");
+    auto statmTexts = preload("statm");
+    auto ioTexts = preload("io");
+
+    std::vector<std::string> paths[3];
+    const char *names[3] = {"stat", "statm", "io"};
+    for (int i = 0; i < 3; ++i) {
+        for (int pid : pids) paths[i].push_back(pidPath(pid, names[i]));
+    }
+
+    std::vector<int> scanned;
+    runner.run("scan", true, [&] {
+        scanned.clear();
+        procfs::listPids(environment.procRoot.c_str(), scanned);
+    });
+
+    for (int i = 0; i < 3; ++i) {
+        runner.run(fmt::format("read_{}", names[i]), true, [&] {
+            for (const auto &path : paths[i]) procfs::readFile(path.c_str(), buffer);
+        });
+    }
+
+    procfs::ProcStat stat;
+    runner.run("parse_stat", true, [&] {
+        for (const auto &text : statTexts) procfs::parseProcStat(text, stat);
+    });
+    procfs::ProcStatm statm;
+    runner.run("parse_statm", true, [&] {
+        for (const auto &text : statmTexts) procfs::parseStatm(text, statm);
+    });
+    procfs::ProcIo io;
+    runner.run("parse_io", true, [&] {
+        for (const auto &text : ioTexts) procfs::parseProcIo(text, io);
+    });
+
+    // 约200条规则：大部分是程序名，其余是带锚定和字符类的正则，都不匹配时需要扫描完整文本
+    std::vector<std::string> rules;
+    for (int i = 0; i < 150; ++i) rules.push_back(fmt::format("service-{}d", i));
+    for (int i = 0; i < 50; ++i) rules.push_back(fmt::format("^/opt/app{}/bin/[a-z]+$", i));
+    rules.push_back("worker-4[0-9]");
+    ProcessClassifier classifier(rules);
+    auto cmdlines = preload("cmdline");
+    for (auto &text : cmdlines) std::replace(text.begin(), text.end(), '\0', ' ');
+    runner.run("classify", true, [&] {
+        for (const auto &text : cmdlines) classifier.classify(text);
+    });
+
+    std::mt19937_64 rng(42);
+    std::vector<std::pair<uint64_t, int>> values, work;
+    for (int pid : pids) values.emplace_back(rng() % 100000, pid);
+    work.reserve(values.size());
+    runner.run("topk", true, [&] {
+        work.assign(values.begin(), values.end());
+        selectTopK(work, 3, [](const auto &v) { return v.first; });
+    });
+
+    auto meminfoPath = environment.procRoot + "/meminfo";
+    runner.run("meminfo", false, [&] {
+        MemInfo info;
+        procfs::readFile(meminfoPath.c_str(), buffer);
+        procfs::parseMeminfo(buffer, info);
+    });
+
+    auto diskstatsPath = environment.procRoot + "/diskstats";
+    std::vector<procfs::DiskstatsEntry> entries;
+    runner.run("diskstats", false, [&] {
+        entries.clear();
+        procfs::readFile(diskstatsPath.c_str(), buffer);
+        procfs::parseDiskstats(buffer, entries);
+    });
+
+    ResourceMonitor monitor(environment);
+    runner.run("temperature", false, [&] { monitor.getTemperatures(); });
+    runner.run("top_cpu", true, [&] { monitor.getTopCpu(3, 0.0); });
+    runner.run("top_mem", true, [&] { monitor.getTopMem(3, 0); });
+    runner.run("top_disk", true, [&] { monitor.getTopDisk(3, 0); });
+
+    SampleOptions options;
+    options.minCpuUsage = 0;
+    options.minMemUsage = 0;
+    options.minDiskUsage = 0;
+    runner.run("sample", true, [&] { monitor.sample(options); });
+
+    // 分组：在已有的扫描结果上做一次哈希聚合，UID只在首次遇到进程时读取
+    monitor.setGrouping(GroupBy::User);
+    runner.run("groups_user", true, [&] { monitor.getProcessGroups(); });
+    monitor.setGrouping(GroupBy::Tree);
+    runner.run("groups_tree", true, [&] { monitor.getProcessGroups(); });
+    monitor.setGrouping(GroupBy::None);
+
+    // 过滤：stat中的rss已能排除约3/4的进程，这些进程不再读取statm和io
+    monitor.setFilter("rss > 192M && uid != 0");
+    runner.run("top_mem_filter", true, [&] { monitor.getTopMem(3, 0); });
+    runner.run("top_disk_filter", true, [&] { monitor.getTopDisk(3, 0); });
+    monitor.setFilter("");
+
+    // 监视列表：只读取3个进程，与总进程数无关
+    WatchOptions watchOptions;
+    watchOptions.pids.assign(pids.begin(), pids.begin() + std::min<size_t>(3, pids.size()));
+    ProcessWatcher watcher(watchOptions, environment);
+    size_t watchTicks = 0;
+    runner.run("watch", false, [&] {
+        watcher.sample();
+        if (++watchTicks % 64 == 0) watcher.collect();
+    });
+
+    auto snapshot = monitor.sample(options);
+    runner.run("format", false, [&] {
+        std::string text = formatCpu(snapshot.cpuPercent);
+        text += formatMemory(snapshot.mem);
+        text += formatDisks(snapshot.disksReady, snapshot.disks);
+        text += formatTemperatures(snapshot.temperatures);
+        for (const auto &p : snapshot.topCpu) text += formatTopCpu(p);
+        for (const auto &p : snapshot.topMem) text += formatTopMem(p, snapshot.memRank);
+        for (const auto &p : snapshot.topDisk) text += formatTopDisk(p);
+    });
+
+    out.insert(out.end(), runner.results().begin(), runner.results().end());
+}
+
+static std::string toJson(const std::vector<BenchResult> &results) {
+    fmt::memory_buffer buf;
+    auto out = std::back_inserter(buf);
+    fmt::format_to(out, "{{\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto &r = results[i];
+        fmt::format_to(out,
+            "    {{\"source\": \"{}\", \"pids\": {}, \"name\": \"{}\", \"iterations\": {}, "
+            "\"ns_per_op\": {:.1f}, \"ns_per_pid\": {}, \"allocs_per_op\": {:.2f}, "
+            "\"syscalls_per_op\": {:.2f}, \"bytes_read_per_op\": {:.1f}}}{}\n",
+            r.source, r.pids, r.name, r.iterations, r.nsPerOp,
+            r.perPid && r.pids ? fmt::format("{:.2f}", r.nsPerOp / r.pids) : "null",
+            r.allocsPerOp, r.syscallsPerOp, r.bytesReadPerOp,
+            i + 1 < results.size() ? "," : "");
+    }
+    fmt::format_to(out, "  ]\n}}\n");
+    return fmt::to_string(buf);
+}
+
+int main(int argc, char **argv) {
+    auto args = docopt::docopt(USAGE, {argv + 1, argv + argc}, true);
+
+    std::vector<int> pidCounts = {1000, 10000, 100000};
+    std::chrono::milliseconds minTime(200);
+    std::string fixtureDir = "/tmp/res_monitor_bench";
+    try {
+        if (args["--pids"].isString()) {
+            pidCounts.clear();
+            std::string list = args["--pids"].asString();
+            for (size_t pos = 0; pos < list.size();) {
+                auto comma = list.find(',', pos);
+                if (comma == std::string::npos) comma = list.size();
+                if (comma > pos) pidCounts.push_back(std::stoi(list.substr(pos, comma - pos)));
+                pos = comma + 1;
+            }
+        }
+        if (args["--min-time"].isString()) {
+            minTime = std::chrono::milliseconds(std::stoull(args["--min-time"].asString()));
+        }
+        if (args["--fixture-dir"].isString()) fixtureDir = args["--fixture-dir"].asString();
+    } catch (const std::exception &e) {
+        std::cerr << "参数解析错误: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::vector<BenchResult> results;
+    if (!args["--no-live"].asBool()) {
+        benchSource("live", MonitorEnvironment{}, minTime, results);
+    }
+
+    for (int count : pidCounts) {
+        FixtureOptions options;
+        options.numPids = count;
+        auto root = fs::path(fixtureDir) / fmt::format("pids-{}", count);
+        std::cerr << fmt::format("generating {} ...\n", root.string());
+        generateFixture(root.string(), options);
+
+        MonitorEnvironment environment;
+        environment.procRoot = (root / "proc").string();
+        environment.sysRoot = (root / "sys").string();
+        benchSource("fixture", environment, minTime, results);
+        fs::remove_all(root);
+    }
+
+    auto json = toJson(results);
+    if (args["--output"].isString()) {
+        std::ofstream(args["--output"].asString()) << json;
+    } else {
+        std::cout << json;
+    }
+    return 0;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <string>
+#include <memory>
+#include "snapshot_channel.h"
+
+// agent模式：把每份快照编码后经一条长连接推送给aggregator，协议见agent_protocol.h。
+// 编码线程从SnapshotChannel读取新快照，编码后放入本地环形缓冲；发送线程把尚未发送的快照
+// 合并为一批压缩发送（通常每个周期一批），收到确认后才从缓冲中删除。
+// 连接断开时按1秒起、最长30秒的退避重连，重连后从最早未确认的快照开始补发；
+// 缓冲满时丢弃最旧的快照。采样线程不会被网络阻塞
+class AgentClient {
+public:
+    AgentClient();
+    ~AgentClient();
+
+    // server格式为host:port；host为上报的主机名；backlog为缓冲保留的快照数。
+    // 地址格式错误时抛出std::runtime_error，连接失败不抛出，在后台重试
+    void start(const std::string &server, const std::string &host, size_t backlog, const SnapshotChannel &channel);
+
+    // 编码线程在channel关闭后退出，须先关闭channel再调用；未确认的快照丢弃
+    void stop();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
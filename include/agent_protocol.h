@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <bit>
+
+// agent与aggregator之间的TCP协议。每帧为FrameHeader加payloadSize字节的负载，
+// 字段按小端序（只支持小端主机）：
+//   Hello  agent连接后首先发送；sequence为agent进程的会话号，负载为主机名
+//   Batch  agent发送；一批count份连续的快照，sequence为第一份的序号，原始负载为count个
+//          (LEB128长度, snapshot_codec.h编码的快照)，flags含kCompressed时负载经lz_codec.h压缩，
+//          字典为同一连接上一个Batch的原始负载（连接上的第一个Batch没有字典）
+//   Ack    aggregator发送；sequence为已写入记录的最后一份快照的序号，agent据此丢弃本地的副本
+// 连接断开后agent重连并从最早未确认的快照开始重发，aggregator按会话号和序号丢弃重复的快照
+namespace agent {
+
+static_assert(std::endian::native == std::endian::little, "agent protocol assumes a little-endian host");
+
+constexpr uint32_t kMagic = 0x32414d52;         // "RMA2"，快照编码变化时递增，旧版本的对端在Hello时即被拒绝
+constexpr uint32_t kMaxPayload = 16 << 20;      // 超出视为协议错误
+
+enum class FrameType : uint8_t {
+    Hello = 1,
+    Batch = 2,
+    Ack = 3,
+};
+
+constexpr uint8_t kCompressed = 1;
+
+struct FrameHeader {
+    uint32_t magic = kMagic;
+    FrameType type = FrameType::Hello;
+    uint8_t flags = 0;
+    uint16_t count = 0;
+    uint32_t rawSize = 0;       // 解压后的负载大小
+    uint32_t payloadSize = 0;
+    uint64_t sequence = 0;
+};
+static_assert(sizeof(FrameHeader) == 24);
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include "snapshot.h"
+#include "query_protocol.h"
+
+// aggregator中一台主机的状态
+struct HostState {
+    std::string host;
+    bool connected = false;
+    std::chrono::system_clock::time_point lastSeen;     // 最近一次收到快照的时间
+    uint64_t snapshots = 0;     // 收到的快照数，不含重复
+    uint64_t missed = 0;        // agent缓冲满时丢弃、没有送达的快照数
+    std::shared_ptr<const Snapshot> latest;
+};
+
+// aggregator模式：在一个epoll线程中接收多个agent的快照（协议见agent_protocol.h），
+// 保存每台主机最近的快照，并把所有主机的快照按到达顺序写入同一个记录文件（文本，每行带主机名），
+// 写入后才向agent确认。主机以agent上报的主机名区分，须保证唯一。
+// 收到的快照同时加入fleet_index.h的索引，用于回答整个集群的查询
+class Aggregator {
+public:
+    Aggregator();
+    ~Aggregator();
+
+    // listen格式为host:port；recordPath为空时不写记录；每台主机的分位数统计最近history份快照；
+    // 失败抛出std::runtime_error
+    void start(const std::string &listen, const std::string &recordPath, size_t history);
+    void stop();
+
+    // 各主机的状态，按主机名排序；可在任意线程调用
+    std::vector<HostState> hosts() const;
+
+    // 回答Fleet*查询（QueryHandler），可在任意线程调用，期间阻塞接收快照
+    query::Status answer(const query::Request &request, query::ResponseHeader &header, std::vector<char> &response) const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
@@ -0,0 +1,46 @@
+#pragma once
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <spdlog/sinks/base_sink.h>
+
+// 日志文件的压缩方式
+enum class LogCompression {
+    None,       // spdlog的rotating_file_sink，不压缩
+    Rotate,     // 当前文件为文本，轮转后在后台压缩
+    Stream,     // 当前文件直接写为gzip流
+};
+
+// 解析none|rotate|stream，不合法时抛出std::invalid_argument
+LogCompression parseLogCompression(std::string_view text);
+
+// base为logs/monitor.log时，第index个归档为logs/monitor.<index>.log（与rotating_file_sink相同），compressed时再加.gz
+std::filesystem::path logArchivePath(const std::filesystem::path &base, size_t index, bool compressed);
+
+// newest成为1号归档，已有归档的序号依次加一，超出maxFiles的删除；newest改名失败时抛出std::runtime_error
+void shiftLogArchives(const std::filesystem::path &base, size_t maxFiles, const std::filesystem::path &newest, bool compressed);
+
+// 轮转时压缩的文件日志（压缩实现见gzip.h），保留最近maxFiles个归档monitor.1.log.gz…monitor.N.log.gz，
+// 序号越大越旧。压缩、归档改名和删除都在后台线程进行，写日志的线程不会因此阻塞：
+//   Rotate：monitor.log超过maxSize时只把它改名为monitor.log.<序号>并重新打开，由后台线程按顺序压缩归档；
+//     退出时还没压缩的文件留在目录中，下次启动时补压
+//   Stream：日志追加到内存缓冲，后台线程压缩后写入monitor.log.gz，每64KB或每秒sync flush一次，
+//     zcat可以读出最近一秒之前的内容；压缩后超过maxSize时结束gzip流并归档。启动时已有的monitor.log.gz
+//     （上次可能没有正常结束）先归档。后台线程跟不上时缓冲最多64MB，超出的日志丢弃，之后记录丢弃的字节数
+class CompressedFileSink : public spdlog::sinks::base_sink<std::mutex> {
+public:
+    // 打开当前文件失败时抛出std::runtime_error
+    CompressedFileSink(const std::filesystem::path &base, size_t maxSize, size_t maxFiles, LogCompression mode);
+    ~CompressedFileSink() override;
+
+protected:
+    void sink_it_(const spdlog::details::log_msg &msg) override;
+
+    // Stream模式下只通知后台线程尽快sync flush，不等待
+    void flush_() override;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include "resource_monitor.h"
+#include "delta_report.h"
+
+// 运行中可以调整的全部配置。命令行给出初始值，配置文件中出现的项覆盖命令行
+struct MonitorConfig {
+    std::chrono::seconds interval{10};
+    SampleOptions sample;
+    MemRank memRank = MemRank::Rss;
+    std::chrono::milliseconds smapsBudget{20};
+    double cpuBudget = 0;           // 单核百分比，0为不限制
+    GroupBy groupBy = GroupBy::None;
+    std::vector<GroupPattern> groupPatterns;
+    std::string filter;             // 空为不过滤
+    std::chrono::seconds selfReport{60};
+    bool console = true;            // 是否输出到控制台，日志文件始终输出
+    std::string logLevel = "info";  // trace|debug|info|warn|error|critical
+    DeltaOptions delta;
+};
+
+// 以下解析函数格式不合法时抛出std::invalid_argument
+MemRank parseMemRank(std::string_view text);     // rss|pss|uss|swap
+GroupBy parseGroupBy(std::string_view text);     // comm|user|session|tree|pattern
+std::vector<GroupPattern> parseGroupPatterns(std::string_view text);   // name=regex;...
+// 逗号分隔，如"5%,pct=1,mem=16M,io=64K,iops=10,await=1,temp=1"：百分数为相对阈值，其余为各类指标的绝对阈值，
+// mem和io可带K/M/G后缀；未出现的项取defaults中的值
+DeltaOptions parseEpsilon(std::string_view text, const DeltaOptions &defaults);
+// 时长，如"200ms"、"1.5s"，不带单位时为毫秒
+std::chrono::milliseconds parseDuration(std::string_view text);
+
+// 配置文件每行一项"key = value"，#开头为注释，值可以用双引号括起（到最后一个引号为止原样保留）：
+//   interval = 10                   # 更新间隔(秒)，同-i
+//   min_cpu = 1                     # 同-c(%)，min_mem同-m(MB)，min_disk同-d(KB/s)
+//   top = 3                         # 同-n
+//   mem_rank = rss                  # 同--mem-rank，smaps_budget、cpu_budget、self_report同名选项
+//   group = pattern                 # 同--group
+//   group_pattern = web=nginx;db=mysqld
+//   filter = "rss > 1G && uid != 0"
+//   period.cpu = 1                  # 各采集项的周期(次)，0为不采集：cpu memory disk temperature process
+//   keyframe = 6                    # 同--keyframe
+//   epsilon = 5%,pct=2              # 同--epsilon
+//   console = true                  # 是否输出到控制台
+//   log_level = info
+// 未出现的项取defaults中的值。解析时编译filter和分组规则，保证应用时不会失败；
+// 错误信息带行号，抛出std::invalid_argument或std::regex_error
+MonitorConfig parseConfig(std::string_view text, const MonitorConfig &defaults);
+
+// 读取并解析path，读取失败抛出std::runtime_error
+MonitorConfig loadConfig(const std::string &path, const MonitorConfig &defaults);
+
+// 用inotify监视配置文件所在的目录，覆盖写入、改名替换（编辑器和ConfigMap的常见做法）都能感知；
+// 内容变化且解析成功时在后台线程中调用onChange，解析失败时记录错误并保留当前配置
+class ConfigWatcher {
+public:
+    ConfigWatcher();
+    ~ConfigWatcher();
+
+    // 失败抛出std::runtime_error
+    void start(const std::string &path, const MonitorConfig &defaults,
+        std::function<void(MonitorConfig)> onChange);
+    void stop();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
@@ -0,0 +1,96 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+// DDSketch：相对误差有界的流式分位数估计。值按对数分桶，桶号为ceil(log_gamma(v))，
+// gamma = (1 + a) / (1 - a)，任意分位数的估计值与真实值的相对误差不超过a。
+// 桶只保存计数，同一个值总是落入同一个桶，因此可以精确地移除以前加入的值，
+// 用于滑动窗口和"每台主机的最新值"这类会被替换的集合。
+// 只处理非负值，小于kMinValue的值（含0和负值）计入零桶；桶按用到的范围连续存放，
+// 1%精度下从kMinValue到1e15也只有约2000个桶，不做合并
+class DDSketch {
+public:
+    static constexpr double kMinValue = 1e-3;
+
+    explicit DDSketch(double relativeAccuracy = 0.01)
+        : gamma_((1 + relativeAccuracy) / (1 - relativeAccuracy)), logGamma_(std::log(gamma_)) {
+    }
+
+    void add(double value) { update(value, 1); }
+
+    // value须是以前加入过的值
+    void remove(double value) { update(value, -1); }
+
+    uint64_t count() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+    // q在[0, 1]之间，返回排名为q * (count - 1)的值的估计；没有值时返回0
+    double quantile(double q) const {
+        if (count_ == 0) return 0;
+        auto rank = static_cast<int64_t>(std::clamp(q, 0.0, 1.0) * (count_ - 1));
+        // 常用的是p90、p99这类高分位数，从较近的一端开始累加，跳过的空桶更少
+        if (rank >= count_ / 2) {
+            int64_t above = count_ - 1 - rank;     // 比它大的值的个数
+            int64_t seen = 0;
+            for (size_t i = bins_.size(); i-- > 0;) {
+                seen += bins_[i];
+                if (seen > above) return value(offset_ + static_cast<int>(i));
+            }
+            return 0;
+        }
+        int64_t seen = zero_;
+        if (seen > rank) return 0;
+        for (size_t i = 0; i < bins_.size(); ++i) {
+            seen += bins_[i];
+            if (seen > rank) return value(offset_ + static_cast<int>(i));
+        }
+        return value(offset_ + static_cast<int>(bins_.size()) - 1);
+    }
+
+private:
+    double gamma_;
+    double logGamma_;
+    int offset_ = 0;                // bins_[0]的桶号
+    std::vector<int64_t> bins_;
+    int64_t zero_ = 0;
+    int64_t count_ = 0;
+
+    int key(double value) const {
+        return static_cast<int>(std::ceil(std::log(value) / logGamma_));
+    }
+
+    // 桶key覆盖(gamma^(key-1), gamma^key]，取使相对误差最小的代表值
+    double value(int key) const {
+        return 2 * std::pow(gamma_, key) / (gamma_ + 1);
+    }
+
+    void update(double value, int64_t delta) {
+        count_ += delta;
+        if (!(value >= kMinValue)) {
+            zero_ += delta;
+            return;
+        }
+        int k = key(value);
+        if (bins_.empty()) {
+            offset_ = k;
+            bins_.push_back(0);
+        } else if (k < offset_) {
+            bins_.insert(bins_.begin(), offset_ - k, 0);
+            offset_ = k;
+        } else if (k >= offset_ + static_cast<int>(bins_.size())) {
+            bins_.resize(k - offset_ + 1, 0);
+        }
+        bins_[k - offset_] += delta;
+        // 移除后两端的空桶收缩，避免窗口滑过后范围只增不减
+        while (!bins_.empty() && bins_.back() == 0) bins_.pop_back();
+        size_t leading = 0;
+        while (leading < bins_.size() && bins_[leading] == 0) ++leading;
+        if (leading > 0) {
+            bins_.erase(bins_.begin(), bins_.begin() + leading);
+            offset_ += static_cast<int>(leading);
+        }
+    }
+};
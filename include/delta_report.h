@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "snapshot.h"
+
+// 变化输出的选项。一项指标与它上次输出的值相差超过max(绝对阈值, relative × |上次的值|)才再次输出，
+// 与上次输出比较而不是与上个周期比较，缓慢的漂移累积到阈值后同样会输出
+struct DeltaOptions {
+    int keyframe = 0;               // 每隔多少个周期输出一次完整快照（关键帧），0和1为每次都完整输出
+    double relative = 0.05;
+    double percent = 1;             // 百分点：CPU、内存使用率、磁盘繁忙率，以及进程和分组的CPU
+    double bytes = 16 << 20;        // 内存各项、进程和分组的内存
+    double rate = 64 << 10;         // 字节/秒：磁盘、进程和分组的读写速率
+    double iops = 10;
+    double awaitMs = 1;
+    double celsius = 1;
+
+    bool operator==(const DeltaOptions &) const = default;
+};
+
+// 变化输出（change data capture）：每keyframe个周期输出一次完整快照，其间只输出超过阈值的指标
+// 和top-N成员的变化，安静的主机上大多数周期没有任何输出。
+// 主机CPU、内存、每个磁盘和每个温度传感器各算一项，top-N列表和分组列表按pid/分组名逐项比较，
+// 进程只比较所在列表的排序依据；监视进程的汇总每个周期都照常输出，扫描覆盖率只在关键帧输出
+class DeltaReporter {
+public:
+    // 下一份快照为关键帧
+    void setOptions(const DeltaOptions &options);
+    const DeltaOptions &options() const { return options_; }
+
+    // 处理下一份快照：为关键帧时返回true，由调用方输出完整快照；否则把变化逐行追加到lines。
+    // 行首"~"为数值变化（格式与完整输出相同），"+"为进入列表，"-"为离开列表（带最后一次输出的值）
+    bool next(const Snapshot &snapshot, std::vector<std::string> &lines);
+
+private:
+    DeltaOptions options_;
+    uint64_t ticks_ = 0;            // 上一个关键帧以来的周期数
+    Snapshot reported_;             // 各项最后一次输出的值
+
+    bool moved(double last, double current, double absolute) const;
+};
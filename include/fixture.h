@@ -0,0 +1,26 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+// 合成的procfs/sysfs目录树，用于在没有真实负载的机器上测量采集开销。
+// 生成的目录结构：
+//   <root>/proc/{stat,meminfo,diskstats}
+//   <root>/proc/<pid>/{stat,statm,io,cmdline,status,smaps_rollup}
+//   <root>/sys/block/<disk> -> ../devices/...  （整盘、分区、dm、loop）
+//   <root>/sys/class/block/<dev>
+//   <root>/sys/class/hwmon/hwmonN、<root>/sys/class/thermal/thermal_zoneN
+// 所有计数器都是(pid, tick)的确定函数，配合MonitorEnvironment::clock可得到确定的速率。
+struct FixtureOptions {
+    int numPids = 1000;
+    int numSensors = 8;
+    int numDisks = 2;
+    int numCpus = 4;
+};
+
+// 生成完整的目录树，计数器取第tick个周期的值。root下已有的proc、sys会被替换，
+// 但不是此前生成的（没有标记文件）时抛出std::runtime_error，不删除任何内容
+void generateFixture(const std::string &root, const FixtureOptions &options, uint64_t tick = 0);
+
+// 只重写随时间变化的文件（CPU时间、IO计数、磁盘计数），推进到第tick个周期；
+// root不是generateFixture生成的目录时抛出std::runtime_error
+void advanceFixture(const std::string &root, const FixtureOptions &options, uint64_t tick);
@@ -0,0 +1,70 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <array>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include "snapshot.h"
+#include "ddsketch.h"
+#include "query_protocol.h"
+
+// aggregator的内存索引，按主机、指标和进程分组组织，整个集群的查询不必遍历每台主机的快照：
+//   每台主机每个指标一个DDSketch，覆盖最近window份快照，回答FleetHosts；常用的分位数在快照到达时算好，
+//   与最新值一起放在按主机连续存放的摘要中，查询时顺序扫描，不必逐台访问草图
+//   每个指标一个DDSketch保存所有主机的最新值，每个(进程分组, 指标)同样一个，回答FleetDistribution
+//   每个排序依据一个按值降序的有序索引，保存所有主机最新的top-N进程，FleetTop只需从头取n项
+// 新快照到达时先移除该主机旧的值再加入新的值，除FleetHosts与主机数成正比外，查询的开销与主机数和快照数无关。
+// 不是线程安全的
+class FleetIndex {
+public:
+    explicit FleetIndex(size_t window);
+
+    // host的下一份快照，须按采样先后调用
+    void add(const std::string &host, const Snapshot &snapshot);
+    void setConnected(const std::string &host, bool connected);
+
+    // 按query_protocol.h回答Fleet*查询，其余类型返回BadRequest
+    query::Status answer(const query::Request &request, query::ResponseHeader &header, std::vector<char> &response) const;
+
+private:
+    static constexpr size_t kMetrics = 3;   // 按query::SortKey编号
+    static constexpr std::array<float, 4> kHostQuantiles = {0.5f, 0.9f, 0.95f, 0.99f};
+    using Values = std::array<float, kMetrics>;
+
+    struct TopEntry {
+        const std::string *host;
+        query::ProcessRecord process;
+    };
+    using TopIndex = std::multimap<float, TopEntry, std::greater<float>>;
+
+    // 一台主机的摘要，FleetHosts只读这里
+    struct Summary {
+        const std::string *host = nullptr;
+        std::array<std::array<float, kHostQuantiles.size()>, kMetrics> quantiles{};
+        Values latest{};
+        uint32_t samples = 0;
+        bool connected = false;
+    };
+
+    struct Host {
+        size_t slot = 0;                        // 在summaries_中的位置
+        std::deque<Values> window;              // 最近的快照的指标，从旧到新
+        std::array<DDSketch, kMetrics> sketches;
+        std::unordered_map<std::string, Values> groups;     // 最新快照中各分组的值
+        std::array<std::vector<TopIndex::iterator>, kMetrics> top;
+    };
+
+    size_t window_;
+    std::map<std::string, Host> hosts_;     // 节点地址稳定，TopEntry和Summary引用其中的主机名
+    std::vector<Summary> summaries_;
+    std::array<DDSketch, kMetrics> fleet_;
+    std::unordered_map<std::string, std::array<DDSketch, kMetrics>> groups_;
+    std::array<TopIndex, kMetrics> top_;
+    uint64_t snapshots_ = 0;
+    int64_t latestMs_ = 0;
+
+    Host &host(const std::string &name);
+    void updateTop(const std::string &name, Host &host, const Snapshot &snapshot);
+    void updateGroups(Host &host, const Snapshot &snapshot);
+};
@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+
+// gzip（RFC 1952/1951）流式压缩，不依赖zlib，输出可直接用zcat/gzip -d读取。
+// 以32KB滑动窗口做LZ77（哈希链，贪心匹配），每个块按统计出的频率生成动态Huffman码，
+// 与固定Huffman码和不压缩的存储块比较后取最短的一种；日志这类重复多的文本通常可压缩十倍左右。
+// 输入先在内部累积，满一个块才压缩，write之间的分割不影响输出
+class GzipEncoder {
+public:
+    GzipEncoder();
+
+    // 压缩input，产生的字节追加到output（第一次调用时先输出gzip头）
+    void write(std::string_view input, std::string &output);
+
+    // 压缩已缓冲的全部输入并以空的存储块结束（同zlib的Z_SYNC_FLUSH），
+    // 此前写入的内容在已输出的字节中都能解压出来，供读取仍在写入的文件
+    void flush(std::string &output);
+
+    // 压缩剩余输入，输出最后一个块和gzip尾（CRC32、长度），之后不能再写入
+    void finish(std::string &output);
+
+    // 已写入的未压缩字节数
+    uint64_t inputSize() const { return inputSize_; }
+
+private:
+    std::string window_;            // 最近32KB的历史，之后是未压缩的输入
+    size_t history_ = 0;            // window_中历史部分的长度
+    std::vector<int32_t> head_;     // 哈希槽中最近一次出现的位置
+    std::vector<int32_t> prev_;     // 同一哈希值上一次出现的位置
+    std::vector<uint32_t> symbols_; // 当前块的LZ77结果：低16位为字面量/长度，高16位为距离
+    uint64_t bitBuffer_ = 0;
+    int bitCount_ = 0;
+    uint32_t crc_ = 0;
+    uint64_t inputSize_ = 0;
+    bool started_ = false;
+    bool finished_ = false;
+
+    void compressBlock(bool last, std::string &output);
+    void putBits(uint32_t bits, int count, std::string &output);
+    void alignToByte(std::string &output);
+};
+
+// 把source压缩为gzip格式写入target，出错时抛出std::runtime_error
+void gzipFile(const std::filesystem::path &source, const std::filesystem::path &target);
@@ -0,0 +1,16 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+// 面向速度的LZ77压缩（块格式与LZ4相同，不含帧头），用于agent上报的快照批次。
+// 每个序列为：token（高4位字面量长度，低4位匹配长度-4，值为15时后接每字节累加的扩展长度，
+// 遇到小于255的字节结束），字面量，2字节小端偏移，扩展的匹配长度；最后一个序列只有字面量。
+// 单份快照内重复的内容不多，压缩时以上一批作为字典（匹配可以引用字典末尾64KB），
+// 相邻快照间相同的命令行、设备名和数值使每个周期的批次也能压缩数倍
+
+// 压缩input并追加到output
+void lzCompress(std::string_view input, std::string &output, std::string_view dictionary = {});
+
+// 解压input并追加到output，解压后必须恰好为size字节，dictionary须与压缩时相同；
+// 数据损坏时抛出std::runtime_error
+void lzDecompress(std::string_view input, size_t size, std::string &output, std::string_view dictionary = {});
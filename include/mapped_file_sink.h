@@ -0,0 +1,31 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <spdlog/sinks/base_sink.h>
+
+// 预分配、mmap写入的文件日志：写一行只是一次memcpy和一次原子的尾部更新，不经过stdio，
+// 写日志的线程上除轮转外没有系统调用，延迟稳定在微秒级。
+//   当前段monitor.log用fallocate预分配为maxSize并整段映射，写满时直接切换到后台线程预先建好并映射的
+//   下一段monitor.log.next，切换只是交换指针；
+//   后台线程把写满的段msync、截断到实际长度后归档为monitor.1.log…monitor.N.log（与rotating_file_sink的命名相同），
+//   把下一段改名为monitor.log，再预建新的下一段；每隔flushInterval把新写入的部分msync到磁盘，
+//   flush()只通知它尽快msync，不等待。
+// 运行中当前段的长度为maxSize，未写的部分为0字节；退出时截断到实际长度，异常退出后下次启动从最后一个非0字节之后接着写。
+// 后台线程来不及预建下一段时（单段写满的速度快过一次fallocate），在写日志的线程上同步创建
+class MappedFileSink : public spdlog::sinks::base_sink<std::mutex> {
+public:
+    // 创建或映射当前段失败时抛出std::runtime_error
+    MappedFileSink(const std::filesystem::path &base, size_t maxSize, size_t maxFiles,
+                   std::chrono::milliseconds flushInterval = std::chrono::seconds(1));
+    ~MappedFileSink() override;
+
+protected:
+    void sink_it_(const spdlog::details::log_msg &msg) override;
+    void flush_() override;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+#include <memory>
+#include "snapshot_channel.h"
+
+// 内置HTTP服务，以OpenMetrics文本格式提供最近一次采样结果（GET /metrics）。
+// 渲染线程从SnapshotChannel读取每份新快照，渲染出完整响应后原子替换缓存；
+// 抓取请求只发送缓存内容，不会触发采集或重新格式化，也不会阻塞采样线程。
+class MetricsExporter {
+public:
+    MetricsExporter();
+    ~MetricsExporter();
+
+    // listen格式为host:port，如127.0.0.1:9100；失败抛出std::runtime_error
+    void start(const std::string &listen, const SnapshotChannel &channel);
+
+    // 渲染线程在channel关闭后退出，须先关闭channel再调用
+    void stop();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
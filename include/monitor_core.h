@@ -0,0 +1,50 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <functional>
+#include <cstdint>
+#include "resource_monitor.h"
+
+// 供其他服务嵌入的采样接口（库res_monitor_core），C接口见res_monitor_c.h。
+// 库本身不创建线程：调用方在自己的线程（或定时器）中调用poll()，每次只执行有订阅且到期的采集项；
+// 订阅回调交给调用方提供的executor执行，未提供时在poll()的线程中同步执行。
+// 未执行的采集项基准不变，下次执行时按实际经过的时间计算速率，因此各订阅可以使用不同的周期。
+class MonitorCore {
+public:
+    // 订阅的采集项，与CollectorPeriods一一对应
+    enum class Topic {
+        Cpu,            // Snapshot::cpuPercent
+        Memory,         // Snapshot::mem
+        Disks,          // Snapshot::disksReady、disks
+        Temperatures,   // Snapshot::temperatures
+        Processes,      // Snapshot::topCpu/topMem/topDisk、分组和进程表
+    };
+    static constexpr size_t kTopicCount = 5;
+
+    // 回调收到本次采样的快照，只有本次执行的采集项有效，其余为默认值
+    using Callback = std::function<void(const Snapshot &snapshot)>;
+    // 执行一个任务，可以同步执行或投递到线程池；快照在任务执行完之前保持有效
+    using Executor = std::function<void(std::function<void()> task)>;
+
+    explicit MonitorCore(MonitorEnvironment environment = {}, Executor executor = {});
+    ~MonitorCore();
+
+    // 进程排名等设置（setMemRank、setFilter、setGrouping…）直接在采集器上调用，
+    // 与poll()一样只能在采样线程中调用
+    ResourceMonitor &monitor();
+
+    // top-N的数量、阈值和是否附带进程表；periods由订阅决定，设置的值不生效
+    void setSampleOptions(const SampleOptions &options);
+
+    // 每period次poll()执行一次topic并回调，返回用于取消订阅的id；可在任意线程调用
+    uint64_t subscribe(Topic topic, Callback callback, int period = 1);
+    void unsubscribe(uint64_t id);
+
+    // 采样一次并分发给到期的订阅，没有到期的采集项时不读取任何文件，返回nullptr；
+    // 同一时刻只能有一个线程调用
+    std::shared_ptr<const Snapshot> poll();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
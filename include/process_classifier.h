@@ -0,0 +1,39 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+// 把一组正则规则一次性编译为多模式匹配器，返回第一条匹配的规则（搜索语义，与std::regex_search一致）：
+//   不含元字符的规则合并为一个Aho-Corasick自动机，一遍扫描即可找出所有子串匹配；
+//   其余规则（字符类、重复、^/$锚定等）合并为一个NFA，匹配时按需构造DFA状态并缓存转移；
+//   自动机无法表达的写法（反向引用、环视、\b等）退回std::regex，只在前面的规则都不匹配时执行。
+// 匹配时会扩充DFA缓存，不是线程安全的，每个使用者各自持有一个实例
+class ProcessClassifier {
+public:
+    // patterns为ECMAScript正则，不合法时抛出std::regex_error
+    explicit ProcessClassifier(const std::vector<std::string> &patterns);
+    ~ProcessClassifier();
+
+    // 在text中搜索，返回第一条匹配的规则下标，都不匹配时返回-1
+    int classify(std::string_view text);
+
+    // 完整命令行或comm与规则匹配即可，与ProcessWatcher和GroupBy::Pattern的口径一致
+    int classify(std::string_view cmdline, std::string_view comm);
+
+    size_t size() const;
+
+    // 各部分编译到的规则数和当前缓存的DFA状态数
+    struct Stats {
+        size_t literals = 0;
+        size_t automaton = 0;
+        size_t fallback = 0;
+        size_t dfaStates = 0;
+    };
+    Stats stats() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
@@ -0,0 +1,65 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <cstdint>
+
+// 过滤表达式可以引用的进程字段
+enum class FilterField : uint8_t {
+    Pid,
+    Ppid,
+    Session,
+    Threads,
+    Uid,        // 有效UID，来自/proc/[pid]/status
+    User,       // UID对应的用户名
+    Comm,
+    Cmd,        // 完整命令行（参数以空格分隔），只支持~、!~、==、!=
+    Cpu,        // CPU占用(%)，口径与ProcessSample::cpuPercent相同
+    Rss,        // 字节
+    Read,       // 磁盘读速率(字节/秒)
+    Write,      // 磁盘写速率(字节/秒)
+    Io,         // 读写速率之和
+};
+
+// 求值时按需读取的字段，尚未采集的字段返回nullopt，表达式的结果随之为Unknown
+class FilterSource {
+public:
+    virtual ~FilterSource() = default;
+    virtual std::optional<double> number(FilterField field) = 0;
+    virtual std::optional<std::string_view> text(FilterField field) = 0;     // Comm、User
+    // cmd的第index条规则是否匹配，实现方可按进程缓存，再通过ProcessFilter::matchCommand计算
+    virtual std::optional<bool> commandMatches(size_t index) = 0;
+};
+
+// 过滤表达式，如：rss > 1G && cmd ~ "java" && uid != 0
+//   比较：== != < <= > >=，字符串字段另有正则匹配~和!~（ECMAScript，搜索语义）
+//   逻辑：&& || ! 和括号
+//   数值可带K/M/G/T后缀（1024进制），字符串用双引号
+// 解析一次后编译为短路求值的字节码，按三值逻辑计算：缺少的字段只在确实影响结果时才得到Unknown，
+// 采集端据此在读取更多文件之前先排除确定不满足的进程
+class ProcessFilter {
+public:
+    enum class Result {
+        False,
+        True,
+        Unknown,
+    };
+
+    // 语法错误时抛出std::invalid_argument，正则不合法时抛出std::regex_error
+    explicit ProcessFilter(std::string_view expression);
+    ~ProcessFilter();
+
+    // 只向source读取求值路径上用到的字段；内部的匹配器会缓存DFA状态，不是线程安全的
+    Result evaluate(FilterSource &source);
+
+    // cmd的第index条规则，index小于64
+    bool matchCommand(size_t index, std::string_view cmdline);
+
+    const std::string &expression() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
@@ -0,0 +1,36 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include "resource_monitor.h"
+#include "snapshot.h"
+
+// 监视列表：只采样指定的几个进程，不扫描整个/proc
+struct WatchOptions {
+    std::vector<int> pids;
+    std::vector<std::string> patterns;  // 与进程的完整命令行或comm做正则搜索(ECMAScript)
+    std::chrono::milliseconds rescanInterval{2000};  // 按patterns查找新进程的周期
+};
+
+// 对每个目标进程长期持有/proc/[pid]/{stat,io}的文件描述符，每次采样用pread读取，
+// 开销只与目标进程数有关。目标进程退出后读取失败，随下次collect()报告并移除；
+// 按patterns匹配的目标会定期在新出现的进程中重新查找
+class ProcessWatcher {
+public:
+    // patterns不是合法的正则表达式时抛出std::regex_error
+    explicit ProcessWatcher(WatchOptions options, MonitorEnvironment environment = {});
+    ~ProcessWatcher();
+
+    // 读取所有目标进程的计数，追加一个采样点
+    void sample();
+
+    // 取出自上次调用以来的时间序列，并移除已退出的进程
+    std::vector<WatchedProcess> collect();
+
+    size_t size() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
@@ -0,0 +1,146 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory_resource>
+#include <cstdint>
+
+// /proc/meminfo中的内存统计，除HugePages_*为页数外均为字节
+struct MemInfo {
+    uint64_t total = 0;
+    uint64_t free = 0;
+    uint64_t available = 0;
+    uint64_t buffers = 0;
+    uint64_t cached = 0;
+    uint64_t swapCached = 0;
+    uint64_t active = 0;
+    uint64_t inactive = 0;
+    uint64_t shmem = 0;
+    uint64_t slab = 0;
+    uint64_t sReclaimable = 0;
+    uint64_t sUnreclaim = 0;
+    uint64_t dirty = 0;
+    uint64_t writeback = 0;
+    uint64_t anonPages = 0;
+    uint64_t mapped = 0;
+    uint64_t swapTotal = 0;
+    uint64_t swapFree = 0;
+    uint64_t hugePagesTotal = 0;
+    uint64_t hugePagesFree = 0;
+    uint64_t hugePageSize = 0;
+    uint64_t hugetlb = 0;
+    bool hasAvailable = false;  // 3.14之前的内核没有MemAvailable
+
+    // 与free(1)一致：有MemAvailable时为total - available，
+    // 否则为total - free - buffers - cached - sReclaimable
+    uint64_t used() const;
+    uint64_t swapUsed() const { return swapTotal - swapFree; }
+};
+
+namespace procfs {
+
+// 当前线程经由本文件中的函数产生的系统调用计数，用于基准测试和自监控
+struct IoCounters {
+    uint64_t opens = 0;
+    uint64_t reads = 0;         // read/getdents调用次数
+    uint64_t closes = 0;
+    uint64_t bytesRead = 0;
+
+    uint64_t syscalls() const { return opens + reads + closes; }
+};
+IoCounters &ioCounters();
+
+// 一次性读取整个文件（/proc下的文件不能用stat获取大小），失败返回false
+bool readFile(const char *path, std::string &out);
+
+// 长期持有的文件：打开一次，之后每次用pread从头读取，省去open/close。
+// /proc/[pid]下的文件在进程退出后读取会失败(ESRCH)，pid被复用也不会读到新进程
+int openFile(const char *path);
+void closeFile(int fd);
+bool readAt(int fd, std::string &out);
+
+// 列出procRoot下所有数字命名的目录（即进程），结果追加到pids
+bool listPids(const char *procRoot, std::vector<int> &pids);
+
+// 列出目录下除.和..以外的所有条目名，结果追加到names
+bool listDir(const char *dir, std::pmr::vector<std::pmr::string> &names);
+
+// /proc/stat第一行的汇总CPU时间（单位为USER_HZ）
+struct CpuTimes {
+    uint64_t user = 0;
+    uint64_t nice = 0;
+    uint64_t system = 0;
+    uint64_t idle = 0;
+    uint64_t iowait = 0;
+    uint64_t irq = 0;
+    uint64_t softirq = 0;
+    uint64_t steal = 0;
+
+    // guest时间已计入user，不重复累加
+    uint64_t total() const { return user + nice + system + idle + iowait + irq + softirq + steal; }
+    uint64_t idleTotal() const { return idle + iowait; }
+};
+bool parseCpuTimes(std::string_view text, CpuTimes &times);
+
+// 单遍解析/proc/meminfo的内容，未出现的字段保持为0
+void parseMeminfo(std::string_view text, MemInfo &info);
+
+// /proc/diskstats的一行，name指向输入文本
+struct DiskstatsEntry {
+    unsigned major = 0;
+    unsigned minor = 0;
+    std::string_view name;
+    uint64_t reads = 0;
+    uint64_t readMerges = 0;
+    uint64_t readSectors = 0;
+    uint64_t readTicks = 0;
+    uint64_t writes = 0;
+    uint64_t writeMerges = 0;
+    uint64_t writeSectors = 0;
+    uint64_t writeTicks = 0;
+    uint64_t inFlight = 0;
+    uint64_t ioTimeMs = 0;
+    uint64_t weightedIoTimeMs = 0;
+};
+void parseDiskstats(std::string_view text, std::vector<DiskstatsEntry> &entries);
+
+// /proc/[pid]/stat，comm可能包含空格和括号，以最后一个')'为界；comm指向输入文本
+struct ProcStat {
+    int pid = 0;
+    std::string_view comm;
+    char state = '?';
+    int ppid = 0;
+    int pgrp = 0;
+    int session = 0;
+    uint64_t utime = 0;
+    uint64_t stime = 0;
+    uint64_t cutime = 0;
+    uint64_t cstime = 0;
+    uint64_t numThreads = 0;
+    uint64_t startTime = 0;     // 进程启动时刻（开机后的USER_HZ），与pid一起唯一标识一个进程
+    uint64_t vsize = 0;
+    uint64_t rssPages = 0;
+};
+bool parseProcStat(std::string_view text, ProcStat &stat);
+
+// /proc/[pid]/status中Uid行的有效UID（第二列）
+bool parseStatusUid(std::string_view text, uint32_t &uid);
+
+// /proc/[pid]/statm，单位为页
+struct ProcStatm {
+    uint64_t size = 0;
+    uint64_t resident = 0;
+    uint64_t shared = 0;
+};
+bool parseStatm(std::string_view text, ProcStatm &statm);
+
+// /proc/[pid]/io，单位为字节
+struct ProcIo {
+    uint64_t rchar = 0;
+    uint64_t wchar = 0;
+    uint64_t readBytes = 0;
+    uint64_t writeBytes = 0;
+};
+bool parseProcIo(std::string_view text, ProcIo &io);
+
+}
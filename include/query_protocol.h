@@ -0,0 +1,125 @@
+#pragma once
+#include <cstdint>
+
+// 本地查询服务的二进制协议。只在同一台机器上通过Unix域套接字使用，字段按本机字节序。
+// 每个连接一次请求：客户端发送Request，服务端回复ResponseHeader和count条定长记录后关闭连接：
+//   Top      count条ProcessRecord，按sortKey降序
+//   Process  一条ProcessRecord（最近一次的值），随后count条SeriesPoint，按时间先后
+//   Disks    count条DiskRecord，按时间先后，同一时刻的各设备相邻
+// 以下只由aggregator回答，单机模式返回BadRequest；sortKey为指标，主机的Mem为内存使用率，
+// Disk为各整盘读写速率之和，分组的Mem为RSS：
+//   FleetTop           count条FleetProcessRecord，所有主机最新的top-N列表合并后按sortKey降序
+//   FleetHosts         count条HostRecord，各主机最近快照中该指标的quantile分位数不小于threshold的主机，降序
+//   FleetDistribution  count条QuantileRecord，所有主机最新值的分布；group非空时为该进程分组的分布
+namespace query {
+
+constexpr uint32_t kMagic = 0x32514d52;     // "RMQ2"
+
+enum class Type : uint8_t {
+    Top = 1,
+    Process = 2,
+    Disks = 3,
+    FleetTop = 4,
+    FleetHosts = 5,
+    FleetDistribution = 6,
+};
+
+enum class SortKey : uint8_t {
+    Cpu,
+    Mem,
+    Disk,       // 读写速率之和
+};
+
+enum class Status : uint8_t {
+    Ok,
+    BadRequest,
+    NoData,     // 还没有快照，或快照中没有进程表
+    NotFound,   // 历史中没有该进程
+};
+
+struct Request {
+    uint32_t magic = kMagic;
+    Type type = Type::Top;
+    SortKey sortKey = SortKey::Cpu;
+    uint16_t reserved = 0;
+    int32_t pid = 0;
+    uint32_t count = 0;     // Top的进程数；Process和Disks最多返回的快照数，0为全部历史
+    float quantile = 0;     // FleetHosts使用的分位数，如0.95
+    float threshold = 0;    // FleetHosts只返回分位数不小于此值的主机
+    char group[64] = {};    // FleetDistribution的进程分组名，空为主机的指标
+};
+static_assert(sizeof(Request) == 88);
+
+struct ResponseHeader {
+    uint32_t magic = kMagic;
+    Type type = Type::Top;
+    Status status = Status::Ok;
+    uint16_t reserved = 0;
+    uint32_t count = 0;
+    uint32_t recordSize = 0;    // 每条记录的字节数（Process为SeriesPoint的大小）
+    int64_t timeMs = 0;         // 最近一次快照的时间，Unix毫秒
+    uint64_t generation = 0;    // 最近一次快照的序号；aggregator为收到的快照总数
+};
+static_assert(sizeof(ResponseHeader) == 32);
+
+struct ProcessRecord {
+    int32_t pid = 0;
+    float cpuPercent = 0;
+    uint64_t rssBytes = 0;
+    float readBytesPerSec = 0;
+    float writeBytesPerSec = 0;
+    char command[64] = {};      // 出现在top-N中的进程为完整命令行（截断），其余为comm
+};
+static_assert(sizeof(ProcessRecord) == 88);
+
+struct SeriesPoint {
+    int64_t timeMs = 0;
+    uint64_t rssBytes = 0;
+    float cpuPercent = 0;
+    float readBytesPerSec = 0;
+    float writeBytesPerSec = 0;
+    uint32_t reserved = 0;
+};
+static_assert(sizeof(SeriesPoint) == 32);
+
+struct DiskRecord {
+    int64_t timeMs = 0;
+    char name[32] = {};
+    float readBytesPerSec = 0;
+    float writeBytesPerSec = 0;
+    float readIops = 0;
+    float writeIops = 0;
+    float readAwaitMs = 0;
+    float writeAwaitMs = 0;
+    float busyPercent = 0;
+    float avgQueueSize = 0;
+    uint32_t inFlight = 0;
+    uint32_t reserved = 0;
+};
+static_assert(sizeof(DiskRecord) == 80);
+
+struct FleetProcessRecord {
+    char host[64] = {};
+    ProcessRecord process;      // 命令行来自agent的top-N列表；Mem时rssBytes为agent按--mem-rank统计的内存
+};
+static_assert(sizeof(FleetProcessRecord) == 152);
+
+struct HostRecord {
+    char host[64] = {};
+    float value = 0;            // 分位数的估计，相对误差不超过1%
+    float latest = 0;           // 最近一份快照的值
+    uint32_t samples = 0;       // 参与统计的快照数
+    uint8_t connected = 0;
+    uint8_t reserved[3] = {};
+};
+static_assert(sizeof(HostRecord) == 80);
+
+struct QuantileRecord {
+    float quantile = 0;
+    float value = 0;            // 相对误差不超过1%
+    uint32_t samples = 0;       // 参与统计的主机数
+    uint32_t reserved = 0;
+};
+static_assert(sizeof(QuantileRecord) == 16);
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <new>
+#include "snapshot_channel.h"
+#include "query_protocol.h"
+
+// 本地查询服务：在Unix域套接字上按query_protocol.h回答查询。
+// 历史线程把SnapshotChannel中的每份新快照放入环形缓冲（只持有指针，不拷贝）；
+// 服务线程逐个处理连接，答案全部来自已有的快照，查询不会触发采集，也不会阻塞采样线程。
+
+// 回答一次请求：填写header的count、recordSize、timeMs和generation，用appendRecord把记录追加到response
+// （开头已预留ResponseHeader的位置），返回状态；只在服务线程中调用
+using QueryHandler = std::function<query::Status(const query::Request &request, query::ResponseHeader &header,
+                                                 std::vector<char> &response)>;
+
+template <typename T>
+T &appendRecord(std::vector<char> &response) {
+    response.resize(response.size() + sizeof(T));
+    return *new (response.data() + response.size() - sizeof(T)) T();
+}
+
+class QueryServer {
+public:
+    QueryServer();
+    ~QueryServer();
+
+    // 保留最近history份快照；失败抛出std::runtime_error。
+    // path已存在且是套接字时先删除（上次异常退出的残留）
+    void start(const std::string &path, const SnapshotChannel &channel, size_t history);
+
+    // 由handler回答查询，不保留快照历史（aggregator模式）
+    void start(const std::string &path, QueryHandler handler);
+
+    // 历史线程在channel关闭后退出，须先关闭channel再调用；退出时删除套接字文件
+    void stop();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+// 一次查询的结果，records为header.count条定长记录（Process时前面还有一条ProcessRecord）
+struct QueryResponse {
+    query::ResponseHeader header;
+    query::ProcessRecord process;
+    std::vector<char> records;
+
+    template <typename T>
+    const T &record(size_t index) const {
+        return reinterpret_cast<const T *>(records.data())[index];
+    }
+};
+
+// 客户端：连接path发送一次请求并读取完整响应，失败抛出std::runtime_error
+QueryResponse sendQuery(const std::string &path, const query::Request &request);
@@ -0,0 +1,40 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <optional>
+#include <string_view>
+#include "snapshot.h"
+
+// 字节数转换为带单位的可读字符串，如"1.50 MB"
+std::string valueToHumanReadable(double value);
+
+// 日志中使用的各项文本格式
+std::string formatCpu(const std::optional<double> &cpuPercent);
+std::string formatMemory(const MemInfo &info);
+std::string formatDisks(bool ready, const std::vector<DiskStat> &disks);
+std::string formatTemperatures(const std::vector<TemperatureReading> &temperatures);
+std::string formatTopCpu(const ProcessSample &process);
+std::string formatTopMem(const ProcessSample &process, MemRank rank);
+std::string formatTopDisk(const ProcessSample &process);
+
+// 分组方式的名字，如"user"，用于参数和指标标签
+std::string_view groupByName(GroupBy groupBy);
+std::string formatTopCpuGroup(const ProcessGroup &group, GroupBy groupBy);
+std::string formatTopMemGroup(const ProcessGroup &group, GroupBy groupBy);
+std::string formatTopDiskGroup(const ProcessGroup &group, GroupBy groupBy);
+
+std::string formatScanCoverage(const ScanCoverage &coverage);
+
+// 监视进程在一个汇报周期内的汇总，points为空时各项为0
+struct WatchSummary {
+    size_t samples = 0;
+    WatchPoint last;
+    double avgCpuPercent = 0;
+    double maxCpuPercent = 0;
+    uint64_t maxRssBytes = 0;
+    double avgReadBytesPerSec = 0;
+    double avgWriteBytesPerSec = 0;
+};
+WatchSummary summarizeWatched(const WatchedProcess &process);
+std::string formatWatched(const WatchedProcess &process);
+std::string formatCollectorStats(const CollectorStatsArray &collectors);
@@ -0,0 +1,124 @@
+#pragma once
+/* res_monitor_core的C接口，对应monitor_core.h中的MonitorCore。
+ * 返回int的函数成功为0、失败为-1，失败原因由rm_last_error()取得（每个线程各自保存）。
+ * 结构体只会在末尾追加字段；快照及其中的字符串只在回调执行期间有效。 */
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct rm_monitor rm_monitor;
+
+typedef enum rm_topic {
+    RM_TOPIC_CPU = 0,
+    RM_TOPIC_MEMORY = 1,
+    RM_TOPIC_DISKS = 2,
+    RM_TOPIC_TEMPERATURES = 3,
+    RM_TOPIC_PROCESSES = 4,
+} rm_topic;
+
+typedef enum rm_mem_rank {
+    RM_MEM_RANK_RSS = 0,
+    RM_MEM_RANK_PSS = 1,
+    RM_MEM_RANK_USS = 2,
+    RM_MEM_RANK_SWAP = 3,
+} rm_mem_rank;
+
+/* 字节，used与free(1)口径一致 */
+typedef struct rm_memory {
+    uint64_t total;
+    uint64_t used;
+    uint64_t free;
+    uint64_t available;
+    uint64_t buffers;
+    uint64_t cached;
+    uint64_t shmem;
+    uint64_t slab;
+    uint64_t dirty;
+    uint64_t writeback;
+    uint64_t swap_total;
+    uint64_t swap_free;
+} rm_memory;
+
+typedef struct rm_disk {
+    const char *name;
+    double read_bytes_per_sec;
+    double write_bytes_per_sec;
+    double read_iops;
+    double write_iops;
+    double read_await_ms;
+    double write_await_ms;
+    double busy_percent;
+    double avg_queue_size;
+    uint64_t in_flight;
+} rm_disk;
+
+/* 没有阈值时high、crit为NaN */
+typedef struct rm_temperature {
+    const char *chip;
+    const char *label;
+    double celsius;
+    double high;
+    double crit;
+    const char *hwmon;          /* hwmon目录名，区分同名的芯片 */
+} rm_temperature;
+
+typedef struct rm_process {
+    int32_t pid;
+    const char *cmdline;
+    double cpu_percent;
+    uint64_t mem_bytes;         /* 按rm_mem_rank统计 */
+    double read_bytes_per_sec;
+    double write_bytes_per_sec;
+} rm_process;
+
+/* 一次采样，只有回调订阅的采集项有效 */
+typedef struct rm_snapshot {
+    int64_t time_ms;            /* Unix毫秒 */
+    int has_cpu;                /* 首次采样没有CPU使用率 */
+    double cpu_percent;
+    rm_memory mem;
+    int disks_ready;            /* 首次采样没有磁盘速率 */
+    size_t disk_count;
+    const rm_disk *disks;
+    size_t temperature_count;
+    const rm_temperature *temperatures;
+    size_t top_cpu_count;
+    const rm_process *top_cpu;
+    size_t top_mem_count;
+    const rm_process *top_mem;
+    size_t top_disk_count;
+    const rm_process *top_disk;
+} rm_snapshot;
+
+typedef void (*rm_callback)(const rm_snapshot *snapshot, void *user);
+
+/* 调用方提供的executor收到run和task，须在某个线程中调用一次run(task) */
+typedef void (*rm_task)(void *task);
+typedef void (*rm_executor)(rm_task run, void *task, void *user);
+
+/* proc_root/sys_root为NULL或空字符串时使用/proc和/sys；executor为NULL时回调在rm_monitor_poll的线程中同步执行 */
+rm_monitor *rm_monitor_create(const char *proc_root, const char *sys_root, rm_executor executor, void *executor_user);
+void rm_monitor_destroy(rm_monitor *monitor);
+
+/* top-N的数量和阈值，count为0时不扫描进程；默认3个进程，1% CPU、1MB内存、1KB/s IO */
+int rm_monitor_set_processes(rm_monitor *monitor, int count, double min_cpu_percent,
+                             uint64_t min_mem_bytes, uint64_t min_disk_bytes_per_sec);
+int rm_monitor_set_mem_rank(rm_monitor *monitor, rm_mem_rank rank, int smaps_budget_ms);
+/* 语法与res_monitor --filter相同，NULL或空字符串为不过滤 */
+int rm_monitor_set_filter(rm_monitor *monitor, const char *expression);
+
+/* 每period次rm_monitor_poll执行一次topic并回调，返回订阅id，失败返回0；可在任意线程调用 */
+uint64_t rm_monitor_subscribe(rm_monitor *monitor, rm_topic topic, int period, rm_callback callback, void *user);
+void rm_monitor_unsubscribe(rm_monitor *monitor, uint64_t id);
+
+/* 采样一次并分发给到期的订阅：返回1；没有到期的订阅返回0；失败返回-1。同一时刻只能有一个线程调用 */
+int rm_monitor_poll(rm_monitor *monitor);
+
+const char *rm_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -2,12 +2,102 @@
 #include <string>
 #include <memory>
 #include <vector>
+#include <memory_resource>
+#include <cstdint>
+#include <chrono>
+#include <functional>
+#include <utility>
+#include "snapshot.h"
+
+// 采集的数据来源，可指向生成的测试目录以便基准测试和确定性测试
+struct MonitorEnvironment {
+    std::string procRoot = "/proc";
+    std::string sysRoot = "/sys";
+    // 计算速率使用的单调时钟，为空时使用std::chrono::steady_clock::now
+    std::function<std::chrono::steady_clock::time_point()> clock;
+};
+
+// 各采集项每隔几次采样执行一次，0为不采集。未到周期时快照沿用上次的结果，
+// 基准不变，下次执行时按实际经过的时间计算速率
+struct CollectorPeriods {
+    int cpu = 1;
+    int memory = 1;
+    int disks = 1;
+    int temperatures = 1;
+    int processes = 1;      // 进程top-N和分组
+};
+
+// 一次完整采样的参数
+struct SampleOptions {
+    int numProcesses = 3;               // 0为不扫描进程
+    double minCpuUsage = 0.01;          // 比例，0.01即1%
+    uint64_t minMemUsage = 1024*1024;   // 字节
+    uint64_t minDiskUsage = 1024;       // 字节/秒
+    CollectorPeriods periods;
+    bool processTable = false;          // 在快照中附带完整的进程表，供查询服务使用
+};
+
+// GroupBy::Pattern的一条规则：完整命令行（参数以空格分隔）或comm与regex匹配的进程归入name组，
+// 按顺序使用第一条匹配的规则
+struct GroupPattern {
+    std::string name;
+    std::string regex;  // ECMAScript
+
+    bool operator==(const GroupPattern &) const = default;
+};
 
 class ResourceMonitor {
 public:
+    using MemRank = ::MemRank;
+
     ResourceMonitor();
+    explicit ResourceMonitor(MonitorEnvironment environment);
     ~ResourceMonitor();
 
+    // 非RSS模式下只对RSS排名靠前的候选进程读取/proc/[pid]/smaps_rollup，
+    // 每次采样读取smaps_rollup的总耗时不超过budget，超出部分沿用缓存值
+    void setMemRank(MemRank rank, std::chrono::milliseconds budget = std::chrono::milliseconds(20));
+
+    // 限制采样自身占用的CPU（单核百分比，0为不限制），按sample()在调用线程上的CPU时间计算，
+    // 不含进程中的其他线程。超出时按比例轮转扫描部分进程，
+    // 跳过此前不活跃进程的io/smaps_rollup，并延长温度等慢速采集的周期
+    void setCpuBudget(double percent);
+
+    // 启用进程分组（None为关闭），regex不合法时抛出std::regex_error。
+    // 分组用到的comm、ppid、会话来自getTopCpu已读取的stat，UID和规则匹配结果每个进程只读取一次
+    void setGrouping(GroupBy groupBy, const std::vector<GroupPattern> &patterns = {});
+
+    // 只在满足表达式的进程中选取top-N和汇总分组（语法见process_filter.h），空字符串为不过滤；
+    // 表达式不合法时抛出std::invalid_argument或std::regex_error。
+    // 字段按需读取：uid/user首次用到时读取status，cmd首次用到时读取cmdline，结果随进程缓存；
+    // getTopMem/getTopDisk先只用stat中的字段求值，确定不满足的进程不再打开statm、io和smaps_rollup。
+    // 依赖同一次采样中getTopCpu读取的stat；getTopDisk之前的IO字段取上次采样的值
+    void setFilter(const std::string &expression);
+
+    // 依次调用下面所有结构化接口，得到一次完整采样
+    Snapshot sample(const SampleOptions &options);
+
+    // 只建立计算速率和CPU占用的基准：读取/proc/stat、/proc/diskstats和各进程的stat、io，
+    // 不读取meminfo、温度、statm和smaps_rollup。之后的sample()按实际经过的时间得到完整的结果
+    void prime(const SampleOptions &options);
+
+    std::optional<double> getCpuPercent();
+    MemInfo getMemInfo();
+    std::vector<DiskStat> getDiskStats();
+    std::vector<TemperatureReading> getTemperatures();
+    std::vector<ProcessSample> getTopCpu(int numProcesses, double minCpuUsage = 0.01);
+    std::vector<ProcessSample> getTopMem(int numProcesses, uint64_t minMemUsage = 1024*1024);
+    std::vector<ProcessSample> getTopDisk(int numProcesses, uint64_t minDiskUsage = 1024);
+
+    // 在一次遍历中按分组汇总最近一次getTopCpu/getTopMem/getTopDisk的结果，顺序不定；
+    // 未启用分组时为空
+    std::vector<ProcessGroup> getProcessGroups();
+
+    // 最近一次getTopCpu/getTopMem/getTopDisk得到的全部进程，按pid排序，内存固定按RSS统计；
+    // 设置了过滤表达式时只包含满足条件的进程
+    std::vector<ProcessEntry> getProcessTable();
+
+    // 以下接口返回格式化后的文本，格式见report.h
     std::string getCpuUsage();
     std::string getMemoryUsage();
     std::string getDiskIo();
@@ -17,7 +107,15 @@ public:
     std::vector<std::string> getTopCpuProcesses(int numProcesses, double minCpuUsage = 0.01);
     std::vector<std::string> getTopMemProcesses(int numProcesses, uint64_t minMemUsage = 1024*1024);
     std::vector<std::string> getTopDiskProcesses(int numProcesses, uint64_t minDiskUsage = 1024);
+
+    // 各结构化接口自身的耗时与开销
+    CollectorStatsArray getCollectorStats() const;
+    ScanCoverage getScanCoverage() const;
 private:
+    // 就地把按RSS统计的memories替换为按memRank统计的候选进程，仍按RSS排名的进程记入rssOnly（按pid排序）
+    void rankBySmaps(std::pmr::vector<std::pair<uint64_t, int>> &memories, int numProcesses,
+                     std::pmr::vector<int> &rssOnly);
+
     struct Impl;
     std::unique_ptr<Impl> impl_;
 };
@@ -0,0 +1,74 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+#include <string_view>
+
+// 被自监控的采集函数
+enum class Collector {
+    Cpu,
+    Memory,
+    Disk,
+    Temperature,
+    TopCpu,
+    TopMem,
+    TopDisk,
+    Groups,
+    Sample,     // 一次完整采样，包含以上全部
+};
+constexpr size_t kCollectorCount = 9;
+
+// 用于日志和指标标签的名字，如"top_cpu"
+std::string_view collectorName(Collector collector);
+
+// 一个采集函数的自监控统计
+struct CollectorStats {
+    uint64_t calls = 0;
+    double totalMs = 0;         // 累计耗时
+    double p50Ms = 0;           // 最近若干次调用的耗时分位数
+    double p99Ms = 0;
+
+    // 最近一次调用的开销
+    double lastMs = 0;
+    uint64_t opens = 0;
+    uint64_t bytesRead = 0;
+    uint64_t allocations = 0;   // 未链接res_monitor_alloc时恒为0
+};
+using CollectorStatsArray = std::array<CollectorStats, kCollectorCount>;
+
+// 当前线程的堆分配次数，由res_monitor_alloc（counting_allocator.cpp）替换的operator new累加
+uint64_t &threadAllocations();
+
+// 记录各采集函数的耗时（真实单调时钟）、打开文件数、读取字节数和堆分配次数，
+// 只应在采样线程中使用
+class SelfProfiler {
+public:
+    // 析构时把作用域内的开销记入对应的采集函数
+    class Scope {
+    public:
+        Scope(SelfProfiler &profiler, Collector collector);
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+    private:
+        SelfProfiler &profiler_;
+        Collector collector_;
+        std::chrono::steady_clock::time_point start_;
+        uint64_t opens_;
+        uint64_t bytesRead_;
+        uint64_t allocations_;
+    };
+
+    Scope scope(Collector collector) { return Scope(*this, collector); }
+    CollectorStatsArray stats() const;
+
+private:
+    static constexpr size_t kWindow = 256;   // 计算分位数使用的最近调用次数
+
+    struct History {
+        std::array<double, kWindow> latencies{};
+        CollectorStats stats;
+    };
+    std::array<History, kCollectorCount> histories_;
+};
@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+#include <memory>
+#include "snapshot_channel.h"
+
+// 把每份快照写入POSIX共享内存，布局和读取方法见shm_snapshot.h。
+// 写入线程从SnapshotChannel读取新快照，先转换到私有的暂存区，再在seqlock内一次memcpy发布，
+// 读取方看到的不一致窗口只有一次拷贝的时间；不会阻塞采样线程。
+class ShmExporter {
+public:
+    ShmExporter();
+    ~ShmExporter();
+
+    // name如"/res_monitor"；失败抛出std::runtime_error
+    void start(const std::string &name, const SnapshotChannel &channel);
+
+    // 写入线程在channel关闭后退出，须先关闭channel再调用；退出时删除共享内存
+    void stop();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
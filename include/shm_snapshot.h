@@ -0,0 +1,183 @@
+#pragma once
+// 共享内存快照的布局和只读访问，仅依赖标准库和POSIX，可单独拷贝给其他程序使用（C++17）。
+// res_monitor --shm <name>把每份快照写入POSIX共享内存<name>，其他进程映射后用一次memcpy读取，
+// 不需要再扫描/proc。写入方用seqlock保护：写之前序号变为奇数，写完变为偶数；
+// 读取方拷贝前后序号相同且为偶数即得到一致的副本，写入方从不等待读取方。
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace shm {
+
+constexpr uint32_t kMagic = 0x534d5352;     // "RSMS"
+constexpr uint32_t kVersion = 1;            // 布局不兼容时递增；兼容的扩展只在Snapshot末尾追加字段
+constexpr const char *kDefaultName = "/res_monitor";
+constexpr size_t kMaxDisks = 32;
+constexpr size_t kMaxProcesses = 32;        // 每个top-N列表
+constexpr size_t kCommandSize = 128;
+constexpr auto kMaxWriteWait = std::chrono::seconds(1);    // 一次写入只需几微秒，序号保持奇数超过此时长视为写入方异常
+
+struct Disk {
+    char name[32];
+    double readBytesPerSec;
+    double writeBytesPerSec;
+    double readIops;
+    double writeIops;
+    double readAwaitMs;
+    double writeAwaitMs;
+    double busyPercent;
+    double avgQueueSize;
+    uint64_t inFlight;
+};
+
+struct Process {
+    int32_t pid;
+    uint32_t reserved;
+    double cpuPercent;
+    uint64_t memBytes;          // 按memRank统计
+    double readBytesPerSec;
+    double writeBytesPerSec;
+    char command[kCommandSize]; // 截断的命令行
+};
+
+// 字节；used与free(1)口径一致
+struct Memory {
+    uint64_t total;
+    uint64_t used;
+    uint64_t free;
+    uint64_t available;
+    uint64_t buffers;
+    uint64_t cached;
+    uint64_t shmem;
+    uint64_t slab;
+    uint64_t dirty;
+    uint64_t writeback;
+    uint64_t swapTotal;
+    uint64_t swapFree;
+};
+
+// 一份快照，未采集的列表计数为0
+struct Snapshot {
+    int64_t timeMs;             // 采样时间，Unix毫秒
+    uint64_t generation;        // 快照序号，从1开始
+    uint32_t hasCpu;            // 首次采样没有CPU使用率
+    uint32_t disksReady;        // 首次采样没有磁盘速率
+    double cpuPercent;
+    Memory mem;
+    uint32_t memRank;           // 0 rss，1 pss，2 uss，3 swap
+    uint32_t diskCount;
+    uint32_t topCpuCount;
+    uint32_t topMemCount;
+    uint32_t topDiskCount;
+    uint32_t reserved;
+    Disk disks[kMaxDisks];
+    Process topCpu[kMaxProcesses];
+    Process topMem[kMaxProcesses];
+    Process topDisk[kMaxProcesses];
+};
+
+struct Segment {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t snapshotSize;      // 写入方的sizeof(Snapshot)，据此判断末尾追加的字段是否有效
+    int32_t writerPid;
+    std::atomic<uint64_t> sequence;     // 奇数为正在写入，0为尚未发布
+    uint64_t reserved[5];
+    Snapshot snapshot;
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "seqlock needs an address-free atomic");
+
+// 写入一份快照，只能有一个写入方
+inline void publish(Segment &segment, const Snapshot &snapshot) {
+    auto sequence = segment.sequence.load(std::memory_order_relaxed);
+    segment.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&segment.snapshot, &snapshot, sizeof(snapshot));
+    segment.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+// 拷贝一致的副本；尚未发布时返回false。写入只需几微秒，与写入冲突时让出CPU后重试。
+// 写入方在写入中途退出时序号不会再变为偶数：序号保持奇数超过kMaxWriteWait时不再等待，
+// 用kill(writerPid, 0)区分写入方已退出和仍在但停止了（如被调试器暂停），都抛出std::runtime_error
+inline bool read(const Segment &segment, Snapshot &out) {
+    std::chrono::steady_clock::time_point oddSince{};
+    uint64_t oddSequence = 0;
+    for (;;) {
+        auto before = segment.sequence.load(std::memory_order_acquire);
+        if (before == 0) return false;
+        if (before & 1) {
+            auto now = std::chrono::steady_clock::now();
+            if (before != oddSequence) {
+                oddSequence = before;
+                oddSince = now;
+            } else if (now - oddSince > kMaxWriteWait) {
+                int pid = segment.writerPid;
+                if (::kill(pid, 0) < 0 && errno == ESRCH) {
+                    throw std::runtime_error("shm: writer " + std::to_string(pid) + " is gone, exited during an update");
+                }
+                throw std::runtime_error("shm: writer " + std::to_string(pid) + " stalled during an update");
+            }
+            std::this_thread::yield();
+            continue;
+        }
+        std::memcpy(&out, &segment.snapshot, sizeof(out));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (segment.sequence.load(std::memory_order_relaxed) == before) return true;
+    }
+}
+
+// 只读映射name，段不存在或版本不兼容时抛出std::runtime_error
+class Reader {
+public:
+    explicit Reader(const std::string &name = kDefaultName) {
+        int fd = ::shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+        if (fd < 0) throw std::runtime_error("shm_open " + name + ": " + std::strerror(errno));
+        struct stat st;
+        if (::fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(Segment)) {
+            ::close(fd);
+            throw std::runtime_error("shm " + name + ": segment too small");
+        }
+        void *address = ::mmap(nullptr, sizeof(Segment), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (address == MAP_FAILED) throw std::runtime_error("mmap " + name + ": " + std::strerror(errno));
+        segment_ = static_cast<const Segment *>(address);
+        if (segment_->magic != kMagic || segment_->version != kVersion) {
+            ::munmap(const_cast<Segment *>(segment_), sizeof(Segment));
+            throw std::runtime_error("shm " + name + ": incompatible segment");
+        }
+    }
+    ~Reader() {
+        ::munmap(const_cast<Segment *>(segment_), sizeof(Segment));
+    }
+    Reader(const Reader &) = delete;
+    Reader &operator=(const Reader &) = delete;
+
+    // 最近一份快照，尚未发布时返回false；写入方在写入中途退出或停止时抛出std::runtime_error
+    bool read(Snapshot &out) const {
+        return shm::read(*segment_, out);
+    }
+
+    // 不拷贝，只读序号：与上次相同说明没有新快照
+    uint64_t sequence() const {
+        return segment_->sequence.load(std::memory_order_acquire);
+    }
+
+    int writerPid() const {
+        return segment_->writerPid;
+    }
+
+private:
+    const Segment *segment_ = nullptr;
+};
+
+}
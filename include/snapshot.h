@@ -0,0 +1,147 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <array>
+#include <memory>
+#include <optional>
+#include <cstdint>
+#include <chrono>
+#include "procfs.h"
+#include "self_stats.h"
+
+// 块设备在一个采样周期内的统计（来自/proc/diskstats的差值）
+struct DiskStat {
+    enum class Kind {
+        Disk,       // 整盘（sdX、nvmeXnY、vdX、xvdX、mmcblkX…）
+        Stacked,    // 堆叠的虚拟设备（dm-X、mdX），由/sys/block/<dev>/slaves判断
+    };
+
+    std::string name;
+    Kind kind = Kind::Disk;
+    double readBytesPerSec = 0;
+    double writeBytesPerSec = 0;
+    double readIops = 0;
+    double writeIops = 0;
+    double readAwaitMs = 0;     // 平均每个读请求耗时（含排队）
+    double writeAwaitMs = 0;    // 平均每个写请求耗时（含排队）
+    double busyPercent = 0;     // 设备繁忙时间占比（%util）
+    double avgQueueSize = 0;    // 平均队列深度（aqu-sz）
+    uint64_t inFlight = 0;      // 采样时刻正在处理的请求数
+};
+
+// hwmon温度传感器的一个读数
+struct TemperatureReading {
+    std::string hwmon;          // hwmon目录名，如hwmon3；多路CPU的coretemp、多块NVMe的芯片名相同，靠它区分
+    std::string chip;           // hwmon芯片名，如coretemp
+    bool pciAdapter = false;    // 有device子目录视为PCI/Platform适配器，否则为ISA
+    std::string label;          // 如"Package id 0"、"Core 0"
+    double celsius = 0;
+    std::optional<double> high;
+    std::optional<double> crit;
+};
+
+// 进程内存排序依据
+enum class MemRank {
+    Rss,    // /proc/[pid]/statm中的驻留内存（默认，开销最小）
+    Pss,    // 按共享进程数均摊后的内存
+    Uss,    // 进程独占内存（Private_Clean + Private_Dirty）
+    Swap,   // 被换出的内存
+};
+
+// top-N列表中的一个进程，未采集的指标为0
+struct ProcessSample {
+    int pid = 0;
+    std::string cmdline;
+    double cpuPercent = 0;
+    uint64_t memBytes = 0;          // 按MemRank统计的内存
+    bool memIsRss = false;          // 按PSS/USS排名但未及时读到smaps_rollup，memBytes为RSS
+    double readBytesPerSec = 0;
+    double writeBytesPerSec = 0;
+};
+
+// 进程表中的一个进程：只包含扫描时已经得到的数据，不为它额外读取文件。
+// 进程表随每次采样保留多份，数值用float以减小体积
+struct ProcessEntry {
+    int pid = 0;
+    uint64_t startTime = 0;         // 与pid一起识别pid复用
+    std::array<char, 16> comm{};
+    float cpuPercent = 0;           // 口径与ProcessSample::cpuPercent相同，未知时为0
+    uint64_t rssBytes = 0;
+    float readBytesPerSec = 0;
+    float writeBytesPerSec = 0;
+};
+
+// 进程分组方式
+enum class GroupBy {
+    None,
+    Comm,       // 进程名（/proc/[pid]/stat中的comm）
+    User,       // 有效UID
+    Session,    // 会话，以会话首进程命名
+    Tree,       // 进程树：归入pid 1（或kthreadd）之下的顶层祖先进程
+    Pattern,    // 按正则规则分组，不匹配任何规则的进程按comm分组
+};
+
+// 一组进程的合计，口径与ProcessSample相同，内存固定按RSS统计
+struct ProcessGroup {
+    std::string name;
+    size_t processes = 0;
+    double cpuPercent = 0;
+    uint64_t memBytes = 0;
+    double readBytesPerSec = 0;
+    double writeBytesPerSec = 0;
+};
+
+// 监视列表中进程的一个采样点，速率和CPU占用按与上一个采样点的差值计算
+struct WatchPoint {
+    std::chrono::system_clock::time_point time;
+    double cpuPercent = 0;          // 口径与ProcessSample::cpuPercent相同
+    uint64_t rssBytes = 0;
+    double readBytesPerSec = 0;
+    double writeBytesPerSec = 0;
+};
+
+// 监视列表中的一个进程自上次汇报以来的时间序列
+struct WatchedProcess {
+    int pid = 0;
+    std::string cmdline;
+    bool hasIo = false;             // 其他用户的进程没有权限读取io
+    bool exited = false;            // 本周期内退出，之后不再出现
+    std::vector<WatchPoint> points;
+};
+
+// 进程扫描的覆盖情况，超出CPU预算时只扫描部分进程
+struct ScanCoverage {
+    size_t processes = 0;       // 列出的进程数
+    size_t scanned = 0;         // 其中本次重新读取了stat的进程数
+    double target = 1.0;        // 预算控制给出的轮转扫描比例
+    double cpuBudgetPercent = 0;            // 0为不限制
+    std::optional<double> selfCpuPercent;   // 上个周期自身占用的CPU（单核百分比）
+};
+
+// 一次采样的完整结构化结果
+struct Snapshot {
+    std::chrono::system_clock::time_point time;
+    std::optional<double> cpuPercent;   // 首次采样没有基准，无法计算
+    MemInfo mem;
+    bool disksReady = false;            // 同上，首次采样磁盘速率不可用
+    std::vector<DiskStat> disks;
+    std::vector<TemperatureReading> temperatures;
+
+    MemRank memRank = MemRank::Rss;
+    std::vector<ProcessSample> topCpu;
+    std::vector<ProcessSample> topMem;
+    std::vector<ProcessSample> topDisk;
+
+    GroupBy groupBy = GroupBy::None;
+    std::vector<ProcessGroup> topCpuGroups;     // 分组后的top-N，未启用分组时为空
+    std::vector<ProcessGroup> topMemGroups;
+    std::vector<ProcessGroup> topDiskGroups;
+
+    std::vector<WatchedProcess> watched;    // --pid/--match监视的进程，未启用时为空
+
+    // 满足过滤条件的全部进程，按pid排序；只在SampleOptions::processTable时生成，多份快照可共享同一张表
+    std::shared_ptr<const std::vector<ProcessEntry>> processes;
+
+    CollectorStatsArray collectors;     // 采集自身的开销，含本次采样
+    ScanCoverage coverage;
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include "snapshot.h"
+
+// 发布后不再修改的快照，generation从1开始每次发布递增
+struct PublishedSnapshot {
+    uint64_t generation;
+    Snapshot snapshot;
+};
+
+// 采样线程（唯一的发布者）与多个消费者（日志、指标服务等）之间传递快照。
+// 发布是一次原子指针替换，读取是一次原子指针拷贝，双方都不持锁；
+// 旧快照在最后一个读者释放后自动回收。
+class SnapshotChannel {
+public:
+    void publish(Snapshot snapshot);
+
+    // 最近一次发布的快照，尚未发布时为空
+    std::shared_ptr<const PublishedSnapshot> latest() const;
+    uint64_t generation() const;
+
+    // 阻塞直到generation超过after或通道关闭，返回当前generation
+    uint64_t waitNext(uint64_t after) const;
+
+    // 唤醒所有等待者，之后waitNext立即返回
+    void close();
+    bool closed() const;
+
+private:
+    static constexpr uint64_t kClosed = uint64_t(1) << 63;
+
+    std::atomic<std::shared_ptr<const PublishedSnapshot>> latest_;
+    std::atomic<uint64_t> state_{0};    // 低63位为generation，最高位表示已关闭
+};
+
+// 消费者的读取游标，用generation检测错过的快照
+class SnapshotReader {
+public:
+    explicit SnapshotReader(const SnapshotChannel &channel) : channel_(channel) {}
+
+    // 有新快照时返回它，否则返回空；missed为自上次读取以来跳过的快照数（首次读取为0）
+    std::shared_ptr<const PublishedSnapshot> poll(uint64_t *missed = nullptr);
+
+    // 阻塞等待下一份快照，通道关闭时返回空
+    std::shared_ptr<const PublishedSnapshot> next(uint64_t *missed = nullptr);
+
+private:
+    const SnapshotChannel &channel_;
+    uint64_t lastGeneration_ = 0;
+};
@@ -0,0 +1,15 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include "snapshot.h"
+
+// 快照的紧凑二进制编码，用于agent与aggregator之间传输。
+// 整数为LEB128变长编码，有符号数先做zigzag；小数按固定精度取整后编码：
+// 百分比0.01、速率1字节/秒、IOPS和队列深度0.01、耗时1微秒、温度0.001℃。
+// 不含采集自身的统计（collectors、coverage）和进程表
+
+// 编码snapshot并追加到output
+void encodeSnapshot(const Snapshot &snapshot, std::string &output);
+
+// 从input开头解码一份快照并移过已读取的部分；数据不完整时抛出std::runtime_error
+Snapshot decodeSnapshot(std::string_view &input);
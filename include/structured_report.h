@@ -0,0 +1,28 @@
+#pragma once
+#include <string_view>
+#include <spdlog/fmt/fmt.h>
+#include "snapshot.h"
+
+// 快照的输出格式
+enum class OutputFormat {
+    Text,       // 日志中的可读文本
+    Json,       // 每份快照一行JSON对象（NDJSON）
+    Csv,        // 每项指标一行
+};
+
+// 解析text|json|csv，不合法时抛出std::invalid_argument
+OutputFormat parseOutputFormat(std::string_view text);
+
+// 供程序处理的输出：直接从结构化快照格式化到buf末尾，不经过中间字符串，调用方可以复用buf。
+// 数值都是原始值：内存为字节，速率为每秒字节数，CPU为百分比，时间为Unix毫秒，未知的值为null或空
+
+// 一行JSON：time_ms、cpu_percent、mem、disks（首次采样为null）、temperatures、top_cpu/top_mem/top_disk、
+// mem_rank、group_by和分组的top-N、watched（每个进程带本周期的采样点）
+void appendJson(const Snapshot &snapshot, fmt::memory_buffer &buf);
+
+// CSV的表头time_ms,section,pid,name,field,value，只在输出开始时写一次
+void appendCsvHeader(fmt::memory_buffer &buf);
+
+// 快照中的每项指标一行：section为cpu/mem/disk/temp/top_cpu…/watched，name为设备、传感器、命令行或分组名，
+// 只有进程有pid；监视进程的采样点各自带采样时刻
+void appendCsv(const Snapshot &snapshot, fmt::memory_buffer &buf);
@@ -0,0 +1,44 @@
+#pragma once
+#include <memory_resource>
+#include <optional>
+#include <vector>
+#include <cstddef>
+
+// 一次采样内临时数据使用的单调分配器：只分配不释放，reset()时整体回收。
+// 缓冲区按此前的最高用量预留，稳态下不再向堆申请内存；超出时由上游分配，
+// 并在下次reset()时扩大缓冲区
+class TickArena : public std::pmr::memory_resource {
+public:
+    explicit TickArena(size_t initialSize = 64 * 1024);
+
+    void reset();
+
+    size_t used() const { return used_; }
+    size_t highWater() const { return highWater_; }
+    size_t capacity() const { return buffer_.size(); }
+
+private:
+    friend class TickArenaScope;
+
+    void *do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void *, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+    std::vector<std::byte> buffer_;
+    std::optional<std::pmr::monotonic_buffer_resource> resource_;
+    size_t used_ = 0;
+    size_t highWater_ = 0;
+    int depth_ = 0;     // 嵌套的TickArenaScope层数
+};
+
+// 嵌套的采集调用共用同一个arena，最外层作用域结束时reset
+class TickArenaScope {
+public:
+    explicit TickArenaScope(TickArena &arena) : arena_(arena) { ++arena_.depth_; }
+    ~TickArenaScope() { if (--arena_.depth_ == 0) arena_.reset(); }
+    TickArenaScope(const TickArenaScope &) = delete;
+    TickArenaScope &operator=(const TickArenaScope &) = delete;
+
+private:
+    TickArena &arena_;
+};
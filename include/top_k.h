@@ -0,0 +1,14 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+// 按key降序保留items中最大的k个元素，其余丢弃。
+// 只对前k个做部分排序，复杂度O(n log k)，比把所有进程放入multimap便宜得多。
+template<typename T, typename Alloc, typename Key>
+void selectTopK(std::vector<T, Alloc> &items, size_t k, Key key) {
+    k = std::min(k, items.size());
+    std::partial_sort(items.begin(), items.begin() + k, items.end(),
+        [&key](const T &a, const T &b) { return key(a) > key(b); });
+    items.erase(items.begin() + k, items.end());
+}
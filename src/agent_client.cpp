@@ -0,0 +1,319 @@
+#include "agent_client.h"
+#include "agent_protocol.h"
+#include "snapshot_codec.h"
+#include "lz_codec.h"
+#include <spdlog/spdlog.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace {
+
+constexpr size_t kMaxBatch = 64;                // 补发时每批最多的快照数
+constexpr size_t kMaxBatchBytes = 1 << 20;      // 每批原始负载的上限
+constexpr auto kMinBackoff = std::chrono::seconds(1);
+constexpr auto kMaxBackoff = std::chrono::seconds(30);
+
+void putVarint(std::string &output, uint64_t value) {
+    for (; value >= 0x80; value >>= 7) output.push_back(static_cast<char>(value | 0x80));
+    output.push_back(static_cast<char>(value));
+}
+
+void appendFrame(std::string &output, agent::FrameHeader header, std::string_view payload) {
+    header.payloadSize = payload.size();
+    output.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    output.append(payload);
+}
+
+// 发起非阻塞连接，返回套接字，连接结果由可写事件和SO_ERROR得到；失败返回-1并设置error
+int connectAsync(const std::string &host, const std::string &port, std::string &error) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV;
+    addrinfo *result = nullptr;
+    int rc = ::getaddrinfo(host.c_str(), port.c_str(), &hints, &result);
+    if (rc != 0) {
+        error = gai_strerror(rc);
+        return -1;
+    }
+    int fd = ::socket(result->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && ::connect(fd, result->ai_addr, result->ai_addrlen) < 0 && errno != EINPROGRESS) {
+        ::close(fd);
+        fd = -1;
+    }
+    if (fd < 0) error = strerror(errno);
+    ::freeaddrinfo(result);
+    return fd;
+}
+
+}
+
+struct AgentClient::Impl {
+    struct Entry {
+        uint64_t sequence;
+        std::string data;   // snapshot_codec.h编码的快照
+    };
+
+    std::string host_;
+    std::string port_;
+    std::string server_;
+    std::string name_;
+    size_t backlog_ = 0;
+    uint64_t session_ = 0;
+    int wakeFd_ = -1;       // eventfd，有新快照或需要退出时通知发送线程
+    std::atomic<bool> stopping_{false};
+    std::thread encodeThread_;
+    std::thread sendThread_;
+
+    std::mutex mutex_;      // 保护以下成员
+    std::deque<Entry> pending_;     // 未确认的快照，序号连续递增
+    uint64_t nextSequence_ = 1;
+    bool dropping_ = false;         // 缓冲已满并开始丢弃，收到确认后恢复
+
+    std::string dictionary_;        // 本次连接上一批的原始负载，只在发送线程中使用
+
+    void wake() {
+        uint64_t one = 1;
+        (void)!::write(wakeFd_, &one, sizeof(one));
+    }
+
+    void encode(const SnapshotChannel &channel);
+    void send();
+    // 把序号大于sent的快照合并为一批追加到output，返回是否有新的批次
+    bool appendBatch(std::string &output, uint64_t &sent);
+    void acknowledge(uint64_t sequence);
+};
+
+AgentClient::AgentClient()
+    : impl_(new Impl) {
+}
+
+AgentClient::~AgentClient() {
+    stop();
+}
+
+void AgentClient::start(const std::string &server, const std::string &host, size_t backlog, const SnapshotChannel &channel) {
+    auto colon = server.rfind(':');
+    if (colon == std::string::npos || colon == 0 || colon + 1 == server.size()) {
+        throw std::runtime_error("invalid agent address: " + server);
+    }
+    impl_->host_ = server.substr(0, colon);
+    impl_->port_ = server.substr(colon + 1);
+    auto &address = impl_->host_;
+    if (address.size() >= 2 && address.front() == '[' && address.back() == ']') address = address.substr(1, address.size() - 2);
+    if (backlog == 0) throw std::runtime_error("agent backlog must be positive");
+
+    impl_->server_ = server;
+    impl_->name_ = host;
+    impl_->backlog_ = backlog;
+    // 会话号区分agent的每次启动，aggregator据此重置去重用的序号
+    impl_->session_ = (static_cast<uint64_t>(std::random_device()()) << 32) ^
+        static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+    impl_->wakeFd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    impl_->encodeThread_ = std::thread([this, &channel] { impl_->encode(channel); });
+    impl_->sendThread_ = std::thread([this] { impl_->send(); });
+}
+
+void AgentClient::stop() {
+    if (!impl_->sendThread_.joinable()) return;
+    impl_->encodeThread_.join();
+    impl_->stopping_ = true;
+    impl_->wake();
+    impl_->sendThread_.join();
+    ::close(impl_->wakeFd_);
+    impl_->wakeFd_ = -1;
+}
+
+void AgentClient::Impl::encode(const SnapshotChannel &channel) {
+    SnapshotReader reader(channel);
+    while (auto published = reader.next()) {
+        std::string data;
+        encodeSnapshot(published->snapshot, data);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_.push_back({nextSequence_++, std::move(data)});
+            if (pending_.size() > backlog_) {
+                pending_.pop_front();
+                if (!dropping_) SPDLOG_WARN("agent: backlog of {} snapshots is full, dropping the oldest", backlog_);
+                dropping_ = true;
+            }
+        }
+        wake();
+    }
+}
+
+bool AgentClient::Impl::appendBatch(std::string &output, uint64_t &sent) {
+    std::string raw;
+    agent::FrameHeader header;
+    header.type = agent::FrameType::Batch;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (pending_.empty() || pending_.back().sequence <= sent) return false;
+        // 序号连续，直接算出第一份未发送的快照；已发送的快照被丢弃时从最旧的开始
+        size_t index = sent + 1 > pending_.front().sequence ? sent + 1 - pending_.front().sequence : 0;
+        header.sequence = pending_[index].sequence;
+        for (; index < pending_.size() && header.count < kMaxBatch && raw.size() < kMaxBatchBytes; ++index) {
+            putVarint(raw, pending_[index].data.size());
+            raw.append(pending_[index].data);
+            ++header.count;
+        }
+    }
+    sent = header.sequence + header.count - 1;
+    header.rawSize = raw.size();
+
+    std::string compressed;
+    lzCompress(raw, compressed, dictionary_);
+    if (compressed.size() < raw.size()) {
+        header.flags = agent::kCompressed;
+        appendFrame(output, header, compressed);
+    } else {
+        appendFrame(output, header, raw);
+    }
+    dictionary_ = std::move(raw);
+    return true;
+}
+
+void AgentClient::Impl::acknowledge(uint64_t sequence) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (!pending_.empty() && pending_.front().sequence <= sequence) pending_.pop_front();
+    dropping_ = false;
+}
+
+void AgentClient::Impl::send() {
+    int fd = -1;
+    bool connecting = false;
+    bool failing = false;       // 已输出过连接失败，恢复前不重复输出
+    auto backoff = std::chrono::steady_clock::duration(kMinBackoff);
+    auto nextConnect = std::chrono::steady_clock::now();
+    std::string output;         // 待发送的帧
+    size_t written = 0;
+    std::string input;          // 收到的不完整的帧
+    uint64_t sent = 0;          // 本次连接中已放入output的最后一份快照的序号
+
+    auto disconnect = [&](const std::string &reason) {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+        connecting = false;
+        if (!failing) SPDLOG_WARN("agent: {}: {}, reconnecting", server_, reason);
+        failing = true;
+        nextConnect = std::chrono::steady_clock::now() + backoff;
+        backoff = std::min<std::chrono::steady_clock::duration>(backoff * 2, kMaxBackoff);
+    };
+
+    while (!stopping_) {
+        auto now = std::chrono::steady_clock::now();
+        if (fd < 0 && now >= nextConnect) {
+            std::string error;
+            fd = connectAsync(host_, port_, error);
+            if (fd < 0) {
+                disconnect(error);
+                continue;
+            }
+            connecting = true;
+        }
+
+        pollfd fds[2] = {{wakeFd_, POLLIN, 0}, {fd, POLLIN, 0}};
+        if (connecting || written < output.size()) fds[1].events |= POLLOUT;
+        int timeout = -1;
+        if (fd < 0) {
+            timeout = std::chrono::duration_cast<std::chrono::milliseconds>(nextConnect - now).count() + 1;
+        }
+        int n = ::poll(fds, fd < 0 ? 1 : 2, timeout);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            SPDLOG_ERROR("agent poll: {}", strerror(errno));
+            break;
+        }
+        if (fds[0].revents) {
+            uint64_t value;
+            (void)!::read(wakeFd_, &value, sizeof(value));
+        }
+        if (fd < 0) continue;
+
+        if (connecting) {
+            if (!fds[1].revents) continue;
+            int error = 0;
+            socklen_t length = sizeof(error);
+            ::getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length);
+            if (error) {
+                disconnect(strerror(error));
+                continue;
+            }
+            connecting = false;
+            SPDLOG_INFO("agent: connected to {}", server_);
+            // 从最早未确认的快照开始重发
+            agent::FrameHeader hello;
+            hello.type = agent::FrameType::Hello;
+            hello.sequence = session_;
+            hello.rawSize = name_.size();
+            output.clear();
+            written = 0;
+            input.clear();
+            appendFrame(output, hello, name_);
+            sent = 0;
+            dictionary_.clear();
+        }
+
+        if (fds[1].revents & (POLLIN | POLLERR | POLLHUP)) {
+            char buffer[4096];
+            ssize_t size;
+            while ((size = ::recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) input.append(buffer, size);
+            if (size == 0 || (size < 0 && errno != EAGAIN && errno != EINTR)) {
+                disconnect(size == 0 ? "connection closed" : strerror(errno));
+                continue;
+            }
+            size_t offset = 0;
+            for (; input.size() - offset >= sizeof(agent::FrameHeader); offset += sizeof(agent::FrameHeader)) {
+                agent::FrameHeader header;
+                std::memcpy(&header, input.data() + offset, sizeof(header));
+                if (header.magic != agent::kMagic || header.type != agent::FrameType::Ack || header.payloadSize != 0) {
+                    break;
+                }
+                acknowledge(header.sequence);
+                if (failing) SPDLOG_INFO("agent: {} recovered", server_);
+                failing = false;
+                backoff = kMinBackoff;
+            }
+            input.erase(0, offset);
+            if (input.size() >= sizeof(agent::FrameHeader)) {
+                disconnect("protocol error");
+                continue;
+            }
+        }
+
+        // 上一批基本发完后再合并新的批次，断线期间积压的快照分批补发
+        if (output.size() - written < kMaxBatchBytes) {
+            output.erase(0, written);
+            written = 0;
+            while (output.size() < kMaxBatchBytes && appendBatch(output, sent)) {
+            }
+        }
+        if (written < output.size()) {
+            ssize_t size = ::send(fd, output.data() + written, output.size() - written, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (size > 0) {
+                written += size;
+            } else if (size < 0 && errno != EAGAIN && errno != EINTR) {
+                disconnect(strerror(errno));
+                continue;
+            }
+            if (written == output.size()) {
+                output.clear();
+                written = 0;
+            }
+        }
+    }
+    if (fd >= 0) ::close(fd);
+}
@@ -0,0 +1,365 @@
+#include "aggregator.h"
+#include "agent_protocol.h"
+#include "snapshot_codec.h"
+#include "lz_codec.h"
+#include "fleet_index.h"
+#include "report.h"
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/chrono.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+uint64_t getVarint(std::string_view &input) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64 && !input.empty(); shift += 7) {
+        auto byte = static_cast<uint8_t>(input.front());
+        input.remove_prefix(1);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+    throw std::runtime_error("invalid batch");
+}
+
+std::string peerName(int fd) {
+    sockaddr_storage address{};
+    socklen_t length = sizeof(address);
+    char host[NI_MAXHOST] = "?", port[NI_MAXSERV] = "?";
+    if (::getpeername(fd, reinterpret_cast<sockaddr *>(&address), &length) == 0) {
+        ::getnameinfo(reinterpret_cast<sockaddr *>(&address), length, host, sizeof(host), port, sizeof(port),
+                      NI_NUMERICHOST | NI_NUMERICSERV);
+    }
+    return fmt::format("{}:{}", host, port);
+}
+
+// 记录文件中的一份快照，格式与日志相同，每行以时间和主机名开头
+void formatRecord(const std::string &host, const Snapshot &snapshot, fmt::memory_buffer &out) {
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(snapshot.time.time_since_epoch()).count();
+    auto prefix = fmt::format("{:%Y-%m-%d %H:%M:%S}.{:03} [{}]",
+        fmt::localtime(static_cast<std::time_t>(ms / 1000)), ms % 1000, host);
+    auto it = std::back_inserter(out);
+    fmt::format_to(it, "{} {}, {}, {}\n", prefix,
+        formatCpu(snapshot.cpuPercent), formatMemory(snapshot.mem), formatDisks(snapshot.disksReady, snapshot.disks));
+    for (const auto &process : snapshot.topCpu) fmt::format_to(it, "{} {}\n", prefix, formatTopCpu(process));
+    for (const auto &process : snapshot.topMem) fmt::format_to(it, "{} {}\n", prefix, formatTopMem(process, snapshot.memRank));
+    for (const auto &process : snapshot.topDisk) fmt::format_to(it, "{} {}\n", prefix, formatTopDisk(process));
+    for (const auto &group : snapshot.topCpuGroups) fmt::format_to(it, "{} {}\n", prefix, formatTopCpuGroup(group, snapshot.groupBy));
+    for (const auto &group : snapshot.topMemGroups) fmt::format_to(it, "{} {}\n", prefix, formatTopMemGroup(group, snapshot.groupBy));
+    for (const auto &group : snapshot.topDiskGroups) fmt::format_to(it, "{} {}\n", prefix, formatTopDiskGroup(group, snapshot.groupBy));
+    for (const auto &process : snapshot.watched) fmt::format_to(it, "{} {}\n", prefix, formatWatched(process));
+}
+
+}
+
+struct Aggregator::Impl {
+    struct Connection {
+        int fd = -1;
+        std::string peer;
+        std::string host;       // Hello之后才有
+        std::string input;      // 收到的不完整的帧
+        std::string output;     // 待发送的确认
+        std::string dictionary; // 上一批的原始负载，解压下一批时作为字典
+        bool writable = false;  // 是否在等待可写事件
+    };
+
+    struct Host {
+        HostState state;
+        uint64_t session = 0;
+        uint64_t lastSequence = 0;  // 本会话已写入记录的最后一份快照的序号
+        int connections = 0;
+    };
+
+    int listenFd_ = -1;
+    int wakeFd_ = -1;       // eventfd，用于通知服务线程退出
+    int epollFd_ = -1;
+    FILE *record_ = nullptr;
+    std::thread thread_;
+    std::unordered_map<int, Connection> connections_;   // 只在服务线程中使用
+
+    mutable std::mutex mutex_;  // 保护hosts_和index_
+    std::map<std::string, Host> hosts_;
+    std::unique_ptr<FleetIndex> index_;
+
+    fmt::memory_buffer recordBuffer_;   // 复用的格式化缓冲区
+
+    void serve();
+    void accept();
+    void close(Connection &connection);
+    // 处理input中的完整帧，协议错误时抛出std::runtime_error
+    void process(Connection &connection);
+    void hello(Connection &connection, uint64_t session, std::string_view host);
+    void batch(Connection &connection, const agent::FrameHeader &header, std::string_view payload);
+    void flush(Connection &connection);
+};
+
+Aggregator::Aggregator()
+    : impl_(new Impl) {
+}
+
+Aggregator::~Aggregator() {
+    stop();
+}
+
+void Aggregator::start(const std::string &listen, const std::string &recordPath, size_t history) {
+    auto colon = listen.rfind(':');
+    if (colon == std::string::npos) throw std::runtime_error("invalid listen address: " + listen);
+    std::string host = listen.substr(0, colon);
+    std::string port = listen.substr(colon + 1);
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') host = host.substr(1, host.size() - 2);
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+    addrinfo *result = nullptr;
+    int rc = ::getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result);
+    if (rc != 0) throw std::runtime_error(fmt::format("resolve {}: {}", listen, gai_strerror(rc)));
+
+    int fd = ::socket(result->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    if (fd >= 0) ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (fd < 0 || ::bind(fd, result->ai_addr, result->ai_addrlen) < 0 || ::listen(fd, 128) < 0) {
+        int err = errno;
+        ::freeaddrinfo(result);
+        if (fd >= 0) ::close(fd);
+        throw std::runtime_error(fmt::format("listen {}: {}", listen, strerror(err)));
+    }
+    ::freeaddrinfo(result);
+
+    if (!recordPath.empty()) {
+        impl_->record_ = std::fopen(recordPath.c_str(), "ae");
+        if (!impl_->record_) {
+            int err = errno;
+            ::close(fd);
+            throw std::runtime_error(fmt::format("open {}: {}", recordPath, strerror(err)));
+        }
+    }
+
+    impl_->index_ = std::make_unique<FleetIndex>(history);
+    impl_->listenFd_ = fd;
+    impl_->wakeFd_ = ::eventfd(0, EFD_CLOEXEC);
+    impl_->epollFd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = impl_->listenFd_;
+    ::epoll_ctl(impl_->epollFd_, EPOLL_CTL_ADD, impl_->listenFd_, &event);
+    event.data.fd = impl_->wakeFd_;
+    ::epoll_ctl(impl_->epollFd_, EPOLL_CTL_ADD, impl_->wakeFd_, &event);
+    impl_->thread_ = std::thread([this] { impl_->serve(); });
+}
+
+void Aggregator::stop() {
+    if (!impl_->thread_.joinable()) return;
+    uint64_t one = 1;
+    (void)!::write(impl_->wakeFd_, &one, sizeof(one));
+    impl_->thread_.join();
+    for (auto &[fd, connection] : impl_->connections_) ::close(fd);
+    impl_->connections_.clear();
+    ::close(impl_->listenFd_);
+    ::close(impl_->wakeFd_);
+    ::close(impl_->epollFd_);
+    impl_->listenFd_ = impl_->wakeFd_ = impl_->epollFd_ = -1;
+    if (impl_->record_) std::fclose(impl_->record_);
+    impl_->record_ = nullptr;
+}
+
+std::vector<HostState> Aggregator::hosts() const {
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    std::vector<HostState> hosts;
+    hosts.reserve(impl_->hosts_.size());
+    for (const auto &[name, host] : impl_->hosts_) hosts.push_back(host.state);
+    return hosts;
+}
+
+query::Status Aggregator::answer(const query::Request &request, query::ResponseHeader &header, std::vector<char> &response) const {
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    return impl_->index_ ? impl_->index_->answer(request, header, response) : query::Status::NoData;
+}
+
+void Aggregator::Impl::serve() {
+    epoll_event events[64];
+    for (;;) {
+        int n = ::epoll_wait(epollFd_, events, 64, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            SPDLOG_ERROR("aggregator epoll: {}", strerror(errno));
+            return;
+        }
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == wakeFd_) return;
+            if (fd == listenFd_) {
+                accept();
+                continue;
+            }
+            auto it = connections_.find(fd);
+            if (it == connections_.end()) continue;
+            auto &connection = it->second;
+            if (events[i].events & EPOLLOUT) flush(connection);
+            if (!(events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))) continue;
+
+            char buffer[65536];
+            ssize_t size;
+            while ((size = ::recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) connection.input.append(buffer, size);
+            bool closed = size == 0 || (size < 0 && errno != EAGAIN && errno != EINTR);
+            try {
+                process(connection);
+            } catch (const std::exception &e) {
+                SPDLOG_WARN("aggregator: {} ({}): {}", connection.peer, connection.host, e.what());
+                closed = true;
+            }
+            if (closed) close(connection);
+        }
+    }
+}
+
+void Aggregator::Impl::accept() {
+    for (;;) {
+        int fd = ::accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+        auto &connection = connections_[fd];
+        connection.fd = fd;
+        connection.peer = peerName(fd);
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        ::epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+void Aggregator::Impl::close(Connection &connection) {
+    if (!connection.host.empty()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto &host = hosts_[connection.host];
+        host.state.connected = --host.connections > 0;
+        index_->setConnected(connection.host, host.state.connected);
+        SPDLOG_INFO("aggregator: {} disconnected ({})", connection.host, connection.peer);
+    }
+    int fd = connection.fd;
+    ::close(fd);
+    connections_.erase(fd);
+}
+
+void Aggregator::Impl::process(Connection &connection) {
+    size_t offset = 0;
+    std::string raw;
+    while (connection.input.size() - offset >= sizeof(agent::FrameHeader)) {
+        agent::FrameHeader header;
+        std::memcpy(&header, connection.input.data() + offset, sizeof(header));
+        if (header.magic != agent::kMagic || header.payloadSize > agent::kMaxPayload || header.rawSize > agent::kMaxPayload) {
+            throw std::runtime_error("protocol error");
+        }
+        if (connection.input.size() - offset - sizeof(header) < header.payloadSize) break;
+        std::string_view payload(connection.input.data() + offset + sizeof(header), header.payloadSize);
+        offset += sizeof(header) + header.payloadSize;
+
+        if (header.flags & agent::kCompressed) {
+            raw.clear();
+            lzDecompress(payload, header.rawSize, raw, connection.dictionary);
+            payload = raw;
+        } else if (header.rawSize != header.payloadSize) {
+            throw std::runtime_error("protocol error");
+        }
+
+        if (header.type == agent::FrameType::Hello) {
+            hello(connection, header.sequence, payload);
+        } else if (header.type == agent::FrameType::Batch && !connection.host.empty()) {
+            batch(connection, header, payload);
+            connection.dictionary.assign(payload);
+        } else {
+            throw std::runtime_error("unexpected frame");
+        }
+    }
+    connection.input.erase(0, offset);
+}
+
+void Aggregator::Impl::hello(Connection &connection, uint64_t session, std::string_view name) {
+    if (!connection.host.empty() || name.empty() || name.size() > 255) throw std::runtime_error("invalid hello");
+    connection.host = name;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &host = hosts_[connection.host];
+    host.state.host = connection.host;
+    host.state.connected = true;
+    ++host.connections;
+    index_->setConnected(connection.host, true);
+    if (host.session != session) {
+        host.session = session;
+        host.lastSequence = 0;
+    }
+    SPDLOG_INFO("aggregator: {} connected from {}", connection.host, connection.peer);
+}
+
+void Aggregator::Impl::batch(Connection &connection, const agent::FrameHeader &header, std::string_view payload) {
+    if (header.count == 0) throw std::runtime_error("empty batch");
+    std::vector<Snapshot> snapshots;
+    snapshots.reserve(header.count);
+    for (size_t i = 0; i < header.count; ++i) {
+        auto size = getVarint(payload);
+        if (size > payload.size()) throw std::runtime_error("invalid batch");
+        auto data = payload.substr(0, size);
+        payload.remove_prefix(size);
+        snapshots.push_back(decodeSnapshot(data));
+        if (!data.empty()) throw std::runtime_error("invalid batch");
+    }
+    if (!payload.empty()) throw std::runtime_error("invalid batch");
+
+    // 重连后补发的快照中已经写入过的部分跳过
+    recordBuffer_.clear();
+    uint64_t last = header.sequence + header.count - 1;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto &host = hosts_[connection.host];
+        for (size_t i = 0; i < snapshots.size(); ++i) {
+            uint64_t sequence = header.sequence + i;
+            if (sequence <= host.lastSequence) continue;
+            if (host.lastSequence > 0 && sequence > host.lastSequence + 1) {
+                host.state.missed += sequence - host.lastSequence - 1;
+                SPDLOG_WARN("aggregator: {} lost {} snapshot(s)", connection.host, sequence - host.lastSequence - 1);
+            }
+            host.lastSequence = sequence;
+            if (record_) formatRecord(connection.host, snapshots[i], recordBuffer_);
+            index_->add(connection.host, snapshots[i]);
+            ++host.state.snapshots;
+            host.state.lastSeen = std::chrono::system_clock::now();
+            if (i + 1 == snapshots.size()) host.state.latest = std::make_shared<const Snapshot>(std::move(snapshots[i]));
+        }
+    }
+    if (record_ && recordBuffer_.size() > 0) {
+        std::fwrite(recordBuffer_.data(), 1, recordBuffer_.size(), record_);
+        std::fflush(record_);
+    }
+
+    agent::FrameHeader ack;
+    ack.type = agent::FrameType::Ack;
+    ack.sequence = last;
+    connection.output.append(reinterpret_cast<const char *>(&ack), sizeof(ack));
+    flush(connection);
+}
+
+void Aggregator::Impl::flush(Connection &connection) {
+    while (!connection.output.empty()) {
+        ssize_t size = ::send(connection.fd, connection.output.data(), connection.output.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (size <= 0) break;
+        connection.output.erase(0, size);
+    }
+    // 发送缓冲满时等待可写，发完后只关注可读
+    bool writable = !connection.output.empty();
+    if (writable == connection.writable) return;
+    connection.writable = writable;
+    epoll_event event{};
+    event.events = writable ? EPOLLIN | EPOLLOUT : EPOLLIN;
+    event.data.fd = connection.fd;
+    ::epoll_ctl(epollFd_, EPOLL_CTL_MOD, connection.fd, &event);
+}
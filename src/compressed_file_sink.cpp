@@ -0,0 +1,291 @@
+#include "compressed_file_sink.h"
+#include "gzip.h"
+#include <spdlog/spdlog.h>
+#include <spdlog/details/file_helper.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr size_t kChunk = 64 * 1024;                // Stream：缓冲满此大小即唤醒后台线程
+constexpr size_t kMaxPending = 64 * 1024 * 1024;    // Stream：缓冲上限
+constexpr auto kSyncPeriod = std::chrono::seconds(1);
+
+}
+
+LogCompression parseLogCompression(std::string_view text) {
+    if (text == "none") return LogCompression::None;
+    if (text == "rotate") return LogCompression::Rotate;
+    if (text == "stream") return LogCompression::Stream;
+    throw std::invalid_argument(fmt::format("unknown log compression: {}", text));
+}
+
+fs::path logArchivePath(const fs::path &base, size_t index, bool compressed) {
+    return base.parent_path() / fmt::format("{}.{}{}{}", base.stem().string(), index, base.extension().string(),
+        compressed ? ".gz" : "");
+}
+
+void shiftLogArchives(const fs::path &base, size_t maxFiles, const fs::path &newest, bool compressed) {
+    std::error_code ec;
+    fs::remove(logArchivePath(base, maxFiles, compressed), ec);
+    for (size_t i = maxFiles; i-- > 1;) {
+        auto from = logArchivePath(base, i, compressed);
+        if (fs::exists(from, ec)) fs::rename(from, logArchivePath(base, i + 1, compressed), ec);
+    }
+    fs::rename(newest, logArchivePath(base, 1, compressed), ec);
+    if (ec) throw std::runtime_error(fmt::format("rename {}: {}", newest.string(), ec.message()));
+}
+
+struct CompressedFileSink::Impl {
+    fs::path base_;
+    size_t maxSize_;
+    size_t maxFiles_;
+    LogCompression mode_;
+
+    // Rotate：写日志的线程直接写当前文件，只在持有sink的锁时访问
+    spdlog::details::file_helper file_;
+    size_t currentSize_ = 0;
+    uint64_t nextSequence_ = 1;
+
+    // Stream：后台线程独占
+    std::FILE *stream_ = nullptr;
+    GzipEncoder encoder_;
+    size_t streamSize_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<fs::path> rotated_;      // Rotate：等待压缩的文件，从旧到新
+    std::string pending_;               // Stream：等待压缩的日志
+    uint64_t dropped_ = 0;
+    bool flushRequested_ = false;
+    bool stopping_ = false;
+    std::thread thread_;
+
+    fs::path streamPath() const {
+        return fs::path(base_) += ".gz";
+    }
+
+    void shiftArchives(const fs::path &newest) {
+        shiftLogArchives(base_, maxFiles_, newest, true);
+    }
+
+    // 上次退出前没有压缩的monitor.log.<序号>按序号排队
+    void resumeRotated() {
+        std::vector<std::pair<uint64_t, fs::path>> found;
+        auto prefix = base_.filename().string() + ".";
+        std::error_code ec;
+        for (const auto &entry : fs::directory_iterator(base_.parent_path(), ec)) {
+            auto name = entry.path().filename().string();
+            if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0) continue;
+            auto suffix = std::string_view(name).substr(prefix.size());
+            if (!std::all_of(suffix.begin(), suffix.end(), [](char c) { return c >= '0' && c <= '9'; })) continue;
+            found.emplace_back(std::stoull(std::string(suffix)), entry.path());
+        }
+        std::sort(found.begin(), found.end());
+        for (auto &[sequence, path] : found) {
+            nextSequence_ = sequence + 1;
+            rotated_.push_back(std::move(path));
+        }
+    }
+
+    void rotate() {
+        file_.close();
+        auto target = fs::path(base_) += fmt::format(".{}", nextSequence_++);
+        std::error_code ec;
+        fs::rename(base_, target, ec);
+        file_.reopen(true);     // 改名失败时也截断，避免当前文件无限增长
+        currentSize_ = 0;
+        if (ec) throw spdlog::spdlog_ex(fmt::format("rename {}: {}", base_.string(), ec.message()));
+        {
+            std::lock_guard lock(mutex_);
+            rotated_.push_back(std::move(target));
+        }
+        cv_.notify_one();
+    }
+
+    void compressRotated() {
+        auto temporary = fs::path(base_) += ".gz.tmp";
+        for (;;) {
+            fs::path source;
+            bool expired;
+            {
+                std::unique_lock lock(mutex_);
+                cv_.wait(lock, [this] { return stopping_ || !rotated_.empty(); });
+                if (stopping_) return;
+                source = rotated_.front();
+                // 排队的文件超过maxFiles时，最旧的压缩后也会立即被挤出归档，直接删除
+                expired = rotated_.size() > maxFiles_;
+            }
+            if (expired) {
+                std::error_code ec;
+                fs::remove(source, ec);
+                std::lock_guard lock(mutex_);
+                rotated_.pop_front();
+                continue;
+            }
+            try {
+                gzipFile(source, temporary);
+                shiftArchives(temporary);
+                fs::remove(source);
+            } catch (const std::exception &e) {
+                std::error_code ec;
+                fs::remove(temporary, ec);
+                SPDLOG_ERROR("压缩日志失败: {}", e.what());
+            }
+            std::lock_guard lock(mutex_);
+            rotated_.pop_front();
+        }
+    }
+
+    void openStream() {
+        auto path = streamPath();
+        stream_ = std::fopen(path.c_str(), "we");
+        if (!stream_) throw std::runtime_error(fmt::format("open {}: {}", path.string(), strerror(errno)));
+        encoder_ = GzipEncoder();
+        streamSize_ = 0;
+    }
+
+    void writeStream(const std::string &data) {
+        if (data.empty()) return;
+        if (std::fwrite(data.data(), 1, data.size(), stream_) != data.size()) {
+            throw std::runtime_error(fmt::format("write {}: {}", streamPath().string(), strerror(errno)));
+        }
+        streamSize_ += data.size();
+    }
+
+    void compressStream() {
+        std::string input, output;
+        bool unsynced = false;      // 上次sync flush之后有没有写入
+        for (;;) {
+            bool stop, sync;
+            uint64_t lost;
+            {
+                std::unique_lock lock(mutex_);
+                cv_.wait_for(lock, kSyncPeriod, [this] { return stopping_ || flushRequested_ || pending_.size() >= kChunk; });
+                input.clear();
+                input.swap(pending_);
+                stop = stopping_;
+                sync = flushRequested_ || input.size() < kChunk;    // 被请求或缓冲不满一块（空闲）时sync flush
+                flushRequested_ = false;
+                lost = dropped_;
+                dropped_ = 0;
+            }
+            if (lost > 0) input += fmt::format("[res_monitor] log buffer full, dropped {} bytes\n", lost);
+
+            try {
+                if (!stream_) openStream();
+                // 分块写入，压缩后的大小超过maxSize时在块之间结束gzip流并归档
+                for (std::string_view rest = input; !rest.empty();) {
+                    auto piece = rest.substr(0, kChunk);
+                    rest.remove_prefix(piece.size());
+                    output.clear();
+                    encoder_.write(piece, output);
+                    unsynced = true;
+                    bool full = streamSize_ + output.size() >= maxSize_;
+                    if (full) encoder_.finish(output);
+                    writeStream(output);
+                    if (full) {
+                        std::fclose(stream_);
+                        stream_ = nullptr;
+                        unsynced = false;
+                        shiftArchives(streamPath());
+                        openStream();
+                    }
+                }
+                output.clear();
+                if (stop) {
+                    encoder_.finish(output);
+                } else if (sync && unsynced) {
+                    encoder_.flush(output);
+                    unsynced = false;
+                }
+                writeStream(output);
+                if (sync || stop) std::fflush(stream_);
+                if (stop) {
+                    std::fclose(stream_);
+                    stream_ = nullptr;
+                    return;
+                }
+            } catch (const std::exception &e) {
+                if (stream_) std::fclose(stream_);
+                stream_ = nullptr;
+                unsynced = false;
+                if (stop) return;     // 退出时sink正随logger析构，不能再写日志
+                SPDLOG_ERROR("写入压缩日志失败: {}", e.what());
+            }
+        }
+    }
+};
+
+CompressedFileSink::CompressedFileSink(const fs::path &base, size_t maxSize, size_t maxFiles, LogCompression mode)
+    : impl_(std::make_unique<Impl>()) {
+    if (maxSize == 0 || maxFiles == 0) throw std::invalid_argument("compressed log needs a positive size and file count");
+    impl_->base_ = base;
+    impl_->maxSize_ = maxSize;
+    impl_->maxFiles_ = maxFiles;
+    impl_->mode_ = mode;
+    if (mode == LogCompression::Stream) {
+        std::error_code ec;
+        if (fs::exists(impl_->streamPath(), ec)) impl_->shiftArchives(impl_->streamPath());
+        impl_->openStream();
+        impl_->thread_ = std::thread([impl = impl_.get()] { impl->compressStream(); });
+    } else {
+        impl_->file_.open(base);
+        impl_->currentSize_ = impl_->file_.size();
+        impl_->resumeRotated();
+        impl_->thread_ = std::thread([impl = impl_.get()] { impl->compressRotated(); });
+    }
+}
+
+CompressedFileSink::~CompressedFileSink() {
+    {
+        std::lock_guard lock(impl_->mutex_);
+        impl_->stopping_ = true;
+    }
+    impl_->cv_.notify_all();
+    impl_->thread_.join();
+}
+
+void CompressedFileSink::sink_it_(const spdlog::details::log_msg &msg) {
+    spdlog::memory_buf_t formatted;
+    formatter_->format(msg, formatted);
+    auto &impl = *impl_;
+    if (impl.mode_ == LogCompression::Stream) {
+        bool wake;
+        {
+            std::lock_guard lock(impl.mutex_);
+            if (impl.pending_.size() + formatted.size() > kMaxPending) {
+                impl.dropped_ += formatted.size();
+                return;
+            }
+            wake = impl.pending_.size() < kChunk && impl.pending_.size() + formatted.size() >= kChunk;
+            impl.pending_.append(formatted.data(), formatted.size());
+        }
+        if (wake) impl.cv_.notify_one();
+        return;
+    }
+
+    if (impl.currentSize_ > 0 && impl.currentSize_ + formatted.size() > impl.maxSize_) impl.rotate();
+    impl.file_.write(formatted);
+    impl.currentSize_ += formatted.size();
+}
+
+void CompressedFileSink::flush_() {
+    auto &impl = *impl_;
+    if (impl.mode_ != LogCompression::Stream) {
+        impl.file_.flush();
+        return;
+    }
+    {
+        std::lock_guard lock(impl.mutex_);
+        impl.flushRequested_ = true;
+    }
+    impl.cv_.notify_one();
+}
@@ -0,0 +1,327 @@
+#include "config_file.h"
+#include "process_filter.h"
+#include "process_classifier.h"
+#include "procfs.h"
+#include <spdlog/spdlog.h>
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <charconv>
+#include <cmath>
+#include <algorithm>
+#include <filesystem>
+#include <thread>
+#include <stdexcept>
+
+namespace {
+
+std::string_view trim(std::string_view text) {
+    auto begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string_view::npos) return {};
+    auto end = text.find_last_not_of(" \t\r");
+    return text.substr(begin, end - begin + 1);
+}
+
+template <typename T>
+T parseNumber(std::string_view key, std::string_view value) {
+    T result{};
+    auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+    if (ec != std::errc() || ptr != value.data() + value.size() || result < 0) {
+        throw std::invalid_argument(fmt::format("bad {}: {}", key, value));
+    }
+    return result;
+}
+
+bool parseBool(std::string_view key, std::string_view value) {
+    if (value == "true" || value == "on" || value == "1") return true;
+    if (value == "false" || value == "off" || value == "0") return false;
+    throw std::invalid_argument(fmt::format("bad {}: {}", key, value));
+}
+
+void applyKey(MonitorConfig &config, std::string_view key, std::string_view value) {
+    auto &sample = config.sample;
+    auto &periods = sample.periods;
+    if (key == "interval") {
+        config.interval = std::chrono::seconds(parseNumber<uint64_t>(key, value));
+        if (config.interval.count() == 0) throw std::invalid_argument("interval must be positive");
+    }
+    else if (key == "min_cpu") sample.minCpuUsage = parseNumber<double>(key, value) / 100.0;
+    else if (key == "min_mem") sample.minMemUsage = parseNumber<uint64_t>(key, value) * 1024 * 1024;
+    else if (key == "min_disk") sample.minDiskUsage = parseNumber<uint64_t>(key, value) * 1024;
+    else if (key == "top") sample.numProcesses = parseNumber<int>(key, value);
+    else if (key == "mem_rank") config.memRank = parseMemRank(value);
+    else if (key == "smaps_budget") config.smapsBudget = std::chrono::milliseconds(parseNumber<uint64_t>(key, value));
+    else if (key == "cpu_budget") config.cpuBudget = parseNumber<double>(key, value);
+    else if (key == "self_report") config.selfReport = std::chrono::seconds(parseNumber<uint64_t>(key, value));
+    else if (key == "group") config.groupBy = parseGroupBy(value);
+    else if (key == "group_pattern") config.groupPatterns = parseGroupPatterns(value);
+    else if (key == "filter") config.filter = value;
+    else if (key == "period.cpu") periods.cpu = parseNumber<int>(key, value);
+    else if (key == "period.memory") periods.memory = parseNumber<int>(key, value);
+    else if (key == "period.disk") periods.disks = parseNumber<int>(key, value);
+    else if (key == "period.temperature") periods.temperatures = parseNumber<int>(key, value);
+    else if (key == "period.process") periods.processes = parseNumber<int>(key, value);
+    else if (key == "keyframe") config.delta.keyframe = parseNumber<int>(key, value);
+    else if (key == "epsilon") config.delta = parseEpsilon(value, config.delta);
+    else if (key == "console") config.console = parseBool(key, value);
+    else if (key == "log_level") {
+        static const std::string_view levels[] = {"trace", "debug", "info", "warn", "error", "critical"};
+        if (std::find(std::begin(levels), std::end(levels), value) == std::end(levels)) {
+            throw std::invalid_argument(fmt::format("unknown log_level: {}", value));
+        }
+        config.logLevel = value;
+    }
+    else throw std::invalid_argument(fmt::format("unknown key: {}", key));
+}
+
+}
+
+MemRank parseMemRank(std::string_view text) {
+    if (text == "rss") return MemRank::Rss;
+    if (text == "pss") return MemRank::Pss;
+    if (text == "uss") return MemRank::Uss;
+    if (text == "swap") return MemRank::Swap;
+    throw std::invalid_argument(fmt::format("unknown --mem-rank: {}", text));
+}
+
+GroupBy parseGroupBy(std::string_view text) {
+    if (text == "comm") return GroupBy::Comm;
+    if (text == "user") return GroupBy::User;
+    if (text == "session") return GroupBy::Session;
+    if (text == "tree") return GroupBy::Tree;
+    if (text == "pattern") return GroupBy::Pattern;
+    throw std::invalid_argument(fmt::format("unknown --group: {}", text));
+}
+
+std::vector<GroupPattern> parseGroupPatterns(std::string_view text) {
+    std::vector<GroupPattern> patterns;
+    for (size_t pos = 0; pos < text.size();) {
+        auto end = text.find(';', pos);
+        if (end == std::string_view::npos) end = text.size();
+        auto rule = text.substr(pos, end - pos);
+        pos = end + 1;
+        if (rule.empty()) continue;
+        auto equal = rule.find('=');
+        if (equal == std::string_view::npos || equal == 0) {
+            throw std::invalid_argument(fmt::format("bad --group-pattern rule: {}", rule));
+        }
+        patterns.push_back({std::string(rule.substr(0, equal)), std::string(rule.substr(equal + 1))});
+    }
+    return patterns;
+}
+
+DeltaOptions parseEpsilon(std::string_view text, const DeltaOptions &defaults) {
+    DeltaOptions options = defaults;
+    // 字节数可带K/M/G后缀（1024进制）
+    auto parseBytes = [](std::string_view key, std::string_view value) {
+        double scale = 1;
+        if (!value.empty()) {
+            switch (value.back()) {
+                case 'K': case 'k': scale = 1024.0; break;
+                case 'M': case 'm': scale = 1024.0 * 1024; break;
+                case 'G': case 'g': scale = 1024.0 * 1024 * 1024; break;
+            }
+            if (scale != 1) value.remove_suffix(1);
+        }
+        return parseNumber<double>(key, value) * scale;
+    };
+    for (size_t pos = 0; pos <= text.size();) {
+        auto end = text.find(',', pos);
+        if (end == std::string_view::npos) end = text.size();
+        auto item = trim(text.substr(pos, end - pos));
+        pos = end + 1;
+        if (item.empty()) continue;
+        if (item.back() == '%') {
+            options.relative = parseNumber<double>("epsilon", item.substr(0, item.size() - 1)) / 100.0;
+            continue;
+        }
+        auto equal = item.find('=');
+        if (equal == std::string_view::npos) throw std::invalid_argument(fmt::format("bad epsilon: {}", item));
+        auto key = trim(item.substr(0, equal));
+        auto value = trim(item.substr(equal + 1));
+        if (key == "pct") options.percent = parseNumber<double>(key, value);
+        else if (key == "mem") options.bytes = parseBytes(key, value);
+        else if (key == "io") options.rate = parseBytes(key, value);
+        else if (key == "iops") options.iops = parseNumber<double>(key, value);
+        else if (key == "await") options.awaitMs = parseNumber<double>(key, value);
+        else if (key == "temp") options.celsius = parseNumber<double>(key, value);
+        else throw std::invalid_argument(fmt::format("unknown epsilon: {}", key));
+    }
+    return options;
+}
+
+std::chrono::milliseconds parseDuration(std::string_view text) {
+    text = trim(text);
+    double scale = 1;
+    if (text.size() > 2 && text.substr(text.size() - 2) == "ms") {
+        text.remove_suffix(2);
+    } else if (!text.empty() && text.back() == 's') {
+        text.remove_suffix(1);
+        scale = 1000;
+    }
+    double value = parseNumber<double>("duration", text) * scale;
+    if (!std::isfinite(value)) throw std::invalid_argument(fmt::format("bad duration: {}", text));
+    return std::chrono::milliseconds(static_cast<int64_t>(value + 0.5));
+}
+
+MonitorConfig parseConfig(std::string_view text, const MonitorConfig &defaults) {
+    MonitorConfig config = defaults;
+    size_t lineNumber = 0;
+    while (!text.empty()) {
+        ++lineNumber;
+        auto lineEnd = text.find('\n');
+        auto line = trim(text.substr(0, lineEnd));
+        text = lineEnd == std::string_view::npos ? std::string_view() : text.substr(lineEnd + 1);
+        if (line.empty() || line.front() == '#') continue;
+
+        auto equal = line.find('=');
+        if (equal == std::string_view::npos) {
+            throw std::invalid_argument(fmt::format("line {}: expected key = value", lineNumber));
+        }
+        auto key = trim(line.substr(0, equal));
+        auto value = trim(line.substr(equal + 1));
+        if (!value.empty() && value.front() == '"') {
+            // 到最后一个引号为止原样保留，filter中的字符串无需转义，其后只允许注释
+            auto close = value.rfind('"');
+            auto rest = close > 0 ? trim(value.substr(close + 1)) : std::string_view("?");
+            if (!rest.empty() && rest.front() != '#') {
+                throw std::invalid_argument(fmt::format("line {}: unterminated quote", lineNumber));
+            }
+            value = value.substr(1, close - 1);
+        } else if (auto comment = value.find(" #"); comment != std::string_view::npos) {
+            value = trim(value.substr(0, comment));
+        }
+        try {
+            applyKey(config, key, value);
+        } catch (const std::invalid_argument &e) {
+            throw std::invalid_argument(fmt::format("line {}: {}", lineNumber, e.what()));
+        }
+    }
+
+    if (config.groupBy == GroupBy::Pattern && config.groupPatterns.empty()) {
+        throw std::invalid_argument("group = pattern requires group_pattern");
+    }
+    // 提前编译一次，应用到ResourceMonitor时不会再失败
+    if (!config.filter.empty()) ProcessFilter filter(config.filter);
+    std::vector<std::string> regexes;
+    for (const auto &pattern : config.groupPatterns) regexes.push_back(pattern.regex);
+    ProcessClassifier classifier(regexes);
+    return config;
+}
+
+MonitorConfig loadConfig(const std::string &path, const MonitorConfig &defaults) {
+    std::string text;
+    if (!procfs::readFile(path.c_str(), text)) {
+        throw std::runtime_error(fmt::format("read {}: {}", path, strerror(errno)));
+    }
+    return parseConfig(text, defaults);
+}
+
+struct ConfigWatcher::Impl {
+    std::string path_;
+    std::string name_;          // 目录中的文件名，用于过滤事件
+    MonitorConfig defaults_;
+    std::function<void(MonitorConfig)> onChange_;
+    std::string text_;          // 上次应用的内容，目录中其他文件的事件或内容未变时不重新加载
+    int inotifyFd_ = -1;
+    int wakeFd_ = -1;           // eventfd，用于通知线程退出
+    std::thread thread_;
+
+    void run();
+    void reload();
+};
+
+ConfigWatcher::ConfigWatcher()
+    : impl_(new Impl) {
+}
+
+ConfigWatcher::~ConfigWatcher() {
+    stop();
+}
+
+void ConfigWatcher::start(const std::string &path, const MonitorConfig &defaults,
+        std::function<void(MonitorConfig)> onChange) {
+    std::filesystem::path file(path);
+    auto directory = file.parent_path().empty() ? std::filesystem::path(".") : file.parent_path();
+
+    int fd = ::inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (fd < 0) throw std::runtime_error(fmt::format("inotify_init1: {}", strerror(errno)));
+    // 监视目录而不是文件本身：改名替换后原文件的watch会失效。
+    // 不监视IN_CREATE：新建时文件还是空的，写完关闭时的IN_CLOSE_WRITE才是完整内容
+    if (::inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE) < 0) {
+        int err = errno;
+        ::close(fd);
+        throw std::runtime_error(fmt::format("inotify_add_watch {}: {}", directory.string(), strerror(err)));
+    }
+
+    impl_->path_ = path;
+    impl_->name_ = file.filename().string();
+    impl_->defaults_ = defaults;
+    impl_->onChange_ = std::move(onChange);
+    impl_->text_.clear();
+    procfs::readFile(path.c_str(), impl_->text_);
+    impl_->inotifyFd_ = fd;
+    impl_->wakeFd_ = ::eventfd(0, EFD_CLOEXEC);
+    impl_->thread_ = std::thread([this] { impl_->run(); });
+}
+
+void ConfigWatcher::stop() {
+    if (!impl_->thread_.joinable()) return;
+    uint64_t one = 1;
+    (void)!::write(impl_->wakeFd_, &one, sizeof(one));
+    impl_->thread_.join();
+    ::close(impl_->inotifyFd_);
+    ::close(impl_->wakeFd_);
+    impl_->inotifyFd_ = impl_->wakeFd_ = -1;
+}
+
+void ConfigWatcher::Impl::run() {
+    pollfd fds[2] = {{inotifyFd_, POLLIN, 0}, {wakeFd_, POLLIN, 0}};
+    alignas(inotify_event) char events[4096];
+    for (;;) {
+        int n = ::poll(fds, 2, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            SPDLOG_ERROR("config watcher poll: {}", strerror(errno));
+            return;
+        }
+        if (fds[1].revents) return;
+        if (!(fds[0].revents & POLLIN)) continue;
+
+        // 一次读出所有排队的事件，多个事件只重新加载一次
+        bool changed = false;
+        for (;;) {
+            ssize_t size = ::read(inotifyFd_, events, sizeof(events));
+            if (size <= 0) break;
+            for (ssize_t offset = 0; offset < size;) {
+                auto *event = reinterpret_cast<const inotify_event *>(events + offset);
+                // ConfigMap等通过替换目录中的符号链接更新，事件中的名字不是配置文件本身
+                if (event->len == 0 || name_ == event->name || event->name[0] == '.') changed = true;
+                offset += sizeof(inotify_event) + event->len;
+            }
+        }
+        if (changed) reload();
+    }
+}
+
+void ConfigWatcher::Impl::reload() {
+    std::string text;
+    if (!procfs::readFile(path_.c_str(), text)) return;    // 改名替换的中间状态，等待下一个事件
+    if (text == text_) return;
+    // 截断后重写的中间状态，不当作全部取默认值的配置应用
+    if (text.empty()) {
+        SPDLOG_WARN("config {} is empty, keeping the current settings", path_);
+        return;
+    }
+    text_ = std::move(text);
+    try {
+        auto config = parseConfig(text_, defaults_);
+        SPDLOG_INFO("config reloaded: {}", path_);
+        onChange_(std::move(config));
+    } catch (const std::exception &e) {
+        SPDLOG_ERROR("config {} ignored: {}", path_, e.what());
+    }
+}
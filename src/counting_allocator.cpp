@@ -0,0 +1,69 @@
+#include "self_stats.h"
+#include <cstdlib>
+#include <new>
+
+// 替换全局operator new/delete，按线程统计堆分配次数（见threadAllocations()），供自监控和基准测试使用。
+// 包括数组、nothrow和按对齐分配的形式，都由malloc/aligned_alloc分配、free释放；
+// 单独编译为res_monitor_alloc，链接它的程序才会替换，嵌入res_monitor_core的程序可自行选择
+
+namespace {
+
+// 失败时按标准的要求调用new_handler后重试，没有new_handler时返回nullptr
+void *allocate(std::size_t size, std::size_t alignment) {
+    ++threadAllocations();
+    if (size == 0) size = 1;
+    bool aligned = alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+    if (aligned) size = (size + alignment - 1) & ~(alignment - 1);     // aligned_alloc要求大小为对齐的整数倍
+    for (;;) {
+        if (void *p = aligned ? std::aligned_alloc(alignment, size) : std::malloc(size)) return p;
+        auto handler = std::get_new_handler();
+        if (!handler) return nullptr;
+        handler();
+    }
+}
+
+void *allocateOrThrow(std::size_t size, std::size_t alignment) {
+    if (void *p = allocate(size, alignment)) return p;
+    throw std::bad_alloc();
+}
+
+// new_handler可能抛出std::bad_alloc
+void *allocateNoThrow(std::size_t size, std::size_t alignment) noexcept {
+    try {
+        return allocate(size, alignment);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+}
+
+void *operator new(std::size_t size) { return allocateOrThrow(size, 0); }
+void *operator new[](std::size_t size) { return allocateOrThrow(size, 0); }
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept { return allocateNoThrow(size, 0); }
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept { return allocateNoThrow(size, 0); }
+void *operator new(std::size_t size, std::align_val_t alignment) {
+    return allocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+    return allocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+void *operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return allocateNoThrow(size, static_cast<std::size_t>(alignment));
+}
+void *operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return allocateNoThrow(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { std::free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept { std::free(p); }
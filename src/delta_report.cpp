@@ -0,0 +1,130 @@
+#include "delta_report.h"
+#include "report.h"
+#include <spdlog/fmt/fmt.h>
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+namespace {
+
+std::string formatTemperature(const TemperatureReading &reading) {
+    return fmt::format("TEMP {}/{} {}: {:+.1f}°C", reading.hwmon, reading.chip, reading.label, reading.celsius);
+}
+
+// 按id逐项比较current和上次输出的reported：新出现的输出"+"，changed为真的输出"~"，消失的输出"-"。
+// 之后reported按current的顺序保存每项最后一次输出的值
+template <typename T, typename Id, typename Changed, typename Format>
+void diffList(const std::vector<T> &current, std::vector<T> &reported, Id id, Changed changed, Format format,
+              std::vector<std::string> &lines) {
+    std::vector<T> kept;
+    kept.reserve(current.size());
+    for (const auto &item : current) {
+        auto it = std::find_if(reported.begin(), reported.end(), [&](const T &old) { return id(old) == id(item); });
+        if (it == reported.end()) {
+            lines.push_back("+ " + format(item));
+            kept.push_back(item);
+        } else if (changed(*it, item)) {
+            lines.push_back("~ " + format(item));
+            kept.push_back(item);
+        } else {
+            kept.push_back(*it);
+        }
+    }
+    for (const auto &old : reported) {
+        if (std::none_of(current.begin(), current.end(), [&](const T &item) { return id(item) == id(old); })) {
+            lines.push_back("- " + format(old));
+        }
+    }
+    reported = std::move(kept);
+}
+
+}
+
+void DeltaReporter::setOptions(const DeltaOptions &options) {
+    options_ = options;
+    ticks_ = 0;
+}
+
+bool DeltaReporter::moved(double last, double current, double absolute) const {
+    return std::abs(current - last) > std::max(absolute, options_.relative * std::abs(last));
+}
+
+bool DeltaReporter::next(const Snapshot &snapshot, std::vector<std::string> &lines) {
+    // 排序依据或分组方式改变后旧的列表没有可比性
+    bool keyframe = options_.keyframe <= 1 || ticks_ % options_.keyframe == 0
+        || snapshot.memRank != reported_.memRank || snapshot.groupBy != reported_.groupBy;
+    if (keyframe) {
+        ticks_ = 1;
+        reported_ = snapshot;
+        reported_.processes.reset();    // 不延长进程表的生命周期
+        reported_.watched.clear();
+        return true;
+    }
+    ++ticks_;
+
+    const auto &o = options_;
+    if (snapshot.cpuPercent.has_value() != reported_.cpuPercent.has_value()
+        || (snapshot.cpuPercent && moved(*reported_.cpuPercent, *snapshot.cpuPercent, o.percent))) {
+        lines.push_back("~ " + formatCpu(snapshot.cpuPercent));
+        reported_.cpuPercent = snapshot.cpuPercent;
+    }
+
+    const auto &mem = snapshot.mem, &last = reported_.mem;
+    auto usage = [](const MemInfo &info) { return info.total ? 100.0 * info.used() / info.total : 0.0; };
+    if (moved(usage(last), usage(mem), o.percent)
+        || moved(last.available, mem.available, o.bytes) || moved(last.slab, mem.slab, o.bytes)
+        || moved(last.shmem, mem.shmem, o.bytes) || moved(last.dirty, mem.dirty, o.bytes)
+        || moved(last.writeback, mem.writeback, o.bytes) || moved(last.swapUsed(), mem.swapUsed(), o.bytes)) {
+        lines.push_back("~ " + formatMemory(mem));
+        reported_.mem = mem;
+    }
+
+    if (snapshot.disksReady != reported_.disksReady) {
+        lines.push_back("~ " + formatDisks(snapshot.disksReady, snapshot.disks));
+        reported_.disksReady = snapshot.disksReady;
+        reported_.disks = snapshot.disks;
+    } else if (snapshot.disksReady) {
+        diffList(snapshot.disks, reported_.disks, [](const DiskStat &d) -> const std::string & { return d.name; },
+            [&](const DiskStat &a, const DiskStat &b) {
+                return moved(a.busyPercent, b.busyPercent, o.percent)
+                    || moved(a.readBytesPerSec, b.readBytesPerSec, o.rate) || moved(a.writeBytesPerSec, b.writeBytesPerSec, o.rate)
+                    || moved(a.readIops, b.readIops, o.iops) || moved(a.writeIops, b.writeIops, o.iops)
+                    || moved(a.readAwaitMs, b.readAwaitMs, o.awaitMs) || moved(a.writeAwaitMs, b.writeAwaitMs, o.awaitMs);
+            },
+            [](const DiskStat &d) { return formatDisks(true, {d}); }, lines);
+    }
+
+    // 同名芯片的传感器名相同，按hwmon设备区分
+    diffList(snapshot.temperatures, reported_.temperatures,
+        [](const TemperatureReading &r) { return std::tie(r.hwmon, r.label); },
+        [&](const TemperatureReading &a, const TemperatureReading &b) { return moved(a.celsius, b.celsius, o.celsius); },
+        formatTemperature, lines);
+
+    auto pid = [](const ProcessSample &p) { return p.pid; };
+    diffList(snapshot.topCpu, reported_.topCpu, pid,
+        [&](const ProcessSample &a, const ProcessSample &b) { return moved(a.cpuPercent, b.cpuPercent, o.percent); },
+        formatTopCpu, lines);
+    diffList(snapshot.topMem, reported_.topMem, pid,
+        [&](const ProcessSample &a, const ProcessSample &b) { return moved(a.memBytes, b.memBytes, o.bytes); },
+        [&](const ProcessSample &p) { return formatTopMem(p, snapshot.memRank); }, lines);
+    diffList(snapshot.topDisk, reported_.topDisk, pid,
+        [&](const ProcessSample &a, const ProcessSample &b) {
+            return moved(a.readBytesPerSec + a.writeBytesPerSec, b.readBytesPerSec + b.writeBytesPerSec, o.rate);
+        },
+        formatTopDisk, lines);
+
+    auto name = [](const ProcessGroup &g) -> const std::string & { return g.name; };
+    auto groupBy = snapshot.groupBy;
+    diffList(snapshot.topCpuGroups, reported_.topCpuGroups, name,
+        [&](const ProcessGroup &a, const ProcessGroup &b) { return moved(a.cpuPercent, b.cpuPercent, o.percent); },
+        [groupBy](const ProcessGroup &g) { return formatTopCpuGroup(g, groupBy); }, lines);
+    diffList(snapshot.topMemGroups, reported_.topMemGroups, name,
+        [&](const ProcessGroup &a, const ProcessGroup &b) { return moved(a.memBytes, b.memBytes, o.bytes); },
+        [groupBy](const ProcessGroup &g) { return formatTopMemGroup(g, groupBy); }, lines);
+    diffList(snapshot.topDiskGroups, reported_.topDiskGroups, name,
+        [&](const ProcessGroup &a, const ProcessGroup &b) {
+            return moved(a.readBytesPerSec + a.writeBytesPerSec, b.readBytesPerSec + b.writeBytesPerSec, o.rate);
+        },
+        [groupBy](const ProcessGroup &g) { return formatTopDiskGroup(g, groupBy); }, lines);
+    return false;
+}
@@ -0,0 +1,257 @@
+#include "fixture.h"
+#include <spdlog/spdlog.h>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// 每个周期按100Hz的USER_HZ计，10秒为1000个时钟滴答
+constexpr uint64_t kTicksPerPeriod = 1000;
+constexpr int kFirstPid = 100;
+
+// 确定性的伪随机数，同一个输入总得到同一个输出
+uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+void writeFile(const fs::path &path, std::string_view content) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) throw std::runtime_error("cannot write " + path.string());
+    out.write(content.data(), content.size());
+}
+
+// 与内核的命名一致：sda…sdz之后是sdaa…sdzz、sdaaa…
+std::string diskName(int index) {
+    std::string suffix;
+    for (int n = index + 1; n > 0; n = (n - 1) / 26) suffix.insert(suffix.begin(), static_cast<char>('a' + (n - 1) % 26));
+    return "sd" + suffix;
+}
+
+// 生成的proc、sys目录中的标记文件，重新生成时只删除带标记的目录
+constexpr char kMarker[] = ".res_monitor_fixture";
+
+void checkRemovable(const fs::path &dir) {
+    if (fs::exists(fs::symlink_status(dir)) && !fs::exists(dir / kMarker)) {
+        throw std::runtime_error(fmt::format("{} exists and was not generated as a fixture, refusing to replace it", dir.string()));
+    }
+}
+
+// 约5%的进程在持续消耗CPU和IO，其余空闲
+bool isActive(int pid) {
+    return mix(pid) % 20 == 0;
+}
+
+void writeProcStat(const fs::path &proc, const FixtureOptions &options, uint64_t tick) {
+    fmt::memory_buffer buf;
+    auto cpuLine = [&](const std::string &name, uint64_t scale) {
+        uint64_t base = tick * kTicksPerPeriod * scale;
+        fmt::format_to(std::back_inserter(buf), "{} {} {} {} {} {} {} {} 0 0 0\n",
+            name, base * 30 / 100, base / 100, base * 10 / 100, base * 55 / 100,
+            base * 2 / 100, base / 100, base / 100);
+    };
+    cpuLine("cpu", options.numCpus);
+    for (int i = 0; i < options.numCpus; ++i) cpuLine(fmt::format("cpu{}", i), 1);
+    fmt::format_to(std::back_inserter(buf), "intr 0\nctxt {}\nbtime 1700000000\nprocesses {}\n",
+        tick * 100000, options.numPids);
+    writeFile(proc / "stat", {buf.data(), buf.size()});
+}
+
+void writeMeminfo(const fs::path &proc, const FixtureOptions &options) {
+    uint64_t totalKb = 64ULL * 1024 * 1024;
+    uint64_t usedKb = std::min<uint64_t>(totalKb / 2, 4096ULL * options.numPids);
+    auto text = fmt::format(
+        "MemTotal:       {} kB\n"
+        "MemFree:        {} kB\n"
+        "MemAvailable:   {} kB\n"
+        "Buffers:          204800 kB\n"
+        "Cached:          4194304 kB\n"
+        "SwapCached:            0 kB\n"
+        "Active:          8388608 kB\n"
+        "Inactive:        4194304 kB\n"
+        "Dirty:              2048 kB\n"
+        "Writeback:             0 kB\n"
+        "AnonPages:       {} kB\n"
+        "Mapped:           524288 kB\n"
+        "Shmem:            131072 kB\n"
+        "Slab:             524288 kB\n"
+        "SReclaimable:     262144 kB\n"
+        "SUnreclaim:       262144 kB\n"
+        "SwapTotal:       8388608 kB\n"
+        "SwapFree:        8126464 kB\n"
+        "HugePages_Total:       0\n"
+        "HugePages_Free:        0\n"
+        "Hugepagesize:       2048 kB\n"
+        "Hugetlb:               0 kB\n",
+        totalKb, totalKb - usedKb - 4194304 - 204800, totalKb - usedKb, usedKb);
+    writeFile(proc / "meminfo", text);
+}
+
+void writeDiskstats(const fs::path &proc, const FixtureOptions &options, uint64_t tick) {
+    fmt::memory_buffer buf;
+    auto line = [&](unsigned major, unsigned minor, const std::string &name, uint64_t scale) {
+        uint64_t ios = tick * 500 * scale;
+        // major minor name reads merges sectors ticks writes merges sectors ticks inflight io_ticks weighted ...
+        fmt::format_to(std::back_inserter(buf),
+            "{:4} {:7} {} {} {} {} {} {} {} {} {} {} {} {} 0 0 0 0 0 0\n",
+            major, minor, name,
+            ios, ios / 10, ios * 16, ios / 2,
+            ios * 2, ios / 5, ios * 64, ios,
+            scale % 3, tick * 2000 * scale / (scale + 1), ios * 3 / 2);
+    };
+    for (int i = 0; i < options.numDisks; ++i) {
+        line(8, i * 16, diskName(i), i + 1);
+        line(8, i * 16 + 1, diskName(i) + "1", i + 1);
+    }
+    if (options.numDisks > 0) line(253, 0, "dm-0", 1);
+    line(7, 0, "loop0", 0);
+    writeFile(proc / "diskstats", {buf.data(), buf.size()});
+}
+
+void writeProcessCounters(const fs::path &dir, int pid, uint64_t tick) {
+    uint64_t h = mix(pid);
+    bool active = isActive(pid);
+    uint64_t utime = (h % 5000) + (active ? tick * (h % 200 + 10) : 0);
+    uint64_t stime = (h % 700) + (active ? tick * (h % 40) : 0);
+    uint64_t rssPages = 64 + h % 65536;
+
+    // 少量进程名包含空格和括号，与真实系统一样
+    std::string comm = pid % 97 == 0 ? fmt::format("worker ({})", pid % 7) : fmt::format("worker-{}", h % 50);
+    writeFile(dir / "stat", fmt::format(
+        "{} ({}) S {} {} {} 0 -1 4194560 {} 0 {} 0 {} {} 0 0 20 0 1 0 {} {} {} 18446744073709551615 1 1 0 0 0 0 0 0 0 0 0 0 17 {} 0 0 0 0 0\n",
+        pid, comm, pid > kFirstPid ? kFirstPid + h % (pid - kFirstPid) : 1, pid, pid,
+        h % 100000, h % 100, utime, stime,
+        1000 + pid, rssPages * 4096 * 4, rssPages, pid % 8));
+
+    writeFile(dir / "statm", fmt::format("{} {} {} 10 0 {} 0\n",
+        rssPages * 4, rssPages, rssPages / 4, rssPages / 2));
+
+    uint64_t readBytes = (h % 100) * 4096 + (active ? tick * (h % 64) * 4096 * 100 : 0);
+    uint64_t writeBytes = (h % 50) * 4096 + (active ? tick * (h % 32) * 4096 * 100 : 0);
+    writeFile(dir / "io", fmt::format(
+        "rchar: {}\nwchar: {}\nsyscr: {}\nsyscw: {}\nread_bytes: {}\nwrite_bytes: {}\ncancelled_write_bytes: 0\n",
+        readBytes * 2, writeBytes * 2, tick * 100, tick * 50, readBytes, writeBytes));
+}
+
+void writeProcess(const fs::path &proc, int pid, uint64_t tick) {
+    auto dir = proc / std::to_string(pid);
+    fs::create_directories(dir);
+    uint64_t h = mix(pid);
+
+    writeProcessCounters(dir, pid, tick);
+
+    std::string cmdline = fmt::format("/usr/bin/worker-{}", h % 50);
+    cmdline.push_back('\0');
+    cmdline += fmt::format("--id={}", pid);
+    cmdline.push_back('\0');
+    writeFile(dir / "cmdline", cmdline);
+
+    uint64_t uid = h % 4 == 0 ? 0 : 1000 + h % 5;
+    writeFile(dir / "status", fmt::format(
+        "Name:\tworker-{}\nState:\tS (sleeping)\nTgid:\t{}\nPid:\t{}\nPPid:\t1\nUid:\t{} {} {} {}\nGid:\t{} {} {} {}\n",
+        h % 50, pid, pid, uid, uid, uid, uid, uid, uid, uid, uid));
+
+    uint64_t rssKb = (64 + h % 65536) * 4;
+    uint64_t privateKb = rssKb / (1 + h % 4);
+    writeFile(dir / "smaps_rollup", fmt::format(
+        "00400000-7fffffffe000 ---p 00000000 00:00 0                          [rollup]\n"
+        "Rss:            {} kB\nPss:            {} kB\nShared_Clean:   {} kB\nShared_Dirty:   0 kB\n"
+        "Private_Clean:  0 kB\nPrivate_Dirty:  {} kB\nSwap:           {} kB\nSwapPss:        0 kB\n",
+        rssKb, privateKb + (rssKb - privateKb) / 8, rssKb - privateKb, privateKb, h % 3 == 0 ? h % 1024 : 0));
+}
+
+void writeSys(const fs::path &sys, const FixtureOptions &options) {
+    auto devices = sys / "devices";
+    auto block = sys / "block";
+    auto classBlock = sys / "class/block";
+    fs::create_directories(block);
+    fs::create_directories(classBlock);
+
+    auto addDevice = [&](const fs::path &devDir, const std::string &name) {
+        fs::create_directories(devDir);
+        fs::create_directory_symlink(fs::relative(devDir, block), block / name);
+        fs::create_directory_symlink(fs::relative(devDir, classBlock), classBlock / name);
+    };
+
+    for (int i = 0; i < options.numDisks; ++i) {
+        auto name = diskName(i);
+        auto devDir = devices / fmt::format("pci0000:00/0000:00:{:02x}.0/block", i + 1) / name;
+        addDevice(devDir, name);
+        fs::create_directories(devDir / "slaves");
+        auto partDir = devDir / (name + "1");
+        fs::create_directories(partDir);
+        writeFile(partDir / "partition", "1\n");
+        fs::create_directory_symlink(fs::relative(partDir, classBlock), classBlock / (name + "1"));
+    }
+    if (options.numDisks > 0) {
+        auto dmDir = devices / "virtual/block/dm-0";
+        addDevice(dmDir, "dm-0");
+        fs::create_directories(dmDir / "slaves");
+        writeFile(dmDir / "slaves" / (diskName(0) + "1"), "");
+    }
+    auto loopDir = devices / "virtual/block/loop0";
+    addDevice(loopDir, "loop0");
+    fs::create_directories(loopDir / "slaves");
+
+    // 每个hwmon芯片最多4个温度传感器，每个芯片对应一个thermal zone
+    int chips = (options.numSensors + 3) / 4;
+    for (int chip = 0; chip < chips; ++chip) {
+        auto hw = sys / "class/hwmon" / fmt::format("hwmon{}", chip);
+        fs::create_directories(hw / "device");
+        writeFile(hw / "name", chip == 0 ? "coretemp\n" : fmt::format("chip{}\n", chip));
+        for (int n = 1; n <= 4 && chip * 4 + n <= options.numSensors; ++n) {
+            writeFile(hw / fmt::format("temp{}_input", n), fmt::format("{}\n", 40000 + (chip * 4 + n) * 500));
+            writeFile(hw / fmt::format("temp{}_label", n), n == 1 ? fmt::format("Package id {}\n", chip) : fmt::format("Core {}\n", n - 2));
+            writeFile(hw / fmt::format("temp{}_max", n), "80000\n");
+            writeFile(hw / fmt::format("temp{}_crit", n), "100000\n");
+        }
+
+        auto zone = sys / "class/thermal" / fmt::format("thermal_zone{}", chip);
+        fs::create_directories(zone);
+        writeFile(zone / "type", fmt::format("x86_pkg_temp{}\n", chip));
+        writeFile(zone / "temp", fmt::format("{}\n", 45000 + chip * 1000));
+    }
+}
+
+}
+
+void generateFixture(const std::string &root, const FixtureOptions &options, uint64_t tick) {
+    fs::path base(root);
+    checkRemovable(base / "proc");
+    checkRemovable(base / "sys");
+    fs::remove_all(base / "proc");
+    fs::remove_all(base / "sys");
+    auto proc = base / "proc";
+    fs::create_directories(proc);
+    fs::create_directories(base / "sys");
+    writeFile(proc / kMarker, "");
+    writeFile(base / "sys" / kMarker, "");
+
+    writeMeminfo(proc, options);
+    for (int i = 0; i < options.numPids; ++i) {
+        writeProcess(proc, kFirstPid + i, tick);
+    }
+    writeProcStat(proc, options, tick);
+    writeDiskstats(proc, options, tick);
+    writeSys(base / "sys", options);
+}
+
+void advanceFixture(const std::string &root, const FixtureOptions &options, uint64_t tick) {
+    auto proc = fs::path(root) / "proc";
+    if (!fs::exists(proc / kMarker)) throw std::runtime_error(fmt::format("{} is not a generated fixture", proc.string()));
+    writeProcStat(proc, options, tick);
+    writeDiskstats(proc, options, tick);
+    for (int i = 0; i < options.numPids; ++i) {
+        int pid = kFirstPid + i;
+        if (isActive(pid) || tick == 0) {
+            writeProcessCounters(proc / std::to_string(pid), pid, tick);
+        }
+    }
+}
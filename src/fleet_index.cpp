@@ -0,0 +1,189 @@
+#include "fleet_index.h"
+#include "query_server.h"
+#include "top_k.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr float kQuantiles[] = {0, 0.5, 0.75, 0.9, 0.95, 0.99, 1};
+
+template <size_t N>
+void copyName(char (&out)[N], std::string_view name) {
+    auto size = std::min(name.size(), N - 1);
+    std::memcpy(out, name.data(), size);
+    out[size] = '\0';
+}
+
+// 整盘读写速率之和，不含dm/md等堆叠设备，避免重复计算
+double diskBytesPerSec(const Snapshot &snapshot) {
+    double total = 0;
+    for (const auto &disk : snapshot.disks) {
+        if (disk.kind == DiskStat::Kind::Disk) total += disk.readBytesPerSec + disk.writeBytesPerSec;
+    }
+    return total;
+}
+
+}
+
+FleetIndex::FleetIndex(size_t window)
+    : window_(std::max<size_t>(window, 1)) {
+}
+
+FleetIndex::Host &FleetIndex::host(const std::string &name) {
+    auto [it, inserted] = hosts_.try_emplace(name);
+    if (inserted) {
+        it->second.slot = summaries_.size();
+        summaries_.emplace_back().host = &it->first;
+    }
+    return it->second;
+}
+
+void FleetIndex::setConnected(const std::string &name, bool connected) {
+    summaries_[host(name).slot].connected = connected;
+}
+
+void FleetIndex::add(const std::string &name, const Snapshot &snapshot) {
+    auto &host = this->host(name);
+    auto &summary = summaries_[host.slot];
+    ++snapshots_;
+    latestMs_ = std::max<int64_t>(latestMs_,
+        std::chrono::duration_cast<std::chrono::milliseconds>(snapshot.time.time_since_epoch()).count());
+    updateTop(*summary.host, host, snapshot);
+    updateGroups(host, snapshot);
+
+    // 首次采样没有CPU和磁盘速率，不计入
+    if (!snapshot.cpuPercent || !snapshot.disksReady) return;
+    Values values = {
+        static_cast<float>(*snapshot.cpuPercent),
+        snapshot.mem.total ? static_cast<float>(100.0 * snapshot.mem.used() / snapshot.mem.total) : 0.0f,
+        static_cast<float>(diskBytesPerSec(snapshot)),
+    };
+    if (!host.window.empty()) {
+        for (size_t m = 0; m < kMetrics; ++m) fleet_[m].remove(host.window.back()[m]);
+    }
+    if (host.window.size() == window_) {
+        for (size_t m = 0; m < kMetrics; ++m) host.sketches[m].remove(host.window.front()[m]);
+        host.window.pop_front();
+    }
+    host.window.push_back(values);
+    for (size_t m = 0; m < kMetrics; ++m) {
+        host.sketches[m].add(values[m]);
+        fleet_[m].add(values[m]);
+        for (size_t i = 0; i < kHostQuantiles.size(); ++i) summary.quantiles[m][i] = host.sketches[m].quantile(kHostQuantiles[i]);
+    }
+    summary.latest = values;
+    summary.samples = host.window.size();
+}
+
+void FleetIndex::updateTop(const std::string &name, Host &host, const Snapshot &snapshot) {
+    const std::vector<ProcessSample> *lists[kMetrics] = {&snapshot.topCpu, &snapshot.topMem, &snapshot.topDisk};
+    for (size_t m = 0; m < kMetrics; ++m) {
+        for (auto entry : host.top[m]) top_[m].erase(entry);
+        host.top[m].clear();
+        for (const auto &process : *lists[m]) {
+            TopEntry entry{&name, {}};
+            auto &record = entry.process;
+            record.pid = process.pid;
+            record.cpuPercent = process.cpuPercent;
+            record.rssBytes = process.memBytes;
+            record.readBytesPerSec = process.readBytesPerSec;
+            record.writeBytesPerSec = process.writeBytesPerSec;
+            copyName(record.command, process.cmdline);
+            float key = m == 0 ? record.cpuPercent
+                : m == 1 ? static_cast<float>(record.rssBytes)
+                : record.readBytesPerSec + record.writeBytesPerSec;
+            host.top[m].push_back(top_[m].emplace(key, entry));
+        }
+    }
+}
+
+void FleetIndex::updateGroups(Host &host, const Snapshot &snapshot) {
+    for (const auto &[group, values] : host.groups) {
+        auto it = groups_.find(group);
+        for (size_t m = 0; m < kMetrics; ++m) it->second[m].remove(values[m]);
+        if (it->second[0].empty()) groups_.erase(it);
+    }
+    host.groups.clear();
+    // 分组只在top-N中出现，三个列表的并集为这台主机已知的分组
+    for (const auto *list : {&snapshot.topCpuGroups, &snapshot.topMemGroups, &snapshot.topDiskGroups}) {
+        for (const auto &group : *list) {
+            host.groups.try_emplace(group.name, Values{static_cast<float>(group.cpuPercent), static_cast<float>(group.memBytes),
+                static_cast<float>(group.readBytesPerSec + group.writeBytesPerSec)});
+        }
+    }
+    for (const auto &[group, values] : host.groups) {
+        auto &sketches = groups_[group];
+        for (size_t m = 0; m < kMetrics; ++m) sketches[m].add(values[m]);
+    }
+}
+
+query::Status FleetIndex::answer(const query::Request &request, query::ResponseHeader &header, std::vector<char> &response) const {
+    auto metric = static_cast<size_t>(request.sortKey);
+    if (metric >= kMetrics) return query::Status::BadRequest;
+    header.timeMs = latestMs_;
+    header.generation = snapshots_;
+    if (snapshots_ == 0) return query::Status::NoData;
+
+    switch (request.type) {
+        case query::Type::FleetTop: {
+            const auto &index = top_[metric];
+            size_t n = request.count ? request.count : index.size();
+            for (auto it = index.begin(); it != index.end() && header.count < n; ++it, ++header.count) {
+                auto &record = appendRecord<query::FleetProcessRecord>(response);
+                copyName(record.host, *it->second.host);
+                record.process = it->second.process;
+            }
+            header.recordSize = sizeof(query::FleetProcessRecord);
+            return query::Status::Ok;
+        }
+
+        case query::Type::FleetHosts: {
+            if (!(request.quantile >= 0 && request.quantile <= 1)) return query::Status::BadRequest;
+            // 常用的分位数直接取摘要中算好的值，其余的才逐台访问草图
+            auto preset = std::find(kHostQuantiles.begin(), kHostQuantiles.end(), request.quantile) - kHostQuantiles.begin();
+            std::vector<std::pair<float, const Summary *>> hosts;
+            for (const auto &summary : summaries_) {
+                if (summary.samples == 0) continue;
+                float value = preset < static_cast<ptrdiff_t>(kHostQuantiles.size()) ? summary.quantiles[metric][preset]
+                    : hosts_.find(*summary.host)->second.sketches[metric].quantile(request.quantile);
+                if (value >= request.threshold) hosts.emplace_back(value, &summary);
+            }
+            selectTopK(hosts, request.count ? request.count : hosts.size(), [](const auto &host) { return host.first; });
+            for (const auto &[value, summary] : hosts) {
+                auto &record = appendRecord<query::HostRecord>(response);
+                copyName(record.host, *summary->host);
+                record.value = value;
+                record.latest = summary->latest[metric];
+                record.samples = summary->samples;
+                record.connected = summary->connected;
+            }
+            header.count = hosts.size();
+            header.recordSize = sizeof(query::HostRecord);
+            return query::Status::Ok;
+        }
+
+        case query::Type::FleetDistribution: {
+            const DDSketch *sketch = &fleet_[metric];
+            std::string_view group(request.group, strnlen(request.group, sizeof(request.group)));
+            if (!group.empty()) {
+                auto it = groups_.find(std::string(group));
+                if (it == groups_.end()) return query::Status::NotFound;
+                sketch = &it->second[metric];
+            }
+            if (sketch->empty()) return query::Status::NoData;
+            for (float q : kQuantiles) {
+                auto &record = appendRecord<query::QuantileRecord>(response);
+                record.quantile = q;
+                record.value = sketch->quantile(q);
+                record.samples = sketch->count();
+            }
+            header.count = std::size(kQuantiles);
+            header.recordSize = sizeof(query::QuantileRecord);
+            return query::Status::Ok;
+        }
+
+        default:
+            return query::Status::BadRequest;
+    }
+}
@@ -0,0 +1,389 @@
+#include "gzip.h"
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <queue>
+#include <stdexcept>
+
+namespace {
+
+constexpr size_t kWindow = 32768;
+constexpr size_t kMinMatch = 3;
+constexpr size_t kMaxMatch = 258;
+constexpr size_t kBlockSize = 128 * 1024;   // 每个块压缩的输入字节数
+constexpr int kHashBits = 15;
+constexpr int kMaxChain = 32;               // 每个位置最多比较的候选数
+constexpr size_t kLiterals = 286;           // 字面量/长度码，256为块结束
+constexpr size_t kDistances = 30;
+constexpr size_t kCodeLengths = 19;
+
+constexpr uint16_t kLengthBase[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr uint8_t kLengthExtra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr uint16_t kDistanceBase[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+constexpr uint8_t kDistanceExtra[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+constexpr uint8_t kCodeLengthOrder[] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+size_t lengthCode(size_t length) {
+    return std::upper_bound(std::begin(kLengthBase), std::end(kLengthBase), length) - std::begin(kLengthBase) - 1;
+}
+
+size_t distanceCode(size_t distance) {
+    return std::upper_bound(std::begin(kDistanceBase), std::end(kDistanceBase), distance) - std::begin(kDistanceBase) - 1;
+}
+
+uint32_t crc32(uint32_t crc, std::string_view data) {
+    static const auto table = [] {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        return table;
+    }();
+    crc = ~crc;
+    for (unsigned char byte : data) crc = table[(crc ^ byte) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+// 按频率生成不超过limit位的Huffman码长；超出时把频率减半（非零的保持非零）后重建，
+// 频率趋于相同时码长趋于平衡，总能收敛
+std::vector<uint8_t> huffmanLengths(std::vector<uint32_t> frequencies, int limit) {
+    std::vector<uint8_t> lengths(frequencies.size(), 0);
+    for (;;) {
+        // 节点先是叶子，之后按合并的先后编号，父节点总在子节点之后
+        std::vector<int> parent, symbol;
+        using Item = std::pair<uint64_t, int>;
+        std::priority_queue<Item, std::vector<Item>, std::greater<>> queue;
+        for (size_t i = 0; i < frequencies.size(); ++i) {
+            if (frequencies[i] == 0) continue;
+            queue.emplace(frequencies[i], static_cast<int>(parent.size()));
+            parent.push_back(-1);
+            symbol.push_back(static_cast<int>(i));
+        }
+        if (symbol.empty()) return lengths;
+        if (symbol.size() == 1) {
+            lengths[symbol[0]] = 1;     // 只有一个码时也须占1位
+            return lengths;
+        }
+        while (queue.size() > 1) {
+            auto [a, left] = queue.top();
+            queue.pop();
+            auto [b, right] = queue.top();
+            queue.pop();
+            int node = static_cast<int>(parent.size());
+            parent[left] = parent[right] = node;
+            parent.push_back(-1);
+            queue.emplace(a + b, node);
+        }
+        std::vector<int> depth(parent.size(), 0);
+        for (size_t node = parent.size() - 1; node-- > 0;) depth[node] = depth[parent[node]] + 1;
+        if (*std::max_element(depth.begin(), depth.begin() + symbol.size()) <= limit) {
+            for (size_t i = 0; i < symbol.size(); ++i) lengths[symbol[i]] = static_cast<uint8_t>(depth[i]);
+            return lengths;
+        }
+        for (auto &frequency : frequencies) frequency = (frequency + 1) / 2;
+    }
+}
+
+// 码长对应的规范Huffman码，按位反转后存放：deflate的Huffman码从高位起写，其余字段从低位起写
+std::vector<uint16_t> canonicalCodes(const std::vector<uint8_t> &lengths) {
+    int count[16] = {};
+    for (auto length : lengths) ++count[length];
+    count[0] = 0;
+    int next[16] = {};
+    for (int bits = 1, code = 0; bits < 16; ++bits) {
+        code = (code + count[bits - 1]) << 1;
+        next[bits] = code;
+    }
+    std::vector<uint16_t> codes(lengths.size(), 0);
+    for (size_t i = 0; i < lengths.size(); ++i) {
+        if (lengths[i] == 0) continue;
+        uint32_t code = next[lengths[i]]++, reversed = 0;
+        for (int bit = 0; bit < lengths[i]; ++bit, code >>= 1) reversed = (reversed << 1) | (code & 1);
+        codes[i] = static_cast<uint16_t>(reversed);
+    }
+    return codes;
+}
+
+struct HuffmanCode {
+    std::vector<uint8_t> lengths;
+    std::vector<uint16_t> codes;
+};
+
+HuffmanCode makeCode(std::vector<uint8_t> lengths) {
+    auto codes = canonicalCodes(lengths);
+    return {std::move(lengths), std::move(codes)};
+}
+
+const HuffmanCode &fixedLiterals() {
+    static const auto code = [] {
+        std::vector<uint8_t> lengths(288);
+        for (size_t i = 0; i < lengths.size(); ++i) lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+        return makeCode(std::move(lengths));
+    }();
+    return code;
+}
+
+const HuffmanCode &fixedDistances() {
+    static const auto code = makeCode(std::vector<uint8_t>(kDistances, 5));
+    return code;
+}
+
+// 码长序列按游程编码：16重复上一个码长3-6次，17/18重复0码长3-10/11-138次；低8位为符号，高8位为附加值
+std::vector<uint16_t> encodeLengths(const std::vector<uint8_t> &lengths) {
+    std::vector<uint16_t> out;
+    for (size_t i = 0; i < lengths.size();) {
+        auto value = lengths[i];
+        size_t run = 1;
+        while (i + run < lengths.size() && lengths[i + run] == value) ++run;
+        i += run;
+        if (value == 0) {
+            for (; run >= 11; ) {
+                size_t n = std::min<size_t>(run, 138);
+                out.push_back(static_cast<uint16_t>(18 | (n - 11) << 8));
+                run -= n;
+            }
+            if (run >= 3) {
+                out.push_back(static_cast<uint16_t>(17 | (run - 3) << 8));
+                run = 0;
+            }
+        } else {
+            out.push_back(value);
+            --run;
+            for (; run >= 3; ) {
+                size_t n = std::min<size_t>(run, 6);
+                out.push_back(static_cast<uint16_t>(16 | (n - 3) << 8));
+                run -= n;
+            }
+        }
+        for (; run > 0; --run) out.push_back(value);
+    }
+    return out;
+}
+
+constexpr int codeLengthExtra(int symbol) {
+    return symbol == 16 ? 2 : symbol == 17 ? 3 : symbol == 18 ? 7 : 0;
+}
+
+}
+
+GzipEncoder::GzipEncoder()
+    : head_(size_t(1) << kHashBits, -1) {
+}
+
+void GzipEncoder::putBits(uint32_t bits, int count, std::string &output) {
+    bitBuffer_ |= static_cast<uint64_t>(bits) << bitCount_;
+    bitCount_ += count;
+    while (bitCount_ >= 8) {
+        output.push_back(static_cast<char>(bitBuffer_ & 0xff));
+        bitBuffer_ >>= 8;
+        bitCount_ -= 8;
+    }
+}
+
+void GzipEncoder::alignToByte(std::string &output) {
+    if (bitCount_ > 0) output.push_back(static_cast<char>(bitBuffer_ & 0xff));
+    bitBuffer_ = 0;
+    bitCount_ = 0;
+}
+
+void GzipEncoder::write(std::string_view input, std::string &output) {
+    if (!started_) {
+        // 魔数、deflate、无标志、无修改时间、无额外标志、Unix
+        output.append("\x1f\x8b\x08\x00\x00\x00\x00\x00\x00\x03", 10);
+        started_ = true;
+    }
+    crc_ = crc32(crc_, input);
+    inputSize_ += input.size();
+    while (!input.empty()) {
+        size_t n = std::min(input.size(), kBlockSize - (window_.size() - history_));
+        window_.append(input.substr(0, n));
+        input.remove_prefix(n);
+        if (window_.size() - history_ == kBlockSize) compressBlock(false, output);
+    }
+}
+
+void GzipEncoder::flush(std::string &output) {
+    write({}, output);
+    if (window_.size() > history_) compressBlock(false, output);
+    putBits(0, 3, output);  // 非最后的存储块，长度0
+    alignToByte(output);
+    output.append("\x00\x00\xff\xff", 4);
+}
+
+void GzipEncoder::finish(std::string &output) {
+    if (finished_) return;
+    write({}, output);
+    compressBlock(true, output);
+    alignToByte(output);
+    for (int i = 0; i < 4; ++i) output.push_back(static_cast<char>(crc_ >> (8 * i)));
+    for (int i = 0; i < 4; ++i) output.push_back(static_cast<char>(inputSize_ >> (8 * i)));
+    finished_ = true;
+}
+
+void GzipEncoder::compressBlock(bool last, std::string &output) {
+    const auto *data = reinterpret_cast<const unsigned char *>(window_.data());
+    size_t start = history_, end = window_.size();
+
+    // LZ77：历史部分只加入哈希链供匹配，从start开始输出符号
+    std::fill(head_.begin(), head_.end(), -1);
+    prev_.assign(end, -1);
+    auto insert = [&](size_t pos) {
+        if (pos + kMinMatch > end) return;
+        uint32_t value = data[pos] | data[pos + 1] << 8 | data[pos + 2] << 16;
+        auto &slot = head_[(value * 2654435761u) >> (32 - kHashBits)];
+        prev_[pos] = slot;
+        slot = static_cast<int32_t>(pos);
+    };
+    for (size_t pos = 0; pos < start; ++pos) insert(pos);
+
+    symbols_.clear();
+    for (size_t pos = start; pos < end;) {
+        size_t best = 0, distance = 0;
+        if (pos + kMinMatch <= end) {
+            size_t limit = std::min(kMaxMatch, end - pos);
+            uint32_t value = data[pos] | data[pos + 1] << 8 | data[pos + 2] << 16;
+            int chain = kMaxChain;
+            for (int32_t candidate = head_[(value * 2654435761u) >> (32 - kHashBits)];
+                 candidate >= 0 && pos - candidate <= kWindow && chain-- > 0; candidate = prev_[candidate]) {
+                if (data[candidate + best] != data[pos + best]) continue;
+                size_t length = 0;
+                while (length < limit && data[candidate + length] == data[pos + length]) ++length;
+                if (length > best) {
+                    best = length;
+                    distance = pos - candidate;
+                    if (length == limit) break;
+                }
+            }
+        }
+        if (best >= kMinMatch) {
+            symbols_.push_back(static_cast<uint32_t>(best | distance << 16));
+            for (size_t i = 0; i < best; ++i) insert(pos + i);
+            pos += best;
+        } else {
+            symbols_.push_back(data[pos]);
+            insert(pos++);
+        }
+    }
+
+    // 统计频率，生成动态Huffman码并估算三种块的长度
+    std::vector<uint32_t> literalCounts(kLiterals, 0), distanceCounts(kDistances, 0);
+    uint64_t extraBits = 0;
+    for (auto symbol : symbols_) {
+        size_t distance = symbol >> 16, value = symbol & 0xffff;
+        if (distance == 0) {
+            ++literalCounts[value];
+            continue;
+        }
+        auto lc = lengthCode(value), dc = distanceCode(distance);
+        ++literalCounts[257 + lc];
+        ++distanceCounts[dc];
+        extraBits += kLengthExtra[lc] + kDistanceExtra[dc];
+    }
+    ++literalCounts[256];
+
+    auto literals = makeCode(huffmanLengths(literalCounts, 15));
+    auto distances = makeCode(huffmanLengths(distanceCounts, 15));
+    if (std::all_of(distances.lengths.begin(), distances.lengths.end(), [](uint8_t l) { return l == 0; })) {
+        distances = makeCode(std::vector<uint8_t>{1});     // 没有匹配时也须有一个距离码
+    }
+    size_t literalCount = kLiterals, distanceCount = distances.lengths.size();
+    while (literalCount > 257 && literals.lengths[literalCount - 1] == 0) --literalCount;
+    while (distanceCount > 1 && distances.lengths[distanceCount - 1] == 0) --distanceCount;
+    std::vector<uint8_t> lengths(literals.lengths.begin(), literals.lengths.begin() + literalCount);
+    lengths.insert(lengths.end(), distances.lengths.begin(), distances.lengths.begin() + distanceCount);
+    auto encodedLengths = encodeLengths(lengths);
+    std::vector<uint32_t> codeLengthCounts(kCodeLengths, 0);
+    for (auto item : encodedLengths) ++codeLengthCounts[item & 0xff];
+    auto codeLengths = makeCode(huffmanLengths(codeLengthCounts, 7));
+    size_t codeLengthCount = kCodeLengths;
+    while (codeLengthCount > 4 && codeLengths.lengths[kCodeLengthOrder[codeLengthCount - 1]] == 0) --codeLengthCount;
+
+    auto cost = [&](const HuffmanCode &literalTable, const HuffmanCode &distanceTable) {
+        uint64_t bits = 3 + extraBits;
+        for (size_t i = 0; i < kLiterals; ++i) bits += uint64_t(literalCounts[i]) * literalTable.lengths[i];
+        for (size_t i = 0; i < distanceCounts.size() && i < distanceTable.lengths.size(); ++i) {
+            bits += uint64_t(distanceCounts[i]) * distanceTable.lengths[i];
+        }
+        return bits;
+    };
+    uint64_t dynamicBits = cost(literals, distances) + 14 + 3 * codeLengthCount;
+    for (auto item : encodedLengths) dynamicBits += codeLengths.lengths[item & 0xff] + codeLengthExtra(item & 0xff);
+    uint64_t fixedBits = cost(fixedLiterals(), fixedDistances());
+    size_t size = end - start;
+    uint64_t storedBits = 8 * (size + 5 * std::max<size_t>(1, (size + 65534) / 65535)) + 7;
+
+    if (storedBits < dynamicBits && storedBits < fixedBits) {
+        // 存储块：每块最多65535字节，按字节对齐后写入长度、长度的反码和原始数据
+        size_t pos = start;
+        do {
+            size_t n = std::min<size_t>(end - pos, 65535);
+            putBits(last && pos + n == end ? 1 : 0, 3, output);
+            alignToByte(output);
+            uint32_t header = static_cast<uint32_t>(n | (~n & 0xffff) << 16);
+            for (int i = 0; i < 4; ++i) output.push_back(static_cast<char>(header >> (8 * i)));
+            output.append(window_, pos, n);
+            pos += n;
+        } while (pos < end);
+    } else {
+        bool dynamic = dynamicBits < fixedBits;
+        const auto &literalTable = dynamic ? literals : fixedLiterals();
+        const auto &distanceTable = dynamic ? distances : fixedDistances();
+        putBits(last ? 1 : 0, 1, output);
+        putBits(dynamic ? 2 : 1, 2, output);
+        if (dynamic) {
+            putBits(static_cast<uint32_t>(literalCount - 257), 5, output);
+            putBits(static_cast<uint32_t>(distanceCount - 1), 5, output);
+            putBits(static_cast<uint32_t>(codeLengthCount - 4), 4, output);
+            for (size_t i = 0; i < codeLengthCount; ++i) putBits(codeLengths.lengths[kCodeLengthOrder[i]], 3, output);
+            for (auto item : encodedLengths) {
+                int symbol = item & 0xff;
+                putBits(codeLengths.codes[symbol], codeLengths.lengths[symbol], output);
+                if (int extra = codeLengthExtra(symbol)) putBits(item >> 8, extra, output);
+            }
+        }
+        for (auto symbol : symbols_) {
+            size_t distance = symbol >> 16, value = symbol & 0xffff;
+            if (distance == 0) {
+                putBits(literalTable.codes[value], literalTable.lengths[value], output);
+                continue;
+            }
+            auto lc = lengthCode(value), dc = distanceCode(distance);
+            putBits(literalTable.codes[257 + lc], literalTable.lengths[257 + lc], output);
+            putBits(static_cast<uint32_t>(value - kLengthBase[lc]), kLengthExtra[lc], output);
+            putBits(distanceTable.codes[dc], distanceTable.lengths[dc], output);
+            putBits(static_cast<uint32_t>(distance - kDistanceBase[dc]), kDistanceExtra[dc], output);
+        }
+        putBits(literalTable.codes[256], literalTable.lengths[256], output);
+    }
+
+    // 保留最近32KB作为下一个块的匹配窗口
+    if (window_.size() > kWindow) window_.erase(0, window_.size() - kWindow);
+    history_ = window_.size();
+}
+
+void gzipFile(const std::filesystem::path &source, const std::filesystem::path &target) {
+    std::ifstream in(source, std::ios::binary);
+    if (!in) throw std::runtime_error("cannot read " + source.string());
+    std::ofstream out(target, std::ios::binary | std::ios::trunc);
+    if (!out) throw std::runtime_error("cannot write " + target.string());
+
+    GzipEncoder encoder;
+    std::string buffer(1 << 20, '\0'), compressed;
+    while (in) {
+        in.read(buffer.data(), buffer.size());
+        encoder.write(std::string_view(buffer.data(), in.gcount()), compressed);
+        out.write(compressed.data(), compressed.size());
+        compressed.clear();
+    }
+    if (in.bad()) throw std::runtime_error("cannot read " + source.string());
+    encoder.finish(compressed);
+    out.write(compressed.data(), compressed.size());
+    out.close();
+    if (!out) throw std::runtime_error("cannot write " + target.string());
+}
@@ -0,0 +1,128 @@
+#include "lz_codec.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+
+constexpr size_t kMinMatch = 4;
+constexpr size_t kMaxOffset = 65535;
+constexpr int kHashBits = 13;
+
+uint32_t read32(const char *p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+uint32_t hash(uint32_t value) {
+    return (value * 2654435761u) >> (32 - kHashBits);
+}
+
+void putLength(std::string &output, size_t length) {
+    for (; length >= 255; length -= 255) output.push_back(static_cast<char>(255));
+    output.push_back(static_cast<char>(length));
+}
+
+// 字面量之后没有匹配时matchLength为0
+void putSequence(std::string &output, std::string_view literals, size_t matchLength, size_t offset) {
+    size_t matchCode = matchLength ? matchLength - kMinMatch : 0;
+    output.push_back(static_cast<char>((std::min<size_t>(literals.size(), 15) << 4) | std::min<size_t>(matchCode, 15)));
+    if (literals.size() >= 15) putLength(output, literals.size() - 15);
+    output.append(literals);
+    if (matchLength == 0) return;
+    output.push_back(static_cast<char>(offset & 0xff));
+    output.push_back(static_cast<char>(offset >> 8));
+    if (matchCode >= 15) putLength(output, matchCode - 15);
+}
+
+}
+
+void lzCompress(std::string_view input, std::string &output, std::string_view dictionary) {
+    // 字典只取能被偏移覆盖的末尾部分，与input拼接后压缩，只为input部分输出序列
+    if (dictionary.size() > kMaxOffset) dictionary = dictionary.substr(dictionary.size() - kMaxOffset);
+    std::string joined;
+    if (!dictionary.empty()) {
+        joined.reserve(dictionary.size() + input.size());
+        joined.append(dictionary).append(input);
+    }
+    std::string_view data = dictionary.empty() ? input : std::string_view(joined);
+
+    // 每个哈希槽保存最近一次出现的位置，候选位置在比较前都会校验，初始的0不会产生错误匹配
+    auto table = std::make_unique<uint32_t[]>(size_t(1) << kHashBits);
+    const char *base = data.data();
+    size_t size = data.size();
+    for (size_t pos = 0; pos + kMinMatch <= dictionary.size(); ++pos) table[hash(read32(base + pos))] = pos;
+
+    size_t anchor = dictionary.size();
+    size_t pos = anchor;
+    while (size >= kMinMatch && pos <= size - kMinMatch) {
+        uint32_t sequence = read32(base + pos);
+        auto &slot = table[hash(sequence)];
+        size_t candidate = slot;
+        slot = static_cast<uint32_t>(pos);
+        if (candidate >= pos || pos - candidate > kMaxOffset || read32(base + candidate) != sequence) {
+            ++pos;
+            continue;
+        }
+
+        size_t length = kMinMatch;
+        while (pos + length < size && base[candidate + length] == base[pos + length]) ++length;
+        while (pos > anchor && candidate > 0 && base[pos - 1] == base[candidate - 1]) {
+            --pos;
+            --candidate;
+            ++length;
+        }
+        putSequence(output, data.substr(anchor, pos - anchor), length, pos - candidate);
+        pos += length;
+        anchor = pos;
+    }
+    putSequence(output, data.substr(anchor), 0, 0);
+}
+
+void lzDecompress(std::string_view input, size_t size, std::string &output, std::string_view dictionary) {
+    auto corrupt = [] { throw std::runtime_error("corrupt compressed data"); };
+    // 在字典之后解压，匹配可以引用字典，完成后只保留解压出的部分
+    if (dictionary.size() > kMaxOffset) dictionary = dictionary.substr(dictionary.size() - kMaxOffset);
+    std::string buffer;
+    buffer.reserve(dictionary.size() + size);
+    buffer.append(dictionary);
+    size_t in = 0;
+    auto getLength = [&](size_t length) {
+        if (length < 15) return length;
+        for (;;) {
+            if (in >= input.size()) corrupt();
+            auto byte = static_cast<uint8_t>(input[in++]);
+            length += byte;
+            if (byte != 255) return length;
+        }
+    };
+
+    size_t limit = dictionary.size() + size;
+    bool finished = false;
+    while (in < input.size()) {
+        auto token = static_cast<uint8_t>(input[in++]);
+        size_t literals = getLength(token >> 4);
+        if (literals > input.size() - in || buffer.size() + literals > limit) corrupt();
+        buffer.append(input.substr(in, literals));
+        in += literals;
+        if (in == input.size()) {       // 最后一个序列只有字面量
+            finished = true;
+            break;
+        }
+
+        if (input.size() - in < 2) corrupt();
+        size_t offset = static_cast<uint8_t>(input[in]) | (static_cast<uint8_t>(input[in + 1]) << 8);
+        in += 2;
+        size_t length = getLength(token & 15) + kMinMatch;
+        if (offset == 0 || offset > buffer.size() || buffer.size() + length > limit) corrupt();
+        // 匹配可能与自身重叠（offset < length），只能逐字节复制
+        size_t from = buffer.size() - offset;
+        for (size_t i = 0; i < length; ++i) buffer.push_back(buffer[from + i]);
+    }
+    // 缺少最后一个序列说明数据被截断，即使长度恰好相符
+    if (!finished || buffer.size() != limit) corrupt();
+    output.append(buffer, dictionary.size());
+}
@@ -1,9 +1,23 @@
 #include "resource_monitor.h"
+#include "report.h"
+#include "metrics_exporter.h"
+#include "snapshot_channel.h"
+#include "process_watcher.h"
+#include "config_file.h"
+#include "query_server.h"
+#include "shm_exporter.h"
+#include "agent_client.h"
+#include "aggregator.h"
+#include "delta_report.h"
+#include "compressed_file_sink.h"
+#include "mapped_file_sink.h"
+#include "structured_report.h"
 #include <docopt.h>
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/sinks/rotating_file_sink.h>
+#include <spdlog/fmt/chrono.h>
 #include <chrono>
 #include <thread>
 #include <filesystem>
@@ -12,6 +26,10 @@
 #include <mutex>
 #include <condition_variable>
 #include <iostream>
+#include <optional>
+#include <algorithm>
+#include <cstring>
+#include <unistd.h>
 
 namespace fs = std::filesystem;
 
@@ -19,6 +37,7 @@ struct Global {
     std::atomic<bool> stopping_{false};
     std::mutex mutex_;
     std::condition_variable cv_;
+    std::optional<MonitorConfig> pendingConfig_;    // 配置文件重新加载后待应用的配置，受mutex_保护
 };
 
 Global &getGlobal() {
@@ -32,11 +51,145 @@ void signalHandler(int signum) {
     global.cv_.notify_all();  // 唤醒所有等待的线程
 }
 
+// 把buf整个写到标准输出，被信号中断或部分写入时继续写
+static void writeStdout(const fmt::memory_buffer &buf) {
+    for (size_t written = 0; written < buf.size();) {
+        auto n = ::write(STDOUT_FILENO, buf.data() + written, buf.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            SPDLOG_ERROR("write stdout: {}", strerror(errno));
+            return;
+        }
+        written += n;
+    }
+}
+
+// 以文本格式输出一份完整的快照，不含监视进程
+static void logSnapshot(const Snapshot &snapshot) {
+    SPDLOG_INFO("{}, {}, {}",
+        formatCpu(snapshot.cpuPercent),
+        formatMemory(snapshot.mem),
+        formatDisks(snapshot.disksReady, snapshot.disks));
+    SPDLOG_INFO("\n{}", formatTemperatures(snapshot.temperatures));
+    if (snapshot.coverage.cpuBudgetPercent > 0) {
+        SPDLOG_INFO("{}", formatScanCoverage(snapshot.coverage));
+    }
+
+    for(const auto& process : snapshot.topCpu) {
+        SPDLOG_INFO("{}", formatTopCpu(process));
+    }
+
+    for(const auto& process : snapshot.topMem) {
+        SPDLOG_INFO("{}", formatTopMem(process, snapshot.memRank));
+    }
+
+    for(const auto& process : snapshot.topDisk) {
+        SPDLOG_INFO("{}", formatTopDisk(process));
+    }
+
+    for(const auto& group : snapshot.topCpuGroups) {
+        SPDLOG_INFO("{}", formatTopCpuGroup(group, snapshot.groupBy));
+    }
+
+    for(const auto& group : snapshot.topMemGroups) {
+        SPDLOG_INFO("{}", formatTopMemGroup(group, snapshot.groupBy));
+    }
+
+    for(const auto& group : snapshot.topDiskGroups) {
+        SPDLOG_INFO("{}", formatTopDiskGroup(group, snapshot.groupBy));
+    }
+}
+
+// 日志消费者：把每份快照格式化输出到日志，每隔selfReport输出一次自监控统计（为0时不输出）；
+// 启用变化输出时关键帧之间只输出变化的项。format为json/csv时快照改为写到标准输出，
+// 每份快照格式化到同一个缓冲后一次写出，日志中只保留告警和自监控统计
+void logSnapshots(const SnapshotChannel &channel, OutputFormat format, const std::atomic<std::chrono::seconds> &selfReport,
+        const std::atomic<std::shared_ptr<const DeltaOptions>> &deltaOptions) {
+    SnapshotReader reader(channel);
+    uint64_t missed = 0;
+    auto lastSelfReport = std::chrono::steady_clock::now();
+    DeltaReporter delta;
+    std::vector<std::string> changes;
+    fmt::memory_buffer structured;
+    if (format == OutputFormat::Csv) {
+        appendCsvHeader(structured);
+        writeStdout(structured);
+    }
+    while (auto published = reader.next(&missed)) {
+        const auto &snapshot = published->snapshot;
+        if (missed > 0) {
+            SPDLOG_WARN("skipped {} snapshot(s)", missed);
+        }
+
+        auto options = deltaOptions.load();
+        if (*options != delta.options()) delta.setOptions(*options);
+        changes.clear();
+        if (format != OutputFormat::Text) {
+            structured.clear();
+            if (format == OutputFormat::Json) appendJson(snapshot, structured);
+            else appendCsv(snapshot, structured);
+            writeStdout(structured);
+        } else if (!delta.next(snapshot, changes)) {
+            for (const auto &line : changes) {
+                SPDLOG_INFO("{}", line);
+            }
+        } else {
+            logSnapshot(snapshot);
+        }
+
+        // json/csv中已经包含监视进程的采样点
+        if (format == OutputFormat::Text) {
+            for(const auto& process : snapshot.watched) {
+                SPDLOG_INFO("{}", formatWatched(process));
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        auto period = selfReport.load();
+        if (period.count() > 0 && now - lastSelfReport >= period) {
+            lastSelfReport = now;
+            SPDLOG_INFO("\n{}", formatCollectorStats(snapshot.collectors));
+        }
+    }
+}
+
+// 应用配置，只在两次采样之间调用。ResourceMonitor中的进程记录和速率基准都保留，
+// 过滤表达式和分组规则只在变化时重新设置，避免清空按进程缓存的匹配结果
+static void applyConfig(ResourceMonitor &monitor, const MonitorConfig &config, const MonitorConfig *previous,
+        const spdlog::sink_ptr &console) {
+    monitor.setMemRank(config.memRank, config.smapsBudget);
+    monitor.setCpuBudget(config.cpuBudget);
+    if (!previous || previous->groupBy != config.groupBy || previous->groupPatterns != config.groupPatterns) {
+        monitor.setGrouping(config.groupBy, config.groupPatterns);
+    }
+    if (!previous || previous->filter != config.filter) monitor.setFilter(config.filter);
+    spdlog::default_logger()->set_level(spdlog::level::from_str(config.logLevel));
+    console->set_level(config.console ? spdlog::level::trace : spdlog::level::off);
+}
+
+static void logConfig(const MonitorConfig &config) {
+    SPDLOG_INFO("interval: {}sec, minCpu: {}%, minMem: {}M, minDisk: {}k, numProcesses: {}",
+        config.interval.count(),
+        config.sample.minCpuUsage * 100,
+        config.sample.minMemUsage / (1024 * 1024),
+        config.sample.minDiskUsage / 1024,
+        config.sample.numProcesses);
+    if (!config.filter.empty()) SPDLOG_INFO("filter: {}", config.filter);
+    if (config.delta.keyframe > 1) SPDLOG_INFO("delta: keyframe every {} samples, epsilon {}%", config.delta.keyframe, config.delta.relative * 100);
+}
+
 static const char USAGE[] =
 R"(资源监控工具
 
 Usage:
-  res_monitor [-i <interval>] [-c <min_cpu>] [-m <min_mem>] [-d <min_disk>] [-n <num_processes>]
+  res_monitor [options]
+  res_monitor query top [options]
+  res_monitor query pid <pid> [options]
+  res_monitor query disks [options]
+  res_monitor query fleet top [options]
+  res_monitor query fleet hosts [options]
+  res_monitor query fleet dist [<group>] [options]
+  res_monitor aggregate <addr> [options]
   res_monitor (-h | --help)
 
 Options:
@@ -45,45 +198,375 @@ Options:
   -m <min_mem>        最小内存使用量(MB) [默认: 1]
   -d <min_disk>       最小磁盘IO(KB/s) [默认: 1]
   -n <num_processes>  显示进程数 [默认: 3]
+  --mem-rank <mode>   进程内存排序依据: rss|pss|uss|swap [默认: rss]
+  --smaps-budget <ms> 每次采样读取smaps_rollup的时间预算(毫秒)，超出时未读到的进程按RSS排名并标为RSS，
+                      按swap排名时不列出 [默认: 20]
+  --group <mode>      按进程分组汇总CPU、内存和IO，并按-n显示排名靠前的分组: comm|user|session|tree|pattern
+  --group-pattern <rules>  pattern分组的规则name=regex，多条以;分隔，如"web=nginx|php-fpm;db=mysqld"，不匹配的进程按comm分组
+  --filter <expr>     只统计满足表达式的进程，如'rss > 1G && cmd ~ "java" && uid != 0'，
+                      字段: pid ppid session threads uid user comm cmd cpu rss read write io
+  --listen <addr>     在host:port上提供OpenMetrics指标(GET /metrics)，如127.0.0.1:9100
+  --proc-root <dir>   procfs挂载点 [默认: /proc]
+  --sys-root <dir>    sysfs挂载点 [默认: /sys]
+  --pid <pids>        只监视指定的进程(逗号分隔)，不扫描整个/proc
+  --match <regex>     只监视命令行或进程名匹配的进程，定期查找新出现的进程
+  --watch-interval <ms>  监视进程的采样间隔(毫秒)，按-i的间隔汇报 [默认: 200]
+  --cpu-budget <pct>  自身CPU占用上限(单核百分比)，超出时轮转扫描部分进程并降低慢速采集频率，0为不限制 [默认: 0]
+  --config <file>     从文件读取上述采集选项（文件中的项覆盖命令行），文件修改后在两次采样之间生效，
+                      不丢失计算速率的基准；格式见Readme
+  --socket <path>     在Unix域套接字上提供查询服务，res_monitor query从中读取最近的快照；
+                      aggregate在其上回答query fleet；query默认连接/tmp/res_monitor.sock
+  --history <n>       查询服务保留的快照数；aggregate为每台主机分位数统计的快照数 [默认: 60]
+  --by <key>          query top的排序依据: cpu|mem|disk，-n为返回的进程数(默认10)；
+                      query fleet hosts/dist的指标 [默认: cpu]
+  --points <k>        query pid/disks最多返回的快照数，0为全部历史 [默认: 1(disks)或0(pid)]
+  --quantile <q>      query fleet hosts按每台主机最近快照的此分位数筛选 [默认: 0.95]
+  --above <x>         query fleet hosts只列出分位数不小于此值的主机(cpu/mem为百分比，disk为字节/秒) [默认: 0]
+  --shm <name>        把每份快照写入POSIX共享内存(如/res_monitor)，本机其他进程用shm_snapshot.h直接读取
+  --agent <addr>      把每份快照压缩后经长连接推送给host:port上的aggregator，断线时缓存并在重连后补发
+  --host <name>       推送时使用的主机名，须在所有agent中唯一 [默认: 本机主机名]
+  --backlog <n>       断线时缓存的快照数，超出时丢弃最旧的 [默认: 600]
+  --record <file>     aggregate把所有主机的快照追加写入此文件，每行带主机名
+  --keyframe <n>      变化输出：每n个周期输出一次完整快照，其间只输出超过阈值的指标和top-N成员的变化，
+                      0为每次都完整输出 [默认: 0]
+  --epsilon <spec>    变化输出的阈值，百分数为相对阈值，其余为绝对阈值：pct百分点，mem内存，io读写速率(每秒)，
+                      iops，await毫秒，temp摄氏度 [默认: 5%,pct=1,mem=16M,io=64K,iops=10,await=1,temp=1]
+  --format <fmt>      快照的输出格式：text写入日志，json每份快照一行JSON(NDJSON)、csv每项指标一行，
+                      都写到标准输出，数值为原始的字节、字节/秒和百分比，此时控制台日志改为输出到标准错误 [默认: text]
+  --once              采样两次后输出一份完整的快照并退出：先只读取计算速率所需的计数作为基准，
+                      等待--window后再完整采样一次；不创建日志文件，不启动各项服务
+  --window <t>        --once两次采样的间隔，如200ms、1s [默认: 200ms]
+  --log-compress <m>  日志文件的压缩：none不压缩，rotate轮转后在后台压缩为.gz，stream当前文件也直接写为gzip流，
+                      都保留10个文件 [默认: none]
+  --log-mmap          日志文件用fallocate预分配、mmap写入的50MB段，写满时切换到预先建好的下一段，后台每秒msync；
+                      不能与--log-compress同用
+  --self-report <sec> 输出自监控统计(各采集函数耗时p50/p99、打开文件数、读取字节数、堆分配次数)的间隔(秒)，0为不输出 [默认: 60]
   -h --help           显示帮助信息
 )";
 
 //#define PTI do {SPDLOG_INFO("");} while(0)
 
+static std::string formatQueryTime(int64_t timeMs) {
+    return fmt::format("{:%Y-%m-%d %H:%M:%S}", fmt::localtime(static_cast<std::time_t>(timeMs / 1000)));
+}
+
+// 查询客户端：向运行中的res_monitor发送一次请求，结果输出到标准输出
+static int runQuery(std::map<std::string, docopt::value> &args) {
+    query::Request request;
+    uint32_t points = 0;
+    try {
+        if (args["<pid>"].isString()) request.pid = std::stoi(args["<pid>"].asString());
+        if (args["--points"].isString()) points = std::stoul(args["--points"].asString());
+        std::string by = args["--by"].isString() ? args["--by"].asString() : "cpu";
+        if (by == "cpu") request.sortKey = query::SortKey::Cpu;
+        else if (by == "mem") request.sortKey = query::SortKey::Mem;
+        else if (by == "disk") request.sortKey = query::SortKey::Disk;
+        else throw std::invalid_argument("unknown --by: " + by);
+        if (args["fleet"].asBool()) {
+            request.count = args["-n"].isString() ? std::stoul(args["-n"].asString()) : 10;
+            if (args["top"].asBool()) {
+                request.type = query::Type::FleetTop;
+            } else if (args["hosts"].asBool()) {
+                request.type = query::Type::FleetHosts;
+                if (!args["-n"].isString()) request.count = 0;
+                request.quantile = args["--quantile"].isString() ? std::stof(args["--quantile"].asString()) : 0.95f;
+                request.threshold = args["--above"].isString() ? std::stof(args["--above"].asString()) : 0;
+                if (!(request.quantile >= 0 && request.quantile <= 1)) throw std::invalid_argument("--quantile must be in [0, 1]");
+            } else {
+                request.type = query::Type::FleetDistribution;
+                if (args["<group>"].isString()) {
+                    std::string group = args["<group>"].asString();
+                    if (group.size() >= sizeof(request.group)) throw std::invalid_argument("group name too long: " + group);
+                    std::memcpy(request.group, group.data(), group.size());
+                }
+            }
+        } else if (args["top"].asBool()) {
+            request.type = query::Type::Top;
+            request.count = args["-n"].isString() ? std::stoul(args["-n"].asString()) : 10;
+        } else if (args["pid"].asBool()) {
+            request.type = query::Type::Process;
+            request.count = points;
+        } else {
+            request.type = query::Type::Disks;
+            request.count = args["--points"].isString() ? points : 1;
+        }
+    } catch (const std::exception& e) {
+        SPDLOG_ERROR("参数解析错误: {}", e.what());
+        return 1;
+    }
+
+    std::string path = args["--socket"].isString() ? args["--socket"].asString() : "/tmp/res_monitor.sock";
+    QueryResponse response;
+    try {
+        response = sendQuery(path, request);
+    } catch (const std::exception& e) {
+        SPDLOG_ERROR("查询失败: {}", e.what());
+        return 1;
+    }
+
+    const auto &header = response.header;
+    switch (header.status) {
+        case query::Status::Ok: break;
+        case query::Status::NoData: SPDLOG_ERROR("查询失败: 还没有可用的快照"); return 1;
+        case query::Status::NotFound:
+            if (request.type == query::Type::FleetDistribution) SPDLOG_ERROR("查询失败: 没有主机上报分组{}", request.group);
+            else SPDLOG_ERROR("查询失败: 最近的快照中没有进程{}", request.pid);
+            return 1;
+        default: SPDLOG_ERROR("查询失败: 请求无效"); return 1;
+    }
+
+    fmt::memory_buffer out;
+    auto it = std::back_inserter(out);
+    auto formatProcess = [&it](const query::ProcessRecord &p) {
+        fmt::format_to(it, "CPU: {:.2f}%, MEM: {}, DISK: {}/s+{}/s, CMD: [{}]{}\n",
+            p.cpuPercent, valueToHumanReadable(p.rssBytes),
+            valueToHumanReadable(p.readBytesPerSec), valueToHumanReadable(p.writeBytesPerSec), p.pid, p.command);
+    };
+    // 集群查询的值：主机的mem为内存使用率，分组的mem为RSS
+    bool group = request.group[0] != '\0';
+    auto formatValue = [&request, group](float value) {
+        switch (request.sortKey) {
+            case query::SortKey::Cpu: return fmt::format("{:.2f}%", value);
+            case query::SortKey::Mem: return group ? valueToHumanReadable(value) : fmt::format("{:.2f}%", value);
+            default: return valueToHumanReadable(value) + "/s";
+        }
+    };
+    std::string metric = args["--by"].isString() ? args["--by"].asString() : "cpu";
+    if (request.type == query::Type::Top) {
+        fmt::format_to(it, "{} (#{})\n", formatQueryTime(header.timeMs), header.generation);
+        for (size_t i = 0; i < header.count; ++i) formatProcess(response.record<query::ProcessRecord>(i));
+    } else if (request.type == query::Type::FleetTop) {
+        fmt::format_to(it, "{} (#{})\n", formatQueryTime(header.timeMs), header.generation);
+        for (size_t i = 0; i < header.count; ++i) {
+            const auto &record = response.record<query::FleetProcessRecord>(i);
+            fmt::format_to(it, "[{}] ", record.host);
+            formatProcess(record.process);
+        }
+    } else if (request.type == query::Type::FleetHosts) {
+        fmt::format_to(it, "{} (#{})\n", formatQueryTime(header.timeMs), header.generation);
+        for (size_t i = 0; i < header.count; ++i) {
+            const auto &record = response.record<query::HostRecord>(i);
+            fmt::format_to(it, "[{}] p{:g} {}: {} (latest: {}, {} samples){}\n", record.host, request.quantile * 100,
+                metric, formatValue(record.value), formatValue(record.latest), record.samples,
+                record.connected ? "" : " (disconnected)");
+        }
+    } else if (request.type == query::Type::FleetDistribution) {
+        fmt::format_to(it, "{} (#{}) {}{} across {} hosts\n", formatQueryTime(header.timeMs), header.generation,
+            group ? fmt::format("group {} ", request.group) : "", metric, header.count ? response.record<query::QuantileRecord>(0).samples : 0);
+        for (size_t i = 0; i < header.count; ++i) {
+            const auto &record = response.record<query::QuantileRecord>(i);
+            std::string name = record.quantile == 0 ? "min" : record.quantile == 1 ? "max" : fmt::format("p{:g}", record.quantile * 100);
+            fmt::format_to(it, "{}: {}\n", name, formatValue(record.value));
+        }
+    } else if (request.type == query::Type::Process) {
+        formatProcess(response.process);
+        for (size_t i = 0; i < header.count; ++i) {
+            const auto &point = response.record<query::SeriesPoint>(i);
+            fmt::format_to(it, "{} CPU: {:.2f}%, MEM: {}, DISK: {}/s+{}/s\n", formatQueryTime(point.timeMs),
+                point.cpuPercent, valueToHumanReadable(point.rssBytes),
+                valueToHumanReadable(point.readBytesPerSec), valueToHumanReadable(point.writeBytesPerSec));
+        }
+    } else {
+        // 同一时刻的设备相邻，合并为一行，格式与日志相同
+        std::vector<DiskStat> disks;
+        for (size_t i = 0; i < header.count; ++i) {
+            const auto &record = response.record<query::DiskRecord>(i);
+            auto &disk = disks.emplace_back();
+            disk.name = record.name;
+            disk.readBytesPerSec = record.readBytesPerSec;
+            disk.writeBytesPerSec = record.writeBytesPerSec;
+            disk.readIops = record.readIops;
+            disk.writeIops = record.writeIops;
+            disk.readAwaitMs = record.readAwaitMs;
+            disk.writeAwaitMs = record.writeAwaitMs;
+            disk.busyPercent = record.busyPercent;
+            disk.avgQueueSize = record.avgQueueSize;
+            disk.inFlight = record.inFlight;
+            if (i + 1 == header.count || response.record<query::DiskRecord>(i + 1).timeMs != record.timeMs) {
+                fmt::format_to(it, "{} {}\n", formatQueryTime(record.timeMs), formatDisks(true, disks));
+                disks.clear();
+            }
+        }
+    }
+    std::cout << fmt::to_string(out) << std::flush;
+    return 0;
+}
+
+// 单次模式：建立基准后等待window再采样一次，输出一份完整的快照后退出
+static int runOnce(ResourceMonitor &monitor, const MonitorConfig &config, ProcessWatcher *watcher,
+        OutputFormat format, std::chrono::milliseconds window) {
+    monitor.prime(config.sample);
+    if (watcher) watcher->sample();
+    {
+        auto &global = getGlobal();
+        std::unique_lock<std::mutex> lock(global.mutex_);
+        if (global.cv_.wait_for(lock, window, [&global]{ return global.stopping_.load(); })) return 1;
+    }
+    if (watcher) watcher->sample();
+    auto snapshot = monitor.sample(config.sample);
+    if (watcher) snapshot.watched = watcher->collect();
+
+    if (format == OutputFormat::Text) {
+        logSnapshot(snapshot);
+        for(const auto& process : snapshot.watched) {
+            SPDLOG_INFO("{}", formatWatched(process));
+        }
+        spdlog::default_logger()->flush();
+        return 0;
+    }
+    fmt::memory_buffer out;
+    if (format == OutputFormat::Json) {
+        appendJson(snapshot, out);
+    } else {
+        appendCsvHeader(out);
+        appendCsv(snapshot, out);
+    }
+    writeStdout(out);
+    return 0;
+}
+
+// 汇总模式：在addr上接收agent推送的快照，每隔-i秒输出各主机最近的状态
+static int runAggregator(std::map<std::string, docopt::value> &args) {
+    uint64_t interval = 10;
+    uint64_t history = 60;
+    try {
+        if (args["-i"].isString()) interval = std::stoull(args["-i"].asString());
+        if (args["--history"].isString()) history = std::stoull(args["--history"].asString());
+        if (interval == 0) throw std::invalid_argument("-i must be positive");
+    } catch (const std::exception& e) {
+        SPDLOG_ERROR("参数解析错误: {}", e.what());
+        return 1;
+    }
+
+    Aggregator aggregator;
+    std::string record = args["--record"].isString() ? args["--record"].asString() : "";
+    try {
+        aggregator.start(args["<addr>"].asString(), record, history);
+    } catch (const std::exception& e) {
+        SPDLOG_ERROR("启动汇总服务失败: {}", e.what());
+        return 1;
+    }
+    SPDLOG_INFO("aggregator: {}{}", args["<addr>"].asString(), record.empty() ? "" : ", record: " + record);
+
+    QueryServer queryServer;
+    if (args["--socket"].isString()) {
+        try {
+            queryServer.start(args["--socket"].asString(),
+                [&aggregator](const query::Request &request, query::ResponseHeader &header, std::vector<char> &response) {
+                    return aggregator.answer(request, header, response);
+                });
+        } catch (const std::exception& e) {
+            SPDLOG_ERROR("启动查询服务失败: {}", e.what());
+            return 1;
+        }
+        SPDLOG_INFO("query: {} ({} snapshots per host)", args["--socket"].asString(), history);
+    }
+
+    auto &global = getGlobal();
+    auto next = std::chrono::steady_clock::now() + std::chrono::seconds(interval);
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(global.mutex_);
+            if (global.cv_.wait_until(lock, next, [&global]{ return global.stopping_.load(); })) break;
+        }
+        next += std::chrono::seconds(interval);
+
+        auto hosts = aggregator.hosts();
+        auto connected = std::count_if(hosts.begin(), hosts.end(), [](const HostState &h) { return h.connected; });
+        SPDLOG_INFO("hosts: {}, connected: {}", hosts.size(), connected);
+        for (const auto &host : hosts) {
+            if (!host.latest) continue;
+            const auto &snapshot = *host.latest;
+            SPDLOG_INFO("[{}] {}, {}, {}{}", host.host, formatCpu(snapshot.cpuPercent), formatMemory(snapshot.mem),
+                formatDisks(snapshot.disksReady, snapshot.disks), host.connected ? "" : " (disconnected)");
+        }
+    }
+
+    queryServer.stop();
+    aggregator.stop();
+    SPDLOG_INFO("Stopping...");
+    spdlog::default_logger()->flush();
+    spdlog::shutdown();
+    return 0;
+}
+
 int main(int argc, char** argv) {
+    // 解析命令行参数 
+    auto args = docopt::docopt(USAGE, {argv + 1, argv + argc}, true);
+    if (args["query"].asBool()) return runQuery(args);
+
     // 注册信号处理
     std::signal(SIGINT, signalHandler);
     std::signal(SIGTERM, signalHandler);
 
-    // 创建控制台和轮转文件日志器
-    auto console_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
-
-    // 获取可执行文件当前目录
-    fs::path currentPath = std::filesystem::current_path();
-    fs::path logPath = currentPath / "logs";
-    // 创建轮转文件日志器
-    std::filesystem::create_directories(logPath);
-    fs::path logFilePath = logPath / "monitor.log";
-
-    auto rotating_sink = std::make_shared<spdlog::sinks::rotating_file_sink_mt>(
-        logFilePath, 
-        50 * 1024 * 1024, // 每个文件最大50MB
-        10  // 保留10个文件
-    );
-    
-    auto logger = std::make_shared<spdlog::logger>(spdlog::logger{"multi_sink", {console_sink, rotating_sink}});
+    OutputFormat format = OutputFormat::Text;
+    bool once = args["--once"].asBool();
+    auto window = std::chrono::milliseconds(200);
+    try {
+        if (args["--format"].isString()) format = parseOutputFormat(args["--format"].asString());
+        if (args["--window"].isString()) window = parseDuration(args["--window"].asString());
+    } catch (const std::exception& e) {
+        SPDLOG_ERROR("参数解析错误: {}", e.what());
+        return 1;
+    }
+
+    // 创建控制台和轮转文件日志器，json/csv输出占用标准输出时控制台日志写到标准错误
+    spdlog::sink_ptr console_sink;
+    if (format == OutputFormat::Text) console_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+    else console_sink = std::make_shared<spdlog::sinks::stderr_color_sink_mt>();
+
+    // 单次模式只输出到控制台，不创建日志目录和文件
+    spdlog::sink_ptr file_sink;
+    if (!once) {
+        // 获取可执行文件当前目录
+        fs::path currentPath = std::filesystem::current_path();
+        fs::path logPath = currentPath / "logs";
+        // 创建轮转文件日志器
+        std::filesystem::create_directories(logPath);
+        fs::path logFilePath = logPath / "monitor.log";
+
+        try {
+            auto compression = args["--log-compress"].isString() ? parseLogCompression(args["--log-compress"].asString()) : LogCompression::None;
+            if (args["--log-mmap"].asBool()) {
+                if (compression != LogCompression::None) throw std::invalid_argument("--log-mmap cannot be combined with --log-compress");
+                file_sink = std::make_shared<MappedFileSink>(logFilePath, 50 * 1024 * 1024, 10);
+            } else if (compression == LogCompression::None) {
+                file_sink = std::make_shared<spdlog::sinks::rotating_file_sink_mt>(
+                    logFilePath,
+                    50 * 1024 * 1024, // 每个文件最大50MB
+                    10  // 保留10个文件
+                );
+            } else {
+                // 压缩后同样保留10个文件，Stream模式下50MB为压缩后的大小
+                file_sink = std::make_shared<CompressedFileSink>(logFilePath, 50 * 1024 * 1024, 10, compression);
+            }
+        } catch (const std::exception& e) {
+            SPDLOG_ERROR("创建日志文件失败: {}", e.what());
+            return 1;
+        }
+    }
+
+    auto logger = file_sink
+        ? std::make_shared<spdlog::logger>(spdlog::logger{"multi_sink", {console_sink, file_sink}})
+        : std::make_shared<spdlog::logger>("multi_sink", console_sink);
     spdlog::set_default_logger(logger);
     logger->set_level(spdlog::level::info);
     //logger.set_pattern("[%Y-%m-%d %T.%f] [%L] [%t] [%s:%#:%!] %^%v%#$");
-
-    // 解析命令行参数 
-    auto args = docopt::docopt(USAGE, {argv + 1, argv + argc}, true);
+    if (args["aggregate"].asBool()) return runAggregator(args);
 
     uint64_t interval = 10; // 10s
     uint64_t minCpu = 1;    // 1%
     uint64_t minMem = 1;    // 1MB
     uint64_t minDisk = 1;   // 1KB
     uint64_t numProcesses = 3;  // 3
+    uint64_t smapsBudget = 20;  // 20ms
+    uint64_t selfReport = 60;   // 60s
+    uint64_t history = 60;
+    uint64_t backlog = 600;
+    double cpuBudget = 0;       // 不限制
+    uint64_t watchInterval = 200;   // 200ms
+    WatchOptions watchOptions;
+    MonitorConfig config;
     
     auto getArg = [&args](const std::string& key, uint64_t *result) {
         const auto &value = args[key];
@@ -101,52 +584,217 @@ int main(int argc, char** argv) {
         getArg("-m", &minMem);
         getArg("-d", &minDisk);
         getArg("-n", &numProcesses);
+        getArg("--smaps-budget", &smapsBudget);
+        getArg("--self-report", &selfReport);
+        getArg("--history", &history);
+        getArg("--backlog", &backlog);
+        if (args["--cpu-budget"].isString()) {
+            cpuBudget = std::stod(args["--cpu-budget"].asString());
+        }
+        getArg("--watch-interval", &watchInterval);
+        if (args["--pid"].isString()) {
+            std::string list = args["--pid"].asString();
+            for (size_t pos = 0; pos < list.size();) {
+                auto comma = list.find(',', pos);
+                if (comma == std::string::npos) comma = list.size();
+                if (comma > pos) watchOptions.pids.push_back(std::stoi(list.substr(pos, comma - pos)));
+                pos = comma + 1;
+            }
+        }
+        if (args["--match"].isString()) watchOptions.patterns.push_back(args["--match"].asString());
+        if (watchInterval == 0) throw std::invalid_argument("--watch-interval must be positive");
+
+        if (args["--mem-rank"].isString()) config.memRank = parseMemRank(args["--mem-rank"].asString());
+        if (args["--group-pattern"].isString()) {
+            config.groupPatterns = parseGroupPatterns(args["--group-pattern"].asString());
+            config.groupBy = GroupBy::Pattern;
+        }
+        if (args["--group"].isString()) config.groupBy = parseGroupBy(args["--group"].asString());
+        if (config.groupBy == GroupBy::Pattern && config.groupPatterns.empty()) {
+            throw std::invalid_argument("--group pattern requires --group-pattern");
+        }
+        if (args["--filter"].isString()) config.filter = args["--filter"].asString();
+        if (args["--keyframe"].isString()) config.delta.keyframe = std::stoi(args["--keyframe"].asString());
+        if (args["--epsilon"].isString()) config.delta = parseEpsilon(args["--epsilon"].asString(), config.delta);
     } catch (const std::exception& e) {
         SPDLOG_ERROR("参数解析错误: {}", e.what());
         return 1;
     }
 
-    SPDLOG_INFO("interval: {}sec, minCpu: {}%, minMem: {}M, minDisk: {}k, numProcesses: {}",
-        interval,
-        minCpu,
-        minMem,
-        minDisk,
-        numProcesses);
+    MonitorEnvironment environment;
+    if (args["--proc-root"].isString()) environment.procRoot = args["--proc-root"].asString();
+    if (args["--sys-root"].isString()) environment.sysRoot = args["--sys-root"].asString();
+
+    // 监视模式下只按较短的间隔采样目标进程，除非指定了-n，否则不再扫描整个/proc
+    std::unique_ptr<ProcessWatcher> watcher;
+    if (!watchOptions.pids.empty() || !watchOptions.patterns.empty()) {
+        try {
+            watcher = std::make_unique<ProcessWatcher>(watchOptions, environment);
+        } catch (const std::exception& e) {
+            SPDLOG_ERROR("参数解析错误: {}", e.what());
+            return 1;
+        }
+        if (!args["-n"].isString()) numProcesses = 0;
+        SPDLOG_INFO("watching {} process(es) every {}ms", watcher->size(), watchInterval);
+    }
+
+    config.interval = std::chrono::seconds(interval);
+    config.sample.numProcesses = numProcesses;
+    config.sample.minCpuUsage = minCpu/100.0;
+    config.sample.minMemUsage = minMem*1024*1024;
+    config.sample.minDiskUsage = minDisk*1024;
+    config.smapsBudget = std::chrono::milliseconds(smapsBudget);
+    config.cpuBudget = cpuBudget;
+    config.selfReport = std::chrono::seconds(selfReport);
+    config.sample.processTable = args["--socket"].isString();
+
+    // 配置文件中的项覆盖命令行，重新加载时同样以命令行为缺省值
+    const MonitorConfig commandLine = config;
+    ResourceMonitor monitor(environment);
+    try {
+        if (args["--config"].isString()) config = loadConfig(args["--config"].asString(), commandLine);
+        if (config.interval.count() == 0) throw std::invalid_argument("-i must be positive");
+        applyConfig(monitor, config, nullptr, console_sink);
+    } catch (const std::exception& e) {
+        SPDLOG_ERROR("参数解析错误: {}", e.what());
+        return 1;
+    }
+    if (once) return runOnce(monitor, config, watcher.get(), format, window);
+    logConfig(config);
 
-    ResourceMonitor monitor;
     auto &global = getGlobal();
-    while(!global.stopping_) {
-        auto cpuUsage = monitor.getCpuUsage();
-        auto memUsage = monitor.getMemoryUsage();
-        auto diskIo = monitor.getDiskIo();
-        auto temperature = monitor.getTemperature();
-        
-        SPDLOG_INFO("{}, {}, {}", cpuUsage, memUsage, diskIo);
-        SPDLOG_INFO("\n{}", temperature);
+    ConfigWatcher configWatcher;
+    if (args["--config"].isString()) {
+        try {
+            configWatcher.start(args["--config"].asString(), commandLine, [&global](MonitorConfig next) {
+                std::lock_guard<std::mutex> lock(global.mutex_);
+                global.pendingConfig_ = std::move(next);
+                global.cv_.notify_all();
+            });
+        } catch (const std::exception& e) {
+            SPDLOG_ERROR("监视配置文件失败: {}", e.what());
+            return 1;
+        }
+        SPDLOG_INFO("config: {}", args["--config"].asString());
+    }
+
+    // 采样线程（即主线程）只负责采样和发布，日志和指标服务各自消费快照
+    SnapshotChannel channel;
+    MetricsExporter exporter;
+    QueryServer queryServer;
+    ShmExporter shmExporter;
+    AgentClient agent;
+    // 各服务的stop()要求channel已关闭，析构时也会调用stop()：在它们之后声明，任何返回路径上都先关闭channel
+    struct ChannelCloser {
+        SnapshotChannel &channel;
+        ~ChannelCloser() { channel.close(); }
+    } channelCloser{channel};
+    if (args["--listen"].isString()) {
+        try {
+            exporter.start(args["--listen"].asString(), channel);
+        } catch (const std::exception& e) {
+            SPDLOG_ERROR("启动指标服务失败: {}", e.what());
+            return 1;
+        }
+        SPDLOG_INFO("metrics: http://{}/metrics", args["--listen"].asString());
+    }
+
+    if (args["--socket"].isString()) {
+        try {
+            queryServer.start(args["--socket"].asString(), channel, history);
+        } catch (const std::exception& e) {
+            SPDLOG_ERROR("启动查询服务失败: {}", e.what());
+            return 1;
+        }
+        SPDLOG_INFO("query: {} ({} snapshots)", args["--socket"].asString(), history);
+    }
 
-        auto topCPUs = monitor.getTopCpuProcesses(numProcesses, minCpu/100.0);
-        auto topMemories = monitor.getTopMemProcesses(numProcesses, minMem*1024*1024);
-        auto topDiskIos = monitor.getTopDiskProcesses(numProcesses, minDisk*1024);
-        
-        for(const auto& process : topCPUs) {
-            SPDLOG_INFO("{}", process);
+    if (args["--shm"].isString()) {
+        try {
+            shmExporter.start(args["--shm"].asString(), channel);
+        } catch (const std::exception& e) {
+            SPDLOG_ERROR("启动共享内存导出失败: {}", e.what());
+            return 1;
         }
+        SPDLOG_INFO("shm: {}", args["--shm"].asString());
+    }
 
-        for(const auto& process : topMemories) {
-            SPDLOG_INFO("{}", process);
+    if (args["--agent"].isString()) {
+        try {
+            std::string host;
+            if (args["--host"].isString()) {
+                host = args["--host"].asString();
+            } else {
+                char name[256] = {};
+                ::gethostname(name, sizeof(name) - 1);
+                host = name;
+            }
+            agent.start(args["--agent"].asString(), host, backlog, channel);
+            SPDLOG_INFO("agent: {} as {} (backlog {})", args["--agent"].asString(), host, backlog);
+        } catch (const std::exception& e) {
+            SPDLOG_ERROR("启动agent失败: {}", e.what());
+            return 1;
         }
+    }
 
-        for(const auto& process : topDiskIos) {
-            SPDLOG_INFO("{}", process);
+    std::atomic<std::chrono::seconds> selfReportPeriod(config.selfReport);
+    std::atomic<std::shared_ptr<const DeltaOptions>> deltaOptions(std::make_shared<const DeltaOptions>(config.delta));
+    std::thread logThread(logSnapshots, std::cref(channel), format, std::cref(selfReportPeriod), std::cref(deltaOptions));
+
+    auto reportInterval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(config.interval);
+    auto tickInterval = watcher
+        ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::milliseconds(watchInterval))
+        : reportInterval;
+    auto nextTick = std::chrono::steady_clock::now();
+    auto nextReport = nextTick;
+    while(!global.stopping_) {
+        if (watcher) watcher->sample();
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= nextReport) {
+            auto snapshot = monitor.sample(config.sample);
+            if (watcher) snapshot.watched = watcher->collect();
+            channel.publish(std::move(snapshot));
+            nextReport += reportInterval;
+            if (nextReport <= now) nextReport = now + reportInterval;  // 采样太慢，跳过错过的周期
         }
 
-        // 可中断的睡眠
+        nextTick += tickInterval;
+        if (nextTick <= now) nextTick = now + tickInterval;
+
+        // 可中断的睡眠，期间重新加载的配置立即应用，然后继续等到下一个周期
         std::unique_lock<std::mutex> lock(global.mutex_);
-        global.cv_.wait_for(lock, std::chrono::seconds(interval), [&global]{
-            return global.stopping_.load();
-        });
+        while (global.cv_.wait_until(lock, nextTick, [&global]{
+            return global.stopping_.load() || global.pendingConfig_.has_value();
+        }) && !global.stopping_) {
+            auto next = std::move(*global.pendingConfig_);
+            global.pendingConfig_.reset();
+            lock.unlock();
+
+            applyConfig(monitor, next, &config, console_sink);
+            selfReportPeriod = next.selfReport;
+            if (next.delta != config.delta) deltaOptions = std::make_shared<const DeltaOptions>(next.delta);
+            logConfig(next);
+            // 新的间隔从上次采样的时间算起
+            auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(next.interval);
+            nextReport += interval - reportInterval;
+            reportInterval = interval;
+            if (!watcher) {
+                tickInterval = reportInterval;
+                nextTick = nextReport;
+            }
+            config = std::move(next);
+            lock.lock();
+        }
     }
 
+    configWatcher.stop();
+    channel.close();
+    logThread.join();
+    exporter.stop();
+    queryServer.stop();
+    shmExporter.stop();
+    agent.stop();
     SPDLOG_INFO("Stopping...");
     logger->flush();
     spdlog::shutdown();
@@ -0,0 +1,267 @@
+#include "mapped_file_sink.h"
+#include "compressed_file_sink.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// 后台线程提前把尾部之后这么多字节的页映射为可写，写日志的线程写到新的页时不再缺页；
+// 预先映射的页被标记为脏页，最多多写回这么多0字节
+constexpr size_t kPrefault = 4 * 1024 * 1024;
+
+// 一个预分配并整段映射的日志文件
+struct Segment {
+    fs::path path;
+    int fd = -1;
+    char *data = nullptr;
+    size_t capacity = 0;
+    size_t used = 0;        // 映射时已有的内容；写满交给后台线程时为写入的长度
+};
+
+// 打开或创建path，预分配到至少capacity字节并整段映射；已有的内容保留，used为最后一个非0字节之后的位置
+Segment mapSegment(const fs::path &path, size_t capacity) {
+    Segment segment;
+    segment.path = path;
+    segment.fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (segment.fd < 0) throw std::runtime_error(fmt::format("open {}: {}", path.string(), strerror(errno)));
+    struct stat st;
+    size_t existing = ::fstat(segment.fd, &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+    segment.capacity = std::max(capacity, existing);
+    // 预先分配磁盘块，写入时不再分配；文件系统不支持fallocate时退回到稀疏文件
+    if (::fallocate(segment.fd, 0, 0, segment.capacity) < 0 && ::ftruncate(segment.fd, segment.capacity) < 0) {
+        int err = errno;
+        ::close(segment.fd);
+        throw std::runtime_error(fmt::format("fallocate {}: {}", path.string(), strerror(err)));
+    }
+    void *address = ::mmap(nullptr, segment.capacity, PROT_READ | PROT_WRITE, MAP_SHARED, segment.fd, 0);
+    if (address == MAP_FAILED) {
+        int err = errno;
+        ::close(segment.fd);
+        throw std::runtime_error(fmt::format("mmap {}: {}", path.string(), strerror(err)));
+    }
+    segment.data = static_cast<char *>(address);
+    segment.used = existing;
+    while (segment.used > 0 && segment.data[segment.used - 1] == '\0') --segment.used;
+    return segment;
+}
+
+// 不改变内容，只建立可写的页表项；内核不支持时什么都不做
+void prefault(char *data, size_t size) {
+#ifdef MADV_POPULATE_WRITE
+    if (size > 0) ::madvise(data, size, MADV_POPULATE_WRITE);
+#endif
+}
+
+// 写回已写入的部分，解除映射并截断到实际长度；截断失败时返回false，文件末尾留有预分配的0字节
+bool closeSegment(Segment &segment) {
+    if (segment.used > 0) ::msync(segment.data, segment.used, MS_SYNC);
+    ::munmap(segment.data, segment.capacity);
+    bool truncated = ::ftruncate(segment.fd, segment.used) == 0;
+    ::close(segment.fd);
+    segment.fd = -1;
+    segment.data = nullptr;
+    return truncated;
+}
+
+}
+
+struct MappedFileSink::Impl {
+    fs::path base_;
+    size_t maxSize_;
+    size_t maxFiles_;
+    std::chrono::milliseconds flushInterval_;
+
+    // 当前段的内容只由写日志的线程（持有sink的锁）写入；更换当前段或改名时持有mutex_，后台线程持有mutex_读取
+    Segment active_;
+    std::atomic<size_t> tail_{0};
+    uint64_t fallbacks_ = 0;            // 写日志的线程同步创建下一段的次数，用于区分文件名
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::optional<Segment> next_;       // 预建好的下一段
+    std::deque<Segment> retired_;       // 写满待归档的段，从旧到新
+    bool flushRequested_ = false;
+    bool stopping_ = false;
+    std::thread thread_;
+
+    fs::path nextPath() const {
+        return fs::path(base_) += ".next";
+    }
+
+    // 上次异常退出残留的下一段只有预分配的0字节，直接删除
+    void removeStaleSegments() {
+        auto prefix = nextPath().filename().string();
+        std::error_code ec;
+        for (const auto &entry : fs::directory_iterator(base_.parent_path(), ec)) {
+            if (entry.path().filename().string().compare(0, prefix.size(), prefix) == 0) fs::remove(entry.path(), ec);
+        }
+    }
+
+    void rotate() {
+        std::optional<Segment> next;
+        {
+            std::lock_guard lock(mutex_);
+            next.swap(next_);
+        }
+        // 后台线程还没建好下一段时同步创建，文件名与后台线程预建的不同
+        if (!next) next = mapSegment(fs::path(nextPath()) += fmt::format(".{}", ++fallbacks_), maxSize_);
+        {
+            std::lock_guard lock(mutex_);
+            active_.used = tail_.load(std::memory_order_relaxed);
+            retired_.push_back(std::move(active_));
+            active_ = std::move(*next);
+            tail_.store(active_.used, std::memory_order_release);
+        }
+        cv_.notify_one();
+    }
+
+    void run() {
+        static const size_t pageSize = ::sysconf(_SC_PAGESIZE);
+        const char *syncedData = nullptr;   // 上次msync的段和位置
+        size_t synced = 0;
+        size_t prefaulted = 0;              // syncedData中已预先映射到的位置
+        bool prepareFailed = false;         // 无法预建时等到下一个周期再试
+        for (;;) {
+            std::deque<Segment> retired;
+            bool stop;
+            {
+                std::unique_lock lock(mutex_);
+                cv_.wait_for(lock, flushInterval_, [&] {
+                    return stopping_ || flushRequested_ || !retired_.empty() || (!next_ && !prepareFailed);
+                });
+                retired.swap(retired_);
+                stop = stopping_;
+                flushRequested_ = false;
+            }
+
+            // 先归档写满的段，腾出monitor.log后再把当前段改名为monitor.log
+            for (auto &segment : retired) {
+                if (!closeSegment(segment)) SPDLOG_WARN("ftruncate {}: {}", segment.path.string(), strerror(errno));
+                try {
+                    shiftLogArchives(base_, maxFiles_, segment.path, false);
+                } catch (const std::exception &e) {
+                    SPDLOG_ERROR("归档日志失败: {}", e.what());
+                }
+            }
+            char *data;
+            size_t tail, capacity;
+            bool needNext;
+            {
+                std::lock_guard lock(mutex_);
+                if (active_.path != base_) {
+                    std::error_code ec;
+                    fs::rename(active_.path, base_, ec);
+                    if (!ec) active_.path = base_;
+                }
+                data = active_.data;
+                capacity = active_.capacity;
+                tail = tail_.load(std::memory_order_acquire);
+                // 当前段改名成功后nextPath()才空出来，改名失败时等到下一个周期再试
+                needNext = !next_;
+                if (needNext && active_.path != base_) {
+                    needNext = false;
+                    prepareFailed = true;
+                }
+            }
+
+            // 当前段只可能由本线程解除映射，不持锁访问是安全的；msync从上次同步位置所在的页开始
+            if (data != syncedData) {
+                syncedData = data;
+                synced = 0;
+                prefaulted = tail & ~(pageSize - 1);
+            }
+            if (tail > synced) {
+                size_t from = synced & ~(pageSize - 1);
+                ::msync(data + from, tail - from, MS_SYNC);
+                synced = tail;
+            }
+            size_t ahead = std::min(capacity, (tail + kPrefault + pageSize - 1) & ~(pageSize - 1));
+            if (!stop && ahead > prefaulted) {
+                prefault(data + prefaulted, ahead - prefaulted);
+                prefaulted = ahead;
+            }
+
+            // 退出时sink正随logger析构，不能再写日志
+            if (stop) {
+                active_.used = tail_.load(std::memory_order_acquire);
+                closeSegment(active_);
+                if (next_) {
+                    closeSegment(*next_);
+                    std::error_code ec;
+                    fs::remove(next_->path, ec);
+                }
+                return;
+            }
+            if (needNext) {
+                try {
+                    auto segment = mapSegment(nextPath(), maxSize_);
+                    prefault(segment.data, std::min(segment.capacity, kPrefault));
+                    std::lock_guard lock(mutex_);
+                    next_ = std::move(segment);
+                    prepareFailed = false;
+                } catch (const std::exception &e) {
+                    prepareFailed = true;
+                    SPDLOG_ERROR("预建日志段失败: {}", e.what());
+                }
+            }
+        }
+    }
+};
+
+MappedFileSink::MappedFileSink(const fs::path &base, size_t maxSize, size_t maxFiles, std::chrono::milliseconds flushInterval)
+    : impl_(std::make_unique<Impl>()) {
+    if (maxSize == 0 || maxFiles == 0) throw std::invalid_argument("mapped log needs a positive size and file count");
+    impl_->base_ = base;
+    impl_->maxSize_ = maxSize;
+    impl_->maxFiles_ = maxFiles;
+    impl_->flushInterval_ = flushInterval;
+    impl_->removeStaleSegments();
+    impl_->active_ = mapSegment(base, maxSize);
+    impl_->tail_ = impl_->active_.used;
+    impl_->thread_ = std::thread([impl = impl_.get()] { impl->run(); });
+}
+
+MappedFileSink::~MappedFileSink() {
+    {
+        std::lock_guard lock(impl_->mutex_);
+        impl_->stopping_ = true;
+    }
+    impl_->cv_.notify_all();
+    impl_->thread_.join();
+}
+
+void MappedFileSink::sink_it_(const spdlog::details::log_msg &msg) {
+    spdlog::memory_buf_t formatted;
+    formatter_->format(msg, formatted);
+    auto &impl = *impl_;
+    size_t tail = impl.tail_.load(std::memory_order_relaxed);
+    if (tail > 0 && tail + formatted.size() > impl.active_.capacity) {
+        impl.rotate();
+        tail = impl.tail_.load(std::memory_order_relaxed);
+    }
+    // 比整段还长的一行截断
+    size_t size = std::min(formatted.size(), impl.active_.capacity - tail);
+    std::memcpy(impl.active_.data + tail, formatted.data(), size);
+    impl.tail_.store(tail + size, std::memory_order_release);
+}
+
+void MappedFileSink::flush_() {
+    {
+        std::lock_guard lock(impl_->mutex_);
+        impl_->flushRequested_ = true;
+    }
+    impl_->cv_.notify_one();
+}
@@ -0,0 +1,386 @@
+#include "metrics_exporter.h"
+#include "report.h"
+#include <spdlog/spdlog.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+constexpr char kContentType[] = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+
+// 标签值中的反斜杠、双引号和换行需要转义
+void appendLabelValue(fmt::memory_buffer &buf, std::string_view value) {
+    for (char c : value) {
+        switch (c) {
+            case '\\': buf.append(std::string_view("\\\\")); break;
+            case '"':  buf.append(std::string_view("\\\"")); break;
+            case '\n': buf.append(std::string_view("\\n")); break;
+            default:   buf.push_back(c); break;
+        }
+    }
+}
+
+void appendFamily(fmt::memory_buffer &buf, std::string_view name, std::string_view type, std::string_view help) {
+    fmt::format_to(std::back_inserter(buf), "# TYPE {} {}\n# HELP {} {}\n", name, type, name, help);
+}
+
+void appendProcess(fmt::memory_buffer &buf, std::string_view name, const ProcessSample &process, double value) {
+    fmt::format_to(std::back_inserter(buf), "{}{{pid=\"{}\",cmd=\"", name, process.pid);
+    appendLabelValue(buf, process.cmdline);
+    fmt::format_to(std::back_inserter(buf), "\"}} {}\n", value);
+}
+
+void appendWatched(fmt::memory_buffer &buf, std::string_view name, const WatchedProcess &process, double value) {
+    fmt::format_to(std::back_inserter(buf), "{}{{pid=\"{}\",cmd=\"", name, process.pid);
+    appendLabelValue(buf, process.cmdline);
+    fmt::format_to(std::back_inserter(buf), "\"}} {}\n", value);
+}
+
+void appendGroup(fmt::memory_buffer &buf, std::string_view name, GroupBy groupBy, const ProcessGroup &group, double value) {
+    fmt::format_to(std::back_inserter(buf), "{}{{group_by=\"{}\",group=\"", name, groupByName(groupBy));
+    appendLabelValue(buf, group.name);
+    fmt::format_to(std::back_inserter(buf), "\"}} {}\n", value);
+}
+
+void renderOpenMetrics(const Snapshot &snapshot, fmt::memory_buffer &buf) {
+    auto out = std::back_inserter(buf);
+
+    appendFamily(buf, "res_monitor_snapshot_timestamp_seconds", "gauge", "Time the snapshot was taken.");
+    fmt::format_to(out, "res_monitor_snapshot_timestamp_seconds {:.3f}\n",
+        std::chrono::duration<double>(snapshot.time.time_since_epoch()).count());
+
+    if (snapshot.cpuPercent) {
+        appendFamily(buf, "res_monitor_cpu_usage_ratio", "gauge", "Host CPU usage over the last interval.");
+        fmt::format_to(out, "res_monitor_cpu_usage_ratio {}\n", *snapshot.cpuPercent / 100.0);
+    }
+
+    const auto &mem = snapshot.mem;
+    if (mem.total > 0) {
+        appendFamily(buf, "res_monitor_memory_bytes", "gauge", "Host memory from /proc/meminfo; used follows free(1).");
+        const std::pair<const char *, uint64_t> memValues[] = {
+            {"total", mem.total}, {"used", mem.used()}, {"free", mem.free},
+            {"available", mem.available}, {"buffers", mem.buffers}, {"cached", mem.cached},
+            {"shmem", mem.shmem}, {"slab", mem.slab}, {"slab_reclaimable", mem.sReclaimable},
+            {"dirty", mem.dirty}, {"writeback", mem.writeback}, {"hugetlb", mem.hugetlb},
+            {"swap_total", mem.swapTotal}, {"swap_used", mem.swapUsed()},
+        };
+        for (const auto &[type, value] : memValues) {
+            fmt::format_to(out, "res_monitor_memory_bytes{{type=\"{}\"}} {}\n", type, value);
+        }
+        appendFamily(buf, "res_monitor_hugepages", "gauge", "Huge pages in the pool.");
+        fmt::format_to(out, "res_monitor_hugepages{{state=\"total\"}} {}\n", mem.hugePagesTotal);
+        fmt::format_to(out, "res_monitor_hugepages{{state=\"free\"}} {}\n", mem.hugePagesFree);
+    }
+
+    if (snapshot.disksReady && !snapshot.disks.empty()) {
+        struct DiskMetric {
+            const char *name;
+            const char *help;
+            double (*value)(const DiskStat &);
+        };
+        static const DiskMetric diskMetrics[] = {
+            {"res_monitor_disk_read_bytes_per_second", "Bytes read per second.", [](const DiskStat &d) { return d.readBytesPerSec; }},
+            {"res_monitor_disk_write_bytes_per_second", "Bytes written per second.", [](const DiskStat &d) { return d.writeBytesPerSec; }},
+            {"res_monitor_disk_read_iops", "Completed reads per second.", [](const DiskStat &d) { return d.readIops; }},
+            {"res_monitor_disk_write_iops", "Completed writes per second.", [](const DiskStat &d) { return d.writeIops; }},
+            {"res_monitor_disk_read_await_seconds", "Average read request latency including queueing.", [](const DiskStat &d) { return d.readAwaitMs / 1000.0; }},
+            {"res_monitor_disk_write_await_seconds", "Average write request latency including queueing.", [](const DiskStat &d) { return d.writeAwaitMs / 1000.0; }},
+            {"res_monitor_disk_busy_ratio", "Fraction of time the device was busy.", [](const DiskStat &d) { return d.busyPercent / 100.0; }},
+            {"res_monitor_disk_queue_size", "Average queue depth over the interval.", [](const DiskStat &d) { return d.avgQueueSize; }},
+            {"res_monitor_disk_in_flight", "Requests in flight when sampled.", [](const DiskStat &d) { return (double)d.inFlight; }},
+        };
+        for (const auto &metric : diskMetrics) {
+            appendFamily(buf, metric.name, "gauge", metric.help);
+            for (const auto &disk : snapshot.disks) {
+                fmt::format_to(out, "{}{{device=\"", metric.name);
+                appendLabelValue(buf, disk.name);
+                fmt::format_to(out, "\"}} {}\n", metric.value(disk));
+            }
+        }
+    }
+
+    if (!snapshot.temperatures.empty()) {
+        appendFamily(buf, "res_monitor_temperature_celsius", "gauge", "hwmon temperature sensors.");
+        for (const auto &t : snapshot.temperatures) {
+            // 同名芯片（多路CPU的coretemp、多块NVMe）的传感器名相同，用hwmon区分
+            buf.append(std::string_view("res_monitor_temperature_celsius{hwmon=\""));
+            appendLabelValue(buf, t.hwmon);
+            buf.append(std::string_view("\",chip=\""));
+            appendLabelValue(buf, t.chip);
+            buf.append(std::string_view("\",sensor=\""));
+            appendLabelValue(buf, t.label);
+            fmt::format_to(out, "\"}} {}\n", t.celsius);
+        }
+    }
+
+    if (!snapshot.topCpu.empty()) {
+        appendFamily(buf, "res_monitor_top_process_cpu_ratio", "gauge", "Top processes by CPU usage.");
+        for (const auto &p : snapshot.topCpu) appendProcess(buf, "res_monitor_top_process_cpu_ratio", p, p.cpuPercent / 100.0);
+    }
+    if (!snapshot.topMem.empty()) {
+        appendFamily(buf, "res_monitor_top_process_memory_bytes", "gauge", "Top processes by memory (RSS, PSS, USS or swap).");
+        for (const auto &p : snapshot.topMem) appendProcess(buf, "res_monitor_top_process_memory_bytes", p, (double)p.memBytes);
+    }
+    if (!snapshot.topDisk.empty()) {
+        appendFamily(buf, "res_monitor_top_process_read_bytes_per_second", "gauge", "Top processes by disk I/O, read rate.");
+        for (const auto &p : snapshot.topDisk) appendProcess(buf, "res_monitor_top_process_read_bytes_per_second", p, p.readBytesPerSec);
+        appendFamily(buf, "res_monitor_top_process_write_bytes_per_second", "gauge", "Top processes by disk I/O, write rate.");
+        for (const auto &p : snapshot.topDisk) appendProcess(buf, "res_monitor_top_process_write_bytes_per_second", p, p.writeBytesPerSec);
+    }
+
+    if (!snapshot.topCpuGroups.empty()) {
+        appendFamily(buf, "res_monitor_top_group_cpu_ratio", "gauge", "Top process groups by summed CPU usage.");
+        for (const auto &g : snapshot.topCpuGroups) appendGroup(buf, "res_monitor_top_group_cpu_ratio", snapshot.groupBy, g, g.cpuPercent / 100.0);
+    }
+    if (!snapshot.topMemGroups.empty()) {
+        appendFamily(buf, "res_monitor_top_group_memory_bytes", "gauge", "Top process groups by summed resident memory.");
+        for (const auto &g : snapshot.topMemGroups) appendGroup(buf, "res_monitor_top_group_memory_bytes", snapshot.groupBy, g, (double)g.memBytes);
+    }
+    if (!snapshot.topDiskGroups.empty()) {
+        appendFamily(buf, "res_monitor_top_group_read_bytes_per_second", "gauge", "Top process groups by summed disk I/O, read rate.");
+        for (const auto &g : snapshot.topDiskGroups) appendGroup(buf, "res_monitor_top_group_read_bytes_per_second", snapshot.groupBy, g, g.readBytesPerSec);
+        appendFamily(buf, "res_monitor_top_group_write_bytes_per_second", "gauge", "Top process groups by summed disk I/O, write rate.");
+        for (const auto &g : snapshot.topDiskGroups) appendGroup(buf, "res_monitor_top_group_write_bytes_per_second", snapshot.groupBy, g, g.writeBytesPerSec);
+    }
+
+    // 监视进程：CPU和IO取汇报周期内的平均值，另给出CPU和RSS的峰值
+    if (!snapshot.watched.empty()) {
+        struct WatchMetric {
+            const char *name;
+            const char *help;
+            bool needsIo;
+            double (*value)(const WatchSummary &);
+        };
+        static const WatchMetric watchMetrics[] = {
+            {"res_monitor_watch_cpu_ratio", "Watched process CPU usage, averaged over the report interval.", false, [](const WatchSummary &s) { return s.avgCpuPercent / 100.0; }},
+            {"res_monitor_watch_cpu_max_ratio", "Watched process peak CPU usage within the report interval.", false, [](const WatchSummary &s) { return s.maxCpuPercent / 100.0; }},
+            {"res_monitor_watch_memory_bytes", "Watched process resident memory at the last sample.", false, [](const WatchSummary &s) { return (double)s.last.rssBytes; }},
+            {"res_monitor_watch_memory_max_bytes", "Watched process peak resident memory within the report interval.", false, [](const WatchSummary &s) { return (double)s.maxRssBytes; }},
+            {"res_monitor_watch_read_bytes_per_second", "Watched process disk read rate, averaged over the report interval.", true, [](const WatchSummary &s) { return s.avgReadBytesPerSec; }},
+            {"res_monitor_watch_write_bytes_per_second", "Watched process disk write rate, averaged over the report interval.", true, [](const WatchSummary &s) { return s.avgWriteBytesPerSec; }},
+        };
+        std::vector<WatchSummary> summaries;
+        for (const auto &process : snapshot.watched) summaries.push_back(summarizeWatched(process));
+        for (const auto &metric : watchMetrics) {
+            appendFamily(buf, metric.name, "gauge", metric.help);
+            for (size_t i = 0; i < snapshot.watched.size(); ++i) {
+                const auto &process = snapshot.watched[i];
+                if (summaries[i].samples == 0 || (metric.needsIo && !process.hasIo)) continue;
+                appendWatched(buf, metric.name, process, metric.value(summaries[i]));
+            }
+        }
+    }
+
+    const auto &coverage = snapshot.coverage;
+    if (coverage.processes > 0) {
+        appendFamily(buf, "res_monitor_scan_coverage_ratio", "gauge", "Fraction of processes whose stat was re-read this sample.");
+        fmt::format_to(out, "res_monitor_scan_coverage_ratio {}\n", (double)coverage.scanned / coverage.processes);
+    }
+    if (coverage.selfCpuPercent) {
+        appendFamily(buf, "res_monitor_self_cpu_ratio", "gauge", "CPU used by the monitor itself over the last interval, as a fraction of one core.");
+        fmt::format_to(out, "res_monitor_self_cpu_ratio {}\n", *coverage.selfCpuPercent / 100.0);
+    }
+    if (coverage.cpuBudgetPercent > 0) {
+        appendFamily(buf, "res_monitor_cpu_budget_ratio", "gauge", "Configured CPU budget, as a fraction of one core.");
+        fmt::format_to(out, "res_monitor_cpu_budget_ratio {}\n", coverage.cpuBudgetPercent / 100.0);
+    }
+
+    // 自监控：各采集函数的耗时分位数和最近一次调用的开销
+    appendFamily(buf, "res_monitor_collector_duration_seconds", "summary", "Wall time spent in each collector over recent calls.");
+    for (size_t i = 0; i < snapshot.collectors.size(); ++i) {
+        const auto &stats = snapshot.collectors[i];
+        if (stats.calls == 0) continue;
+        auto name = collectorName(static_cast<Collector>(i));
+        fmt::format_to(out, "res_monitor_collector_duration_seconds{{collector=\"{}\",quantile=\"0.5\"}} {}\n", name, stats.p50Ms / 1000.0);
+        fmt::format_to(out, "res_monitor_collector_duration_seconds{{collector=\"{}\",quantile=\"0.99\"}} {}\n", name, stats.p99Ms / 1000.0);
+        fmt::format_to(out, "res_monitor_collector_duration_seconds_sum{{collector=\"{}\"}} {}\n", name, stats.totalMs / 1000.0);
+        fmt::format_to(out, "res_monitor_collector_duration_seconds_count{{collector=\"{}\"}} {}\n", name, stats.calls);
+    }
+    struct CollectorMetric {
+        const char *name;
+        const char *help;
+        uint64_t CollectorStats::*value;
+    };
+    static const CollectorMetric collectorMetrics[] = {
+        {"res_monitor_collector_files_opened", "Files opened by the collector's last call.", &CollectorStats::opens},
+        {"res_monitor_collector_read_bytes", "Bytes read by the collector's last call.", &CollectorStats::bytesRead},
+        {"res_monitor_collector_allocations", "Heap allocations made by the collector's last call.", &CollectorStats::allocations},
+    };
+    for (const auto &metric : collectorMetrics) {
+        appendFamily(buf, metric.name, "gauge", metric.help);
+        for (size_t i = 0; i < snapshot.collectors.size(); ++i) {
+            const auto &stats = snapshot.collectors[i];
+            if (stats.calls == 0) continue;
+            fmt::format_to(out, "{}{{collector=\"{}\"}} {}\n", metric.name, collectorName(static_cast<Collector>(i)), stats.*metric.value);
+        }
+    }
+
+    buf.append(std::string_view("# EOF\n"));
+}
+
+bool writeAll(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+}
+
+struct MetricsExporter::Impl {
+    int listenFd_ = -1;
+    int wakeFd_ = -1;       // eventfd，用于通知服务线程退出
+    std::thread thread_;
+    std::thread renderThread_;
+
+    // 渲染用的复用缓冲区，只在渲染线程中使用
+    fmt::memory_buffer body_;
+    fmt::memory_buffer response_;
+
+    // 完整的HTTP响应（含头部），抓取时直接发送
+    std::atomic<std::shared_ptr<const std::string>> cached_;
+
+    void serve();
+    void render(const SnapshotChannel &channel);
+    void handleClient(int fd);
+};
+
+MetricsExporter::MetricsExporter()
+    : impl_(new Impl) {
+}
+
+MetricsExporter::~MetricsExporter() {
+    stop();
+}
+
+void MetricsExporter::start(const std::string &listen, const SnapshotChannel &channel) {
+    auto colon = listen.rfind(':');
+    if (colon == std::string::npos) throw std::runtime_error("invalid listen address: " + listen);
+    std::string host = listen.substr(0, colon);
+    std::string port = listen.substr(colon + 1);
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') host = host.substr(1, host.size() - 2);
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+    addrinfo *result = nullptr;
+    int rc = ::getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result);
+    if (rc != 0) throw std::runtime_error(fmt::format("resolve {}: {}", listen, gai_strerror(rc)));
+
+    int fd = ::socket(result->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int one = 1;
+    if (fd >= 0) ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (fd < 0 || ::bind(fd, result->ai_addr, result->ai_addrlen) < 0 || ::listen(fd, 16) < 0) {
+        int err = errno;
+        ::freeaddrinfo(result);
+        if (fd >= 0) ::close(fd);
+        throw std::runtime_error(fmt::format("listen {}: {}", listen, strerror(err)));
+    }
+    ::freeaddrinfo(result);
+
+    impl_->listenFd_ = fd;
+    impl_->wakeFd_ = ::eventfd(0, EFD_CLOEXEC);
+    impl_->thread_ = std::thread([this] { impl_->serve(); });
+    impl_->renderThread_ = std::thread([this, &channel] { impl_->render(channel); });
+}
+
+void MetricsExporter::stop() {
+    if (!impl_->thread_.joinable()) return;
+    uint64_t one = 1;
+    (void)!::write(impl_->wakeFd_, &one, sizeof(one));
+    impl_->thread_.join();
+    impl_->renderThread_.join();
+    ::close(impl_->listenFd_);
+    ::close(impl_->wakeFd_);
+    impl_->listenFd_ = impl_->wakeFd_ = -1;
+}
+
+void MetricsExporter::Impl::render(const SnapshotChannel &channel) {
+    SnapshotReader reader(channel);
+    while (auto published = reader.next()) {
+        body_.clear();
+        renderOpenMetrics(published->snapshot, body_);
+
+        response_.clear();
+        fmt::format_to(std::back_inserter(response_),
+            "HTTP/1.1 200 OK\r\nContent-Type: {}\r\nContent-Length: {}\r\nConnection: close\r\n\r\n",
+            kContentType, body_.size());
+        response_.append(body_);
+
+        cached_.store(std::make_shared<const std::string>(response_.data(), response_.size()));
+    }
+}
+
+void MetricsExporter::Impl::serve() {
+    pollfd fds[2] = {{listenFd_, POLLIN, 0}, {wakeFd_, POLLIN, 0}};
+    for (;;) {
+        int n = ::poll(fds, 2, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            SPDLOG_ERROR("metrics exporter poll: {}", strerror(errno));
+            return;
+        }
+        if (fds[1].revents) return;
+        if (!(fds[0].revents & POLLIN)) continue;
+
+        int client = ::accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) continue;
+        handleClient(client);
+        ::close(client);
+    }
+}
+
+void MetricsExporter::Impl::handleClient(int fd) {
+    // 慢客户端最多占用服务线程2秒
+    timeval timeout{2, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    char request[4096];
+    size_t size = 0;
+    while (size < sizeof(request)) {
+        ssize_t n = ::recv(fd, request + size, sizeof(request) - size, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        size += n;
+        if (std::string_view(request, size).find("\r\n\r\n") != std::string_view::npos) break;
+    }
+
+    std::string_view line(request, size);
+    line = line.substr(0, line.find("\r\n"));
+
+    static constexpr std::string_view kNotFound =
+        "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    static constexpr std::string_view kUnavailable =
+        "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+    if (line.rfind("GET /metrics ", 0) != 0 && line.rfind("GET / ", 0) != 0) {
+        writeAll(fd, kNotFound.data(), kNotFound.size());
+        return;
+    }
+
+    auto cached = cached_.load();
+    if (!cached) {
+        writeAll(fd, kUnavailable.data(), kUnavailable.size());   // 还没有完成第一次采样
+        return;
+    }
+    writeAll(fd, cached->data(), cached->size());
+}
@@ -0,0 +1,107 @@
+#include "monitor_core.h"
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+struct Subscription {
+    uint64_t id = 0;
+    MonitorCore::Topic topic = MonitorCore::Topic::Cpu;
+    int period = 1;
+    uint64_t firstTick = 0;     // 订阅后的第一次poll()即执行
+    std::shared_ptr<const MonitorCore::Callback> callback;
+
+    bool due(uint64_t tick) const {
+        return (tick - firstTick) % period == 0;
+    }
+};
+
+int &topicPeriod(CollectorPeriods &periods, MonitorCore::Topic topic) {
+    switch (topic) {
+        case MonitorCore::Topic::Cpu: return periods.cpu;
+        case MonitorCore::Topic::Memory: return periods.memory;
+        case MonitorCore::Topic::Disks: return periods.disks;
+        case MonitorCore::Topic::Temperatures: return periods.temperatures;
+        case MonitorCore::Topic::Processes: return periods.processes;
+    }
+    throw std::invalid_argument("unknown topic");
+}
+
+}
+
+struct MonitorCore::Impl {
+    ResourceMonitor monitor_;
+    Executor executor_;
+    SampleOptions options_;
+
+    std::mutex mutex_;          // 保护以下成员，subscribe/unsubscribe可在其他线程调用
+    std::vector<Subscription> subscriptions_;
+    uint64_t nextId_ = 1;
+    uint64_t tick_ = 0;         // 下一次poll()的序号
+
+    explicit Impl(MonitorEnvironment environment, Executor executor)
+        : monitor_(std::move(environment)), executor_(std::move(executor)) {
+    }
+};
+
+MonitorCore::MonitorCore(MonitorEnvironment environment, Executor executor)
+    : impl_(new Impl(std::move(environment), std::move(executor))) {
+}
+
+MonitorCore::~MonitorCore() = default;
+
+ResourceMonitor &MonitorCore::monitor() {
+    return impl_->monitor_;
+}
+
+void MonitorCore::setSampleOptions(const SampleOptions &options) {
+    impl_->options_ = options;
+}
+
+uint64_t MonitorCore::subscribe(Topic topic, Callback callback, int period) {
+    if (period <= 0) throw std::invalid_argument("subscription period must be positive");
+    if (!callback) throw std::invalid_argument("empty subscription callback");
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    Subscription subscription;
+    subscription.id = impl_->nextId_++;
+    subscription.topic = topic;
+    subscription.period = period;
+    subscription.firstTick = impl_->tick_;
+    subscription.callback = std::make_shared<const Callback>(std::move(callback));
+    impl_->subscriptions_.push_back(std::move(subscription));
+    return impl_->subscriptions_.back().id;
+}
+
+void MonitorCore::unsubscribe(uint64_t id) {
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    std::erase_if(impl_->subscriptions_, [id](const Subscription &s) { return s.id == id; });
+}
+
+std::shared_ptr<const Snapshot> MonitorCore::poll() {
+    // 在锁内选出到期的订阅，回调在锁外执行，回调中可以再订阅或取消订阅
+    std::vector<std::shared_ptr<const Callback>> due;
+    auto options = impl_->options_;
+    options.periods = {0, 0, 0, 0, 0};
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex_);
+        auto tick = impl_->tick_++;
+        for (const auto &subscription : impl_->subscriptions_) {
+            if (!subscription.due(tick)) continue;
+            topicPeriod(options.periods, subscription.topic) = 1;
+            due.push_back(subscription.callback);
+        }
+    }
+    if (due.empty()) return nullptr;
+
+    auto snapshot = std::make_shared<const Snapshot>(impl_->monitor_.sample(options));
+    for (auto &callback : due) {
+        if (impl_->executor_) {
+            impl_->executor_([callback, snapshot] { (*callback)(*snapshot); });
+        } else {
+            (*callback)(*snapshot);
+        }
+    }
+    return snapshot;
+}
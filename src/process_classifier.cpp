@@ -0,0 +1,581 @@
+#include "process_classifier.h"
+#include <regex>
+#include <bitset>
+#include <map>
+#include <array>
+#include <optional>
+#include <algorithm>
+#include <climits>
+
+namespace {
+
+using ByteSet = std::bitset<256>;
+
+// 规则的语法树
+struct Node {
+    enum class Kind {
+        Set,        // 一个字节，属于sets[set]
+        Concat,     // 依次匹配children，为空时匹配空串
+        Alt,        // 匹配children之一
+        Repeat,     // children[0]重复min到max次，max为-1表示不限
+    };
+    Kind kind = Kind::Concat;
+    int set = -1;
+    int min = 0;
+    int max = 0;
+    std::vector<Node> children;
+};
+
+// 自动机不支持的写法，由调用者退回std::regex
+struct Unsupported {};
+
+// 解析ECMAScript正则的一个子集。调用前已用std::regex检查过语法，这里只需识别能转换为自动机的写法
+class Parser {
+public:
+    Parser(std::string_view pattern, std::vector<ByteSet> &sets) : p_(pattern), sets_(sets) {}
+
+    // 只识别整条规则开头的^和结尾的$
+    Node parse(bool &anchorStart, bool &anchorEnd) {
+        anchorStart = !p_.empty() && p_.front() == '^';
+        if (anchorStart) pos_ = 1;
+        Node node = parseAlt();
+        anchorEnd = pos_ + 1 == p_.size() && p_[pos_] == '$';
+        if (anchorEnd) ++pos_;
+        if (pos_ != p_.size()) throw Unsupported{};
+        // ^a|b中的锚定只作用于一个分支
+        if ((anchorStart || anchorEnd) && node.kind == Node::Kind::Alt) throw Unsupported{};
+        return node;
+    }
+
+private:
+    std::string_view p_;
+    size_t pos_ = 0;
+    std::vector<ByteSet> &sets_;
+
+    bool atEnd() const { return pos_ >= p_.size(); }
+
+    Node setNode(const ByteSet &set) {
+        Node node;
+        node.kind = Node::Kind::Set;
+        auto it = std::find(sets_.begin(), sets_.end(), set);
+        node.set = static_cast<int>(it - sets_.begin());
+        if (it == sets_.end()) sets_.push_back(set);
+        return node;
+    }
+
+    Node parseAlt() {
+        Node first = parseConcat();
+        if (atEnd() || p_[pos_] != '|') return first;
+        Node alt;
+        alt.kind = Node::Kind::Alt;
+        alt.children.push_back(std::move(first));
+        while (!atEnd() && p_[pos_] == '|') {
+            ++pos_;
+            alt.children.push_back(parseConcat());
+        }
+        return alt;
+    }
+
+    Node parseConcat() {
+        Node concat;
+        while (!atEnd()) {
+            char c = p_[pos_];
+            if (c == '|' || c == ')') break;
+            if (c == '$' && pos_ + 1 == p_.size()) break;
+            concat.children.push_back(parseQuantifier(parseAtom()));
+        }
+        return concat;
+    }
+
+    Node parseQuantifier(Node atom) {
+        if (atEnd()) return atom;
+        int min = 0, max = 0;
+        switch (p_[pos_]) {
+            case '*': min = 0; max = -1; ++pos_; break;
+            case '+': min = 1; max = -1; ++pos_; break;
+            case '?': min = 0; max = 1; ++pos_; break;
+            case '{': parseBraces(min, max); break;
+            default: return atom;
+        }
+        if (!atEnd() && p_[pos_] == '?') ++pos_;   // 非贪婪不影响是否匹配
+
+        Node repeat;
+        repeat.kind = Node::Kind::Repeat;
+        repeat.min = min;
+        repeat.max = max;
+        repeat.children.push_back(std::move(atom));
+        return repeat;
+    }
+
+    // {n}、{n,}、{n,m}；次数过大时展开后的状态太多，交给std::regex
+    void parseBraces(int &min, int &max) {
+        constexpr int kMaxRepeat = 32;
+        auto close = p_.find('}', pos_);
+        if (close == std::string_view::npos) throw Unsupported{};
+        auto body = p_.substr(pos_ + 1, close - pos_ - 1);
+        auto comma = body.find(',');
+        auto number = [](std::string_view s) {
+            if (s.empty() || s.size() > 3 || !std::all_of(s.begin(), s.end(), ::isdigit)) throw Unsupported{};
+            return std::stoi(std::string(s));
+        };
+        min = number(body.substr(0, comma));
+        if (comma == std::string_view::npos) max = min;
+        else if (comma + 1 == body.size()) max = -1;
+        else max = number(body.substr(comma + 1));
+        if (min > kMaxRepeat || max > kMaxRepeat || (max >= 0 && max < min)) throw Unsupported{};
+        pos_ = close + 1;
+    }
+
+    Node parseAtom() {
+        char c = p_[pos_++];
+        switch (c) {
+            case '(': {
+                if (p_.substr(pos_, 2) == "?:") pos_ += 2;
+                else if (!atEnd() && p_[pos_] == '?') throw Unsupported{};     // 环视
+                Node inner = parseAlt();
+                if (atEnd() || p_[pos_] != ')') throw Unsupported{};
+                ++pos_;
+                return inner;
+            }
+            case '.': {
+                ByteSet set;
+                set.set();
+                set.reset('\n');
+                set.reset('\r');
+                return setNode(set);
+            }
+            case '[':
+                return setNode(parseClass());
+            case '\\':
+                return setNode(parseEscape(false));
+            case '^': case '$': case '*': case '+': case '?': case '{': case ')': case '|':
+                throw Unsupported{};
+            default: {
+                ByteSet set;
+                set.set(static_cast<unsigned char>(c));
+                return setNode(set);
+            }
+        }
+    }
+
+    ByteSet parseEscape(bool inClass) {
+        if (atEnd()) throw Unsupported{};
+        auto c = static_cast<unsigned char>(p_[pos_++]);
+        ByteSet set;
+        auto range = [&set](int lo, int hi) { for (int b = lo; b <= hi; ++b) set.set(b); };
+        switch (c) {
+            case 'd': range('0', '9'); break;
+            case 'D': range('0', '9'); set.flip(); break;
+            case 'w': range('0', '9'); range('A', 'Z'); range('a', 'z'); set.set('_'); break;
+            case 'W': range('0', '9'); range('A', 'Z'); range('a', 'z'); set.set('_'); set.flip(); break;
+            case 's': range('\t', '\r'); set.set(' '); break;
+            case 'S': range('\t', '\r'); set.set(' '); set.flip(); break;
+            case 't': set.set('\t'); break;
+            case 'n': set.set('\n'); break;
+            case 'r': set.set('\r'); break;
+            case 'f': set.set('\f'); break;
+            case 'v': set.set('\v'); break;
+            case '0': set.set(0); break;
+            case 'x': {
+                if (pos_ + 2 > p_.size() || !::isxdigit(p_[pos_]) || !::isxdigit(p_[pos_ + 1])) throw Unsupported{};
+                set.set(std::stoi(std::string(p_.substr(pos_, 2)), nullptr, 16));
+                pos_ += 2;
+                break;
+            }
+            case 'b':
+                if (!inClass) throw Unsupported{};     // 单词边界
+                set.set('\b');
+                break;
+            default:
+                if (::isalnum(c)) throw Unsupported{};  // 反向引用\1、\B、\cX、\u等
+                set.set(c);                             // 转义的标点按字面匹配
+        }
+        return set;
+    }
+
+    // ECMAScript中[]是空集合，]不能作为第一个字符出现在集合中
+    ByteSet parseClass() {
+        ByteSet set;
+        bool negate = !atEnd() && p_[pos_] == '^';
+        if (negate) ++pos_;
+        while (true) {
+            if (atEnd()) throw Unsupported{};
+            char c = p_[pos_];
+            if (c == ']') {
+                ++pos_;
+                break;
+            }
+            if (c == '[' && pos_ + 1 < p_.size() && (p_[pos_ + 1] == ':' || p_[pos_ + 1] == '.' || p_[pos_ + 1] == '=')) {
+                throw Unsupported{};    // [:alpha:]等
+            }
+
+            auto single = [](const ByteSet &item) {
+                if (item.count() != 1) return -1;
+                for (int b = 0; b < 256; ++b) if (item.test(b)) return b;
+                return -1;
+            };
+            ByteSet item;
+            ++pos_;
+            if (c == '\\') item = parseEscape(true);
+            else item.set(static_cast<unsigned char>(c));
+
+            int lo = single(item);
+            if (lo >= 0 && pos_ + 1 < p_.size() && p_[pos_] == '-' && p_[pos_ + 1] != ']') {
+                ++pos_;
+                char d = p_[pos_++];
+                ByteSet upper;
+                if (d == '\\') upper = parseEscape(true);
+                else upper.set(static_cast<unsigned char>(d));
+                int hi = single(upper);
+                if (hi < lo) throw Unsupported{};
+                for (int b = lo; b <= hi; ++b) set.set(b);
+            } else {
+                set |= item;
+            }
+        }
+        if (negate) set.flip();
+        return set;
+    }
+};
+
+// 整条规则只是一串普通字符时返回该字符串
+std::optional<std::string> asLiteral(const Node &node, const std::vector<ByteSet> &sets) {
+    if (node.kind != Node::Kind::Concat) return std::nullopt;
+    std::string literal;
+    for (const auto &child : node.children) {
+        if (child.kind != Node::Kind::Set || sets[child.set].count() != 1) return std::nullopt;
+        for (int b = 0; b < 256; ++b) {
+            if (sets[child.set].test(b)) literal.push_back(static_cast<char>(b));
+        }
+    }
+    return literal;
+}
+
+}
+
+struct ProcessClassifier::Impl {
+    size_t size_ = 0;
+
+    // Aho-Corasick：不在任何字面规则中出现的字节归为第0类，转移表按类展开，失败转移已预先填好
+    std::array<int, 256> literalClass_{};
+    int literalClasses_ = 1;
+    std::vector<int> literalNext_;      // 节点 * literalClasses_
+    std::vector<int> literalOutput_;    // 到达节点时匹配的规则下标的最小值（含后缀链），没有时为INT_MAX
+    int literalMin_ = INT_MAX;
+    size_t literalCount_ = 0;
+
+    // Thompson NFA，所有规则共用
+    struct NfaState {
+        int set = -1;           // >=0：读入属于sets_[set]的字节后转到next；-1：ε转移到next和alt
+        int next = -1;
+        int alt = -1;
+        int accept = -1;        // >=0：接受状态，值为规则下标
+        bool atEnd = false;     // 只在文本结尾接受（规则以$结尾）
+    };
+    std::vector<NfaState> nfa_;
+    std::vector<ByteSet> sets_;
+    std::vector<int> anchoredStarts_;       // 以^开头的规则只从文本开头匹配
+    std::vector<int> unanchoredStarts_;     // 其余规则从每个位置开始，相当于前面加上.*
+    int automatonMin_ = INT_MAX;
+    size_t automatonCount_ = 0;
+
+    // 按需构造的DFA：状态为NFA状态集合，转移未计算时为-1；状态过多时整体清空重建
+    static constexpr size_t kMaxDfaStates = 2048;
+    struct DfaState {
+        std::vector<int> nfa;
+        int accept = INT_MAX;
+        int endAccept = INT_MAX;
+    };
+    std::array<int, 256> dfaClass_{};
+    std::vector<int> dfaClassByte_;         // 每类的一个代表字节
+    std::vector<DfaState> dfa_;
+    std::map<std::vector<int>, int> dfaIndex_;
+    std::vector<int> dfaNext_;              // 状态 * dfaClassByte_.size()
+    std::vector<int> startSet_;
+    int dfaStart_ = -1;
+
+    // 闭包计算使用的临时数据
+    std::vector<int> stack_;
+    std::vector<unsigned> mark_;
+    unsigned generation_ = 0;
+
+    // 退回std::regex的规则，按下标排序
+    std::vector<std::pair<int, std::regex>> fallback_;
+
+    int addNfa(NfaState state) {
+        nfa_.push_back(state);
+        return static_cast<int>(nfa_.size() - 1);
+    }
+
+    // 构造匹配node后转到next的片段，返回片段的起始状态
+    int compile(const Node &node, int next) {
+        switch (node.kind) {
+            case Node::Kind::Set:
+                return addNfa({node.set, next});
+            case Node::Kind::Concat:
+                for (auto it = node.children.rbegin(); it != node.children.rend(); ++it) next = compile(*it, next);
+                return next;
+            case Node::Kind::Alt: {
+                int result = compile(node.children.back(), next);
+                for (size_t i = node.children.size() - 1; i-- > 0;) {
+                    result = addNfa({-1, compile(node.children[i], next), result});
+                }
+                return result;
+            }
+            case Node::Kind::Repeat: {
+                const Node &child = node.children[0];
+                int tail = next;
+                if (node.max < 0) {
+                    int loop = addNfa({-1, -1, next});
+                    int body = compile(child, loop);
+                    nfa_[loop].next = body;
+                    tail = loop;
+                } else {
+                    for (int i = node.min; i < node.max; ++i) tail = addNfa({-1, compile(child, tail), tail});
+                }
+                for (int i = 0; i < node.min; ++i) tail = compile(child, tail);
+                return tail;
+            }
+        }
+        return next;
+    }
+
+    void buildLiterals(const std::vector<std::pair<std::string, int>> &literals) {
+        literalCount_ = literals.size();
+        literalClass_.fill(0);
+        for (const auto &[literal, index] : literals) {
+            for (unsigned char c : literal) {
+                if (literalClass_[c] == 0) literalClass_[c] = literalClasses_++;
+            }
+        }
+
+        // 字典树
+        const int classes = literalClasses_;
+        std::vector<int> children(classes, -1);
+        literalOutput_.assign(1, INT_MAX);
+        for (const auto &[literal, index] : literals) {
+            int node = 0;
+            for (unsigned char c : literal) {
+                int &child = children[node * classes + literalClass_[c]];
+                if (child < 0) {
+                    child = static_cast<int>(literalOutput_.size());
+                    literalOutput_.push_back(INT_MAX);
+                    children.resize(children.size() + classes, -1);
+                }
+                node = children[node * classes + literalClass_[c]];
+            }
+            literalOutput_[node] = std::min(literalOutput_[node], index);
+            literalMin_ = std::min(literalMin_, index);
+        }
+
+        // 按层构造失败转移，同时把缺失的转移补全为失败节点的转移
+        literalNext_ = children;
+        std::vector<int> fail(literalOutput_.size(), 0);
+        std::vector<int> queue;
+        for (int c = 0; c < classes; ++c) {
+            int &child = literalNext_[c];
+            if (child < 0) child = 0;
+            else queue.push_back(child);
+        }
+        for (size_t head = 0; head < queue.size(); ++head) {
+            int node = queue[head];
+            literalOutput_[node] = std::min(literalOutput_[node], literalOutput_[fail[node]]);
+            for (int c = 0; c < classes; ++c) {
+                int child = children[node * classes + c];
+                int fallback = literalNext_[fail[node] * classes + c];
+                if (child < 0) {
+                    literalNext_[node * classes + c] = fallback;
+                } else {
+                    fail[child] = fallback;
+                    queue.push_back(child);
+                }
+            }
+        }
+    }
+
+    // 把NFA状态按ε转移展开，只保留读入字节的状态和接受状态，结果排序
+    void closure(std::vector<int> &states) {
+        if (mark_.size() < nfa_.size()) mark_.resize(nfa_.size(), 0);
+        ++generation_;
+        stack_.assign(states.begin(), states.end());
+        states.clear();
+        while (!stack_.empty()) {
+            int s = stack_.back();
+            stack_.pop_back();
+            if (s < 0 || mark_[s] == generation_) continue;
+            mark_[s] = generation_;
+            const auto &state = nfa_[s];
+            if (state.set >= 0 || state.accept >= 0) {
+                states.push_back(s);
+            } else {
+                stack_.push_back(state.alt);
+                stack_.push_back(state.next);
+            }
+        }
+        std::sort(states.begin(), states.end());
+    }
+
+    int addDfaState(std::vector<int> states) {
+        auto it = dfaIndex_.find(states);
+        if (it != dfaIndex_.end()) return it->second;
+
+        DfaState state;
+        for (int s : states) {
+            if (nfa_[s].accept < 0) continue;
+            int &accept = nfa_[s].atEnd ? state.endAccept : state.accept;
+            accept = std::min(accept, nfa_[s].accept);
+        }
+        state.nfa = std::move(states);
+        int index = static_cast<int>(dfa_.size());
+        dfaIndex_.emplace(state.nfa, index);
+        dfa_.push_back(std::move(state));
+        dfaNext_.resize(dfa_.size() * dfaClassByte_.size(), -1);
+        return index;
+    }
+
+    void buildDfa() {
+        // 按所有字节集合划分等价类：对每个集合的归属都相同的字节共用一列转移
+        std::map<std::vector<bool>, int> classes;
+        for (int b = 0; b < 256; ++b) {
+            std::vector<bool> signature(sets_.size());
+            for (size_t i = 0; i < sets_.size(); ++i) signature[i] = sets_[i].test(b);
+            auto [it, inserted] = classes.emplace(std::move(signature), static_cast<int>(dfaClassByte_.size()));
+            if (inserted) dfaClassByte_.push_back(b);
+            dfaClass_[b] = it->second;
+        }
+
+        startSet_ = anchoredStarts_;
+        startSet_.insert(startSet_.end(), unanchoredStarts_.begin(), unanchoredStarts_.end());
+        closure(startSet_);
+        dfaStart_ = addDfaState(startSet_);
+    }
+
+    int step(int state, int cls) {
+        int cached = dfaNext_[state * dfaClassByte_.size() + cls];
+        if (cached >= 0) return cached;
+
+        int byte = dfaClassByte_[cls];
+        std::vector<int> targets = unanchoredStarts_;
+        for (int s : dfa_[state].nfa) {
+            const auto &nfaState = nfa_[s];
+            if (nfaState.set >= 0 && sets_[nfaState.set].test(byte)) targets.push_back(nfaState.next);
+        }
+        closure(targets);
+
+        if (dfa_.size() >= kMaxDfaStates) {
+            dfa_.clear();
+            dfaIndex_.clear();
+            dfaNext_.clear();
+            dfaStart_ = addDfaState(startSet_);
+            return addDfaState(std::move(targets));
+        }
+        int next = addDfaState(std::move(targets));
+        dfaNext_[state * dfaClassByte_.size() + cls] = next;
+        return next;
+    }
+
+    // 返回best与text中匹配的最小规则下标两者的较小值
+    int search(std::string_view text, int best) {
+        if (literalMin_ < best) {
+            int node = 0;
+            best = std::min(best, literalOutput_[0]);
+            const int classes = literalClasses_;
+            for (unsigned char c : text) {
+                if (best <= literalMin_) break;
+                node = literalNext_[node * classes + literalClass_[c]];
+                best = std::min(best, literalOutput_[node]);
+            }
+        }
+
+        if (automatonMin_ < best) {
+            int state = dfaStart_;
+            best = std::min(best, dfa_[state].accept);
+            bool dead = false;
+            for (unsigned char c : text) {
+                if (best <= automatonMin_) break;
+                state = step(state, dfaClass_[c]);
+                if (dfa_[state].nfa.empty()) {
+                    dead = true;    // 只剩锚定的规则且都已失配
+                    break;
+                }
+                best = std::min(best, dfa_[state].accept);
+            }
+            if (!dead) best = std::min(best, dfa_[state].endAccept);
+        }
+
+        for (const auto &[index, re] : fallback_) {
+            if (index >= best) break;
+            if (std::regex_search(text.begin(), text.end(), re)) {
+                best = index;
+                break;
+            }
+        }
+        return best;
+    }
+};
+
+ProcessClassifier::ProcessClassifier(const std::vector<std::string> &patterns)
+    : impl_(new Impl) {
+    impl_->size_ = patterns.size();
+    std::vector<std::pair<std::string, int>> literals;
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        int index = static_cast<int>(i);
+        // 先按std::regex检查语法，保证接受的规则与之前完全一致
+        std::regex re(patterns[i], std::regex::ECMAScript | std::regex::optimize);
+
+        bool anchorStart = false, anchorEnd = false;
+        Node node;
+        try {
+            node = Parser(patterns[i], impl_->sets_).parse(anchorStart, anchorEnd);
+        } catch (const Unsupported &) {
+            impl_->fallback_.emplace_back(index, std::move(re));
+            continue;
+        }
+
+        if (!anchorStart && !anchorEnd) {
+            if (auto literal = asLiteral(node, impl_->sets_)) {
+                literals.emplace_back(std::move(*literal), index);
+                continue;
+            }
+        }
+
+        Impl::NfaState accept;
+        accept.accept = index;
+        accept.atEnd = anchorEnd;
+        int start = impl_->compile(node, impl_->addNfa(accept));
+        (anchorStart ? impl_->anchoredStarts_ : impl_->unanchoredStarts_).push_back(start);
+        impl_->automatonMin_ = std::min(impl_->automatonMin_, index);
+        impl_->automatonCount_++;
+    }
+
+    impl_->buildLiterals(literals);
+    if (impl_->automatonCount_ > 0) impl_->buildDfa();
+}
+
+ProcessClassifier::~ProcessClassifier() {
+}
+
+int ProcessClassifier::classify(std::string_view text) {
+    int best = impl_->search(text, INT_MAX);
+    return best == INT_MAX ? -1 : best;
+}
+
+int ProcessClassifier::classify(std::string_view cmdline, std::string_view comm) {
+    int best = INT_MAX;
+    if (!cmdline.empty()) best = impl_->search(cmdline, best);
+    if (!comm.empty()) best = impl_->search(comm, best);
+    return best == INT_MAX ? -1 : best;
+}
+
+size_t ProcessClassifier::size() const {
+    return impl_->size_;
+}
+
+ProcessClassifier::Stats ProcessClassifier::stats() const {
+    Stats stats;
+    stats.literals = impl_->literalCount_;
+    stats.automaton = impl_->automatonCount_;
+    stats.fallback = impl_->fallback_.size();
+    stats.dfaStates = impl_->dfa_.size();
+    return stats;
+}
@@ -0,0 +1,370 @@
+#include "process_filter.h"
+#include "process_classifier.h"
+#include <spdlog/spdlog.h>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <stdexcept>
+
+namespace {
+
+enum class FieldType {
+    Number,
+    Text,
+    Command,    // 只能做正则匹配，结果按进程缓存
+};
+
+struct FieldInfo {
+    std::string_view name;
+    FilterField field;
+    FieldType type;
+};
+
+constexpr FieldInfo kFields[] = {
+    {"pid", FilterField::Pid, FieldType::Number},
+    {"ppid", FilterField::Ppid, FieldType::Number},
+    {"session", FilterField::Session, FieldType::Number},
+    {"threads", FilterField::Threads, FieldType::Number},
+    {"uid", FilterField::Uid, FieldType::Number},
+    {"user", FilterField::User, FieldType::Text},
+    {"comm", FilterField::Comm, FieldType::Text},
+    {"cmd", FilterField::Cmd, FieldType::Command},
+    {"cpu", FilterField::Cpu, FieldType::Number},
+    {"rss", FilterField::Rss, FieldType::Number},
+    {"read", FilterField::Read, FieldType::Number},
+    {"write", FilterField::Write, FieldType::Number},
+    {"io", FilterField::Io, FieldType::Number},
+};
+
+enum class Compare : uint8_t { Eq, Ne, Lt, Le, Gt, Ge, Match, NotMatch };
+
+// 一条指令。比较指令把结果压栈；跳转指令只查看栈顶，用于&&和||的短路
+struct Instruction {
+    enum class Op : uint8_t {
+        Number,         // field cmp numbers_[operand]
+        Text,           // field cmp texts_[operand]，或field ~ classifiers_[operand]
+        Command,        // cmd ~ classifiers_[operand]
+        Not,
+        And,
+        Or,
+        JumpIfFalse,    // 栈顶为False时跳到operand
+        JumpIfTrue,
+    };
+    Op op;
+    FilterField field = FilterField::Pid;
+    Compare compare = Compare::Eq;
+    uint32_t operand = 0;
+};
+
+using Result = ProcessFilter::Result;
+
+Result fromBool(bool value) { return value ? Result::True : Result::False; }
+
+// 三值逻辑（Kleene）
+Result logicalAnd(Result a, Result b) {
+    if (a == Result::False || b == Result::False) return Result::False;
+    if (a == Result::True && b == Result::True) return Result::True;
+    return Result::Unknown;
+}
+
+Result logicalOr(Result a, Result b) {
+    if (a == Result::True || b == Result::True) return Result::True;
+    if (a == Result::False && b == Result::False) return Result::False;
+    return Result::Unknown;
+}
+
+// 正则元字符转义，用于把cmd == "..."转换为锚定的匹配
+std::string escapeRegex(std::string_view text) {
+    std::string result;
+    for (char c : text) {
+        if (std::string_view("\\^$.|?*+()[]{}").find(c) != std::string_view::npos) result.push_back('\\');
+        result.push_back(c);
+    }
+    return result;
+}
+
+}
+
+struct ProcessFilter::Impl {
+    static constexpr size_t kMaxStack = 32;
+    static constexpr size_t kMaxNesting = 64;           // 括号和!的嵌套层数，限制解析时的递归深度
+    static constexpr size_t kMaxCommandPatterns = 64;   // 调用方用64位掩码缓存匹配结果
+
+    std::string expression_;
+    std::vector<Instruction> program_;
+    std::vector<double> numbers_;
+    std::vector<std::string> texts_;
+    std::vector<std::unique_ptr<ProcessClassifier>> classifiers_;
+
+    // 递归下降解析，边解析边生成指令
+    std::string_view input_;
+    size_t pos_ = 0;
+    size_t depth_ = 0;      // 求值时栈的深度
+    size_t nesting_ = 0;
+
+    [[noreturn]] void fail(const std::string &message) const {
+        throw std::invalid_argument(fmt::format("--filter: {} at offset {}: {}", message, pos_, expression_));
+    }
+
+    void skipSpace() {
+        while (pos_ < input_.size() && std::isspace(static_cast<unsigned char>(input_[pos_]))) ++pos_;
+    }
+
+    bool accept(std::string_view token) {
+        skipSpace();
+        if (input_.substr(pos_, token.size()) != token) return false;
+        pos_ += token.size();
+        return true;
+    }
+
+    void push() {
+        if (++depth_ > kMaxStack) fail("expression too complex");
+    }
+
+    void emit(Instruction instruction) { program_.push_back(instruction); }
+
+    // or := and ('||' and)*
+    void parseOr() {
+        parseAnd();
+        while (accept("||")) {
+            size_t jump = program_.size();
+            emit({Instruction::Op::JumpIfTrue});
+            parseAnd();
+            emit({Instruction::Op::Or});
+            --depth_;
+            program_[jump].operand = static_cast<uint32_t>(program_.size());
+        }
+    }
+
+    // and := unary ('&&' unary)*
+    void parseAnd() {
+        parseUnary();
+        while (accept("&&")) {
+            size_t jump = program_.size();
+            emit({Instruction::Op::JumpIfFalse});
+            parseUnary();
+            emit({Instruction::Op::And});
+            --depth_;
+            program_[jump].operand = static_cast<uint32_t>(program_.size());
+        }
+    }
+
+    // unary := '!' unary | '(' or ')' | comparison
+    void parseUnary() {
+        skipSpace();
+        if (input_.substr(pos_, 2) != "!~" && accept("!")) {
+            nest();
+            parseUnary();
+            --nesting_;
+            emit({Instruction::Op::Not});
+            return;
+        }
+        if (accept("(")) {
+            nest();
+            parseOr();
+            --nesting_;
+            if (!accept(")")) fail("expected ')'");
+            return;
+        }
+        parseComparison();
+    }
+
+    void nest() {
+        if (++nesting_ > kMaxNesting) fail("expression nested too deeply");
+    }
+
+    const FieldInfo &parseField() {
+        skipSpace();
+        size_t start = pos_;
+        while (pos_ < input_.size() && (std::isalpha(static_cast<unsigned char>(input_[pos_])) || input_[pos_] == '_')) ++pos_;
+        auto name = input_.substr(start, pos_ - start);
+        for (const auto &info : kFields) {
+            if (info.name == name) return info;
+        }
+        pos_ = start;
+        fail(name.empty() ? "expected field" : fmt::format("unknown field '{}'", name));
+    }
+
+    Compare parseCompare() {
+        // 长的运算符先匹配
+        static constexpr std::pair<std::string_view, Compare> kOperators[] = {
+            {"==", Compare::Eq}, {"!=", Compare::Ne}, {"<=", Compare::Le}, {">=", Compare::Ge},
+            {"!~", Compare::NotMatch}, {"<", Compare::Lt}, {">", Compare::Gt}, {"~", Compare::Match},
+        };
+        for (const auto &[token, compare] : kOperators) {
+            if (accept(token)) return compare;
+        }
+        fail("expected comparison operator");
+    }
+
+    // 数值，可带K/M/G/T后缀（1024进制），后面可再跟B；cpu可写作5%
+    double parseNumber() {
+        skipSpace();
+        const char *begin = input_.data() + pos_;
+        const char *end = input_.data() + input_.size();
+        double value = 0;
+        auto [next, ec] = std::from_chars(begin, end, value);
+        if (ec != std::errc()) fail("expected number");
+        pos_ += next - begin;
+        if (pos_ < input_.size()) {
+            switch (std::toupper(static_cast<unsigned char>(input_[pos_]))) {
+                case 'K': value *= 1024.0; ++pos_; break;
+                case 'M': value *= 1024.0 * 1024; ++pos_; break;
+                case 'G': value *= 1024.0 * 1024 * 1024; ++pos_; break;
+                case 'T': value *= 1024.0 * 1024 * 1024 * 1024; ++pos_; break;
+            }
+        }
+        if (pos_ < input_.size() && (input_[pos_] == 'B' || input_[pos_] == 'b' || input_[pos_] == '%')) ++pos_;
+        return value;
+    }
+
+    // 只有\"是转义，其余反斜杠原样保留，正则可以直接写成"java\.exe"
+    std::string parseString() {
+        skipSpace();
+        if (pos_ >= input_.size() || input_[pos_] != '"') fail("expected string");
+        std::string value;
+        for (++pos_; pos_ < input_.size() && input_[pos_] != '"'; ++pos_) {
+            if (input_.substr(pos_, 2) == "\\\"") ++pos_;
+            value.push_back(input_[pos_]);
+        }
+        if (pos_ >= input_.size()) fail("unterminated string");
+        ++pos_;
+        return value;
+    }
+
+    uint32_t addClassifier(const std::string &pattern) {
+        classifiers_.push_back(std::make_unique<ProcessClassifier>(std::vector<std::string>{pattern}));
+        return static_cast<uint32_t>(classifiers_.size() - 1);
+    }
+
+    // comparison := field op value
+    void parseComparison() {
+        const auto &info = parseField();
+        Compare compare = parseCompare();
+        bool match = compare == Compare::Match || compare == Compare::NotMatch;
+        Instruction instruction{Instruction::Op::Number, info.field, compare};
+
+        switch (info.type) {
+            case FieldType::Number:
+                if (match) fail(fmt::format("'{}' is numeric", info.name));
+                instruction.operand = static_cast<uint32_t>(numbers_.size());
+                numbers_.push_back(parseNumber());
+                break;
+            case FieldType::Text: {
+                if (compare != Compare::Eq && compare != Compare::Ne && !match) fail(fmt::format("'{}' is a string", info.name));
+                instruction.op = Instruction::Op::Text;
+                auto value = parseString();
+                if (match) {
+                    instruction.operand = addClassifier(value);
+                } else {
+                    instruction.operand = static_cast<uint32_t>(texts_.size());
+                    texts_.push_back(std::move(value));
+                }
+                break;
+            }
+            case FieldType::Command: {
+                if (compare != Compare::Eq && compare != Compare::Ne && !match) fail("'cmd' is a string");
+                instruction.op = Instruction::Op::Command;
+                auto value = parseString();
+                if (!match) {
+                    // 命令行只按规则缓存匹配结果，相等比较转换为锚定的正则
+                    value = "^" + escapeRegex(value) + "$";
+                    instruction.compare = compare == Compare::Eq ? Compare::Match : Compare::NotMatch;
+                }
+                instruction.operand = addClassifier(value);
+                if (classifiers_.size() > kMaxCommandPatterns) fail("too many patterns");
+                break;
+            }
+        }
+        emit(instruction);
+        push();
+    }
+
+    static bool compareNumber(double value, Compare compare, double operand) {
+        switch (compare) {
+            case Compare::Eq: return value == operand;
+            case Compare::Ne: return value != operand;
+            case Compare::Lt: return value < operand;
+            case Compare::Le: return value <= operand;
+            case Compare::Gt: return value > operand;
+            case Compare::Ge: return value >= operand;
+            default: return false;
+        }
+    }
+};
+
+ProcessFilter::ProcessFilter(std::string_view expression)
+    : impl_(new Impl) {
+    impl_->expression_ = expression;
+    impl_->input_ = impl_->expression_;
+    impl_->parseOr();
+    impl_->skipSpace();
+    if (impl_->pos_ != impl_->input_.size()) impl_->fail("unexpected input");
+}
+
+ProcessFilter::~ProcessFilter() {
+}
+
+ProcessFilter::Result ProcessFilter::evaluate(FilterSource &source) {
+    std::array<Result, Impl::kMaxStack> stack;
+    size_t top = 0;
+    const auto &program = impl_->program_;
+    for (size_t pc = 0; pc < program.size(); ++pc) {
+        const auto &instruction = program[pc];
+        switch (instruction.op) {
+            case Instruction::Op::Number: {
+                auto value = source.number(instruction.field);
+                stack[top++] = value
+                    ? fromBool(Impl::compareNumber(*value, instruction.compare, impl_->numbers_[instruction.operand]))
+                    : Result::Unknown;
+                break;
+            }
+            case Instruction::Op::Text: {
+                auto value = source.text(instruction.field);
+                Result result = Result::Unknown;
+                if (value) {
+                    switch (instruction.compare) {
+                        case Compare::Eq: result = fromBool(*value == impl_->texts_[instruction.operand]); break;
+                        case Compare::Ne: result = fromBool(*value != impl_->texts_[instruction.operand]); break;
+                        case Compare::Match: result = fromBool(impl_->classifiers_[instruction.operand]->classify(*value) >= 0); break;
+                        case Compare::NotMatch: result = fromBool(impl_->classifiers_[instruction.operand]->classify(*value) < 0); break;
+                        default: break;
+                    }
+                }
+                stack[top++] = result;
+                break;
+            }
+            case Instruction::Op::Command: {
+                auto matched = source.commandMatches(instruction.operand);
+                stack[top++] = matched ? fromBool(*matched == (instruction.compare == Compare::Match)) : Result::Unknown;
+                break;
+            }
+            case Instruction::Op::Not:
+                if (stack[top - 1] != Result::Unknown) stack[top - 1] = fromBool(stack[top - 1] == Result::False);
+                break;
+            case Instruction::Op::And:
+                --top;
+                stack[top - 1] = logicalAnd(stack[top - 1], stack[top]);
+                break;
+            case Instruction::Op::Or:
+                --top;
+                stack[top - 1] = logicalOr(stack[top - 1], stack[top]);
+                break;
+            case Instruction::Op::JumpIfFalse:
+                if (stack[top - 1] == Result::False) pc = instruction.operand - 1;
+                break;
+            case Instruction::Op::JumpIfTrue:
+                if (stack[top - 1] == Result::True) pc = instruction.operand - 1;
+                break;
+        }
+    }
+    return top > 0 ? stack[top - 1] : Result::True;
+}
+
+bool ProcessFilter::matchCommand(size_t index, std::string_view cmdline) {
+    return impl_->classifiers_[index]->classify(cmdline) >= 0;
+}
+
+const std::string &ProcessFilter::expression() const {
+    return impl_->expression_;
+}
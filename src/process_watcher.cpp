@@ -0,0 +1,226 @@
+#include "process_watcher.h"
+#include "procfs.h"
+#include "process_classifier.h"
+#include <spdlog/spdlog.h>
+#include <unistd.h>
+#include <optional>
+#include <algorithm>
+
+struct ProcessWatcher::Impl {
+    struct Target {
+        int pid_;
+        uint64_t startTime_ = 0;
+        std::string cmdline_;
+        int statFd_ = -1;       // stat中已有rss，不需要再读statm
+        int ioFd_ = -1;
+        bool hasIo_ = false;
+        bool exited_ = false;
+
+        // 上一次读取的计数
+        bool hasPrev_ = false;
+        uint64_t totalTime_ = 0;    // 进程的utime + stime
+        uint64_t cpuTime_ = 0;      // /proc/stat中的CPU总时间
+        uint64_t readIo_ = 0;
+        uint64_t writeIo_ = 0;
+        std::chrono::steady_clock::time_point time_;
+
+        std::vector<WatchPoint> points_;
+    };
+
+    std::string procRoot_;
+    std::function<std::chrono::steady_clock::time_point()> clock_;
+    std::unique_ptr<ProcessClassifier> classifier_;    // 为空时不按patterns查找
+    std::chrono::milliseconds rescanInterval_;
+    std::optional<std::chrono::steady_clock::time_point> lastRescan_;
+    std::vector<int> knownPids_;    // 上次查找时已检查过的进程，按pid排序
+    std::vector<int> pids_;
+
+    int procStatFd_ = -1;
+    std::vector<Target> targets_;
+    std::string buffer_;
+
+    ~Impl() {
+        for (auto &target : targets_) closeTarget(target);
+        procfs::closeFile(procStatFd_);
+    }
+
+    std::chrono::steady_clock::time_point now() const {
+        return clock_ ? clock_() : std::chrono::steady_clock::now();
+    }
+
+    std::string path(int pid, const char *name) const {
+        return fmt::format("{}/{}/{}", procRoot_, pid, name);
+    }
+
+    static void closeTarget(Target &target) {
+        procfs::closeFile(target.statFd_);
+        procfs::closeFile(target.ioFd_);
+        target.statFd_ = target.ioFd_ = -1;
+    }
+
+    bool watching(int pid) const {
+        return std::any_of(targets_.begin(), targets_.end(), [pid](const Target &t) {
+            return t.pid_ == pid && !t.exited_;
+        });
+    }
+
+    // 打开进程的文件并记录启动时间，进程不存在时返回false
+    bool addTarget(int pid) {
+        Target target;
+        target.pid_ = pid;
+        target.statFd_ = procfs::openFile(path(pid, "stat").c_str());
+        if (target.statFd_ < 0) return false;
+
+        procfs::ProcStat stat;
+        if (!procfs::readAt(target.statFd_, buffer_) || !procfs::parseProcStat(buffer_, stat)) {
+            closeTarget(target);
+            return false;
+        }
+        target.startTime_ = stat.startTime;
+        std::string comm(stat.comm);
+
+        target.ioFd_ = procfs::openFile(path(pid, "io").c_str());
+
+        // 与ResourceMonitor一致只显示程序路径，内核线程没有cmdline时显示comm
+        if (procfs::readFile(path(pid, "cmdline").c_str(), buffer_)) target.cmdline_ = buffer_.c_str();
+        if (target.cmdline_.empty()) target.cmdline_ = "[" + comm + "]";
+        targets_.push_back(std::move(target));
+        return true;
+    }
+
+    // 完整命令行（参数以空格分隔）或comm与任一pattern匹配
+    bool matches(int pid) {
+        if (!procfs::readFile(path(pid, "cmdline").c_str(), buffer_)) return false;
+        while (!buffer_.empty() && buffer_.back() == '\0') buffer_.pop_back();
+        std::replace(buffer_.begin(), buffer_.end(), '\0', ' ');
+        std::string cmdline = std::move(buffer_);
+
+        std::string comm;
+        procfs::ProcStat stat;
+        if (procfs::readFile(path(pid, "stat").c_str(), buffer_) && procfs::parseProcStat(buffer_, stat)) {
+            comm = stat.comm;
+        }
+
+        return classifier_->classify(cmdline, comm) >= 0;
+    }
+
+    // 只检查上次查找之后新出现的进程，开销与新进程数成正比
+    void rescan() {
+        pids_.clear();
+        procfs::listPids(procRoot_.c_str(), pids_);
+        std::sort(pids_.begin(), pids_.end());
+        for (int pid : pids_) {
+            if (std::binary_search(knownPids_.begin(), knownPids_.end(), pid)) continue;
+            if (watching(pid) || !matches(pid)) continue;
+            if (addTarget(pid)) {
+                SPDLOG_INFO("watch: [{}]{}", pid, targets_.back().cmdline_);
+            }
+        }
+        std::swap(knownPids_, pids_);
+    }
+};
+
+ProcessWatcher::ProcessWatcher(WatchOptions options, MonitorEnvironment environment)
+    : impl_(new Impl) {
+    impl_->procRoot_ = environment.procRoot;
+    impl_->clock_ = std::move(environment.clock);
+    impl_->rescanInterval_ = options.rescanInterval;
+    if (!options.patterns.empty()) impl_->classifier_ = std::make_unique<ProcessClassifier>(options.patterns);
+
+    impl_->procStatFd_ = procfs::openFile((impl_->procRoot_ + "/stat").c_str());
+    for (int pid : options.pids) {
+        if (impl_->watching(pid)) continue;
+        if (!impl_->addTarget(pid)) {
+            SPDLOG_WARN("watch: pid {} not found", pid);
+        }
+    }
+    if (impl_->classifier_) {
+        impl_->lastRescan_ = impl_->now();
+        impl_->rescan();
+    }
+}
+
+ProcessWatcher::~ProcessWatcher() {
+}
+
+void ProcessWatcher::sample() {
+    static const uint64_t pageSize = sysconf(_SC_PAGESIZE);
+    auto now = impl_->now();
+    auto wallTime = std::chrono::system_clock::now();
+
+    uint64_t cpuTime = 0;
+    procfs::CpuTimes cpuTimes;
+    if (impl_->procStatFd_ >= 0 && procfs::readAt(impl_->procStatFd_, impl_->buffer_)
+        && procfs::parseCpuTimes(impl_->buffer_, cpuTimes)) {
+        cpuTime = cpuTimes.total();
+    }
+
+    procfs::ProcStat stat;
+    procfs::ProcIo io;
+    for (auto &target : impl_->targets_) {
+        if (target.exited_) continue;
+
+        // 进程退出后读取返回ESRCH；僵尸进程不再运行，同样视为退出
+        if (!procfs::readAt(target.statFd_, impl_->buffer_) || !procfs::parseProcStat(impl_->buffer_, stat)
+            || stat.state == 'Z') {
+            target.exited_ = true;
+            Impl::closeTarget(target);
+            continue;
+        }
+        uint64_t totalTime = stat.utime + stat.stime;
+
+        io = {};
+        target.hasIo_ = target.ioFd_ >= 0 && procfs::readAt(target.ioFd_, impl_->buffer_)
+            && procfs::parseProcIo(impl_->buffer_, io);
+
+        if (target.hasPrev_) {
+            WatchPoint point;
+            point.time = wallTime;
+            point.rssBytes = stat.rssPages * pageSize;
+            if (cpuTime > target.cpuTime_ && totalTime >= target.totalTime_) {
+                point.cpuPercent = 100.0 * (totalTime - target.totalTime_) / (cpuTime - target.cpuTime_);
+            }
+            double elapsed = std::chrono::duration<double>(now - target.time_).count();
+            if (target.hasIo_ && elapsed > 0) {
+                point.readBytesPerSec = (io.readBytes - target.readIo_) / elapsed;
+                point.writeBytesPerSec = (io.writeBytes - target.writeIo_) / elapsed;
+            }
+            target.points_.push_back(point);
+        }
+
+        target.hasPrev_ = true;
+        target.totalTime_ = totalTime;
+        target.cpuTime_ = cpuTime;
+        target.readIo_ = io.readBytes;
+        target.writeIo_ = io.writeBytes;
+        target.time_ = now;
+    }
+
+    if (impl_->classifier_ && now - *impl_->lastRescan_ >= impl_->rescanInterval_) {
+        impl_->lastRescan_ = now;
+        impl_->rescan();
+    }
+}
+
+std::vector<WatchedProcess> ProcessWatcher::collect() {
+    std::vector<WatchedProcess> result;
+    result.reserve(impl_->targets_.size());
+    for (auto &target : impl_->targets_) {
+        WatchedProcess process;
+        process.pid = target.pid_;
+        process.cmdline = target.cmdline_;
+        process.hasIo = target.hasIo_;
+        process.exited = target.exited_;
+        process.points = std::move(target.points_);
+        target.points_.clear();
+        result.emplace_back(std::move(process));
+    }
+    std::erase_if(impl_->targets_, [](const Impl::Target &t) { return t.exited_; });
+    return result;
+}
+
+size_t ProcessWatcher::size() const {
+    return std::count_if(impl_->targets_.begin(), impl_->targets_.end(), [](const Impl::Target &t) {
+        return !t.exited_;
+    });
+}
@@ -0,0 +1,363 @@
+#include "procfs.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <cerrno>
+#include <charconv>
+#include <array>
+#include <cstring>
+
+uint64_t MemInfo::used() const {
+    if (hasAvailable) return available < total ? total - available : 0;
+    uint64_t reclaimable = free + buffers + cached + sReclaimable;
+    return reclaimable < total ? total - reclaimable : 0;
+}
+
+namespace procfs {
+
+IoCounters &ioCounters() {
+    thread_local IoCounters counters;
+    return counters;
+}
+
+bool readFile(const char *path, std::string &out) {
+    auto &counters = ioCounters();
+    ++counters.opens;
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    out.clear();
+    size_t size = 0;
+    for (;;) {
+        if (out.size() - size < 4096) out.resize(size + 4096);
+        ssize_t n = ::read(fd, out.data() + size, out.size() - size);
+        ++counters.reads;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ++counters.closes;
+            ::close(fd);
+            return false;
+        }
+        if (n == 0) break;
+        size += n;
+    }
+    ++counters.closes;
+    ::close(fd);
+    counters.bytesRead += size;
+    out.resize(size);
+    return true;
+}
+
+int openFile(const char *path) {
+    ++ioCounters().opens;
+    return ::open(path, O_RDONLY | O_CLOEXEC);
+}
+
+void closeFile(int fd) {
+    if (fd < 0) return;
+    ++ioCounters().closes;
+    ::close(fd);
+}
+
+bool readAt(int fd, std::string &out) {
+    auto &counters = ioCounters();
+    out.clear();
+    size_t size = 0;
+    for (;;) {
+        if (out.size() - size < 4096) out.resize(size + 4096);
+        ssize_t n = ::pread(fd, out.data() + size, out.size() - size, size);
+        ++counters.reads;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (n == 0) break;
+        size += n;
+    }
+    counters.bytesRead += size;
+    out.resize(size);
+    return true;
+}
+
+namespace {
+
+// 用getdents64遍历目录，缓冲区按线程复用，避免opendir每次分配DIR
+template<typename F>
+bool forEachDirEntry(const char *path, F &&func) {
+    auto &counters = ioCounters();
+    ++counters.opens;
+    int fd = ::open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    alignas(struct dirent64) static thread_local char buffer[16384];
+    for (;;) {
+        ssize_t n = ::getdents64(fd, buffer, sizeof(buffer));
+        ++counters.reads;
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        for (ssize_t offset = 0; offset < n;) {
+            auto *entry = reinterpret_cast<struct dirent64 *>(buffer + offset);
+            offset += entry->d_reclen;
+            func(static_cast<const char *>(entry->d_name));
+        }
+    }
+    ++counters.closes;
+    ::close(fd);
+    return true;
+}
+
+}
+
+bool listPids(const char *procRoot, std::vector<int> &pids) {
+    return forEachDirEntry(procRoot, [&](const char *name) {
+        if (*name < '1' || *name > '9') return;
+        int pid = 0;
+        auto [end, ec] = std::from_chars(name, name + strlen(name), pid);
+        if (ec == std::errc() && *end == '\0') pids.push_back(pid);
+    });
+}
+
+bool listDir(const char *dir, std::pmr::vector<std::pmr::string> &names) {
+    return forEachDirEntry(dir, [&](const char *name) {
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) return;
+        names.emplace_back(name);
+    });
+}
+
+namespace {
+
+// 跳过空白后解析一个整数，失败时返回nullptr
+template<typename T>
+const char *parseNumber(const char *p, const char *end, T &value) {
+    while (p < end && (*p == ' ' || *p == '\t')) ++p;
+    auto [next, ec] = std::from_chars(p, end, value);
+    return ec == std::errc() ? next : nullptr;
+}
+
+}
+
+bool parseCpuTimes(std::string_view text, CpuTimes &times) {
+    if (text.substr(0, 4) != "cpu ") return false;
+    const char *p = text.data() + 3;
+    const char *end = text.data() + text.size();
+    uint64_t *fields[] = {&times.user, &times.nice, &times.system, &times.idle,
+                          &times.iowait, &times.irq, &times.softirq, &times.steal};
+    for (size_t i = 0; i < std::size(fields); ++i) {
+        p = parseNumber(p, end, *fields[i]);
+        if (!p) return i >= 4;  // 很老的内核只有前4项
+    }
+    return true;
+}
+
+void parseDiskstats(std::string_view text, std::vector<DiskstatsEntry> &entries) {
+    const char *p = text.data();
+    const char *end = p + text.size();
+    while (p < end) {
+        const char *lineEnd = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (!lineEnd) lineEnd = end;
+
+        DiskstatsEntry entry;
+        const char *q = parseNumber(p, lineEnd, entry.major);
+        if (q) q = parseNumber(q, lineEnd, entry.minor);
+        if (q) {
+            while (q < lineEnd && *q == ' ') ++q;
+            const char *nameEnd = q;
+            while (nameEnd < lineEnd && *nameEnd != ' ') ++nameEnd;
+            entry.name = std::string_view(q, nameEnd - q);
+            q = nameEnd;
+
+            uint64_t *fields[] = {&entry.reads, &entry.readMerges, &entry.readSectors, &entry.readTicks,
+                                  &entry.writes, &entry.writeMerges, &entry.writeSectors, &entry.writeTicks,
+                                  &entry.inFlight, &entry.ioTimeMs, &entry.weightedIoTimeMs};
+            for (auto *field : fields) {
+                if (!q) break;
+                q = parseNumber(q, lineEnd, *field);
+            }
+            if (q) entries.push_back(entry);
+        }
+        p = lineEnd + 1;
+    }
+}
+
+bool parseProcStat(std::string_view text, ProcStat &stat) {
+    auto open = text.find('(');
+    auto close = text.rfind(')');
+    if (open == std::string_view::npos || close == std::string_view::npos || close < open) return false;
+
+    const char *end = text.data() + text.size();
+    if (!parseNumber(text.data(), text.data() + open, stat.pid)) return false;
+    stat.comm = text.substr(open + 1, close - open - 1);
+
+    const char *p = text.data() + close + 1;
+    while (p < end && *p == ' ') ++p;
+    if (p >= end) return false;
+    stat.state = *p++;
+
+    // 第4到24个字段：ppid pgrp session tty_nr tpgid flags minflt cminflt majflt cmajflt
+    // utime stime cutime cstime priority nice num_threads itrealvalue starttime vsize rss
+    int64_t fields[21];
+    for (auto &field : fields) {
+        p = parseNumber(p, end, field);
+        if (!p) return false;
+    }
+    stat.ppid = static_cast<int>(fields[0]);
+    stat.pgrp = static_cast<int>(fields[1]);
+    stat.session = static_cast<int>(fields[2]);
+    stat.utime = fields[10];
+    stat.stime = fields[11];
+    stat.cutime = fields[12];
+    stat.cstime = fields[13];
+    stat.numThreads = fields[16];
+    stat.startTime = fields[18];
+    stat.vsize = fields[19];
+    stat.rssPages = fields[20];
+    return true;
+}
+
+bool parseStatusUid(std::string_view text, uint32_t &uid) {
+    // Uid:	real	effective	saved	fs
+    auto pos = text.find("\nUid:");
+    if (pos == std::string_view::npos) return false;
+    const char *end = text.data() + text.size();
+    const char *p = parseNumber(text.data() + pos + 5, end, uid);
+    if (p) p = parseNumber(p, end, uid);
+    return p != nullptr;
+}
+
+bool parseStatm(std::string_view text, ProcStatm &statm) {
+    const char *p = text.data();
+    const char *end = p + text.size();
+    p = parseNumber(p, end, statm.size);
+    if (p) p = parseNumber(p, end, statm.resident);
+    if (p) p = parseNumber(p, end, statm.shared);
+    return p != nullptr;
+}
+
+bool parseProcIo(std::string_view text, ProcIo &io) {
+    const char *p = text.data();
+    const char *end = p + text.size();
+    bool found = false;
+    while (p < end) {
+        const char *lineEnd = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (!lineEnd) lineEnd = end;
+        const char *colon = static_cast<const char *>(memchr(p, ':', lineEnd - p));
+        if (colon) {
+            std::string_view key(p, colon - p);
+            uint64_t *field = nullptr;
+            if (key == "read_bytes") field = &io.readBytes;
+            else if (key == "write_bytes") field = &io.writeBytes;
+            else if (key == "rchar") field = &io.rchar;
+            else if (key == "wchar") field = &io.wchar;
+            if (field && parseNumber(colon + 1, lineEnd, *field)) found = true;
+        }
+        p = lineEnd + 1;
+    }
+    return found;
+}
+
+namespace {
+
+struct MemInfoKey {
+    std::string_view name;
+    uint64_t MemInfo::*field;
+    bool kb;    // 带kB单位；HugePages_*是页数
+};
+
+constexpr MemInfoKey kMemInfoKeys[] = {
+    {"MemTotal", &MemInfo::total, true},
+    {"MemFree", &MemInfo::free, true},
+    {"MemAvailable", &MemInfo::available, true},
+    {"Buffers", &MemInfo::buffers, true},
+    {"Cached", &MemInfo::cached, true},
+    {"SwapCached", &MemInfo::swapCached, true},
+    {"Active", &MemInfo::active, true},
+    {"Inactive", &MemInfo::inactive, true},
+    {"Shmem", &MemInfo::shmem, true},
+    {"Slab", &MemInfo::slab, true},
+    {"SReclaimable", &MemInfo::sReclaimable, true},
+    {"SUnreclaim", &MemInfo::sUnreclaim, true},
+    {"Dirty", &MemInfo::dirty, true},
+    {"Writeback", &MemInfo::writeback, true},
+    {"AnonPages", &MemInfo::anonPages, true},
+    {"Mapped", &MemInfo::mapped, true},
+    {"SwapTotal", &MemInfo::swapTotal, true},
+    {"SwapFree", &MemInfo::swapFree, true},
+    {"HugePages_Total", &MemInfo::hugePagesTotal, false},
+    {"HugePages_Free", &MemInfo::hugePagesFree, false},
+    {"Hugepagesize", &MemInfo::hugePageSize, true},
+    {"Hugetlb", &MemInfo::hugetlb, true},
+};
+
+// 完美哈希：编译期搜索一个种子，使所有已知键落在互不冲突的槽位上。
+// 运行时每行只需计算一次哈希和一次字符串比较，未知键比较失败即跳过。
+constexpr size_t kMemInfoSlots = 64;
+
+constexpr uint32_t memInfoHash(std::string_view key, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (char c : key) h = (h ^ static_cast<uint8_t>(c)) * 16777619u;
+    // FNV的低位只取决于输入的低位，取模前先做一次混合
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    return h;
+}
+
+constexpr bool memInfoSeedIsPerfect(uint32_t seed) {
+    std::array<bool, kMemInfoSlots> used{};
+    for (const auto &key : kMemInfoKeys) {
+        auto slot = memInfoHash(key.name, seed) % kMemInfoSlots;
+        if (used[slot]) return false;
+        used[slot] = true;
+    }
+    return true;
+}
+
+constexpr uint32_t findMemInfoSeed() {
+    for (uint32_t seed = 0; seed < 100000; ++seed) {
+        if (memInfoSeedIsPerfect(seed)) return seed;
+    }
+    return UINT32_MAX;
+}
+
+constexpr uint32_t kMemInfoSeed = findMemInfoSeed();
+static_assert(kMemInfoSeed != UINT32_MAX, "no perfect hash seed for meminfo keys");
+
+// 槽位 -> kMemInfoKeys下标，-1表示空槽
+constexpr std::array<int8_t, kMemInfoSlots> kMemInfoTable = [] {
+    std::array<int8_t, kMemInfoSlots> table{};
+    for (auto &slot : table) slot = -1;
+    for (size_t i = 0; i < std::size(kMemInfoKeys); ++i) {
+        table[memInfoHash(kMemInfoKeys[i].name, kMemInfoSeed) % kMemInfoSlots] = static_cast<int8_t>(i);
+    }
+    return table;
+}();
+
+}
+
+void parseMeminfo(std::string_view text, MemInfo &info) {
+    const char *p = text.data();
+    const char *end = p + text.size();
+
+    while (p < end) {
+        const char *lineEnd = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (!lineEnd) lineEnd = end;
+
+        const char *colon = static_cast<const char *>(memchr(p, ':', lineEnd - p));
+        if (colon) {
+            std::string_view key(p, colon - p);
+            int8_t index = kMemInfoTable[memInfoHash(key, kMemInfoSeed) % kMemInfoSlots];
+            if (index >= 0 && kMemInfoKeys[index].name == key) {
+                const char *v = colon + 1;
+                while (v < lineEnd && *v == ' ') ++v;
+                uint64_t value = 0;
+                std::from_chars(v, lineEnd, value);
+                const auto &slot = kMemInfoKeys[index];
+                info.*slot.field = slot.kb ? value * 1024 : value;
+                if (slot.field == &MemInfo::available) info.hasAvailable = true;
+            }
+        }
+        p = lineEnd + 1;
+    }
+}
+
+}
@@ -0,0 +1,362 @@
+#include "query_server.h"
+#include "top_k.h"
+#include <spdlog/spdlog.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <stdexcept>
+
+namespace {
+
+bool writeAll(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool readAll(int fd, char *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::recv(fd, data, size, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+sockaddr_un socketAddress(const std::string &path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) throw std::runtime_error("socket path too long: " + path);
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+int64_t toMs(std::chrono::system_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+}
+
+template <size_t N>
+void copyName(char (&out)[N], std::string_view name) {
+    auto size = std::min(name.size(), N - 1);
+    std::memcpy(out, name.data(), size);
+    out[size] = '\0';
+}
+
+const ProcessEntry *findEntry(const std::vector<ProcessEntry> &table, int pid) {
+    auto it = std::lower_bound(table.begin(), table.end(), pid,
+        [](const ProcessEntry &entry, int pid) { return entry.pid < pid; });
+    return it != table.end() && it->pid == pid ? &*it : nullptr;
+}
+
+// top-N中的进程有完整命令行，其余只有comm
+void fillProcess(query::ProcessRecord &record, const ProcessEntry &entry, const Snapshot &snapshot) {
+    record.pid = entry.pid;
+    record.cpuPercent = entry.cpuPercent;
+    record.rssBytes = entry.rssBytes;
+    record.readBytesPerSec = entry.readBytesPerSec;
+    record.writeBytesPerSec = entry.writeBytesPerSec;
+    for (const auto *list : {&snapshot.topCpu, &snapshot.topMem, &snapshot.topDisk}) {
+        for (const auto &process : *list) {
+            if (process.pid == entry.pid && !process.cmdline.empty()) return copyName(record.command, process.cmdline);
+        }
+    }
+    copyName(record.command, entry.comm.data());
+}
+
+}
+
+struct QueryServer::Impl {
+    std::string path_;
+    int listenFd_ = -1;
+    int wakeFd_ = -1;       // eventfd，用于通知服务线程退出
+    std::thread thread_;
+    std::thread historyThread_;
+    QueryHandler handler_;
+
+    // 最近的快照，history_[head_]最旧；只在持锁时增删，服务线程处理请求前拷贝一份指针
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<const PublishedSnapshot>> history_;
+    size_t head_ = 0;
+    size_t capacity_ = 0;
+
+    // 以下只在服务线程中使用，容量复用
+    std::vector<std::shared_ptr<const PublishedSnapshot>> view_;    // 从旧到新
+    std::vector<const ProcessEntry *> candidates_;
+    std::vector<char> response_;
+
+    void listen(const std::string &path);
+    void record(const SnapshotChannel &channel);
+    void serve();
+    void handleClient(int fd);
+    // 从快照历史回答查询
+    query::Status answerHistory(const query::Request &request, query::ResponseHeader &header);
+    query::Status answer(const query::Request &request, query::ResponseHeader &header);
+
+    template <typename T>
+    T &append() {
+        return appendRecord<T>(response_);
+    }
+};
+
+QueryServer::QueryServer()
+    : impl_(new Impl) {
+}
+
+QueryServer::~QueryServer() {
+    stop();
+}
+
+void QueryServer::start(const std::string &path, const SnapshotChannel &channel, size_t history) {
+    impl_->listen(path);
+    impl_->capacity_ = std::max<size_t>(history, 1);
+    impl_->history_.clear();
+    impl_->head_ = 0;
+    impl_->handler_ = [this](const query::Request &request, query::ResponseHeader &header, std::vector<char> &) {
+        return impl_->answerHistory(request, header);
+    };
+    impl_->thread_ = std::thread([this] { impl_->serve(); });
+    impl_->historyThread_ = std::thread([this, &channel] { impl_->record(channel); });
+}
+
+void QueryServer::start(const std::string &path, QueryHandler handler) {
+    impl_->listen(path);
+    impl_->handler_ = std::move(handler);
+    impl_->thread_ = std::thread([this] { impl_->serve(); });
+}
+
+void QueryServer::Impl::listen(const std::string &path) {
+    auto address = socketAddress(path);
+    struct stat st;
+    if (::lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) ::unlink(path.c_str());
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || ::listen(fd, 16) < 0) {
+        int err = errno;
+        if (fd >= 0) ::close(fd);
+        throw std::runtime_error(fmt::format("listen {}: {}", path, strerror(err)));
+    }
+    path_ = path;
+    listenFd_ = fd;
+    wakeFd_ = ::eventfd(0, EFD_CLOEXEC);
+}
+
+void QueryServer::stop() {
+    if (!impl_->thread_.joinable()) return;
+    uint64_t one = 1;
+    (void)!::write(impl_->wakeFd_, &one, sizeof(one));
+    impl_->thread_.join();
+    if (impl_->historyThread_.joinable()) impl_->historyThread_.join();
+    ::close(impl_->listenFd_);
+    ::close(impl_->wakeFd_);
+    ::unlink(impl_->path_.c_str());
+    impl_->listenFd_ = impl_->wakeFd_ = -1;
+}
+
+void QueryServer::Impl::record(const SnapshotChannel &channel) {
+    SnapshotReader reader(channel);
+    while (auto published = reader.next()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (history_.size() < capacity_) {
+            history_.push_back(std::move(published));
+        } else {
+            history_[head_] = std::move(published);
+            head_ = (head_ + 1) % capacity_;
+        }
+    }
+}
+
+void QueryServer::Impl::serve() {
+    pollfd fds[2] = {{listenFd_, POLLIN, 0}, {wakeFd_, POLLIN, 0}};
+    for (;;) {
+        int n = ::poll(fds, 2, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            SPDLOG_ERROR("query server poll: {}", strerror(errno));
+            return;
+        }
+        if (fds[1].revents) return;
+        if (!(fds[0].revents & POLLIN)) continue;
+
+        int client = ::accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) continue;
+        handleClient(client);
+        ::close(client);
+    }
+}
+
+void QueryServer::Impl::handleClient(int fd) {
+    // 慢客户端最多占用服务线程1秒
+    timeval timeout{1, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    query::Request request;
+    if (!readAll(fd, reinterpret_cast<char *>(&request), sizeof(request))) return;
+
+    response_.clear();
+    append<query::ResponseHeader>();
+    query::ResponseHeader header;
+    header.type = request.type;
+    header.status = request.magic == query::kMagic ? handler_(request, header, response_) : query::Status::BadRequest;
+    if (header.status != query::Status::Ok) {
+        response_.resize(sizeof(header));
+        header.count = header.recordSize = 0;
+    }
+    std::memcpy(response_.data(), &header, sizeof(header));
+    writeAll(fd, response_.data(), response_.size());
+}
+
+query::Status QueryServer::Impl::answerHistory(const query::Request &request, query::ResponseHeader &header) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        view_.clear();
+        view_.insert(view_.end(), history_.begin() + head_, history_.end());
+        view_.insert(view_.end(), history_.begin(), history_.begin() + head_);
+    }
+    if (!view_.empty()) {
+        header.timeMs = toMs(view_.back()->snapshot.time);
+        header.generation = view_.back()->generation;
+    }
+    auto status = answer(request, header);
+    view_.clear();  // 不延长快照的生命周期
+    return status;
+}
+
+query::Status QueryServer::Impl::answer(const query::Request &request, query::ResponseHeader &header) {
+    if (view_.empty()) return query::Status::NoData;
+    const auto &latest = view_.back()->snapshot;
+
+    switch (request.type) {
+        case query::Type::Top: {
+            if (!latest.processes) return query::Status::NoData;
+            candidates_.clear();
+            for (const auto &entry : *latest.processes) candidates_.push_back(&entry);
+            size_t n = request.count ? request.count : candidates_.size();
+            switch (request.sortKey) {
+                case query::SortKey::Cpu:
+                    selectTopK(candidates_, n, [](const ProcessEntry *e) { return e->cpuPercent; });
+                    break;
+                case query::SortKey::Mem:
+                    selectTopK(candidates_, n, [](const ProcessEntry *e) { return e->rssBytes; });
+                    break;
+                case query::SortKey::Disk:
+                    selectTopK(candidates_, n, [](const ProcessEntry *e) { return e->readBytesPerSec + e->writeBytesPerSec; });
+                    break;
+                default:
+                    return query::Status::BadRequest;
+            }
+            for (const auto *entry : candidates_) fillProcess(append<query::ProcessRecord>(), *entry, latest);
+            header.count = candidates_.size();
+            header.recordSize = sizeof(query::ProcessRecord);
+            return query::Status::Ok;
+        }
+
+        case query::Type::Process: {
+            // 已退出的进程从它最后出现的快照算起，往前直到pid被复用或进程不在表中
+            auto find = [&](size_t i) {
+                const auto &table = view_[i]->snapshot.processes;
+                return table ? findEntry(*table, request.pid) : nullptr;
+            };
+            size_t last = view_.size();
+            while (last > 0 && !find(last - 1)) --last;
+            if (last == 0) return query::Status::NotFound;
+            const ProcessEntry *newest = find(last - 1);
+            size_t first = last - 1;
+            size_t limit = request.count ? request.count : view_.size();
+            while (first > 0 && last - first < limit) {
+                const auto *entry = find(first - 1);
+                if (!entry || entry->startTime != newest->startTime) break;
+                --first;
+            }
+
+            fillProcess(append<query::ProcessRecord>(), *newest, view_[last - 1]->snapshot);
+            for (size_t i = first; i < last; ++i) {
+                const auto &snapshot = view_[i]->snapshot;
+                const auto *entry = find(i);
+                auto &point = append<query::SeriesPoint>();
+                point.timeMs = toMs(snapshot.time);
+                point.rssBytes = entry->rssBytes;
+                point.cpuPercent = entry->cpuPercent;
+                point.readBytesPerSec = entry->readBytesPerSec;
+                point.writeBytesPerSec = entry->writeBytesPerSec;
+            }
+            header.count = last - first;
+            header.recordSize = sizeof(query::SeriesPoint);
+            return query::Status::Ok;
+        }
+
+        case query::Type::Disks: {
+            size_t limit = request.count ? request.count : view_.size();
+            size_t first = view_.size() - std::min(limit, view_.size());
+            for (size_t i = first; i < view_.size(); ++i) {
+                const auto &snapshot = view_[i]->snapshot;
+                if (!snapshot.disksReady) continue;     // 首次采样没有速率
+                for (const auto &disk : snapshot.disks) {
+                    auto &record = append<query::DiskRecord>();
+                    record.timeMs = toMs(snapshot.time);
+                    copyName(record.name, disk.name);
+                    record.readBytesPerSec = disk.readBytesPerSec;
+                    record.writeBytesPerSec = disk.writeBytesPerSec;
+                    record.readIops = disk.readIops;
+                    record.writeIops = disk.writeIops;
+                    record.readAwaitMs = disk.readAwaitMs;
+                    record.writeAwaitMs = disk.writeAwaitMs;
+                    record.busyPercent = disk.busyPercent;
+                    record.avgQueueSize = disk.avgQueueSize;
+                    record.inFlight = disk.inFlight;
+                    ++header.count;
+                }
+            }
+            header.recordSize = sizeof(query::DiskRecord);
+            return query::Status::Ok;
+        }
+
+        default:
+            break;
+    }
+    return query::Status::BadRequest;
+}
+
+QueryResponse sendQuery(const std::string &path, const query::Request &request) {
+    auto address = socketAddress(path);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+        int err = errno;
+        if (fd >= 0) ::close(fd);
+        throw std::runtime_error(fmt::format("connect {}: {}", path, strerror(err)));
+    }
+    timeval timeout{5, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    QueryResponse response;
+    bool ok = writeAll(fd, reinterpret_cast<const char *>(&request), sizeof(request))
+        && readAll(fd, reinterpret_cast<char *>(&response.header), sizeof(response.header))
+        && response.header.magic == query::kMagic;
+    if (ok && response.header.status == query::Status::Ok) {
+        if (request.type == query::Type::Process) {
+            ok = readAll(fd, reinterpret_cast<char *>(&response.process), sizeof(response.process));
+        }
+        response.records.resize(size_t(response.header.count) * response.header.recordSize);
+        ok = ok && readAll(fd, response.records.data(), response.records.size());
+    }
+    ::close(fd);
+    if (!ok) throw std::runtime_error(fmt::format("query {}: bad response", path));
+    return response;
+}
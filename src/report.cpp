@@ -0,0 +1,276 @@
+#include "report.h"
+#include <spdlog/spdlog.h>
+#include <sstream>
+#include <iomanip>
+
+std::string valueToHumanReadable(double value) {
+    if (value >= (uint64_t)1024 * 1024 * 1024 * 1024) {
+        return fmt::format("{:.2f} TB", value / 1024.0 / 1024.0 / 1024.0 / 1024.0);
+    }
+    else if (value >= (uint64_t)1024 * 1024 * 1024) {
+        return fmt::format("{:.2f} GB", value / 1024.0 / 1024.0 / 1024.0);
+    }
+    else if (value >= (uint64_t)1024 * 1024) {
+        return fmt::format("{:.2f} MB", value / 1024.0 / 1024.0);
+    }
+    else if (value >= (uint64_t)1024) {
+        return fmt::format("{:.2f} kB", value / 1024.0);
+    }
+    else {
+        return fmt::format("{:.0f}B", value);
+    }
+}
+
+std::string formatCpu(const std::optional<double> &cpuPercent) {
+    if (!cpuPercent) return "CPU: ?";  // 第一次调用无法计算使用率
+    return fmt::format("CPU: {:.2f}%", *cpuPercent);
+}
+
+std::string formatMemory(const MemInfo &info) {
+    if (info.total == 0) return "MEM: ?";
+    
+    // 计算物理内存使用率，口径与free(1)一致
+    uint64_t used = info.used();
+    double memoryUsage = 100.0 * used / info.total;
+
+    std::string memoryUsageString = fmt::format("MEM: {:.2f}% ({} of {}), AVAIL: {}, SLAB: {}, SHMEM: {}, DIRTY: {}, WB: {}",
+        memoryUsage,
+        valueToHumanReadable(used),
+        valueToHumanReadable(info.total),
+        valueToHumanReadable(info.hasAvailable ? info.available : info.total - used),
+        valueToHumanReadable(info.slab),
+        valueToHumanReadable(info.shmem),
+        valueToHumanReadable(info.dirty),
+        valueToHumanReadable(info.writeback));
+
+    // 配置了大页时，大页内存不会计入MemFree/MemAvailable
+    if (info.hugePagesTotal > 0) {
+        memoryUsageString += fmt::format(", HUGEPAGES: {}/{} free ({})",
+            info.hugePagesFree,
+            info.hugePagesTotal,
+            valueToHumanReadable(info.hugePageSize));
+    }
+   
+    // 如果有交换分区，计算交换分区使用率
+    if (info.swapTotal > 0) {
+        uint64_t swapUsed = info.swapUsed();
+        double swapUsage = 100.0 * swapUsed / info.swapTotal;
+        return fmt::format("{}, SWAP: {:.2f}% ({} of {})",
+            memoryUsageString,
+            swapUsage,
+            valueToHumanReadable(swapUsed),
+            valueToHumanReadable(info.swapTotal));
+    }
+    else {
+        return memoryUsageString;
+    }
+}
+
+std::string formatDisks(bool ready, const std::vector<DiskStat> &disks) {
+    if (!ready) return "DISK: ?";
+
+    // 繁忙率高但await低说明是饱和，await高则说明设备本身慢
+    std::string result;
+    for(const auto& disk : disks) {
+        if(!result.empty()) result += ", ";  // 不是第一个磁盘，添加逗号以分隔多磁盘情况
+        result += fmt::format("Disk {}: {:.2f}% R {}/s {:.0f}iops {:.2f}ms W {}/s {:.0f}iops {:.2f}ms QD {:.2f}({})",
+            disk.name,
+            disk.busyPercent,
+            valueToHumanReadable(disk.readBytesPerSec),
+            disk.readIops,
+            disk.readAwaitMs,
+            valueToHumanReadable(disk.writeBytesPerSec),
+            disk.writeIops,
+            disk.writeAwaitMs,
+            disk.avgQueueSize,
+            disk.inFlight);
+    }
+
+    return result;
+}
+
+/// 格式示例：
+/// coretemp
+/// Adapter: ISA adapter
+/// Package id 0:  +46.0°C  (high = +80.0°C, crit = +100.0°C)
+/// Core 0:        +44.0°C  (high = +80.0°C, crit = +100.0°C)
+std::string formatTemperatures(const std::vector<TemperatureReading> &temperatures) {
+    std::ostringstream out;
+
+    for (size_t begin = 0; begin < temperatures.size();)
+    {
+        // 同一hwmon设备的读数是连续的，同名的芯片各自输出
+        size_t end = begin;
+        std::size_t maxLabelLen = 0;
+        while (end < temperatures.size() && temperatures[end].hwmon == temperatures[begin].hwmon) {
+            maxLabelLen = std::max(maxLabelLen, temperatures[end].label.size());
+            ++end;
+        }
+
+        out << temperatures[begin].chip << '\n';
+        out << "Adapter: " << (temperatures[begin].pciAdapter ? "PCI adapter" : "ISA adapter") << '\n';
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            const auto &r = temperatures[i];
+            out << std::left << std::setw(maxLabelLen+2) << r.label << ":  "
+                << std::right << std::showpos << std::fixed << std::setprecision(1)
+                << std::setw(6) << r.celsius << "°C" << std::noshowpos;
+
+            if (r.high || r.crit)
+            {
+                out << "  (";
+                bool first = true;
+                if (r.high) { out << "high = " << std::showpos << *r.high << "°C"; first = false; }
+                if (r.crit) { out << (first?"":" ,") << "crit = " << std::showpos << *r.crit << "°C"; }
+                out << ")";
+            }
+            out << '\n';
+        }
+        out << '\n';                // 空行分隔芯片
+        begin = end;
+    }
+
+    std::string result = out.str();
+    if (result.empty()) result = "No temperature sensors found\n";
+    return result;
+}
+
+std::string formatTopCpu(const ProcessSample &process) {
+    return fmt::format("CPU: {:.2f}%, CMD: [{}]{}", process.cpuPercent, process.pid, process.cmdline);
+}
+
+std::string formatTopMem(const ProcessSample &process, MemRank rank) {
+    const char *label = "MEM";
+    if (process.memIsRss) {
+        label = "RSS";      // 还没读到smaps_rollup，与同一列表中的PSS/USS区分
+        rank = MemRank::Rss;
+    }
+    switch (rank) {
+        case MemRank::Rss: break;
+        case MemRank::Pss: label = "PSS"; break;
+        case MemRank::Uss: label = "USS"; break;
+        case MemRank::Swap: label = "SWAP"; break;
+    }
+    return fmt::format("{}: {}, CMD: [{}]{}", 
+        label, valueToHumanReadable(process.memBytes), process.pid, process.cmdline);
+}
+
+std::string formatTopDisk(const ProcessSample &process) {
+    return fmt::format("DISK: {}/s+{}/s, CMD: [{}]{}",
+        valueToHumanReadable(process.readBytesPerSec),
+        valueToHumanReadable(process.writeBytesPerSec),
+        process.pid,
+        process.cmdline);
+}
+
+std::string_view groupByName(GroupBy groupBy) {
+    switch (groupBy) {
+        case GroupBy::None:    return "none";
+        case GroupBy::Comm:    return "comm";
+        case GroupBy::User:    return "user";
+        case GroupBy::Session: return "session";
+        case GroupBy::Tree:    return "tree";
+        case GroupBy::Pattern: return "pattern";
+    }
+    return "unknown";
+}
+
+// 格式示例：GROUP user=www-data (40 procs)
+static std::string formatGroupName(const ProcessGroup &group, GroupBy groupBy) {
+    return fmt::format("GROUP {}={} ({} procs)", groupByName(groupBy), group.name, group.processes);
+}
+
+std::string formatTopCpuGroup(const ProcessGroup &group, GroupBy groupBy) {
+    return fmt::format("CPU: {:.2f}%, {}", group.cpuPercent, formatGroupName(group, groupBy));
+}
+
+std::string formatTopMemGroup(const ProcessGroup &group, GroupBy groupBy) {
+    return fmt::format("MEM: {}, {}", valueToHumanReadable(group.memBytes), formatGroupName(group, groupBy));
+}
+
+std::string formatTopDiskGroup(const ProcessGroup &group, GroupBy groupBy) {
+    return fmt::format("DISK: {}/s+{}/s, {}",
+        valueToHumanReadable(group.readBytesPerSec),
+        valueToHumanReadable(group.writeBytesPerSec),
+        formatGroupName(group, groupBy));
+}
+
+WatchSummary summarizeWatched(const WatchedProcess &process) {
+    WatchSummary summary;
+    summary.samples = process.points.size();
+    if (process.points.empty()) return summary;
+
+    summary.last = process.points.back();
+    for (const auto &point : process.points) {
+        summary.avgCpuPercent += point.cpuPercent;
+        summary.maxCpuPercent = std::max(summary.maxCpuPercent, point.cpuPercent);
+        summary.maxRssBytes = std::max(summary.maxRssBytes, point.rssBytes);
+        summary.avgReadBytesPerSec += point.readBytesPerSec;
+        summary.avgWriteBytesPerSec += point.writeBytesPerSec;
+    }
+    summary.avgCpuPercent /= summary.samples;
+    summary.avgReadBytesPerSec /= summary.samples;
+    summary.avgWriteBytesPerSec /= summary.samples;
+    return summary;
+}
+
+/// 格式示例：
+/// WATCH: CPU 2.00% (avg 1.50%, max 5.00%), RSS 12.00 MB (max 12.50 MB), DISK 1.00 MB/s+0B/s, 50 samples, CMD: [1234]/usr/sbin/nginx
+std::string formatWatched(const WatchedProcess &process) {
+    auto summary = summarizeWatched(process);
+    std::string result;
+    if (summary.samples == 0) {
+        result = "WATCH: no samples";
+    } else {
+        result = fmt::format("WATCH: CPU {:.2f}% (avg {:.2f}%, max {:.2f}%), RSS {} (max {}), ",
+            summary.last.cpuPercent,
+            summary.avgCpuPercent,
+            summary.maxCpuPercent,
+            valueToHumanReadable(summary.last.rssBytes),
+            valueToHumanReadable(summary.maxRssBytes));
+        if (process.hasIo) {
+            result += fmt::format("DISK {}/s+{}/s, ",
+                valueToHumanReadable(summary.avgReadBytesPerSec),
+                valueToHumanReadable(summary.avgWriteBytesPerSec));
+        } else {
+            result += "DISK ?, ";
+        }
+        result += fmt::format("{} samples", summary.samples);
+    }
+    result += fmt::format(", CMD: [{}]{}", process.pid, process.cmdline);
+    if (process.exited) result += " (exited)";
+    return result;
+}
+
+/// 格式示例：SCAN: 25.0% (310 of 1240 processes), SELF CPU: 1.20% of 1.00% budget
+std::string formatScanCoverage(const ScanCoverage &coverage) {
+    double ratio = coverage.processes ? 100.0 * coverage.scanned / coverage.processes : 100.0;
+    std::string result = fmt::format("SCAN: {:.1f}% ({} of {} processes)", ratio, coverage.scanned, coverage.processes);
+    if (coverage.selfCpuPercent) {
+        result += fmt::format(", SELF CPU: {:.2f}%", *coverage.selfCpuPercent);
+        if (coverage.cpuBudgetPercent > 0) result += fmt::format(" of {:.2f}% budget", coverage.cpuBudgetPercent);
+    }
+    return result;
+}
+
+/// 格式示例（每个采集函数一行）：
+/// SELF top_cpu: p50 3.12ms p99 4.80ms last 3.05ms, calls 360, opens 612, read 98.20 kB, allocs 75
+std::string formatCollectorStats(const CollectorStatsArray &collectors) {
+    std::string result;
+    for (size_t i = 0; i < collectors.size(); ++i) {
+        const auto &stats = collectors[i];
+        if (stats.calls == 0) continue;
+        if (!result.empty()) result += '\n';
+        result += fmt::format("SELF {}: p50 {:.2f}ms p99 {:.2f}ms last {:.2f}ms, calls {}, opens {}, read {}, allocs {}",
+            collectorName(static_cast<Collector>(i)),
+            stats.p50Ms,
+            stats.p99Ms,
+            stats.lastMs,
+            stats.calls,
+            stats.opens,
+            valueToHumanReadable(stats.bytesRead),
+            stats.allocations);
+    }
+    return result;
+}
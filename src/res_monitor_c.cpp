@@ -0,0 +1,173 @@
+#include "res_monitor_c.h"
+#include "monitor_core.h"
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+static_assert(static_cast<int>(MonitorCore::Topic::Processes) == RM_TOPIC_PROCESSES);
+static_assert(static_cast<int>(MemRank::Swap) == RM_MEM_RANK_SWAP);
+
+struct rm_monitor {
+    MonitorCore core;
+
+    rm_monitor(MonitorEnvironment environment, MonitorCore::Executor executor)
+        : core(std::move(environment), std::move(executor)) {
+    }
+};
+
+namespace {
+
+thread_local std::string lastError;
+
+// 在C边界上把异常转换为返回值
+template <typename F>
+auto guard(F &&f, decltype(f()) failure) noexcept -> decltype(f()) {
+    try {
+        return f();
+    } catch (const std::exception &e) {
+        lastError = e.what();
+    } catch (...) {
+        lastError = "unknown error";
+    }
+    return failure;
+}
+
+void convertProcesses(const std::vector<ProcessSample> &processes, std::vector<rm_process> &out) {
+    out.reserve(processes.size());
+    for (const auto &p : processes) {
+        out.push_back({p.pid, p.cmdline.c_str(), p.cpuPercent, p.memBytes, p.readBytesPerSec, p.writeBytesPerSec});
+    }
+}
+
+// 快照的C视图，字符串指向snapshot，只在snapshot存活期间有效
+struct SnapshotView {
+    rm_snapshot view{};
+    std::vector<rm_disk> disks;
+    std::vector<rm_temperature> temperatures;
+    std::vector<rm_process> topCpu;
+    std::vector<rm_process> topMem;
+    std::vector<rm_process> topDisk;
+
+    explicit SnapshotView(const Snapshot &snapshot) {
+        view.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(snapshot.time.time_since_epoch()).count();
+        view.has_cpu = snapshot.cpuPercent.has_value();
+        view.cpu_percent = snapshot.cpuPercent.value_or(0);
+
+        const auto &mem = snapshot.mem;
+        view.mem = {mem.total, mem.used(), mem.free, mem.available, mem.buffers, mem.cached,
+                    mem.shmem, mem.slab, mem.dirty, mem.writeback, mem.swapTotal, mem.swapFree};
+
+        view.disks_ready = snapshot.disksReady;
+        disks.reserve(snapshot.disks.size());
+        for (const auto &d : snapshot.disks) {
+            disks.push_back({d.name.c_str(), d.readBytesPerSec, d.writeBytesPerSec, d.readIops, d.writeIops,
+                             d.readAwaitMs, d.writeAwaitMs, d.busyPercent, d.avgQueueSize, d.inFlight});
+        }
+        temperatures.reserve(snapshot.temperatures.size());
+        for (const auto &t : snapshot.temperatures) {
+            temperatures.push_back({t.chip.c_str(), t.label.c_str(), t.celsius,
+                                    t.high.value_or(NAN), t.crit.value_or(NAN), t.hwmon.c_str()});
+        }
+        convertProcesses(snapshot.topCpu, topCpu);
+        convertProcesses(snapshot.topMem, topMem);
+        convertProcesses(snapshot.topDisk, topDisk);
+
+        view.disk_count = disks.size();
+        view.disks = disks.data();
+        view.temperature_count = temperatures.size();
+        view.temperatures = temperatures.data();
+        view.top_cpu_count = topCpu.size();
+        view.top_cpu = topCpu.data();
+        view.top_mem_count = topMem.size();
+        view.top_mem = topMem.data();
+        view.top_disk_count = topDisk.size();
+        view.top_disk = topDisk.data();
+    }
+};
+
+}
+
+extern "C" {
+
+rm_monitor *rm_monitor_create(const char *proc_root, const char *sys_root, rm_executor executor, void *executor_user) {
+    return guard([&]() -> rm_monitor * {
+        MonitorEnvironment environment;
+        if (proc_root && *proc_root) environment.procRoot = proc_root;
+        if (sys_root && *sys_root) environment.sysRoot = sys_root;
+        MonitorCore::Executor run;
+        if (executor) {
+            run = [executor, executor_user](std::function<void()> task) {
+                auto *pending = new std::function<void()>(std::move(task));
+                executor([](void *p) {
+                    std::unique_ptr<std::function<void()>> task(static_cast<std::function<void()> *>(p));
+                    (*task)();
+                }, pending, executor_user);
+            };
+        }
+        return new rm_monitor(std::move(environment), std::move(run));
+    }, nullptr);
+}
+
+void rm_monitor_destroy(rm_monitor *monitor) {
+    delete monitor;
+}
+
+int rm_monitor_set_processes(rm_monitor *monitor, int count, double min_cpu_percent,
+                             uint64_t min_mem_bytes, uint64_t min_disk_bytes_per_sec) {
+    return guard([&] {
+        SampleOptions options;
+        options.numProcesses = count;
+        options.minCpuUsage = min_cpu_percent / 100.0;
+        options.minMemUsage = min_mem_bytes;
+        options.minDiskUsage = min_disk_bytes_per_sec;
+        monitor->core.setSampleOptions(options);
+        return 0;
+    }, -1);
+}
+
+int rm_monitor_set_mem_rank(rm_monitor *monitor, rm_mem_rank rank, int smaps_budget_ms) {
+    return guard([&] {
+        if (rank < RM_MEM_RANK_RSS || rank > RM_MEM_RANK_SWAP) throw std::invalid_argument("invalid mem rank");
+        monitor->core.monitor().setMemRank(static_cast<MemRank>(rank), std::chrono::milliseconds(smaps_budget_ms));
+        return 0;
+    }, -1);
+}
+
+int rm_monitor_set_filter(rm_monitor *monitor, const char *expression) {
+    return guard([&] {
+        monitor->core.monitor().setFilter(expression ? expression : "");
+        return 0;
+    }, -1);
+}
+
+uint64_t rm_monitor_subscribe(rm_monitor *monitor, rm_topic topic, int period, rm_callback callback, void *user) {
+    return guard([&]() -> uint64_t {
+        if (topic < RM_TOPIC_CPU || topic > RM_TOPIC_PROCESSES) throw std::invalid_argument("invalid topic");
+        if (!callback) throw std::invalid_argument("empty subscription callback");
+        return monitor->core.subscribe(static_cast<MonitorCore::Topic>(topic), [callback, user](const Snapshot &snapshot) {
+            SnapshotView view(snapshot);
+            callback(&view.view, user);
+        }, period);
+    }, 0);
+}
+
+void rm_monitor_unsubscribe(rm_monitor *monitor, uint64_t id) {
+    guard([&] {
+        monitor->core.unsubscribe(id);
+        return 0;
+    }, -1);
+}
+
+int rm_monitor_poll(rm_monitor *monitor) {
+    return guard([&] {
+        return monitor->core.poll() ? 1 : 0;
+    }, -1);
+}
+
+const char *rm_last_error(void) {
+    return lastError.c_str();
+}
+
+}
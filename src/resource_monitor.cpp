@@ -1,104 +1,413 @@
 #include "resource_monitor.h"
+#include "report.h"
+#include "top_k.h"
+#include "tick_arena.h"
+#include "process_classifier.h"
+#include "process_filter.h"
 #include <fstream>
 #include <sstream>
 #include <unistd.h>
-#include <iostream>
+#include <pwd.h>
 #include <spdlog/spdlog.h>
 #include <optional>
 #include <map>
-#include <istream>
+#include <unordered_map>
 #include <iterator>
 #include <filesystem>
 #include <iomanip>
-#include <regex>
-#include <optional>
 #include <string>
-#include <iostream>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <ctime>
 
 namespace fs = std::filesystem;
 
+template<typename F>
 struct OnScopeExit {
-    std::function<void()> func_;
-    OnScopeExit(std::function<void()> func) : func_(func) {}
+    F func_;
+    OnScopeExit(F func) : func_(std::move(func)) {}
     ~OnScopeExit() { func_(); }
 };
 
-template<typename T>
-std::string valueToHumanReadable(T value) {
-    if (value >= (uint64_t)1024 * 1024 * 1024 * 1024) {
-        return fmt::format("{:.2f} TB", value / 1024.0 / 1024.0 / 1024.0 / 1024.0);
-    }
-    else if (value >= (uint64_t)1024 * 1024 * 1024) {
-        return fmt::format("{:.2f} GB", value / 1024.0 / 1024.0 / 1024.0);
-    }
-    else if (value >= (uint64_t)1024 * 1024) {
-        return fmt::format("{:.2f} MB", value / 1024.0 / 1024.0);
-    }
-    else if (value >= (uint64_t)1024) {
-        return fmt::format("{:.2f} kB", value / 1024.0);
-    }
-    else {
-        return fmt::format("{}B", value);
-    }
-}
+enum class DiskClass {
+    Disk,
+    Stacked,
+    Partition,
+    Virtual,    // loop、zram、ram等没有下层设备的虚拟设备
+};
 
-std::string getCmdLine(int pid) {
-    std::string cmdlinePath = fmt::format("/proc/{}/cmdline", pid);
-    std::ifstream cmdlineFile(cmdlinePath);
-    if (!cmdlineFile.is_open()) return "";
-    std::string cmdline;
-    std::getline(cmdlineFile, cmdline, '\0');
-    return cmdline;
-}
+// /proc/[pid]/smaps_rollup中的内存统计(字节)
+struct ProcessSmaps {
+    uint64_t rss_;
+    uint64_t pss_;
+    uint64_t uss_;
+    uint64_t swap_;
+};
 
 struct ResourceMonitor::Impl {
+    // 数据源
+    fs::path procRoot_;
+    fs::path sysRoot_;
+    std::string statPath_;
+    std::string meminfoPath_;
+    std::string diskstatsPath_;
+    std::string hwmonPath_;
+    std::function<std::chrono::steady_clock::time_point()> clock_;
+
+    // 用于计算速率的时间戳
+    std::chrono::steady_clock::time_point now() const {
+        return clock_ ? clock_() : std::chrono::steady_clock::now();
+    }
+
     // CPU
     std::optional<uint64_t> prevTotal_;
     std::optional<uint64_t> prevIdleTime_;
 
     // 磁盘
-    std::map<std::string, uint64_t> diskIoTime_;
+    struct DiskCounters {
+        std::string name_;
+        uint64_t reads_;
+        uint64_t readSectors_;
+        uint64_t readTicks_;
+        uint64_t writes_;
+        uint64_t writeSectors_;
+        uint64_t writeTicks_;
+        uint64_t inFlight_;
+        uint64_t ioTimeMs_;
+        uint64_t weightedIoTimeMs_;
+    };
+    // 上次与本次的计数按设备名排序，每次采样结束时交换，容量得以复用
+    std::vector<DiskCounters> diskCounters_;
+    std::vector<DiskCounters> nextDiskCounters_;
     std::optional<std::chrono::steady_clock::time_point> diskIoUpdateTime_;
+    std::map<std::string, DiskClass, std::less<>> diskClasses_;  // 设备分类缓存，首次使用时从/sys/block建立
+    bool diskClassesLoaded_ = false;
+
+    DiskClass classifyDisk(std::string_view name);
+
+    // CPU预算：超出时只轮转扫描部分进程，此前不活跃的进程沿用上次的记录
+    double cpuBudget_ = 0;          // 占单核的比例，0为不限制
+    double coverage_ = 1.0;         // 每次轮转扫描的进程比例
+    double scanCursor_ = 0;         // 本次扫描范围的起点，按在排序后pid列表中的相对位置
+    int slowPeriod_ = 1;            // 温度等慢速采集每隔几次采样执行一次
+    uint64_t tick_ = 0;
+    std::optional<std::chrono::steady_clock::time_point> prevBudgetTime_;   // 上次计算selfCpu_的时刻
+    std::chrono::nanoseconds sampleCpu_{0};     // 此后sample()在调用线程上占用的CPU时间
+    std::optional<double> selfCpu_;  // 上个周期自身占用的CPU，占单核的比例
+    size_t scannedPids_ = 0;
+    std::vector<TemperatureReading> temperatures_;
+    bool temperaturesScanned_ = false;  // 没有传感器的主机上temperatures_始终为空，不能据此判断
+    Snapshot last_;                 // 有采集项周期大于1时保留上次的快照，未到周期的项从中沿用
+    uint64_t lastTick_ = 0;         // last_对应的采样次数，不是上一次的（如刚调整了周期）时不能沿用
+
+    // 第一次采样时所有启用的采集项都执行
+    bool due(int period) const {
+        return period > 0 && (tick_ - 1) % period == 0;
+    }
+
+    void updateCpuBudget();
+
+    // 排序后第index个进程是否在本次轮转扫描的范围内
+    bool inScanSlice(size_t index) const {
+        if (coverage_ >= 1.0 || pids_.empty()) return true;
+        double position = (double)index / pids_.size() - scanCursor_;
+        if (position < 0) position += 1.0;
+        return position < coverage_;
+    }
+    bool degraded() const { return coverage_ < 1.0; }
 
     // 进程CPU占用
     struct ProcessTime {
         int pid_;
-        uint64_t totalTime_;
+        uint64_t startTime_;    // 与pid一起识别pid复用
+        uint64_t totalTime_;    // 进程的utime + stime
+        uint64_t cpuTime_;      // 读取时/proc/stat中的CPU总时间
+        double usage_;          // 与上次读取相比的CPU占用比例，未知时为-1
+
+        // 分组用的属性：comm、ppid和会话随每次读取stat更新，UID和规则匹配结果只在进程首次出现时读取
+        int ppid_ = 0;
+        int session_ = 0;
+        std::array<char, 16> comm_{};   // 内核中comm最长15字节
+        int64_t uid_ = -1;              // -1为尚未读取
+        int pattern_ = -2;              // 匹配的规则下标，-1为不匹配任何规则，-2为尚未匹配
+
+        // 过滤表达式用到的属性，cmd规则的匹配结果按位缓存
+        uint64_t rss_ = 0;
+        uint64_t threads_ = 0;
+        uint64_t commandKnown_ = 0;
+        uint64_t commandMatched_ = 0;
+
+        std::string_view comm() const { return comm_.data(); }
+        void setStat(const procfs::ProcStat &stat) {
+            static const uint64_t pageSize = sysconf(_SC_PAGESIZE);
+            ppid_ = stat.ppid;
+            session_ = stat.session;
+            rss_ = stat.rssPages * pageSize;
+            threads_ = stat.numThreads;
+            auto length = std::min(stat.comm.size(), comm_.size() - 1);
+            std::copy_n(stat.comm.data(), length, comm_.begin());
+            comm_[length] = '\0';
+        }
     };
-    std::optional<uint64_t> prevCpuTime_;   // 和prevTotal_略微相同  
-    std::map<int, ProcessTime> processTimes_;
+    std::vector<ProcessTime> processTimes_;     // 按pid排序，与nextProcessTimes_交替使用
+    std::vector<ProcessTime> nextProcessTimes_;
+
+    // 按pid查找本次的CPU记录，没有时返回nullptr
+    const ProcessTime *findProcessTime(int pid) const {
+        auto it = std::ranges::lower_bound(processTimes_, pid, {}, &ProcessTime::pid_);
+        return it != processTimes_.end() && it->pid_ == pid ? &*it : nullptr;
+    }
+    ProcessTime *findProcessTime(int pid) {
+        return const_cast<ProcessTime *>(std::as_const(*this).findProcessTime(pid));
+    }
+
+    // 进程分组
+    GroupBy groupBy_ = GroupBy::None;
+    std::vector<std::string> groupNames_;
+    std::unique_ptr<ProcessClassifier> classifier_;     // 所有分组规则编译成的一个匹配器
+    std::unordered_map<uint32_t, std::string> userNames_;
+
+    const std::string &userName(uint32_t uid);
+    int64_t processUid(ProcessTime &process);
+    int processPattern(ProcessTime &process);
+    std::optional<std::string_view> readCommandLine(int pid);
+    void findTreeRoots(std::pmr::vector<int> &roots) const;
+
+    // 进程内存占用
+    struct ProcessMem {
+        int pid_;
+        uint64_t rss_;
+    };
+    std::vector<ProcessMem> processMems_;       // 按pid排序，与nextProcessMems_交替使用
+    std::vector<ProcessMem> nextProcessMems_;
+    uint64_t memHotThreshold_ = 0;              // 上次排名靠前的候选进程中最小的RSS
 
     // 进程IO占用
     struct ProcessIo {
         int pid_;
+        uint64_t startTime_;
         uint64_t readIo_;
         uint64_t writeIo_;
+        uint64_t totalTime_;    // 读取时进程的utime + stime，没有运行过的进程不会产生新的IO
+        std::chrono::steady_clock::time_point time_;
+        bool hasRate_;
+        double readRate_;       // 字节/秒
+        double writeRate_;
     };
-    std::optional<std::chrono::steady_clock::time_point> processIoUpdateTime_;
-    std::map<int, ProcessIo> processIos_;
+    std::vector<ProcessIo> processIos_;         // 按pid排序，与nextProcessIos_交替使用
+    std::vector<ProcessIo> nextProcessIos_;
+
+    // 按pid查找IO记录，startTime不一致（pid被复用）时返回nullptr
+    const ProcessIo *findProcessIo(int pid, uint64_t startTime) const {
+        auto it = std::ranges::lower_bound(processIos_, pid, {}, &ProcessIo::pid_);
+        if (it == processIos_.end() || it->pid_ != pid) return nullptr;
+        return it->startTime_ == 0 || it->startTime_ == startTime ? &*it : nullptr;
+    }
+
+    // 过滤表达式，为空时不过滤
+    std::unique_ptr<ProcessFilter> filter_;
+    struct FilterFields;
+    ProcessFilter::Result filterProcess(ProcessTime &process, const ProcessIo *io);
+    // 只按stat中已有的字段求值，确定不满足时返回true，调用方不必再读取该进程的其他文件
+    bool filterRejects(int pid);
+    // 按全部字段求值，只有确定满足时返回true；没有过滤表达式时恒为true
+    bool filterAccepts(int pid, const ProcessIo *io);
+
+    // 进程smaps_rollup统计，RSS未变化时直接复用
+    MemRank memRank_ = MemRank::Rss;
+    std::chrono::milliseconds smapsBudget_{20};
+    struct CachedSmaps {
+        int pid_;
+        ProcessSmaps smaps_;
+    };
+    std::vector<CachedSmaps> processSmaps_;     // 按pid排序，与nextProcessSmaps_交替使用
+    std::vector<CachedSmaps> nextProcessSmaps_;
+
+    // 读取/proc文件的复用缓冲区
+    std::string readBuffer_;
+    std::vector<int> pids_;
+    bool pidsListed_ = false;   // 在PidListScope内，pids_已经列出
+    std::vector<procfs::DiskstatsEntry> diskEntries_;
+    fmt::memory_buffer pathBuffer_;
+
+    // 一次采样内的临时数据，采样结束时整体回收
+    TickArena arena_;
+
+    SelfProfiler profiler_;
+
+    // 拼接<procRoot>/<pid>/<name>，返回的指针在下次调用前有效
+    const char *pidPath(int pid, const char *name) {
+        pathBuffer_.clear();
+        fmt::format_to(std::back_inserter(pathBuffer_), "{}/{}/{}", procRoot_.native(), pid, name);
+        pathBuffer_.push_back('\0');
+        return pathBuffer_.data();
+    }
+
+    // 拼接<dir>/<name><suffix>，返回的指针在下次调用前有效
+    const char *filePath(std::string_view dir, std::string_view name, std::string_view suffix = {}) {
+        pathBuffer_.clear();
+        fmt::format_to(std::back_inserter(pathBuffer_), "{}/{}{}", dir, name, suffix);
+        pathBuffer_.push_back('\0');
+        return pathBuffer_.data();
+    }
+
+    // 读取sysfs中的单行文本，去掉结尾换行；返回值指向readBuffer_，失败时为空
+    std::string_view readLine(const char *path) {
+        if (!procfs::readFile(path, readBuffer_)) return {};
+        std::string_view line(readBuffer_);
+        return line.substr(0, line.find('\n'));
+    }
+
+    // 读取sysfs中的整数，如温度的毫摄氏度
+    std::optional<long> readLong(const char *path) {
+        auto line = readLine(path);
+        long value = 0;
+        auto [end, ec] = std::from_chars(line.data(), line.data() + line.size(), value);
+        if (ec != std::errc()) return std::nullopt;
+        return value;
+    }
+
+    // 读取/proc/<pid>/cmdline中的程序路径（第一个参数）
+    std::string getCmdLine(int pid) {
+        if (!procfs::readFile(pidPath(pid, "cmdline"), readBuffer_)) return "";
+        return std::string(readBuffer_.c_str());
+    }
+
+    // 列出所有进程号并排序，结果存放在pids_；sample()中已列出时直接复用，
+    // 各采集函数和分组汇总看到的是同一份进程列表
+    const std::vector<int> &listPids() {
+        if (pidsListed_) return pids_;
+        pids_.clear();
+        procfs::listPids(procRoot_.c_str(), pids_);
+        std::sort(pids_.begin(), pids_.end());
+        return pids_;
+    }
+
+    // 作用域内只列出一次/proc，离开时（包括异常）恢复为每次调用时列出
+    class PidListScope {
+    public:
+        explicit PidListScope(Impl &impl) : impl_(impl) {
+            impl_.listPids();
+            impl_.pidsListed_ = true;
+        }
+        ~PidListScope() { impl_.pidsListed_ = false; }
+        PidListScope(const PidListScope &) = delete;
+        PidListScope &operator=(const PidListScope &) = delete;
+
+    private:
+        Impl &impl_;
+    };
+
+    // /proc/stat中的汇总CPU时间，读取失败时返回nullopt
+    std::optional<procfs::CpuTimes> readCpuTimes() {
+        procfs::CpuTimes times;
+        if (!procfs::readFile(statPath_.c_str(), readBuffer_)) return std::nullopt;
+        if (!procfs::parseCpuTimes(readBuffer_, times)) return std::nullopt;
+        return times;
+    }
 
 };
 
+// 依据sysfs判断设备类型：
+//   /sys/block/<dev>            整盘或虚拟设备（链接目标位于devices/virtual下即为虚拟设备）
+//   /sys/block/<dev>/slaves     非空说明是堆叠在其他设备之上的dm/md
+//   /sys/class/block/<dev>/partition  存在说明是分区
+static DiskClass classifyBlockDevice(const fs::path &devPath) {
+    std::error_code ec;
+    if (fs::exists(devPath / "partition", ec)) return DiskClass::Partition;
+
+    auto target = fs::canonical(devPath, ec);
+    if (ec || target.string().find("/devices/virtual/") == std::string::npos) return DiskClass::Disk;
+
+    auto slaves = devPath / "slaves";
+    if (fs::is_directory(slaves, ec) && !fs::is_empty(slaves, ec)) return DiskClass::Stacked;
+    return DiskClass::Virtual;
+}
+
+DiskClass ResourceMonitor::Impl::classifyDisk(std::string_view name) {
+    if (!diskClassesLoaded_) {
+        diskClassesLoaded_ = true;
+        std::error_code ec;
+        for (const auto &dev : fs::directory_iterator(sysRoot_ / "block", ec)) {
+            auto devName = dev.path().filename().string();
+            diskClasses_[devName] = classifyBlockDevice(dev.path());
+
+            // 分区是整盘目录下带有partition文件的子目录
+            std::error_code subEc;
+            for (const auto &sub : fs::directory_iterator(dev.path(), subEc)) {
+                if (fs::exists(sub.path() / "partition", subEc)) {
+                    diskClasses_[sub.path().filename().string()] = DiskClass::Partition;
+                }
+            }
+        }
+    }
+
+    auto it = diskClasses_.find(name);
+    if (it != diskClasses_.end()) return it->second;
+
+    // 运行期间新出现的设备（热插拔），单独分类一次后缓存
+    auto cls = classifyBlockDevice(sysRoot_ / "class/block" / fs::path(name));
+    diskClasses_.emplace(std::string(name), cls);
+    return cls;
+}
+
 ResourceMonitor::ResourceMonitor()
+    : ResourceMonitor(MonitorEnvironment{}) {
+}
+
+ResourceMonitor::ResourceMonitor(MonitorEnvironment environment)
     : impl_(new Impl) {
+    impl_->procRoot_ = environment.procRoot;
+    impl_->sysRoot_ = environment.sysRoot;
+    impl_->clock_ = std::move(environment.clock);
+    impl_->statPath_ = impl_->procRoot_ / "stat";
+    impl_->meminfoPath_ = impl_->procRoot_ / "meminfo";
+    impl_->diskstatsPath_ = impl_->procRoot_ / "diskstats";
+    impl_->hwmonPath_ = impl_->sysRoot_ / "class/hwmon";
 }
 
 ResourceMonitor::~ResourceMonitor() {    
 }
 
-std::string ResourceMonitor::getCpuUsage() {
-    std::ifstream proc_stat("/proc/stat");
-    std::string line;
-    std::getline(proc_stat, line);
-    proc_stat.close();
-    
-    std::istringstream iss(line);
-    std::string cpu;
-    uint64_t user, nice, system, idle, iowait, irq, softirq;
-    iss >> cpu >> user >> nice >> system >> idle >> iowait >> irq >> softirq;
+void ResourceMonitor::setMemRank(MemRank rank, std::chrono::milliseconds budget) {
+    impl_->memRank_ = rank;
+    impl_->smapsBudget_ = budget;
+    if (rank == MemRank::Rss) impl_->processSmaps_.clear();
+}
+
+static std::optional<ProcessSmaps> parseSmapsRollup(std::string_view text) {
+    ProcessSmaps smaps{};
+    uint64_t privateClean = 0, privateDirty = 0;
+    bool found = false;
+    while (!text.empty()) {
+        auto lineEnd = text.find('\n');
+        auto line = text.substr(0, lineEnd);
+        text = lineEnd == std::string_view::npos ? std::string_view() : text.substr(lineEnd + 1);
+
+        auto colon = line.find(':');
+        if (colon == std::string_view::npos) continue;   // 第一行是地址范围
+        auto key = line.substr(0, colon);
+        uint64_t kb = std::strtoull(line.data() + colon + 1, nullptr, 10);
+        if (key == "Rss") { smaps.rss_ = kb * 1024; found = true; }
+        else if (key == "Pss") smaps.pss_ = kb * 1024;
+        else if (key == "Private_Clean") privateClean = kb * 1024;
+        else if (key == "Private_Dirty") privateDirty = kb * 1024;
+        else if (key == "Swap") smaps.swap_ = kb * 1024;
+    }
+    if (!found) return std::nullopt;   // 内核线程等没有地址空间
+    smaps.uss_ = privateClean + privateDirty;
+    return smaps;
+}
+
+std::optional<double> ResourceMonitor::getCpuPercent() {
+    auto scope = impl_->profiler_.scope(Collector::Cpu);
+    auto times = impl_->readCpuTimes();
+    if (!times) return std::nullopt;
     
-    uint64_t total = user + nice + system + idle + iowait + irq + softirq;
-    uint64_t idleTime = idle + iowait;
+    uint64_t total = times->total();
+    uint64_t idleTime = times->idleTotal();
     
     OnScopeExit onScopeExit([&]() {
         impl_->prevTotal_ = total;
@@ -106,236 +415,175 @@ std::string ResourceMonitor::getCpuUsage() {
     });
 
     if (!impl_->prevTotal_.has_value()) {
-        return "CPU: ?";  // 第一次调用无法计算使用率
+        return std::nullopt;  // 第一次调用无法计算使用率
     }
     
     uint64_t deltaTotal = total - impl_->prevTotal_.value();
     uint64_t deltaIdle = idleTime - impl_->prevIdleTime_.value();
        
-    if (deltaTotal == 0) return "CPU: ?";  // 避免除以零
+    if (deltaTotal == 0) return std::nullopt;  // 避免除以零
     
-    double cpuUsage = 100.0 * (deltaTotal - deltaIdle) / deltaTotal;
-    return fmt::format("CPU: {:.2f}%", cpuUsage);
+    return 100.0 * (deltaTotal - deltaIdle) / deltaTotal;
 }
 
-std::string ResourceMonitor::getMemoryUsage() {
-    std::ifstream proc_meminfo("/proc/meminfo");
-    if (!proc_meminfo) return "MEM: ?";
-
-    uint64_t total = 0, free = 0, buffers = 0, cached = 0;
-    uint64_t swapTotal = 0, swapFree = 0;
-    std::string line;
-
-    auto parseValue = [](const std::string& unit, uint64_t value) -> uint64_t {
-        if (unit == "kB") return value * 1024;
-        if (unit == "MB") return value * 1024 * 1024;
-        if (unit == "GB") return value * 1024 * 1024 * 1024;
-        if (unit == "TB") return value * 1024 * 1024 * 1024 * 1024;
-        return value;  // 默认按字节处理
-    };
+std::string ResourceMonitor::getCpuUsage() {
+    return formatCpu(getCpuPercent());
+}
 
-    while (std::getline(proc_meminfo, line)) {
-        std::istringstream iss(line);
-        std::string key, unit;
-        uint64_t value;
-        
-        iss >> key >> value >> unit;
-        
-        if (key == "MemTotal:") {
-            total = parseValue(unit, value);
-        } else if (key == "MemFree:") {
-            free = parseValue(unit, value);
-        } else if (key == "Buffers:") {
-            buffers = parseValue(unit, value);
-        } else if (key == "Cached:") {
-            cached = parseValue(unit, value);
-        } else if (key == "SwapTotal:") {
-            swapTotal = parseValue(unit, value);
-        } else if (key == "SwapFree:") {
-            swapFree = parseValue(unit, value);
-        }
+MemInfo ResourceMonitor::getMemInfo() {
+    auto scope = impl_->profiler_.scope(Collector::Memory);
+    MemInfo info;
+    if (procfs::readFile(impl_->meminfoPath_.c_str(), impl_->readBuffer_)) {
+        procfs::parseMeminfo(impl_->readBuffer_, info);
     }
+    return info;
+}
 
-    if (total == 0) return "MEM: ?";
-    
-    // 计算物理内存使用率
-    uint64_t used = total - free - buffers - cached;
-    double memoryUsage = 100.0 * used / total;
-
-    std::string memoryUsageString = fmt::format("MEM: {:.2f}% ({} of {})",
-        memoryUsage,
-        valueToHumanReadable(used),
-        valueToHumanReadable(total));
-   
-    // 如果有交换分区，计算交换分区使用率
-    if (swapTotal > 0) {
-        uint64_t swapUsed = swapTotal - swapFree;
-        double swapUsage = 100.0 * swapUsed / swapTotal;
-        return fmt::format("{}, SWAP: {:.2f}% ({} of {})",
-            memoryUsageString,
-            swapUsage,
-            valueToHumanReadable(swapUsed),
-            valueToHumanReadable(swapTotal));
-    }
-    else {
-        return memoryUsageString;
-    }
+std::string ResourceMonitor::getMemoryUsage() {
+    return formatMemory(getMemInfo());
 }
 
-std::string ResourceMonitor::getDiskIo() {
-    std::ifstream proc_diskstats("/proc/diskstats");
-    if (!proc_diskstats) return "DISK: ?";
-
-    std::string line;
-    std::map<std::string, uint64_t> diskIoTime;
-
-    auto now = std::chrono::steady_clock::now();
-    while (std::getline(proc_diskstats, line)) {
-        std::istringstream iss(line);
-        unsigned major, minor;
-        std::string diskName;
-        uint64_t reads, readMerges, readSectors, readTicks;
-        uint64_t writes, writeMerges, writeSectors, writeTicks;
-        uint64_t inFlight, ioTimeMs, weightedIoTimeMs;
-
-        iss >> major >> minor >> diskName
-            >> reads >> readMerges >> readSectors >> readTicks
-            >> writes >> writeMerges >> writeSectors >> writeTicks
-            >> inFlight >> ioTimeMs >> weightedIoTimeMs;
-
-        // 只统计物理磁盘(sdX, mmcblkX, nvmeXnY)和SD卡
-        if (diskName.find("sd") == 0       // SATA/SCSI磁盘
-            || diskName.find("hd") == 0       // SATA/SCSI磁盘
-            || diskName.find("nvme") == 0     // NVMe SSD
-            || diskName.find("mmcblk") == 0) {   // SD卡/eMMC
-            diskIoTime.emplace(diskName, ioTimeMs);
-        }
+std::vector<DiskStat> ResourceMonitor::getDiskStats() {
+    auto scope = impl_->profiler_.scope(Collector::Disk);
+    std::vector<DiskStat> stats;
+    if (!procfs::readFile(impl_->diskstatsPath_.c_str(), impl_->readBuffer_)) return stats;
+
+    auto &entries = impl_->diskEntries_;
+    entries.clear();
+    procfs::parseDiskstats(impl_->readBuffer_, entries);
+
+    auto &diskCounters = impl_->nextDiskCounters_;
+    diskCounters.clear();
+    auto now = impl_->now();
+    for (const auto &entry : entries) {
+        // 只统计整盘和dm/md，分区和loop/zram等设备会重复计数或没有意义
+        auto cls = impl_->classifyDisk(entry.name);
+        if (cls != DiskClass::Disk && cls != DiskClass::Stacked) continue;
+
+        diskCounters.emplace_back(Impl::DiskCounters{
+            std::string(entry.name),
+            entry.reads, entry.readSectors, entry.readTicks,
+            entry.writes, entry.writeSectors, entry.writeTicks,
+            entry.inFlight, entry.ioTimeMs, entry.weightedIoTimeMs
+        });
     }
+    std::ranges::sort(diskCounters, {}, &Impl::DiskCounters::name_);
 
     OnScopeExit onScopeExit([&]() {
         impl_->diskIoUpdateTime_ = now;
-        impl_->diskIoTime_ = std::move(diskIoTime);
+        std::swap(impl_->diskCounters_, impl_->nextDiskCounters_);
     });
 
     if(!impl_->diskIoUpdateTime_.has_value()) {
-        return "DISK: ?";
+        return stats;
     }
 
-    // 计算磁盘繁忙百分比
     auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - impl_->diskIoUpdateTime_.value()).count();
-
-    std::string result;
-    for(const auto& disk : diskIoTime) {
-        const auto& diskName = disk.first;
-        const auto& ioTimeMs = disk.second;
-
-        auto prevIoTime = impl_->diskIoTime_.find(diskName);
-        if(prevIoTime != impl_->diskIoTime_.end()) {
-            auto prevIoTimeMs = prevIoTime->second;
-            auto ioTimeDeltaMs = ioTimeMs - prevIoTimeMs;
-            auto diskUsage = 100.0 * ioTimeDeltaMs / elapsedMs;
-            if(!result.empty()) result += ", ";  // 不是第一个磁盘，添加逗号以分隔多磁盘情况
-            result += fmt::format("Disk {}: {:.2f}%", diskName, diskUsage);
-        }
+    if (elapsedMs <= 0) return stats;
+    double elapsedSec = elapsedMs / 1000.0;
+
+    const auto &prevCounters = impl_->diskCounters_;
+    for(const auto& cur : diskCounters) {
+        auto prevIt = std::ranges::lower_bound(prevCounters, cur.name_, {}, &Impl::DiskCounters::name_);
+        if(prevIt == prevCounters.end() || prevIt->name_ != cur.name_) continue;
+        const auto &prev = *prevIt;
+
+        // /proc/diskstats中扇区固定按512字节计
+        uint64_t deltaReads = cur.reads_ - prev.reads_;
+        uint64_t deltaWrites = cur.writes_ - prev.writes_;
+
+        DiskStat stat;
+        stat.name = cur.name_;
+        stat.kind = impl_->classifyDisk(cur.name_) == DiskClass::Stacked ? DiskStat::Kind::Stacked : DiskStat::Kind::Disk;
+        stat.readBytesPerSec = (cur.readSectors_ - prev.readSectors_) * 512.0 / elapsedSec;
+        stat.writeBytesPerSec = (cur.writeSectors_ - prev.writeSectors_) * 512.0 / elapsedSec;
+        stat.readIops = deltaReads / elapsedSec;
+        stat.writeIops = deltaWrites / elapsedSec;
+        stat.readAwaitMs = deltaReads ? (double)(cur.readTicks_ - prev.readTicks_) / deltaReads : 0.0;
+        stat.writeAwaitMs = deltaWrites ? (double)(cur.writeTicks_ - prev.writeTicks_) / deltaWrites : 0.0;
+        stat.busyPercent = std::min(100.0, 100.0 * (cur.ioTimeMs_ - prev.ioTimeMs_) / elapsedMs);
+        stat.avgQueueSize = (double)(cur.weightedIoTimeMs_ - prev.weightedIoTimeMs_) / elapsedMs;
+        stat.inFlight = cur.inFlight_;
+        stats.emplace_back(std::move(stat));
     }
 
-    return result;
+    return stats;
 }
 
-/// 格式示例：
-/// coretemp
-/// Adapter: ISA adapter
-/// Package id 0:  +46.0°C  (high = +80.0°C, crit = +100.0°C)
-/// Core 0:        +44.0°C  (high = +80.0°C, crit = +100.0°C)
-std::string ResourceMonitor::getTemperature() {
-    std::ostringstream out;
-    std::regex tempRE(R"(temp(\d+)_input)");
+std::string ResourceMonitor::getDiskIo() {
+    bool ready = impl_->diskIoUpdateTime_.has_value();
+    return formatDisks(ready, getDiskStats());
+}
+
+std::vector<TemperatureReading> ResourceMonitor::getTemperatures() {
+    auto scope = impl_->profiler_.scope(Collector::Temperature);
+    TickArenaScope arenaScope(impl_->arena_);
+    std::vector<TemperatureReading> readings;
 
-    for (const auto& hw : fs::directory_iterator("/sys/class/hwmon"))
+    std::pmr::vector<std::pmr::string> hwmons(&impl_->arena_);
+    std::pmr::vector<std::pmr::string> files(&impl_->arena_);
+    std::pmr::string dir(&impl_->arena_);
+    procfs::listDir(impl_->hwmonPath_.c_str(), hwmons);
+    for (const auto& hwmon : hwmons)
     {
-        if (!fs::is_directory(hw)) continue;
+        dir.assign(impl_->hwmonPath_).append("/").append(hwmon);
+        files.clear();
+        if (!procfs::listDir(dir.c_str(), files)) continue;
 
         /* ---------- 1. 芯片名称 ---------- */
-        std::string chip;
-        {
-            std::ifstream fin(hw.path() / "name");
-            std::getline(fin, chip);
-        }
-        if (chip.empty()) chip = hw.path().filename();
-
-        out << chip << '\n';
+        std::string chip(impl_->readLine(impl_->filePath(dir, "name")));
+        if (chip.empty()) chip = hwmon;
 
         /* ---------- 2. Adapter ---------- */
         // 粗略判断：有 'device' 子目录 → PCI/Platform/USB 适配器；否则 ISA
-        out << "Adapter: " << (fs::exists(hw.path() / "device") ? "PCI adapter" : "ISA adapter") << '\n';
+        bool pciAdapter = ::access(impl_->filePath(dir, "device"), F_OK) == 0;
 
         /* ---------- 3. 每个 tempN ---------- */
-        // 为了让列对齐，先收集一轮求最长 label 长度
-        struct Row { std::string label; double val; std::optional<double> max, crit; };
-        std::vector<Row> rows;
-        std::size_t maxLabelLen = 0;
-
-        for (const auto& f : fs::directory_iterator(hw))
+        for (const auto& file : files)
         {
-            std::smatch m;
-            auto str = f.path().filename().string();
-            if (!std::regex_match(str, m, tempRE)) continue;
-            const std::string N = m[1];
+            // 只处理tempN_input
+            std::string_view name(file);
+            if (!name.starts_with("temp") || !name.ends_with("_input")) continue;
+            auto prefix = name.substr(0, name.size() - std::string_view("_input").size());
+            if (prefix.size() == 4 || !std::all_of(prefix.begin() + 4, prefix.end(), ::isdigit)) continue;
 
-            long milli = 0;
-            { std::ifstream fin(f.path()); fin >> milli; }
+            long milli = impl_->readLong(impl_->filePath(dir, file)).value_or(0);
             if (!milli) continue;                      // 无效
 
-            std::string label;
-            { std::ifstream fin(hw.path() / ("temp"+N+"_label")); std::getline(fin,label); }
-            if (label.empty()) label = "temp" + N;
+            std::string label(impl_->readLine(impl_->filePath(dir, prefix, "_label")));
+            if (label.empty()) label = prefix;
 
-            auto readField = [&](const std::string& fname)->std::optional<double>{
-                std::ifstream fin(hw.path()/fname);
-                long v; if (fin && (fin>>v)) return v/1000.0; return std::nullopt;
+            auto readField = [&](std::string_view suffix)->std::optional<double>{
+                auto v = impl_->readLong(impl_->filePath(dir, prefix, suffix));
+                if (v) return *v/1000.0;
+                return std::nullopt;
             };
 
-            Row row{label,
-                    milli / 1000.0,
-                    readField("temp"+N+"_max"),
-                    readField("temp"+N+"_crit")};
-            maxLabelLen = std::max(maxLabelLen, row.label.size());
-            rows.emplace_back(std::move(row));
+            readings.emplace_back(TemperatureReading{
+                std::string(hwmon),
+                chip,
+                pciAdapter,
+                std::move(label),
+                milli / 1000.0,
+                readField("_max"),
+                readField("_crit")});
         }
-
-        /* ---------- 4. 打印 ---------- */
-        for (const auto& r : rows)
-        {
-            out << std::left << std::setw(maxLabelLen+2) << r.label << ":  "
-                << std::right << std::showpos << std::fixed << std::setprecision(1)
-                << std::setw(6) << r.val << "°C" << std::noshowpos;
-
-            if (r.max || r.crit)
-            {
-                out << "  (";
-                bool first = true;
-                if (r.max)  { out << "high = " << std::showpos << *r.max << "°C"; first = false; }
-                if (r.crit) { out << (first?"":" ,") << "crit = " << std::showpos << *r.crit << "°C"; }
-                out << ")";
-            }
-            out << '\n';
-        }
-        out << '\n';                // 空行分隔芯片
     }
 
-    std::string result = out.str();
-    if (result.empty()) result = "No temperature sensors found\n";
-    return result;
+    return readings;
 }
 
+std::string ResourceMonitor::getTemperature() {
+    return formatTemperatures(getTemperatures());
+}
 
 std::string ResourceMonitor::getTemperatureSimple() {
     std::ostringstream oss;
-    constexpr char kThermalDir[] = "/sys/class/thermal";
+    auto thermalDir = impl_->sysRoot_ / "class/thermal";
 
     try {
         bool isFirst = true;
-        for (const auto& entry : fs::directory_iterator(kThermalDir))
+        for (const auto& entry : fs::directory_iterator(thermalDir))
         {
             if (!entry.is_directory()) continue;
             const auto &zonePath = entry.path();
@@ -365,254 +613,731 @@ std::string ResourceMonitor::getTemperatureSimple() {
 }
 
 
-std::vector<std::string> ResourceMonitor::getTopCpuProcesses(int numProcesses, double minCpuUsage) {
-    std::vector<std::string> topCPUs;
-    auto readCPUTotal = []() -> uint64_t {
-        std::ifstream file("/proc/stat");
-        if (!file.is_open()) return 0;
-    
-        std::string line;
-        std::getline(file, line); // first line should start with "cpu"
-        std::istringstream iss(line);
-    
-        std::string label;
-        iss >> label; // skip "cpu"
-    
-        uint64_t val, sum = 0;
-        while (iss >> val) {
-            sum += val;
+std::vector<ProcessSample> ResourceMonitor::getTopCpu(int numProcesses, double minCpuUsage) {
+    auto scope = impl_->profiler_.scope(Collector::TopCpu);
+    TickArenaScope arenaScope(impl_->arena_);
+    std::vector<ProcessSample> topCPUs;
+
+    auto cpuTimes = impl_->readCpuTimes();
+    uint64_t cpuTime = cpuTimes ? cpuTimes->total() : 0;
+
+    // 遍历/proc目录获取所有进程，两次的列表都按pid排序，归并即可
+    const auto &prevTimes = impl_->processTimes_;
+    auto &processTimes = impl_->nextProcessTimes_;
+    processTimes.clear();
+    auto prev = prevTimes.begin();
+    size_t scanned = 0;
+    procfs::ProcStat stat;
+    const auto &pids = impl_->listPids();
+    for (size_t i = 0; i < pids.size(); ++i) {
+        int pid = pids[i];
+        while (prev != prevTimes.end() && prev->pid_ < pid) ++prev;
+        const Impl::ProcessTime *old = prev != prevTimes.end() && prev->pid_ == pid ? &*prev : nullptr;
+
+        // 不在本次扫描范围内且此前不活跃的进程沿用上次的记录
+        if (old && old->usage_ < minCpuUsage && !impl_->inScanSlice(i)) {
+            processTimes.push_back(*old);
+            continue;
         }
-    
-        return sum;
-    };
 
-    std::map<int, Impl::ProcessTime> processTimes;
-
-    // 遍历/proc目录获取所有进程
-    for (const auto& entry : std::filesystem::directory_iterator("/proc")) {
-        try {
-            // 检查是否是进程目录(数字命名的目录)
-            std::string pidStr = entry.path().filename();
-            if (std::all_of(pidStr.begin(), pidStr.end(), ::isdigit)) {
-                int pid = std::stoi(pidStr);
-                std::ifstream statFile(entry.path() / "stat");
-                std::string statLine;
-                if (std::getline(statFile, statLine)) {
-                    std::istringstream iss(statLine);
-                    std::vector<std::string> tokens{
-                        std::istream_iterator<std::string>{iss},
-                        std::istream_iterator<std::string>{}
-                    };
-
-                    if (tokens.size() >= 22) {
-                        // 计算CPU使用率
-                        uint64_t utime = std::stoull(tokens[13]);
-                        uint64_t stime = std::stoull(tokens[14]);
-                        //uint64_t cutime = std::stoull(tokens[15]);
-                        //uint64_t cstime = std::stoull(tokens[16]);
-                        //uint64_t starttime = std::stoull(tokens[21]);
-                        //uint64_t total_time = utime + stime + cutime + cstime;
-
-                        uint64_t totalTime = utime + stime;
-                        
-                        processTimes[pid] = {
-                            pid,
-                            totalTime
-                        };
-                    }
-                }
+        // 进程可能在遍历期间退出，读取失败直接跳过
+        if (!procfs::readFile(impl_->pidPath(pid, "stat"), impl_->readBuffer_)) continue;
+        if (!procfs::parseProcStat(impl_->readBuffer_, stat)) continue;
+        ++scanned;
+
+        Impl::ProcessTime record{pid, stat.startTime, stat.utime + stat.stime, cpuTime, -1.0};
+        record.setStat(stat);
+        if (old && old->startTime_ == record.startTime_) {
+            record.uid_ = old->uid_;
+            record.pattern_ = old->pattern_;
+            record.commandKnown_ = old->commandKnown_;
+            record.commandMatched_ = old->commandMatched_;
+            if (cpuTime <= old->cpuTime_) {
+                // 两次读取之间CPU总时间没有变化，无法计算，保留上次的基准
+                processTimes.push_back(*old);
+                processTimes.back().usage_ = -1.0;
+                continue;
             }
-        } catch (...) {
-            continue; // 跳过无法访问的进程目录
+            auto deltaTotalTime = record.totalTime_ > old->totalTime_ ? record.totalTime_ - old->totalTime_ : 0;
+            record.usage_ = deltaTotalTime / (double)(cpuTime - old->cpuTime_);
         }
+        processTimes.push_back(record);
+    }
+    std::swap(impl_->processTimes_, impl_->nextProcessTimes_);
+    impl_->scannedPids_ = scanned;
+
+    // 排序并获取前numProcesses个进程，首次读取的进程没有占用率
+    std::pmr::vector<std::pair<double, int>> usages(&impl_->arena_);  // first: CPU占用比例, second: pid
+    for (const auto &process : impl_->processTimes_) {
+        if (process.usage_ < 0 || process.usage_ < minCpuUsage) continue;
+        if (!impl_->filterAccepts(process.pid_, nullptr)) continue;
+        usages.emplace_back(process.usage_, process.pid_);
+    }
+    selectTopK(usages, numProcesses, [](const auto &u) { return u.first; });
+    for(const auto &[cpuUsage, pid] : usages) {
+        ProcessSample sample;
+        sample.pid = pid;
+        sample.cmdline = impl_->getCmdLine(pid);
+        sample.cpuPercent = cpuUsage * 100;
+        topCPUs.emplace_back(std::move(sample));
     }
 
-    auto cpuTime = readCPUTotal();
-
-    OnScopeExit onScopeExit([&]() {
-        impl_->prevCpuTime_ = cpuTime;
-        impl_->processTimes_ = std::move(processTimes);
-    });
+    return topCPUs;
+}
 
-    if(!impl_->prevCpuTime_.has_value()) {
-        return topCPUs;
+std::vector<std::string> ResourceMonitor::getTopCpuProcesses(int numProcesses, double minCpuUsage) {
+    std::vector<std::string> topCPUs;
+    for (const auto &process : getTopCpu(numProcesses, minCpuUsage)) {
+        topCPUs.emplace_back(formatTopCpu(process));
     }
+    return topCPUs;
+}
 
-    // 计算CPU使用率
-    std::multimap<uint64_t, int> topCPUMap;  // key: deltaTotalTime, value: pid
-    for(auto &process: processTimes) {
-        auto prev = impl_->processTimes_.find(process.first);
-        if(prev != impl_->processTimes_.end()) {
-            auto prevTotalTime = prev->second.totalTime_;
-            auto deltaTotalTime = process.second.totalTime_ - prevTotalTime;
-            topCPUMap.emplace(deltaTotalTime, process.first);
+
+std::vector<ProcessSample> ResourceMonitor::getTopMem(int numProcesses, uint64_t minMemUsage) {
+    auto scope = impl_->profiler_.scope(Collector::TopMem);
+    TickArenaScope arenaScope(impl_->arena_);
+    std::vector<ProcessSample> topMemories;
+
+    // 添加内存统计
+    static const uint64_t pageSize = sysconf(_SC_PAGESIZE);
+    const auto &prevMems = impl_->processMems_;
+    auto &processMems = impl_->nextProcessMems_;
+    processMems.clear();
+    auto prev = prevMems.begin();
+    procfs::ProcStatm statm;
+    const auto &pids = impl_->listPids();
+    for (size_t i = 0; i < pids.size(); ++i) {
+        int pid = pids[i];
+        while (prev != prevMems.end() && prev->pid_ < pid) ++prev;
+        const Impl::ProcessMem *old = prev != prevMems.end() && prev->pid_ == pid ? &*prev : nullptr;
+        if (impl_->filterRejects(pid)) continue;
+
+        // 不在本次扫描范围内且上次排名不靠前的进程沿用上次的记录
+        if (old && old->rss_ < impl_->memHotThreshold_ && !impl_->inScanSlice(i)) {
+            processMems.push_back(*old);
+            continue;
         }
+
+        // 读取/proc/[pid]/statm获取内存信息，resident是实际驻留内存大小(页数)
+        if (!procfs::readFile(impl_->pidPath(pid, "statm"), impl_->readBuffer_)) continue;
+        if (!procfs::parseStatm(impl_->readBuffer_, statm)) continue;
+        processMems.push_back({pid, statm.resident * pageSize});
+    }
+    std::swap(impl_->processMems_, impl_->nextProcessMems_);
+
+    std::pmr::vector<std::pair<uint64_t, int>> memories(&impl_->arena_);  // first: 内存大小(字节), second: pid
+    memories.reserve(impl_->processMems_.size());
+    for (const auto &process : impl_->processMems_) {
+        if (!impl_->filterAccepts(process.pid_, nullptr)) continue;
+        memories.emplace_back(process.rss_, process.pid_);
     }
 
-    // 排序并获取前numProcesses个进程
-    auto deltaCpuTime = cpuTime - impl_->prevCpuTime_.value();
-    int n = 0;
-    for(auto it = topCPUMap.rbegin(); it != topCPUMap.rend() && n < numProcesses; ++it, ++n) {
-        double cpuUsage = it->first / (double)deltaCpuTime;
-        //std::cout << "it->first: " << it->first << " deltaCpuTime: " << deltaCpuTime << std::endl;
-        if(cpuUsage < minCpuUsage) continue;
+    // 记录候选进程的门槛，超出CPU预算时RSS低于它的进程可以少读几次
+    const int numCandidates = std::max(numProcesses * 4, 16);
+    selectTopK(memories, numCandidates, [](const auto &m) { return m.first; });
+    impl_->memHotThreshold_ = memories.size() >= (size_t)numCandidates ? memories.back().first : 0;
 
-        auto pid = it->second;
-        auto cmdline = getCmdLine(pid);
-        topCPUs.emplace_back(fmt::format("CPU: {:.2f}%, CMD: [{}]{}", cpuUsage*100, pid, cmdline));
+    std::pmr::vector<int> rssOnly(&impl_->arena_);
+    if (impl_->memRank_ != MemRank::Rss) {
+        rankBySmaps(memories, numProcesses, rssOnly);
     }
 
-    return topCPUs;
-}
+    // 获取内存占用最高的进程  
+    selectTopK(memories, numProcesses, [](const auto &m) { return m.first; });
+    for (const auto &[memorySize, pid] : memories) {
+        if(memorySize < minMemUsage) continue;
 
+        ProcessSample sample;
+        sample.pid = pid;
+        sample.cmdline = impl_->getCmdLine(pid);
+        sample.memBytes = memorySize;
+        sample.memIsRss = std::ranges::binary_search(rssOnly, pid);
+        topMemories.emplace_back(std::move(sample));
+    }
+
+    return topMemories;
+}
 
 std::vector<std::string> ResourceMonitor::getTopMemProcesses(int numProcesses, uint64_t minMemUsage) {
     std::vector<std::string> topMemories;
+    for (const auto &process : getTopMem(numProcesses, minMemUsage)) {
+        topMemories.emplace_back(formatTopMem(process, impl_->memRank_));
+    }
+    return topMemories;
+}
 
-    // 添加内存统计
-    std::multimap<uint64_t, int> memoryMap;  // key: 内存大小(字节), value: pid
-    for (const auto& entry : fs::directory_iterator("/proc")) {
-        try {
-            std::string pidStr = entry.path().filename();
-            if (std::all_of(pidStr.begin(), pidStr.end(), ::isdigit)) {
-                int pid = std::stoi(pidStr);
-                
-                // 读取/proc/[pid]/statm获取内存信息
-                std::ifstream statmFile(entry.path() / "statm");
-                if (statmFile) {
-                    uint64_t size, resident, shared, text, lib, data, dt;
-                    statmFile >> size >> resident >> shared >> text >> lib >> data >> dt;
-                    
-                    // resident是实际驻留内存大小(页数)
-                    uint64_t rss = resident * sysconf(_SC_PAGESIZE); // 转换为字节
-                    memoryMap.emplace(rss, pid);
-                }
+void ResourceMonitor::rankBySmaps(std::pmr::vector<std::pair<uint64_t, int>> &memories, int numProcesses,
+                                  std::pmr::vector<int> &rssOnly) {
+    // smaps_rollup需要遍历整个地址空间，只读取RSS排名靠前的候选进程
+    const int numCandidates = std::max(numProcesses * 4, 16);
+    selectTopK(memories, numCandidates, [](const auto &m) { return m.first; });
+
+    auto start = std::chrono::steady_clock::now();
+    const auto &cache = impl_->processSmaps_;
+    auto &processSmaps = impl_->nextProcessSmaps_;
+    processSmaps.clear();
+    std::pmr::vector<std::pair<uint64_t, int>> ranked(&impl_->arena_);
+    ranked.reserve(memories.size());
+
+    for (const auto &[rss, pid] : memories) {
+        std::optional<ProcessSmaps> smaps;
+        auto cached = std::ranges::lower_bound(cache, pid, {}, &Impl::CachedSmaps::pid_);
+        bool hasCached = cached != cache.end() && cached->pid_ == pid;
+        // 超出CPU预算时，不在本次扫描范围内的进程即使RSS变化也沿用缓存
+        bool reuse = hasCached && impl_->degraded()
+            && !impl_->inScanSlice(std::ranges::lower_bound(impl_->pids_, pid) - impl_->pids_.begin());
+        if (hasCached && (cached->smaps_.rss_ == rss || reuse)) {
+            smaps = cached->smaps_;
+        } else if (std::chrono::steady_clock::now() - start < impl_->smapsBudget_) {
+            if (procfs::readFile(impl_->pidPath(pid, "smaps_rollup"), impl_->readBuffer_)) {
+                smaps = parseSmapsRollup(impl_->readBuffer_);
+            }
+            // statm与smaps_rollup的RSS统计口径略有差异，缓存键统一使用statm的值
+            if (smaps) smaps->rss_ = rss;
+        } else if (hasCached) {
+            smaps = cached->smaps_;     // 超出预算，沿用上次的值
+        } else {
+            // 超出预算且没有缓存（如新出现的大进程）：读到smaps_rollup之前按RSS排名并标明是RSS，
+            // RSS是PSS/USS的上限，不至于让它从列表中消失；不写入缓存，之后在预算内再读取。
+            // RSS与swap无关，按swap排名时不列出
+            if (impl_->memRank_ != MemRank::Swap) {
+                ranked.emplace_back(rss, pid);
+                rssOnly.push_back(pid);
             }
-        } catch (...) {
             continue;
         }
+        if (!smaps) continue;
+
+        uint64_t value = 0;
+        switch (impl_->memRank_) {
+            case MemRank::Rss: value = rss; break;
+            case MemRank::Pss: value = smaps->pss_; break;
+            case MemRank::Uss: value = smaps->uss_; break;
+            case MemRank::Swap: value = smaps->swap_; break;
+        }
+        ranked.emplace_back(value, pid);
+        processSmaps.push_back({pid, *smaps});
     }
 
-    // 获取内存占用最高的进程  
-    int n = 0;
-    for (auto it = memoryMap.rbegin(); it != memoryMap.rend() && n < numProcesses; ++it, ++n) {
-        auto pid = it->second;
-        auto cmdline = getCmdLine(pid);
-        auto memorySize = it->first;
-        if(memorySize < minMemUsage) continue;
+    // 只保留本次候选进程的缓存，已退出的进程自然被淘汰
+    std::ranges::sort(processSmaps, {}, &Impl::CachedSmaps::pid_);
+    std::swap(impl_->processSmaps_, impl_->nextProcessSmaps_);
+    std::ranges::sort(rssOnly);
+    memories = std::move(ranked);
+}
+
+std::vector<ProcessSample> ResourceMonitor::getTopDisk(int numProcesses, uint64_t minDiskUsage) {
+    auto scope = impl_->profiler_.scope(Collector::TopDisk);
+    TickArenaScope arenaScope(impl_->arena_);
+    std::vector<ProcessSample> topDiskIos;
+
+    // 添加磁盘IO统计  
+    auto now = impl_->now();
+    const auto &prevIos = impl_->processIos_;
+    auto &processIos = impl_->nextProcessIos_;
+    processIos.clear();
+    auto prev = prevIos.begin();
+    procfs::ProcIo io;
+    const auto &pids = impl_->listPids();
+    for (size_t i = 0; i < pids.size(); ++i) {
+        int pid = pids[i];
+        while (prev != prevIos.end() && prev->pid_ < pid) ++prev;
+        const Impl::ProcessIo *old = prev != prevIos.end() && prev->pid_ == pid ? &*prev : nullptr;
+        if (impl_->filterRejects(pid)) continue;
+
+        // 同一次采样中getTopCpu已读过stat时，可以据此判断进程是否运行过
+        const auto *cpu = impl_->findProcessTime(pid);
+        if (old && cpu && cpu->startTime_ != old->startTime_) old = nullptr;   // pid被复用
+
+        if (old && impl_->degraded()) {
+            // 超出CPU预算时跳过此前不活跃的进程：没有运行过的进程不会产生新的IO，
+            // 不在本次扫描范围内且上次IO低于阈值的进程沿用上次的记录
+            if (cpu && cpu->totalTime_ == old->totalTime_) {
+                auto record = *old;
+                record.hasRate_ = true;
+                record.readRate_ = record.writeRate_ = 0;
+                processIos.push_back(record);
+                continue;
+            }
+            if ((!old->hasRate_ || old->readRate_ + old->writeRate_ < minDiskUsage) && !impl_->inScanSlice(i)) {
+                processIos.push_back(*old);
+                continue;
+            }
+        }
 
-        topMemories.emplace_back(fmt::format("MEM: {}, CMD: [{}]{}", 
-            valueToHumanReadable(memorySize), pid, cmdline));
+        // 读取/proc/[pid]/io获取IO信息，其他用户的进程没有权限读取
+        io = {};
+        if (!procfs::readFile(impl_->pidPath(pid, "io"), impl_->readBuffer_)) continue;
+        if (!procfs::parseProcIo(impl_->readBuffer_, io)) continue;
+
+        Impl::ProcessIo record{pid, cpu ? cpu->startTime_ : 0, io.readBytes, io.writeBytes,
+                               cpu ? cpu->totalTime_ : 0, now, false, 0, 0};
+        if (old) {
+            auto periodMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - old->time_).count();
+            if (periodMs <= 0) {
+                processIos.push_back(*old);
+                continue;
+            }
+            record.hasRate_ = true;
+            record.readRate_ = (record.readIo_ - old->readIo_) * 1000.0 / periodMs;
+            record.writeRate_ = (record.writeIo_ - old->writeIo_) * 1000.0 / periodMs;
+        }
+        processIos.push_back(record);
+    }
+    std::swap(impl_->processIos_, impl_->nextProcessIos_);
+
+    // 获取磁盘IO最高的进程，首次读取的进程没有速率
+    std::pmr::vector<std::pair<double, const Impl::ProcessIo *>> ioList(&impl_->arena_);
+    for (const auto &process : impl_->processIos_) {
+        if (!process.hasRate_) continue;
+        auto totalSpeed = process.readRate_ + process.writeRate_;
+        if (totalSpeed < minDiskUsage) continue;
+        if (!impl_->filterAccepts(process.pid_, &process)) continue;
+        ioList.emplace_back(totalSpeed, &process);
+    }
+    selectTopK(ioList, numProcesses, [](const auto &d) { return d.first; });
+    for (const auto &[totalSpeed, process] : ioList) {
+        ProcessSample sample;
+        sample.pid = process->pid_;
+        sample.cmdline = impl_->getCmdLine(process->pid_);
+        sample.readBytesPerSec = process->readRate_;
+        sample.writeBytesPerSec = process->writeRate_;
+        topDiskIos.emplace_back(std::move(sample));
     }
 
-    return topMemories;
+    return topDiskIos;
 }
 
 std::vector<std::string> ResourceMonitor::getTopDiskProcesses(int numProcesses, uint64_t minDiskUsage) {
-    //std::vector<std::string> &topMemories,
     std::vector<std::string> topDiskIos;
+    for (const auto &process : getTopDisk(numProcesses, minDiskUsage)) {
+        topDiskIos.emplace_back(formatTopDisk(process));
+    }
+    return topDiskIos;
+}
 
-    // 添加磁盘IO统计  
-    auto now = std::chrono::steady_clock::now();
-    std::map<int, Impl::ProcessIo> processIos;
-    for (const auto& entry : fs::directory_iterator("/proc")) {
-        try {
-            std::string pidStr = entry.path().filename();
-            if (std::all_of(pidStr.begin(), pidStr.end(), ::isdigit)) {
-                int pid = std::stoi(pidStr);
-                
-                // 读取/proc/[pid]/io获取IO信息
-                std::ifstream ioFile(entry.path() / "io");
-                if (ioFile) {
-                    uint64_t readBytes = 0;
-                    uint64_t writeBytes = 0;
-                    std::string line;
-                    
-                    while (std::getline(ioFile, line)) {
-                        if (line.find("read_bytes:") == 0) {
-                            readBytes = std::stoull(line.substr(11));
-                        } else if (line.find("write_bytes:") == 0) {
-                            writeBytes = std::stoull(line.substr(12));
-                        }
-                    }
-
-                    processIos[pid] = {
-                        pid,
-                        readBytes,
-                        writeBytes
-                    };
-                }
+void ResourceMonitor::setGrouping(GroupBy groupBy, const std::vector<GroupPattern> &patterns) {
+    std::vector<std::string> names, regexes;
+    for (const auto &pattern : patterns) {
+        names.push_back(pattern.name);
+        regexes.push_back(pattern.regex);
+    }
+    auto classifier = std::make_unique<ProcessClassifier>(regexes);
+    impl_->groupBy_ = groupBy;
+    impl_->groupNames_ = std::move(names);
+    impl_->classifier_ = std::move(classifier);
+    for (auto &process : impl_->processTimes_) process.pattern_ = -2;   // 规则变化后重新匹配
+}
+
+// 用户名查不到时（如容器中没有对应的passwd条目）使用数字UID
+const std::string &ResourceMonitor::Impl::userName(uint32_t uid) {
+    auto it = userNames_.find(uid);
+    if (it != userNames_.end()) return it->second;
+
+    std::string name = std::to_string(uid);
+    passwd pw, *result = nullptr;
+    char buffer[1024];
+    if (::getpwuid_r(uid, &pw, buffer, sizeof(buffer), &result) == 0 && result) name = result->pw_name;
+    return userNames_.emplace(uid, std::move(name)).first->second;
+}
+
+// stat中没有UID，首次遇到进程时读取一次/proc/[pid]/status，之后随记录沿用
+int64_t ResourceMonitor::Impl::processUid(ProcessTime &process) {
+    if (process.uid_ < 0) {
+        uint32_t uid = 0;
+        if (procfs::readFile(pidPath(process.pid_, "status"), readBuffer_) && procfs::parseStatusUid(readBuffer_, uid)) {
+            process.uid_ = uid;
+        }
+    }
+    return process.uid_;
+}
+
+// 完整命令行，参数以空格分隔；返回值指向readBuffer_，读取失败（进程已退出）时为nullopt
+std::optional<std::string_view> ResourceMonitor::Impl::readCommandLine(int pid) {
+    if (!procfs::readFile(pidPath(pid, "cmdline"), readBuffer_)) return std::nullopt;
+    while (!readBuffer_.empty() && readBuffer_.back() == '\0') readBuffer_.pop_back();
+    std::replace(readBuffer_.begin(), readBuffer_.end(), '\0', ' ');
+    return std::string_view(readBuffer_);
+}
+
+// 用完整命令行和comm匹配，每个进程只分类一次，结果随记录沿用
+int ResourceMonitor::Impl::processPattern(ProcessTime &process) {
+    if (process.pattern_ != -2) return process.pattern_;
+    if (!classifier_) return process.pattern_ = -1;
+
+    auto cmdline = readCommandLine(process.pid_);
+    process.pattern_ = classifier_->classify(cmdline.value_or(""), process.comm());
+    return process.pattern_;
+}
+
+// 沿ppid向上查找每个进程所属进程树的根（父进程为pid 1或0的祖先），结果为processTimes_中的下标。
+// 已求出的祖先直接复用，整体与进程数成正比；记录来自不同时刻可能成环，限制查找深度
+void ResourceMonitor::Impl::findTreeRoots(std::pmr::vector<int> &roots) const {
+    constexpr size_t kMaxDepth = 64;
+    roots.assign(processTimes_.size(), -1);
+    std::pmr::vector<int> path(roots.get_allocator());
+    for (size_t i = 0; i < processTimes_.size(); ++i) {
+        path.clear();
+        int current = static_cast<int>(i);
+        while (roots[current] < 0 && path.size() < kMaxDepth) {
+            path.push_back(current);
+            const auto &process = processTimes_[current];
+            const ProcessTime *parent = process.ppid_ > 1 ? findProcessTime(process.ppid_) : nullptr;
+            if (!parent) break;
+            current = static_cast<int>(parent - processTimes_.data());
+        }
+        int root = roots[current] >= 0 ? roots[current] : current;
+        for (int index : path) roots[index] = root;
+    }
+}
+
+void ResourceMonitor::setFilter(const std::string &expression) {
+    impl_->filter_ = expression.empty() ? nullptr : std::make_unique<ProcessFilter>(expression);
+    for (auto &process : impl_->processTimes_) process.commandKnown_ = process.commandMatched_ = 0;
+}
+
+// 过滤表达式的字段来源：本次读取的stat记录，按需读取的status/cmdline，以及最近一次的IO记录
+struct ResourceMonitor::Impl::FilterFields : FilterSource {
+    Impl &impl_;
+    ProcessTime &process_;
+    const ProcessIo *io_;
+
+    FilterFields(Impl &impl, ProcessTime &process, const ProcessIo *io)
+        : impl_(impl), process_(process), io_(io) {
+    }
+
+    std::optional<double> number(FilterField field) override {
+        switch (field) {
+            case FilterField::Pid: return process_.pid_;
+            case FilterField::Ppid: return process_.ppid_;
+            case FilterField::Session: return process_.session_;
+            case FilterField::Threads: return (double)process_.threads_;
+            case FilterField::Uid: {
+                auto uid = impl_.processUid(process_);
+                if (uid < 0) return std::nullopt;
+                return (double)uid;
             }
-        } catch (...) {
-            continue;
+            case FilterField::Cpu:
+                if (process_.usage_ < 0) return std::nullopt;
+                return process_.usage_ * 100;
+            case FilterField::Rss: return (double)process_.rss_;
+            case FilterField::Read:
+            case FilterField::Write:
+            case FilterField::Io:
+                if (!io_ || !io_->hasRate_) return std::nullopt;
+                if (field == FilterField::Read) return io_->readRate_;
+                if (field == FilterField::Write) return io_->writeRate_;
+                return io_->readRate_ + io_->writeRate_;
+            default:
+                return std::nullopt;
         }
     }
 
-    OnScopeExit onScopeExit([&]() {
-        impl_->processIoUpdateTime_ = now;
-        impl_->processIos_ = std::move(processIos);
-    });
-    
-    if(!impl_->processIoUpdateTime_.has_value()) {
-        return topDiskIos;
+    std::optional<std::string_view> text(FilterField field) override {
+        if (field == FilterField::Comm) return process_.comm();
+        if (field == FilterField::User) {
+            auto uid = impl_.processUid(process_);
+            if (uid < 0) return std::nullopt;
+            return impl_.userName(static_cast<uint32_t>(uid));
+        }
+        return std::nullopt;
     }
 
-    // 计算间隔时间内的磁盘IO总量 
-    struct IoData {
-        int pid_;
-        uint64_t readBytes_;
-        uint64_t writeBytes_;
-    };
-    std::multimap<uint64_t, IoData> ioMap;  // key: IO读写总量(字节), value: pid
-
-    //std::cout << "processIos = " << processIos.size() << "\n";
-    for(auto &process: processIos) {
-        
-        auto prev = impl_->processIos_.find(process.first);
-        if(prev != impl_->processIos_.end()) {
-            //std::cout << "pid = " << process.first << "\n";
-            auto prevReadBytes = prev->second.readIo_;
-            auto prevWriteBytes = prev->second.writeIo_;
-            auto readBytes = process.second.readIo_;
-            auto writeBytes = process.second.writeIo_;
-            auto deltaReadBytes = readBytes - prevReadBytes;
-            auto deltaWriteBytes = writeBytes - prevWriteBytes;
-            uint64_t totalIO = deltaReadBytes + deltaWriteBytes;
-            //if (totalIO > 0) 
-            {
-                ioMap.emplace(totalIO, IoData{
-                    process.first,
-                    deltaReadBytes,
-                    deltaWriteBytes
-                });
+    std::optional<bool> commandMatches(size_t index) override {
+        uint64_t bit = uint64_t(1) << index;
+        if (!(process_.commandKnown_ & bit)) {
+            auto cmdline = impl_.readCommandLine(process_.pid_);
+            if (!cmdline) return std::nullopt;
+            process_.commandKnown_ |= bit;
+            if (impl_.filter_->matchCommand(index, *cmdline)) process_.commandMatched_ |= bit;
+        }
+        return (process_.commandMatched_ & bit) != 0;
+    }
+};
+
+ProcessFilter::Result ResourceMonitor::Impl::filterProcess(ProcessTime &process, const ProcessIo *io) {
+    FilterFields fields(*this, process, io);
+    return filter_->evaluate(fields);
+}
+
+bool ResourceMonitor::Impl::filterRejects(int pid) {
+    if (!filter_) return false;
+    auto *process = findProcessTime(pid);
+    return process && filterProcess(*process, nullptr) == ProcessFilter::Result::False;
+}
+
+bool ResourceMonitor::Impl::filterAccepts(int pid, const ProcessIo *io) {
+    if (!filter_) return true;
+    auto *process = findProcessTime(pid);
+    if (!process) return false;
+    if (io == nullptr) io = findProcessIo(pid, process->startTime_);
+    return filterProcess(*process, io) == ProcessFilter::Result::True;
+}
+
+namespace {
+
+// 分组键：按comm分组时为{-1, comm}，其余为{uid/会话/根进程/规则下标, 空}
+struct GroupKey {
+    int64_t id;
+    std::string_view name;
+    bool operator==(const GroupKey &) const = default;
+};
+
+struct GroupKeyHash {
+    size_t operator()(const GroupKey &key) const {
+        return std::hash<std::string_view>()(key.name) ^ (static_cast<uint64_t>(key.id) * 0x9e3779b97f4a7c15ull);
+    }
+};
+
+}
+
+std::vector<ProcessGroup> ResourceMonitor::getProcessGroups() {
+    auto scope = impl_->profiler_.scope(Collector::Groups);
+    TickArenaScope arenaScope(impl_->arena_);
+    std::vector<ProcessGroup> groups;
+    if (impl_->groupBy_ == GroupBy::None) return groups;
+
+    auto &processes = impl_->processTimes_;
+    std::pmr::vector<int> roots(&impl_->arena_);
+    if (impl_->groupBy_ == GroupBy::Tree) impl_->findTreeRoots(roots);
+
+    // 哈希聚合：分组键到groups中的下标。内存和IO记录同样按pid排序，与CPU记录归并
+    std::pmr::unordered_map<GroupKey, size_t, GroupKeyHash> table(&impl_->arena_);
+    auto mem = impl_->processMems_.cbegin();
+    auto io = impl_->processIos_.cbegin();
+    for (size_t i = 0; i < processes.size(); ++i) {
+        auto &process = processes[i];
+        while (mem != impl_->processMems_.cend() && mem->pid_ < process.pid_) ++mem;
+        while (io != impl_->processIos_.cend() && io->pid_ < process.pid_) ++io;
+        bool hasIo = io != impl_->processIos_.cend() && io->pid_ == process.pid_
+            && (io->startTime_ == 0 || io->startTime_ == process.startTime_);
+        if (impl_->filter_ && impl_->filterProcess(process, hasIo ? &*io : nullptr) != ProcessFilter::Result::True) continue;
+
+        GroupKey key{-1, process.comm()};
+        const Impl::ProcessTime *leader = nullptr;
+        switch (impl_->groupBy_) {
+            case GroupBy::None:
+            case GroupBy::Comm:
+                break;
+            case GroupBy::User:
+                key = {impl_->processUid(process), {}};
+                break;
+            case GroupBy::Session:
+                key = {process.session_, {}};
+                leader = impl_->findProcessTime(process.session_);
+                break;
+            case GroupBy::Tree:
+                leader = &processes[roots[i]];
+                key = {leader->pid_, {}};
+                break;
+            case GroupBy::Pattern:
+                if (int pattern = impl_->processPattern(process); pattern >= 0) key = {pattern, {}};
+                break;
+        }
+
+        auto [it, inserted] = table.try_emplace(key, groups.size());
+        if (inserted) {
+            auto &group = groups.emplace_back();
+            if (!key.name.empty()) group.name = key.name;
+            else if (impl_->groupBy_ == GroupBy::User) group.name = key.id < 0 ? "?" : impl_->userName(key.id);
+            else if (impl_->groupBy_ == GroupBy::Pattern) group.name = impl_->groupNames_[key.id];
+            else if (leader) group.name = fmt::format("[{}]{}", key.id, leader->comm());
+            else group.name = fmt::format("[{}]", key.id);     // 会话首进程已退出
+        }
+
+        auto &group = groups[it->second];
+        group.processes++;
+        if (process.usage_ > 0) group.cpuPercent += process.usage_ * 100;
+
+        if (mem != impl_->processMems_.cend() && mem->pid_ == process.pid_) group.memBytes += mem->rss_;
+        if (hasIo && io->hasRate_) {
+            group.readBytesPerSec += io->readRate_;
+            group.writeBytesPerSec += io->writeRate_;
+        }
+    }
+    return groups;
+}
+
+// 按key从groups中选出不低于minValue的前numGroups个
+template<typename Key>
+static std::vector<ProcessGroup> selectGroups(const std::vector<ProcessGroup> &groups, int numGroups,
+                                              double minValue, Key key) {
+    std::vector<ProcessGroup> selected;
+    for (const auto &group : groups) {
+        if (key(group) > 0 && key(group) >= minValue) selected.push_back(group);
+    }
+    selectTopK(selected, numGroups, key);
+    return selected;
+}
+
+std::vector<ProcessEntry> ResourceMonitor::getProcessTable() {
+    std::vector<ProcessEntry> table;
+    table.reserve(impl_->processTimes_.size());
+    auto mem = impl_->processMems_.cbegin();
+    auto io = impl_->processIos_.cbegin();
+    for (auto &process : impl_->processTimes_) {
+        while (mem != impl_->processMems_.cend() && mem->pid_ < process.pid_) ++mem;
+        while (io != impl_->processIos_.cend() && io->pid_ < process.pid_) ++io;
+        bool hasIo = io != impl_->processIos_.cend() && io->pid_ == process.pid_
+            && (io->startTime_ == 0 || io->startTime_ == process.startTime_);
+        if (impl_->filter_ && impl_->filterProcess(process, hasIo ? &*io : nullptr) != ProcessFilter::Result::True) continue;
+
+        auto &entry = table.emplace_back();
+        entry.pid = process.pid_;
+        entry.startTime = process.startTime_;
+        entry.comm = process.comm_;
+        if (process.usage_ > 0) entry.cpuPercent = (float)(process.usage_ * 100);
+        entry.rssBytes = mem != impl_->processMems_.cend() && mem->pid_ == process.pid_ ? mem->rss_ : process.rss_;
+        if (hasIo && io->hasRate_) {
+            entry.readBytesPerSec = (float)io->readRate_;
+            entry.writeBytesPerSec = (float)io->writeRate_;
+        }
+    }
+    return table;
+}
+
+// 调用线程已占用的CPU时间。CPU预算只统计采样本身，同一进程中其他线程（指标服务、日志压缩、
+// 嵌入MonitorCore的宿主程序）的负载不计入；sample()可能在不同的线程上调用，按每次调用的前后差值累计
+static std::chrono::nanoseconds threadCpuTime() {
+    timespec ts{};
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+Snapshot ResourceMonitor::sample(const SampleOptions &options) {
+    impl_->updateCpuBudget();
+    auto startCpu = threadCpuTime();
+
+    Snapshot snapshot;
+    {
+        auto scope = impl_->profiler_.scope(Collector::Sample);
+        TickArenaScope arenaScope(impl_->arena_);   // 各采集函数共用，本次采样结束时回收
+        snapshot.time = std::chrono::system_clock::now();
+        const auto &periods = options.periods;
+        const auto &last = impl_->last_;
+        bool carried = impl_->lastTick_ + 1 == impl_->tick_;
+        auto collect = [&](int period) { return period > 0 && (impl_->due(period) || !carried); };
+        if (collect(periods.cpu)) snapshot.cpuPercent = getCpuPercent();
+        else if (periods.cpu > 0) snapshot.cpuPercent = last.cpuPercent;
+
+        if (collect(periods.memory)) snapshot.mem = getMemInfo();
+        else if (periods.memory > 0) snapshot.mem = last.mem;
+
+        if (collect(periods.disks)) {
+            snapshot.disksReady = impl_->diskIoUpdateTime_.has_value();
+            snapshot.disks = getDiskStats();
+        } else if (periods.disks > 0) {
+            snapshot.disksReady = last.disksReady;
+            snapshot.disks = last.disks;
+        }
+
+        // 超出CPU预算时温度等慢速采集按更长的周期执行
+        if (periods.temperatures > 0) {
+            if (impl_->due(periods.temperatures * impl_->slowPeriod_) || !impl_->temperaturesScanned_) {
+                impl_->temperatures_ = getTemperatures();
+                impl_->temperaturesScanned_ = true;
             }
+            snapshot.temperatures = impl_->temperatures_;
+        }
+
+        snapshot.memRank = impl_->memRank_;
+        if (options.numProcesses > 0 && collect(periods.processes)) {
+            Impl::PidListScope pidList(*impl_);     // top-N和分组汇总基于同一份进程列表
+            snapshot.topCpu = getTopCpu(options.numProcesses, options.minCpuUsage);
+            snapshot.topMem = getTopMem(options.numProcesses, options.minMemUsage);
+            snapshot.topDisk = getTopDisk(options.numProcesses, options.minDiskUsage);
+
+            if (impl_->groupBy_ != GroupBy::None) {
+                auto groups = getProcessGroups();
+                snapshot.groupBy = impl_->groupBy_;
+                snapshot.topCpuGroups = selectGroups(groups, options.numProcesses, options.minCpuUsage * 100,
+                    [](const ProcessGroup &g) { return g.cpuPercent; });
+                snapshot.topMemGroups = selectGroups(groups, options.numProcesses, (double)options.minMemUsage,
+                    [](const ProcessGroup &g) { return (double)g.memBytes; });
+                snapshot.topDiskGroups = selectGroups(groups, options.numProcesses, (double)options.minDiskUsage,
+                    [](const ProcessGroup &g) { return g.readBytesPerSec + g.writeBytesPerSec; });
+            }
+            if (options.processTable) {
+                snapshot.processes = std::make_shared<const std::vector<ProcessEntry>>(getProcessTable());
+            }
+        } else if (options.numProcesses > 0 && periods.processes > 0) {
+            snapshot.memRank = last.memRank;
+            snapshot.topCpu = last.topCpu;
+            snapshot.topMem = last.topMem;
+            snapshot.topDisk = last.topDisk;
+            snapshot.groupBy = last.groupBy;
+            snapshot.topCpuGroups = last.topCpuGroups;
+            snapshot.topMemGroups = last.topMemGroups;
+            snapshot.topDiskGroups = last.topDiskGroups;
+            snapshot.processes = last.processes;
+        }
+
+        // 周期都为1时不需要保留副本
+        if (periods.cpu > 1 || periods.memory > 1 || periods.disks > 1 || periods.processes > 1) {
+            impl_->last_ = snapshot;
+            impl_->lastTick_ = impl_->tick_;
         }
     }
-    //std::cout << "ioMap = " << ioMap.size() << "\n";
+    snapshot.collectors = getCollectorStats();
+    snapshot.coverage = getScanCoverage();
+    impl_->sampleCpu_ += threadCpuTime() - startCpu;
+    return snapshot;
+}
 
-    // 获取磁盘IO最高的进程
-    int n = 0;
-    for (auto it = ioMap.rbegin(); it != ioMap.rend() && n < numProcesses; ++it, ++n) {
-        auto pid = it->second.pid_;
-        auto deltaReadBytes = it->second.readBytes_;
-        auto deltaWriteBytes = it->second.writeBytes_;
-        auto totalIO = it->first;
+void ResourceMonitor::prime(const SampleOptions &options) {
+    const auto &periods = options.periods;
+    if (periods.cpu > 0) getCpuPercent();
+    if (periods.disks > 0) getDiskStats();
+    if (options.numProcesses > 0 && periods.processes > 0) {
+        Impl::PidListScope pidList(*impl_);
+        getTopCpu(options.numProcesses, options.minCpuUsage);
+        getTopDisk(options.numProcesses, options.minDiskUsage);
+    }
+}
+
+void ResourceMonitor::setCpuBudget(double percent) {
+    impl_->cpuBudget_ = percent / 100.0;
+    if (percent <= 0) impl_->coverage_ = 1.0;
+}
 
-        auto periodMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - impl_->processIoUpdateTime_.value()).count();
-        auto readSpeed = deltaReadBytes * 1000.0 / periodMs;
-        auto writeSpeed = deltaWriteBytes * 1000.0 / periodMs;
-        auto totalSpeed = readSpeed + writeSpeed;
+ScanCoverage ResourceMonitor::getScanCoverage() const {
+    ScanCoverage coverage;
+    coverage.processes = impl_->pids_.size();
+    coverage.scanned = impl_->scannedPids_;
+    coverage.target = impl_->coverage_;
+    coverage.cpuBudgetPercent = impl_->cpuBudget_ * 100;
+    if (impl_->selfCpu_) coverage.selfCpuPercent = *impl_->selfCpu_ * 100;
+    return coverage;
+}
 
-        if(totalSpeed < minDiskUsage) continue;
+// 每次采样前根据上个周期自身占用的CPU调整扫描比例：
+// 超出预算时按比例收缩，低于预算的80%时缓慢放大，避免来回振荡
+void ResourceMonitor::Impl::updateCpuBudget() {
+    constexpr double kMinCoverage = 1.0 / 64;
 
-        auto cmdline = getCmdLine(pid);
-        
-        topDiskIos.emplace_back(fmt::format("DISK: {}/s+{}/s, CMD: [{}]{}",
-            valueToHumanReadable(readSpeed),
-            valueToHumanReadable(writeSpeed),
-            pid,
-            cmdline));
+    auto wall = std::chrono::steady_clock::now();
+    if (prevBudgetTime_) {
+        auto elapsed = std::chrono::duration<double>(wall - *prevBudgetTime_).count();
+        if (elapsed > 0) selfCpu_ = std::chrono::duration<double>(sampleCpu_).count() / elapsed;
     }
+    prevBudgetTime_ = wall;
+    sampleCpu_ = std::chrono::nanoseconds(0);
+
+    // 下一轮从上一轮扫描范围的末尾开始
+    scanCursor_ += coverage_;
+    if (scanCursor_ >= 1.0) scanCursor_ -= 1.0;
+    ++tick_;
+
+    if (cpuBudget_ <= 0 || !selfCpu_) return;
+    if (*selfCpu_ > cpuBudget_) {
+        coverage_ = std::max(kMinCoverage, coverage_ * cpuBudget_ / *selfCpu_ * 0.9);
+    } else if (*selfCpu_ < cpuBudget_ * 0.8) {
+        coverage_ = std::min(1.0, coverage_ * 1.25);
+    }
+    slowPeriod_ = coverage_ >= 1.0 ? 1 : std::min(16, (int)std::ceil(1.0 / coverage_));
+}
 
-    return topDiskIos;
+CollectorStatsArray ResourceMonitor::getCollectorStats() const {
+    return impl_->profiler_.stats();
 }
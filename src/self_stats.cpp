@@ -0,0 +1,69 @@
+#include "self_stats.h"
+#include "procfs.h"
+#include <algorithm>
+#include <cmath>
+
+std::string_view collectorName(Collector collector) {
+    switch (collector) {
+        case Collector::Cpu:         return "cpu";
+        case Collector::Memory:      return "memory";
+        case Collector::Disk:        return "disk";
+        case Collector::Temperature: return "temperature";
+        case Collector::TopCpu:      return "top_cpu";
+        case Collector::TopMem:      return "top_mem";
+        case Collector::TopDisk:     return "top_disk";
+        case Collector::Groups:      return "groups";
+        case Collector::Sample:      return "sample";
+    }
+    return "unknown";
+}
+
+uint64_t &threadAllocations() {
+    static thread_local uint64_t s_allocations = 0;
+    return s_allocations;
+}
+
+SelfProfiler::Scope::Scope(SelfProfiler &profiler, Collector collector)
+    : profiler_(profiler),
+      collector_(collector),
+      start_(std::chrono::steady_clock::now()),
+      opens_(procfs::ioCounters().opens),
+      bytesRead_(procfs::ioCounters().bytesRead),
+      allocations_(threadAllocations()) {
+}
+
+SelfProfiler::Scope::~Scope() {
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+    auto &history = profiler_.histories_[static_cast<size_t>(collector_)];
+    auto &stats = history.stats;
+    history.latencies[stats.calls % kWindow] = ms;
+    stats.calls++;
+    stats.totalMs += ms;
+    stats.lastMs = ms;
+    stats.opens = procfs::ioCounters().opens - opens_;
+    stats.bytesRead = procfs::ioCounters().bytesRead - bytesRead_;
+    stats.allocations = threadAllocations() - allocations_;
+}
+
+CollectorStatsArray SelfProfiler::stats() const {
+    CollectorStatsArray result;
+    std::array<double, kWindow> sorted;
+    for (size_t i = 0; i < kCollectorCount; ++i) {
+        const auto &history = histories_[i];
+        result[i] = history.stats;
+
+        size_t count = std::min<uint64_t>(history.stats.calls, kWindow);
+        if (count == 0) continue;
+        std::copy_n(history.latencies.begin(), count, sorted.begin());
+        // 最近邻秩法：第ceil(q*n)小的值
+        auto quantile = [&](double q) {
+            size_t rank = static_cast<size_t>(std::ceil(q * count));
+            auto nth = sorted.begin() + (rank > 0 ? rank - 1 : 0);
+            std::nth_element(sorted.begin(), nth, sorted.begin() + count);
+            return *nth;
+        };
+        result[i].p50Ms = quantile(0.50);
+        result[i].p99Ms = quantile(0.99);
+    }
+    return result;
+}
@@ -0,0 +1,148 @@
+#include "shm_exporter.h"
+#include "shm_snapshot.h"
+#include <spdlog/spdlog.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <stdexcept>
+
+namespace {
+
+template <size_t N>
+void copyName(char (&out)[N], std::string_view name) {
+    auto size = std::min(name.size(), N - 1);
+    std::memcpy(out, name.data(), size);
+    out[size] = '\0';
+}
+
+uint32_t copyProcesses(shm::Process (&out)[shm::kMaxProcesses], const std::vector<ProcessSample> &processes) {
+    auto count = std::min(processes.size(), shm::kMaxProcesses);
+    for (size_t i = 0; i < count; ++i) {
+        const auto &process = processes[i];
+        auto &record = out[i];
+        record.pid = process.pid;
+        record.cpuPercent = process.cpuPercent;
+        record.memBytes = process.memBytes;
+        record.readBytesPerSec = process.readBytesPerSec;
+        record.writeBytesPerSec = process.writeBytesPerSec;
+        copyName(record.command, process.cmdline);
+    }
+    return count;
+}
+
+// 暂存区事先清零，只覆盖有效部分，计数之外的旧内容读取方不会使用
+void convert(const PublishedSnapshot &published, shm::Snapshot &out) {
+    const auto &snapshot = published.snapshot;
+    out.timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(snapshot.time.time_since_epoch()).count();
+    out.generation = published.generation;
+    out.hasCpu = snapshot.cpuPercent.has_value();
+    out.cpuPercent = snapshot.cpuPercent.value_or(0);
+
+    const auto &mem = snapshot.mem;
+    out.mem.total = mem.total;
+    out.mem.used = mem.used();
+    out.mem.free = mem.free;
+    out.mem.available = mem.available;
+    out.mem.buffers = mem.buffers;
+    out.mem.cached = mem.cached;
+    out.mem.shmem = mem.shmem;
+    out.mem.slab = mem.slab;
+    out.mem.dirty = mem.dirty;
+    out.mem.writeback = mem.writeback;
+    out.mem.swapTotal = mem.swapTotal;
+    out.mem.swapFree = mem.swapFree;
+
+    out.disksReady = snapshot.disksReady;
+    out.diskCount = std::min(snapshot.disks.size(), shm::kMaxDisks);
+    for (size_t i = 0; i < out.diskCount; ++i) {
+        const auto &disk = snapshot.disks[i];
+        auto &record = out.disks[i];
+        copyName(record.name, disk.name);
+        record.readBytesPerSec = disk.readBytesPerSec;
+        record.writeBytesPerSec = disk.writeBytesPerSec;
+        record.readIops = disk.readIops;
+        record.writeIops = disk.writeIops;
+        record.readAwaitMs = disk.readAwaitMs;
+        record.writeAwaitMs = disk.writeAwaitMs;
+        record.busyPercent = disk.busyPercent;
+        record.avgQueueSize = disk.avgQueueSize;
+        record.inFlight = disk.inFlight;
+    }
+
+    out.memRank = static_cast<uint32_t>(snapshot.memRank);
+    out.topCpuCount = copyProcesses(out.topCpu, snapshot.topCpu);
+    out.topMemCount = copyProcesses(out.topMem, snapshot.topMem);
+    out.topDiskCount = copyProcesses(out.topDisk, snapshot.topDisk);
+}
+
+}
+
+struct ShmExporter::Impl {
+    std::string name_;
+    shm::Segment *segment_ = nullptr;
+    std::unique_ptr<shm::Snapshot> staging_;    // 约20KB，放在堆上
+    std::thread thread_;
+
+    void run(const SnapshotChannel &channel);
+};
+
+ShmExporter::ShmExporter()
+    : impl_(new Impl) {
+}
+
+ShmExporter::~ShmExporter() {
+    stop();
+}
+
+void ShmExporter::start(const std::string &name, const SnapshotChannel &channel) {
+    // 先删除再创建：上次异常退出残留的段可能仍被旧的读取方映射，不能在原处改写布局
+    ::shm_unlink(name.c_str());
+    int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) throw std::runtime_error(fmt::format("shm_open {}: {}", name, strerror(errno)));
+    if (::ftruncate(fd, sizeof(shm::Segment)) < 0) {
+        int err = errno;
+        ::close(fd);
+        ::shm_unlink(name.c_str());
+        throw std::runtime_error(fmt::format("ftruncate {}: {}", name, strerror(err)));
+    }
+    void *address = ::mmap(nullptr, sizeof(shm::Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int err = errno;
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        ::shm_unlink(name.c_str());
+        throw std::runtime_error(fmt::format("mmap {}: {}", name, strerror(err)));
+    }
+
+    // ftruncate后内容全为0，序号0表示尚未发布；magic最后写入，读取方看到它时其余头部已就绪
+    auto *segment = new (address) shm::Segment();
+    segment->version = shm::kVersion;
+    segment->snapshotSize = sizeof(shm::Snapshot);
+    segment->writerPid = ::getpid();
+    std::atomic_thread_fence(std::memory_order_release);
+    segment->magic = shm::kMagic;
+
+    impl_->name_ = name;
+    impl_->segment_ = segment;
+    impl_->staging_ = std::make_unique<shm::Snapshot>();
+    impl_->thread_ = std::thread([this, &channel] { impl_->run(channel); });
+}
+
+void ShmExporter::stop() {
+    if (!impl_->thread_.joinable()) return;
+    impl_->thread_.join();
+    ::munmap(impl_->segment_, sizeof(shm::Segment));
+    ::shm_unlink(impl_->name_.c_str());
+    impl_->segment_ = nullptr;
+}
+
+void ShmExporter::Impl::run(const SnapshotChannel &channel) {
+    SnapshotReader reader(channel);
+    while (auto published = reader.next()) {
+        convert(*published, *staging_);
+        shm::publish(*segment_, *staging_);
+    }
+}
@@ -0,0 +1,52 @@
+#include "snapshot_channel.h"
+
+void SnapshotChannel::publish(Snapshot snapshot) {
+    auto generation = (state_.load(std::memory_order_relaxed) & ~kClosed) + 1;
+    latest_.store(std::make_shared<const PublishedSnapshot>(PublishedSnapshot{generation, std::move(snapshot)}),
+        std::memory_order_release);
+    state_.fetch_add(1, std::memory_order_release);
+    state_.notify_all();
+}
+
+std::shared_ptr<const PublishedSnapshot> SnapshotChannel::latest() const {
+    return latest_.load(std::memory_order_acquire);
+}
+
+uint64_t SnapshotChannel::generation() const {
+    return state_.load(std::memory_order_acquire) & ~kClosed;
+}
+
+uint64_t SnapshotChannel::waitNext(uint64_t after) const {
+    for (;;) {
+        auto state = state_.load(std::memory_order_acquire);
+        if ((state & kClosed) || (state & ~kClosed) > after) return state & ~kClosed;
+        state_.wait(state, std::memory_order_acquire);
+    }
+}
+
+void SnapshotChannel::close() {
+    state_.fetch_or(kClosed, std::memory_order_release);
+    state_.notify_all();
+}
+
+bool SnapshotChannel::closed() const {
+    return state_.load(std::memory_order_acquire) & kClosed;
+}
+
+std::shared_ptr<const PublishedSnapshot> SnapshotReader::poll(uint64_t *missed) {
+    if (channel_.generation() == lastGeneration_) return nullptr;
+
+    auto snapshot = channel_.latest();
+    if (!snapshot || snapshot->generation == lastGeneration_) return nullptr;
+    if (missed) *missed = lastGeneration_ ? snapshot->generation - lastGeneration_ - 1 : 0;
+    lastGeneration_ = snapshot->generation;
+    return snapshot;
+}
+
+std::shared_ptr<const PublishedSnapshot> SnapshotReader::next(uint64_t *missed) {
+    for (;;) {
+        if (auto snapshot = poll(missed)) return snapshot;
+        if (channel_.closed()) return nullptr;
+        channel_.waitNext(lastGeneration_);
+    }
+}
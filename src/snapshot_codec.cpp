@@ -0,0 +1,304 @@
+#include "snapshot_codec.h"
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+constexpr double kPercent = 100;
+constexpr double kRate = 1;
+constexpr double kCount = 100;
+constexpr double kMs = 1000;
+constexpr double kCelsius = 1000;
+
+class Writer {
+public:
+    explicit Writer(std::string &output) : output_(output) {}
+
+    void unsignedValue(uint64_t value) {
+        while (value >= 0x80) {
+            output_.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        output_.push_back(static_cast<char>(value));
+    }
+
+    void signedValue(int64_t value) {
+        unsignedValue((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    void fixed(double value, double scale) {
+        signedValue(std::llround(value * scale));
+    }
+
+    void optionalFixed(const std::optional<double> &value, double scale) {
+        unsignedValue(value.has_value());
+        if (value) fixed(*value, scale);
+    }
+
+    void string(std::string_view value) {
+        unsignedValue(value.size());
+        output_.append(value);
+    }
+
+private:
+    std::string &output_;
+};
+
+class Reader {
+public:
+    explicit Reader(std::string_view &input) : input_(input) {}
+
+    uint64_t unsignedValue() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (input_.empty()) truncated();
+            auto byte = static_cast<uint8_t>(input_.front());
+            input_.remove_prefix(1);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        throw std::runtime_error("snapshot: invalid varint");
+    }
+
+    int64_t signedValue() {
+        auto value = unsignedValue();
+        return static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+    }
+
+    double fixed(double scale) {
+        return signedValue() / scale;
+    }
+
+    std::optional<double> optionalFixed(double scale) {
+        if (!unsignedValue()) return std::nullopt;
+        return fixed(scale);
+    }
+
+    std::string string() {
+        auto size = unsignedValue();
+        if (size > input_.size()) truncated();
+        std::string value(input_.substr(0, size));
+        input_.remove_prefix(size);
+        return value;
+    }
+
+    template <typename E>
+    E enumValue(E last) {
+        auto value = unsignedValue();
+        if (value > static_cast<uint64_t>(last)) throw std::runtime_error("snapshot: invalid enum value");
+        return static_cast<E>(value);
+    }
+
+    // 列表长度，每个元素至少占一个字节，据此拒绝明显损坏的长度
+    size_t count() {
+        auto size = unsignedValue();
+        if (size > input_.size()) truncated();
+        return size;
+    }
+
+private:
+    [[noreturn]] static void truncated() {
+        throw std::runtime_error("snapshot: truncated data");
+    }
+
+    std::string_view &input_;
+};
+
+void writeProcesses(Writer &w, const std::vector<ProcessSample> &processes) {
+    w.unsignedValue(processes.size());
+    for (const auto &p : processes) {
+        w.signedValue(p.pid);
+        w.string(p.cmdline);
+        w.fixed(p.cpuPercent, kPercent);
+        w.unsignedValue(p.memBytes);
+        w.fixed(p.readBytesPerSec, kRate);
+        w.fixed(p.writeBytesPerSec, kRate);
+    }
+}
+
+std::vector<ProcessSample> readProcesses(Reader &r) {
+    std::vector<ProcessSample> processes(r.count());
+    for (auto &p : processes) {
+        p.pid = r.signedValue();
+        p.cmdline = r.string();
+        p.cpuPercent = r.fixed(kPercent);
+        p.memBytes = r.unsignedValue();
+        p.readBytesPerSec = r.fixed(kRate);
+        p.writeBytesPerSec = r.fixed(kRate);
+    }
+    return processes;
+}
+
+void writeGroups(Writer &w, const std::vector<ProcessGroup> &groups) {
+    w.unsignedValue(groups.size());
+    for (const auto &g : groups) {
+        w.string(g.name);
+        w.unsignedValue(g.processes);
+        w.fixed(g.cpuPercent, kPercent);
+        w.unsignedValue(g.memBytes);
+        w.fixed(g.readBytesPerSec, kRate);
+        w.fixed(g.writeBytesPerSec, kRate);
+    }
+}
+
+std::vector<ProcessGroup> readGroups(Reader &r) {
+    std::vector<ProcessGroup> groups(r.count());
+    for (auto &g : groups) {
+        g.name = r.string();
+        g.processes = r.unsignedValue();
+        g.cpuPercent = r.fixed(kPercent);
+        g.memBytes = r.unsignedValue();
+        g.readBytesPerSec = r.fixed(kRate);
+        g.writeBytesPerSec = r.fixed(kRate);
+    }
+    return groups;
+}
+
+int64_t toMs(std::chrono::system_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+}
+
+std::chrono::system_clock::time_point fromMs(int64_t ms) {
+    return std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::milliseconds(ms)));
+}
+
+}
+
+void encodeSnapshot(const Snapshot &snapshot, std::string &output) {
+    Writer w(output);
+    w.signedValue(toMs(snapshot.time));
+    w.optionalFixed(snapshot.cpuPercent, kPercent);
+
+    const auto &mem = snapshot.mem;
+    for (auto value : {mem.total, mem.free, mem.available, mem.buffers, mem.cached, mem.swapCached,
+                       mem.active, mem.inactive, mem.shmem, mem.slab, mem.sReclaimable, mem.sUnreclaim,
+                       mem.dirty, mem.writeback, mem.anonPages, mem.mapped, mem.swapTotal, mem.swapFree,
+                       mem.hugePagesTotal, mem.hugePagesFree, mem.hugePageSize, mem.hugetlb}) {
+        w.unsignedValue(value);
+    }
+    w.unsignedValue(mem.hasAvailable);
+
+    w.unsignedValue(snapshot.disksReady);
+    w.unsignedValue(snapshot.disks.size());
+    for (const auto &d : snapshot.disks) {
+        w.string(d.name);
+        w.unsignedValue(static_cast<uint64_t>(d.kind));
+        w.fixed(d.readBytesPerSec, kRate);
+        w.fixed(d.writeBytesPerSec, kRate);
+        w.fixed(d.readIops, kCount);
+        w.fixed(d.writeIops, kCount);
+        w.fixed(d.readAwaitMs, kMs);
+        w.fixed(d.writeAwaitMs, kMs);
+        w.fixed(d.busyPercent, kPercent);
+        w.fixed(d.avgQueueSize, kCount);
+        w.unsignedValue(d.inFlight);
+    }
+
+    w.unsignedValue(snapshot.temperatures.size());
+    for (const auto &t : snapshot.temperatures) {
+        w.string(t.hwmon);
+        w.string(t.chip);
+        w.unsignedValue(t.pciAdapter);
+        w.string(t.label);
+        w.fixed(t.celsius, kCelsius);
+        w.optionalFixed(t.high, kCelsius);
+        w.optionalFixed(t.crit, kCelsius);
+    }
+
+    w.unsignedValue(static_cast<uint64_t>(snapshot.memRank));
+    writeProcesses(w, snapshot.topCpu);
+    writeProcesses(w, snapshot.topMem);
+    writeProcesses(w, snapshot.topDisk);
+
+    w.unsignedValue(static_cast<uint64_t>(snapshot.groupBy));
+    writeGroups(w, snapshot.topCpuGroups);
+    writeGroups(w, snapshot.topMemGroups);
+    writeGroups(w, snapshot.topDiskGroups);
+
+    w.unsignedValue(snapshot.watched.size());
+    for (const auto &p : snapshot.watched) {
+        w.signedValue(p.pid);
+        w.string(p.cmdline);
+        w.unsignedValue(p.hasIo | (p.exited << 1));
+        w.unsignedValue(p.points.size());
+        for (const auto &point : p.points) {
+            w.signedValue(toMs(point.time));
+            w.fixed(point.cpuPercent, kPercent);
+            w.unsignedValue(point.rssBytes);
+            w.fixed(point.readBytesPerSec, kRate);
+            w.fixed(point.writeBytesPerSec, kRate);
+        }
+    }
+}
+
+Snapshot decodeSnapshot(std::string_view &input) {
+    Reader r(input);
+    Snapshot snapshot;
+    snapshot.time = fromMs(r.signedValue());
+    snapshot.cpuPercent = r.optionalFixed(kPercent);
+
+    auto &mem = snapshot.mem;
+    for (auto *value : {&mem.total, &mem.free, &mem.available, &mem.buffers, &mem.cached, &mem.swapCached,
+                        &mem.active, &mem.inactive, &mem.shmem, &mem.slab, &mem.sReclaimable, &mem.sUnreclaim,
+                        &mem.dirty, &mem.writeback, &mem.anonPages, &mem.mapped, &mem.swapTotal, &mem.swapFree,
+                        &mem.hugePagesTotal, &mem.hugePagesFree, &mem.hugePageSize, &mem.hugetlb}) {
+        *value = r.unsignedValue();
+    }
+    mem.hasAvailable = r.unsignedValue();
+
+    snapshot.disksReady = r.unsignedValue();
+    snapshot.disks.resize(r.count());
+    for (auto &d : snapshot.disks) {
+        d.name = r.string();
+        d.kind = r.enumValue(DiskStat::Kind::Stacked);
+        d.readBytesPerSec = r.fixed(kRate);
+        d.writeBytesPerSec = r.fixed(kRate);
+        d.readIops = r.fixed(kCount);
+        d.writeIops = r.fixed(kCount);
+        d.readAwaitMs = r.fixed(kMs);
+        d.writeAwaitMs = r.fixed(kMs);
+        d.busyPercent = r.fixed(kPercent);
+        d.avgQueueSize = r.fixed(kCount);
+        d.inFlight = r.unsignedValue();
+    }
+
+    snapshot.temperatures.resize(r.count());
+    for (auto &t : snapshot.temperatures) {
+        t.hwmon = r.string();
+        t.chip = r.string();
+        t.pciAdapter = r.unsignedValue();
+        t.label = r.string();
+        t.celsius = r.fixed(kCelsius);
+        t.high = r.optionalFixed(kCelsius);
+        t.crit = r.optionalFixed(kCelsius);
+    }
+
+    snapshot.memRank = r.enumValue(MemRank::Swap);
+    snapshot.topCpu = readProcesses(r);
+    snapshot.topMem = readProcesses(r);
+    snapshot.topDisk = readProcesses(r);
+
+    snapshot.groupBy = r.enumValue(GroupBy::Pattern);
+    snapshot.topCpuGroups = readGroups(r);
+    snapshot.topMemGroups = readGroups(r);
+    snapshot.topDiskGroups = readGroups(r);
+
+    snapshot.watched.resize(r.count());
+    for (auto &p : snapshot.watched) {
+        p.pid = r.signedValue();
+        p.cmdline = r.string();
+        auto flags = r.unsignedValue();
+        p.hasIo = flags & 1;
+        p.exited = flags & 2;
+        p.points.resize(r.count());
+        for (auto &point : p.points) {
+            point.time = fromMs(r.signedValue());
+            point.cpuPercent = r.fixed(kPercent);
+            point.rssBytes = r.unsignedValue();
+            point.readBytesPerSec = r.fixed(kRate);
+            point.writeBytesPerSec = r.fixed(kRate);
+        }
+    }
+    return snapshot;
+}
@@ -0,0 +1,376 @@
+#include "structured_report.h"
+#include "report.h"
+#include <cmath>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+int64_t timeMs(std::chrono::system_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+}
+
+// 与--mem-rank的取值相同
+std::string_view memRankName(MemRank rank) {
+    switch (rank) {
+        case MemRank::Pss: return "pss";
+        case MemRank::Uss: return "uss";
+        case MemRank::Swap: return "swap";
+        default: return "rss";
+    }
+}
+
+// value开头一个完整的UTF-8字符的长度，不是合法的UTF-8（截断、过长编码、代理项、超出U+10FFFF）时返回0
+size_t utf8Length(std::string_view value) {
+    auto byte = [&](size_t i) { return static_cast<unsigned char>(value[i]); };
+    unsigned char lead = byte(0);
+    size_t length;
+    unsigned char low = 0x80, high = 0xbf;  // 第二个字节的范围
+    if (lead < 0x80) return 1;
+    else if (lead >= 0xc2 && lead <= 0xdf) length = 2;
+    else if (lead >= 0xe0 && lead <= 0xef) {
+        length = 3;
+        if (lead == 0xe0) low = 0xa0;
+        else if (lead == 0xed) high = 0x9f;
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+        length = 4;
+        if (lead == 0xf0) low = 0x90;
+        else if (lead == 0xf4) high = 0x8f;
+    } else {
+        return 0;
+    }
+    if (value.size() < length || byte(1) < low || byte(1) > high) return 0;
+    for (size_t i = 2; i < length; ++i) {
+        if (byte(i) < 0x80 || byte(i) > 0xbf) return 0;
+    }
+    return length;
+}
+
+// JSON字符串：双引号、反斜杠和控制字符转义。命令行和进程名是任意字节，
+// 不是合法UTF-8的字节逐个替换为U+FFFD，保证每行都能被严格的解析器读取
+void appendJsonString(fmt::memory_buffer &buf, std::string_view value) {
+    buf.push_back('"');
+    while (!value.empty()) {
+        char c = value.front();
+        if (static_cast<unsigned char>(c) >= 0x80) {
+            size_t length = utf8Length(value);
+            if (length == 0) {
+                buf.append(std::string_view("\ufffd"));
+                length = 1;
+            } else {
+                buf.append(value.substr(0, length));
+            }
+            value.remove_prefix(length);
+            continue;
+        }
+        value.remove_prefix(1);
+        switch (c) {
+            case '"':  buf.append(std::string_view("\\\"")); break;
+            case '\\': buf.append(std::string_view("\\\\")); break;
+            case '\n': buf.append(std::string_view("\\n")); break;
+            case '\t': buf.append(std::string_view("\\t")); break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    fmt::format_to(std::back_inserter(buf), "\\u{:04x}", static_cast<unsigned char>(c));
+                } else {
+                    buf.push_back(c);
+                }
+                break;
+        }
+    }
+    buf.push_back('"');
+}
+
+// JSON没有inf和nan，输出为null
+void appendJsonNumber(fmt::memory_buffer &buf, double value) {
+    if (std::isfinite(value)) fmt::format_to(std::back_inserter(buf), "{}", value);
+    else buf.append(std::string_view("null"));
+}
+
+void appendJsonNumber(fmt::memory_buffer &buf, const std::optional<double> &value) {
+    if (value) appendJsonNumber(buf, *value);
+    else buf.append(std::string_view("null"));
+}
+
+void appendJsonProcesses(fmt::memory_buffer &buf, std::string_view key, const std::vector<ProcessSample> &processes) {
+    auto out = std::back_inserter(buf);
+    fmt::format_to(out, ",\"{}\":[", key);
+    for (size_t i = 0; i < processes.size(); ++i) {
+        const auto &process = processes[i];
+        fmt::format_to(out, "{}{{\"pid\":{},\"cmd\":", i ? "," : "", process.pid);
+        appendJsonString(buf, process.cmdline);
+        buf.append(std::string_view(",\"cpu_percent\":"));
+        appendJsonNumber(buf, process.cpuPercent);
+        fmt::format_to(out, ",\"mem_bytes\":{},", process.memBytes);
+        if (process.memIsRss) buf.append(std::string_view("\"mem_is_rss\":true,"));
+        buf.append(std::string_view("\"read_bytes_per_sec\":"));
+        appendJsonNumber(buf, process.readBytesPerSec);
+        buf.append(std::string_view(",\"write_bytes_per_sec\":"));
+        appendJsonNumber(buf, process.writeBytesPerSec);
+        buf.push_back('}');
+    }
+    buf.push_back(']');
+}
+
+void appendJsonGroups(fmt::memory_buffer &buf, std::string_view key, const std::vector<ProcessGroup> &groups) {
+    auto out = std::back_inserter(buf);
+    fmt::format_to(out, ",\"{}\":[", key);
+    for (size_t i = 0; i < groups.size(); ++i) {
+        const auto &group = groups[i];
+        if (i) buf.push_back(',');
+        buf.append(std::string_view("{\"name\":"));
+        appendJsonString(buf, group.name);
+        fmt::format_to(out, ",\"processes\":{},\"cpu_percent\":", group.processes);
+        appendJsonNumber(buf, group.cpuPercent);
+        fmt::format_to(out, ",\"mem_bytes\":{},\"read_bytes_per_sec\":", group.memBytes);
+        appendJsonNumber(buf, group.readBytesPerSec);
+        buf.append(std::string_view(",\"write_bytes_per_sec\":"));
+        appendJsonNumber(buf, group.writeBytesPerSec);
+        buf.push_back('}');
+    }
+    buf.push_back(']');
+}
+
+// CSV字段：含逗号、双引号或换行时加双引号，内部的双引号写两次
+void appendCsvField(fmt::memory_buffer &buf, std::string_view value) {
+    if (value.find_first_of(",\"\r\n") == std::string_view::npos) {
+        buf.append(value);
+        return;
+    }
+    buf.push_back('"');
+    for (char c : value) {
+        if (c == '"') buf.push_back('"');
+        buf.push_back(c);
+    }
+    buf.push_back('"');
+}
+
+// 一份快照中的行共用时间、section、pid和name，逐个字段追加
+struct CsvRows {
+    fmt::memory_buffer &buf;
+    int64_t time;
+    std::string_view section;
+    int pid;                    // 0为不是进程
+    std::string_view name;
+
+    CsvRows(fmt::memory_buffer &buf, int64_t time, std::string_view section, int pid = 0, std::string_view name = {})
+        : buf(buf), time(time), section(section), pid(pid), name(name) {}
+
+    void row(std::string_view field, double value) const {
+        if (!std::isfinite(value)) return;
+        prefix(field);
+        fmt::format_to(std::back_inserter(buf), "{}\n", value);
+    }
+
+    void row(std::string_view field, uint64_t value) const {
+        prefix(field);
+        fmt::format_to(std::back_inserter(buf), "{}\n", value);
+    }
+
+    void prefix(std::string_view field) const {
+        auto out = std::back_inserter(buf);
+        fmt::format_to(out, "{},{},", time, section);
+        if (pid != 0) fmt::format_to(out, "{}", pid);
+        buf.push_back(',');
+        appendCsvField(buf, name);
+        fmt::format_to(out, ",{},", field);
+    }
+};
+
+void appendCsvProcesses(fmt::memory_buffer &buf, int64_t time, std::string_view section,
+        const std::vector<ProcessSample> &processes) {
+    for (const auto &process : processes) {
+        CsvRows rows{buf, time, section, process.pid, process.cmdline};
+        rows.row("cpu_percent", process.cpuPercent);
+        rows.row("mem_bytes", process.memBytes);
+        if (process.memIsRss) rows.row("mem_is_rss", uint64_t{1});
+        rows.row("read_bytes_per_sec", process.readBytesPerSec);
+        rows.row("write_bytes_per_sec", process.writeBytesPerSec);
+    }
+}
+
+void appendCsvGroups(fmt::memory_buffer &buf, int64_t time, std::string_view section,
+        const std::vector<ProcessGroup> &groups) {
+    for (const auto &group : groups) {
+        CsvRows rows{buf, time, section, 0, group.name};
+        rows.row("processes", static_cast<uint64_t>(group.processes));
+        rows.row("cpu_percent", group.cpuPercent);
+        rows.row("mem_bytes", group.memBytes);
+        rows.row("read_bytes_per_sec", group.readBytesPerSec);
+        rows.row("write_bytes_per_sec", group.writeBytesPerSec);
+    }
+}
+
+}
+
+OutputFormat parseOutputFormat(std::string_view text) {
+    if (text == "text") return OutputFormat::Text;
+    if (text == "json") return OutputFormat::Json;
+    if (text == "csv") return OutputFormat::Csv;
+    throw std::invalid_argument(fmt::format("unknown format: {}", text));
+}
+
+void appendJson(const Snapshot &snapshot, fmt::memory_buffer &buf) {
+    auto out = std::back_inserter(buf);
+    fmt::format_to(out, "{{\"time_ms\":{},\"cpu_percent\":", timeMs(snapshot.time));
+    appendJsonNumber(buf, snapshot.cpuPercent);
+
+    const auto &mem = snapshot.mem;
+    fmt::format_to(out, ",\"mem\":{{\"total\":{},\"used\":{},\"free\":{},\"available\":{},\"buffers\":{},"
+        "\"cached\":{},\"shmem\":{},\"slab\":{},\"slab_reclaimable\":{},\"dirty\":{},\"writeback\":{},"
+        "\"hugetlb\":{},\"swap_total\":{},\"swap_used\":{}}}",
+        mem.total, mem.used(), mem.free, mem.available, mem.buffers, mem.cached, mem.shmem, mem.slab,
+        mem.sReclaimable, mem.dirty, mem.writeback, mem.hugetlb, mem.swapTotal, mem.swapUsed());
+
+    buf.append(std::string_view(",\"disks\":"));
+    if (!snapshot.disksReady) {
+        buf.append(std::string_view("null"));
+    } else {
+        buf.push_back('[');
+        for (size_t i = 0; i < snapshot.disks.size(); ++i) {
+            const auto &disk = snapshot.disks[i];
+            if (i) buf.push_back(',');
+            buf.append(std::string_view("{\"name\":"));
+            appendJsonString(buf, disk.name);
+            fmt::format_to(out, ",\"kind\":\"{}\",\"read_bytes_per_sec\":",
+                disk.kind == DiskStat::Kind::Stacked ? "stacked" : "disk");
+            appendJsonNumber(buf, disk.readBytesPerSec);
+            buf.append(std::string_view(",\"write_bytes_per_sec\":"));
+            appendJsonNumber(buf, disk.writeBytesPerSec);
+            buf.append(std::string_view(",\"read_iops\":"));
+            appendJsonNumber(buf, disk.readIops);
+            buf.append(std::string_view(",\"write_iops\":"));
+            appendJsonNumber(buf, disk.writeIops);
+            buf.append(std::string_view(",\"read_await_ms\":"));
+            appendJsonNumber(buf, disk.readAwaitMs);
+            buf.append(std::string_view(",\"write_await_ms\":"));
+            appendJsonNumber(buf, disk.writeAwaitMs);
+            buf.append(std::string_view(",\"busy_percent\":"));
+            appendJsonNumber(buf, disk.busyPercent);
+            buf.append(std::string_view(",\"queue_size\":"));
+            appendJsonNumber(buf, disk.avgQueueSize);
+            fmt::format_to(out, ",\"in_flight\":{}}}", disk.inFlight);
+        }
+        buf.push_back(']');
+    }
+
+    buf.append(std::string_view(",\"temperatures\":["));
+    for (size_t i = 0; i < snapshot.temperatures.size(); ++i) {
+        const auto &reading = snapshot.temperatures[i];
+        if (i) buf.push_back(',');
+        buf.append(std::string_view("{\"hwmon\":"));
+        appendJsonString(buf, reading.hwmon);
+        buf.append(std::string_view(",\"chip\":"));
+        appendJsonString(buf, reading.chip);
+        buf.append(std::string_view(",\"label\":"));
+        appendJsonString(buf, reading.label);
+        buf.append(std::string_view(",\"celsius\":"));
+        appendJsonNumber(buf, reading.celsius);
+        buf.append(std::string_view(",\"high\":"));
+        appendJsonNumber(buf, reading.high);
+        buf.append(std::string_view(",\"crit\":"));
+        appendJsonNumber(buf, reading.crit);
+        buf.push_back('}');
+    }
+    buf.push_back(']');
+
+    fmt::format_to(out, ",\"mem_rank\":\"{}\"", memRankName(snapshot.memRank));
+    appendJsonProcesses(buf, "top_cpu", snapshot.topCpu);
+    appendJsonProcesses(buf, "top_mem", snapshot.topMem);
+    appendJsonProcesses(buf, "top_disk", snapshot.topDisk);
+
+    if (snapshot.groupBy != GroupBy::None) {
+        fmt::format_to(out, ",\"group_by\":\"{}\"", groupByName(snapshot.groupBy));
+        appendJsonGroups(buf, "top_cpu_groups", snapshot.topCpuGroups);
+        appendJsonGroups(buf, "top_mem_groups", snapshot.topMemGroups);
+        appendJsonGroups(buf, "top_disk_groups", snapshot.topDiskGroups);
+    }
+
+    if (!snapshot.watched.empty()) {
+        buf.append(std::string_view(",\"watched\":["));
+        for (size_t i = 0; i < snapshot.watched.size(); ++i) {
+            const auto &process = snapshot.watched[i];
+            fmt::format_to(out, "{}{{\"pid\":{},\"cmd\":", i ? "," : "", process.pid);
+            appendJsonString(buf, process.cmdline);
+            fmt::format_to(out, ",\"has_io\":{},\"exited\":{},\"points\":[", process.hasIo, process.exited);
+            for (size_t j = 0; j < process.points.size(); ++j) {
+                const auto &point = process.points[j];
+                fmt::format_to(out, "{}{{\"time_ms\":{},\"cpu_percent\":", j ? "," : "", timeMs(point.time));
+                appendJsonNumber(buf, point.cpuPercent);
+                fmt::format_to(out, ",\"rss_bytes\":{},\"read_bytes_per_sec\":", point.rssBytes);
+                appendJsonNumber(buf, point.readBytesPerSec);
+                buf.append(std::string_view(",\"write_bytes_per_sec\":"));
+                appendJsonNumber(buf, point.writeBytesPerSec);
+                buf.push_back('}');
+            }
+            buf.append(std::string_view("]}"));
+        }
+        buf.push_back(']');
+    }
+    buf.append(std::string_view("}\n"));
+}
+
+void appendCsvHeader(fmt::memory_buffer &buf) {
+    buf.append(std::string_view("time_ms,section,pid,name,field,value\n"));
+}
+
+void appendCsv(const Snapshot &snapshot, fmt::memory_buffer &buf) {
+    int64_t time = timeMs(snapshot.time);
+    if (snapshot.cpuPercent) CsvRows{buf, time, "cpu"}.row("percent", *snapshot.cpuPercent);
+
+    const auto &mem = snapshot.mem;
+    const std::pair<const char *, uint64_t> memValues[] = {
+        {"total", mem.total}, {"used", mem.used()}, {"free", mem.free},
+        {"available", mem.available}, {"buffers", mem.buffers}, {"cached", mem.cached},
+        {"shmem", mem.shmem}, {"slab", mem.slab}, {"slab_reclaimable", mem.sReclaimable},
+        {"dirty", mem.dirty}, {"writeback", mem.writeback}, {"hugetlb", mem.hugetlb},
+        {"swap_total", mem.swapTotal}, {"swap_used", mem.swapUsed()},
+    };
+    CsvRows memRows{buf, time, "mem"};
+    for (const auto &[field, value] : memValues) memRows.row(field, value);
+
+    if (snapshot.disksReady) {
+        for (const auto &disk : snapshot.disks) {
+            CsvRows rows{buf, time, "disk", 0, disk.name};
+            rows.row("read_bytes_per_sec", disk.readBytesPerSec);
+            rows.row("write_bytes_per_sec", disk.writeBytesPerSec);
+            rows.row("read_iops", disk.readIops);
+            rows.row("write_iops", disk.writeIops);
+            rows.row("read_await_ms", disk.readAwaitMs);
+            rows.row("write_await_ms", disk.writeAwaitMs);
+            rows.row("busy_percent", disk.busyPercent);
+            rows.row("queue_size", disk.avgQueueSize);
+            rows.row("in_flight", disk.inFlight);
+        }
+    }
+
+    // 传感器名为"hwmon/chip/label"，格式化到栈上的缓冲，不为每个读数构造字符串
+    fmt::memory_buffer sensor;
+    for (const auto &reading : snapshot.temperatures) {
+        sensor.clear();
+        fmt::format_to(std::back_inserter(sensor), "{}/{}/{}", reading.hwmon, reading.chip, reading.label);
+        CsvRows rows{buf, time, "temp", 0, std::string_view(sensor.data(), sensor.size())};
+        rows.row("celsius", reading.celsius);
+        if (reading.high) rows.row("high", *reading.high);
+        if (reading.crit) rows.row("crit", *reading.crit);
+    }
+
+    appendCsvProcesses(buf, time, "top_cpu", snapshot.topCpu);
+    appendCsvProcesses(buf, time, "top_mem", snapshot.topMem);
+    appendCsvProcesses(buf, time, "top_disk", snapshot.topDisk);
+    appendCsvGroups(buf, time, "top_cpu_group", snapshot.topCpuGroups);
+    appendCsvGroups(buf, time, "top_mem_group", snapshot.topMemGroups);
+    appendCsvGroups(buf, time, "top_disk_group", snapshot.topDiskGroups);
+
+    for (const auto &process : snapshot.watched) {
+        for (const auto &point : process.points) {
+            CsvRows rows{buf, timeMs(point.time), "watched", process.pid, process.cmdline};
+            rows.row("cpu_percent", point.cpuPercent);
+            rows.row("rss_bytes", point.rssBytes);
+            if (process.hasIo) {
+                rows.row("read_bytes_per_sec", point.readBytesPerSec);
+                rows.row("write_bytes_per_sec", point.writeBytesPerSec);
+            }
+        }
+    }
+}
@@ -0,0 +1,23 @@
+#include "tick_arena.h"
+#include <algorithm>
+
+TickArena::TickArena(size_t initialSize)
+    : buffer_(initialSize) {
+    resource_.emplace(buffer_.data(), buffer_.size(), std::pmr::new_delete_resource());
+}
+
+void TickArena::reset() {
+    // 对齐填充也计入用量，按最高用量的1.5倍预留以免每次少量超出
+    highWater_ = std::max(highWater_, used_);
+    resource_.reset();
+    if (highWater_ > buffer_.size()) {
+        buffer_ = std::vector<std::byte>(highWater_ + highWater_ / 2);
+    }
+    resource_.emplace(buffer_.data(), buffer_.size(), std::pmr::new_delete_resource());
+    used_ = 0;
+}
+
+void *TickArena::do_allocate(size_t bytes, size_t alignment) {
+    used_ += bytes + alignment - 1;
+    return resource_->allocate(bytes, alignment);
+}
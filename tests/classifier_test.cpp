@@ -0,0 +1,75 @@
+#include "test.h"
+#include "process_classifier.h"
+#include <regex>
+
+TEST(classifier, literals) {
+    ProcessClassifier classifier({"nginx", "java", "python"});
+    CHECK_EQ(classifier.classify("/usr/bin/java -jar app.jar"), 1);
+    CHECK_EQ(classifier.classify("nginx: worker process"), 0);
+    CHECK_EQ(classifier.classify("/usr/bin/pyth"), -1);
+    CHECK_EQ(classifier.classify(""), -1);
+    CHECK_EQ(classifier.stats().literals, 3u);
+}
+
+TEST(classifier, first_rule_wins) {
+    // 同时匹配时返回下标最小的规则，与规则的长短和在文本中的位置无关
+    CHECK_EQ(ProcessClassifier({"java", "ja"}).classify("java"), 0);
+    CHECK_EQ(ProcessClassifier({"ja", "java"}).classify("java"), 0);
+    CHECK_EQ(ProcessClassifier({"abcd", "bc"}).classify("xabcx"), 1);
+    CHECK_EQ(ProcessClassifier({"worker", "^nginx"}).classify("nginx: worker"), 0);
+    CHECK_EQ(ProcessClassifier({"(x)\\1", "x"}).classify("xx"), 0);
+    CHECK_EQ(ProcessClassifier({"(x)\\1", "x"}).classify("x"), 1);
+}
+
+TEST(classifier, automaton) {
+    ProcessClassifier classifier({"^/usr/bin/python[0-9.]*$", "[0-9]+\\.log$", "redis-(server|sentinel)"});
+    CHECK_EQ(classifier.classify("/usr/bin/python3.11"), 0);
+    CHECK_EQ(classifier.classify("/usr/bin/python"), 0);
+    CHECK_EQ(classifier.classify("x/usr/bin/python3"), -1);
+    CHECK_EQ(classifier.classify("/usr/bin/python3 -m http.server"), -1);
+    CHECK_EQ(classifier.classify("/usr/bin/pythonista"), -1);
+    CHECK_EQ(classifier.classify("tail -f app.2024.log"), 1);
+    CHECK_EQ(classifier.classify("tail -f app.log"), -1);
+    CHECK_EQ(classifier.classify("redis-sentinel *:26379"), 2);
+    CHECK_EQ(classifier.stats().automaton, 3u);
+}
+
+TEST(classifier, fallback) {
+    ProcessClassifier classifier({"\\bfoo\\b", "(ab)\\1"});
+    CHECK_EQ(classifier.classify("run foo now"), 0);
+    CHECK_EQ(classifier.classify("runfoo"), -1);
+    CHECK_EQ(classifier.classify("xababx"), 1);
+    CHECK_EQ(classifier.stats().fallback, 2u);
+}
+
+TEST(classifier, cmdline_or_comm) {
+    ProcessClassifier classifier({"^kworker", "^nginx$"});
+    CHECK_EQ(classifier.classify("", "kworker/0:1"), 0);
+    CHECK_EQ(classifier.classify("nginx: master process", "nginx"), 1);
+    CHECK_EQ(classifier.classify("nginx: master process", "nginx-debug"), -1);
+}
+
+TEST(classifier, invalid_pattern) {
+    CHECK_THROWS(ProcessClassifier({"java", "("}), std::regex_error);
+}
+
+// 与逐条std::regex_search的结果对照
+TEST(classifier, matches_regex_search) {
+    const std::vector<std::string> patterns = {
+        "^sshd: [a-z]+@", "java", "[Pp]ostgres: .* (idle|active)$", "(ab)\\1", "^/opt/[^/]+/bin/",
+        "a.c", "x*y+z?", "\\d{3,}", "\\bcron\\b", "^$",
+    };
+    const std::vector<std::string> texts = {
+        "", "sshd: root@pts/0", "sshd: 1@", "/usr/lib/jvm/bin/java -Xmx1g", "postgres: app db idle",
+        "Postgres: x y active", "postgres: idle in transaction", "xabab", "/opt/app/bin/server", "/opt/bin/x",
+        "abc", "a\nc", "yy", "pid 12345", "crond", "run cron job", "zz", "ac",
+    };
+    ProcessClassifier classifier(patterns);
+    for (const auto &text : texts) {
+        int expected = -1;
+        for (size_t i = 0; i < patterns.size() && expected < 0; ++i) {
+            if (std::regex_search(text, std::regex(patterns[i]))) expected = static_cast<int>(i);
+        }
+        CHECK_EQ(classifier.classify(text), expected);
+    }
+}
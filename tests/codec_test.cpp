@@ -0,0 +1,258 @@
+#include "test.h"
+#include "lz_codec.h"
+#include "snapshot_codec.h"
+#include <random>
+#include <stdexcept>
+
+namespace {
+
+std::string lzRoundTrip(std::string_view input, std::string_view dictionary = {}) {
+    std::string compressed, output;
+    lzCompress(input, compressed, dictionary);
+    lzDecompress(compressed, input.size(), output, dictionary);
+    return output;
+}
+
+std::string randomBytes(size_t size, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::string bytes(size, '\0');
+    for (auto &c : bytes) c = static_cast<char>(rng());
+    return bytes;
+}
+
+// 相邻快照间多数内容相同，模拟agent的一个批次
+std::string batchText(int tick) {
+    std::string text;
+    for (int i = 0; i < 50; ++i) {
+        text += fmt::format("pid={} cmd=/usr/bin/worker-{} cpu={} rss={}\n", 1000 + i, i, (i * 7 + tick) % 100, 4096 * (i + 1));
+    }
+    return text;
+}
+
+}
+
+TEST(lz, round_trip) {
+    for (const auto &input : {std::string(), std::string("a"), std::string("abc"), std::string("abcd"),
+                              std::string("abcdabcd"), batchText(0), randomBytes(10000, 1),
+                              batchText(1) + randomBytes(3000, 2) + batchText(1)}) {
+        CHECK(lzRoundTrip(input) == input);
+    }
+}
+
+// 偏移小于匹配长度的匹配与自身重叠，如一长串相同的字节
+TEST(lz, overlapping_match) {
+    for (const auto &input : {std::string(1000, 'a'), std::string("x") + std::string(5000, '\0'),
+                              [] { std::string s; for (int i = 0; i < 300; ++i) s += "ab"; return s; }()}) {
+        std::string compressed;
+        lzCompress(input, compressed);
+        CHECK(compressed.size() < 40);
+        CHECK(lzRoundTrip(input) == input);
+    }
+}
+
+// 字面量和匹配长度在15、15+255等边界处需要扩展字节，255表示继续累加
+TEST(lz, length_boundaries) {
+    for (size_t n : {14, 15, 16, 268, 269, 270, 271, 524, 525, 526, 1000}) {
+        auto literals = randomBytes(n, static_cast<unsigned>(n));
+        CHECK(lzRoundTrip(literals) == literals);
+        auto match = "xyz" + std::string(n + 4, 'q') + "end";
+        CHECK(lzRoundTrip(match) == match);
+        auto both = literals + literals + literals;
+        CHECK(lzRoundTrip(both) == both);
+    }
+}
+
+// 以上一批为字典，匹配可以引用字典末尾64KB
+TEST(lz, dictionary) {
+    auto previous = batchText(0);
+    auto current = batchText(1);
+    std::string withDictionary, without;
+    lzCompress(current, withDictionary, previous);
+    lzCompress(current, without);
+    CHECK(withDictionary.size() < without.size());
+    CHECK(lzRoundTrip(current, previous) == current);
+
+    // 与字典完全相同的输入只有对字典的匹配，没有字典时无法解压
+    std::string compressed, output;
+    lzCompress(previous, compressed, previous);
+    CHECK(compressed.size() < 20);
+    CHECK_THROWS(lzDecompress(compressed, previous.size(), output, {}), std::runtime_error);
+
+    // 超过64KB的字典只使用末尾部分
+    auto large = randomBytes(100000, 3);
+    auto input = large.substr(0, 5000) + large.substr(large.size() - 5000);
+    CHECK(lzRoundTrip(input, large) == input);
+}
+
+TEST(lz, corrupt_input) {
+    auto input = batchText(0) + randomBytes(500, 4) + batchText(0);
+    std::string compressed;
+    lzCompress(input, compressed);
+
+    std::string output;
+    CHECK_THROWS(lzDecompress(compressed, input.size() - 1, output), std::runtime_error);
+    CHECK_THROWS(lzDecompress(compressed, input.size() + 1, output), std::runtime_error);
+    // 截断的数据（包括缺少最后一个只有字面量的序列）都应拒绝
+    for (size_t size = 0; size < compressed.size(); ++size) {
+        CHECK_THROWS(lzDecompress(std::string_view(compressed).substr(0, size), input.size(), output), std::runtime_error);
+    }
+
+    using namespace std::string_literals;
+    CHECK_THROWS(lzDecompress("\x10" "a\x00\x00" "\x00"s, 5, output), std::runtime_error);      // 偏移为0
+    CHECK_THROWS(lzDecompress("\x10" "a\x05\x00" "\x00"s, 5, output), std::runtime_error);      // 偏移超出已解压部分
+    CHECK_THROWS(lzDecompress("\xf0\xff\xff"s, 600, output), std::runtime_error);              // 扩展长度没有结束
+    CHECK_THROWS(lzDecompress("\x50" "ab"s, 5, output), std::runtime_error);                   // 字面量不完整
+    CHECK_THROWS(lzDecompress("\x1f" "a\x01\x00\xff\x10"s, 100, output), std::runtime_error);  // 匹配超出声明的大小
+
+    // 随机数据要么被拒绝，要么恰好解出声明的大小，不能越界
+    std::mt19937 rng(5);
+    for (int i = 0; i < 2000; ++i) {
+        auto garbage = randomBytes(rng() % 64, rng());
+        size_t size = rng() % 256;
+        std::string result;
+        try {
+            lzDecompress(garbage, size, result);
+            CHECK_EQ(result.size(), size);
+        } catch (const std::runtime_error &) {
+        }
+    }
+}
+
+namespace {
+
+Snapshot sampleSnapshot() {
+    Snapshot s;
+    s.time = std::chrono::system_clock::time_point(std::chrono::milliseconds(1714564800123));
+    s.cpuPercent = 12.34;
+    s.mem.total = 16ull << 30;
+    s.mem.free = 1ull << 30;
+    s.mem.available = 8ull << 30;
+    s.mem.hugePageSize = 2048 * 1024;
+    s.mem.hasAvailable = true;
+    s.disksReady = true;
+    s.disks.push_back({"nvme0n1", DiskStat::Kind::Disk, 1048576, 2048, 123.45, 6.7, 0.125, 1.5, 99.99, 2.25, 3});
+    s.disks.push_back({"dm-0", DiskStat::Kind::Stacked, 0, 0, 0, 0, 0, 0, 0, 0, 0});
+    s.temperatures.push_back({"hwmon1", "coretemp", true, "Package id 0", 45.5, 80.0, 100.0});
+    s.temperatures.push_back({"hwmon3", "nvme", true, "Composite", 38.85, std::nullopt, std::nullopt});
+    s.memRank = MemRank::Pss;
+    s.topCpu.push_back({1234, "/usr/bin/java -jar app.jar", 250.5, 1 << 20, false, 0, 0});
+    s.topMem.push_back({-1, "negative pid", 0, 1ull << 40, false, 0, 0});
+    s.topDisk.push_back({42, "", 0, 0, false, 1e9, 12345});
+    s.groupBy = GroupBy::User;
+    s.topCpuGroups.push_back({"root", 12, 75.25, 1 << 30, 100, 200});
+    s.topMemGroups.push_back({"www-data", 40, 0, 5ull << 30, 0, 0});
+    WatchedProcess watched;
+    watched.pid = 77;
+    watched.cmdline = "nginx: worker";
+    watched.hasIo = true;
+    watched.exited = true;
+    watched.points.push_back({s.time - std::chrono::milliseconds(200), 3.5, 1 << 24, 1000, 0});
+    watched.points.push_back({s.time, 4.25, 1 << 25, 0, 2000});
+    s.watched.push_back(watched);
+    return s;
+}
+
+std::string encode(const Snapshot &snapshot) {
+    std::string output;
+    encodeSnapshot(snapshot, output);
+    return output;
+}
+
+}
+
+TEST(snapshot_codec, round_trip) {
+    auto original = sampleSnapshot();
+    auto encoded = encode(original);
+    std::string_view input = encoded;
+    auto decoded = decodeSnapshot(input);
+    CHECK(input.empty());
+    CHECK(encode(decoded) == encoded);      // 再次编码得到相同的字节
+
+    CHECK(decoded.time == original.time);
+    CHECK(decoded.cpuPercent == original.cpuPercent);
+    CHECK_EQ(decoded.mem.total, original.mem.total);
+    CHECK_EQ(decoded.mem.hugePageSize, original.mem.hugePageSize);
+    CHECK(decoded.mem.hasAvailable);
+    CHECK(decoded.disksReady);
+    CHECK_EQ(decoded.disks.size(), 2u);
+    CHECK_EQ(decoded.disks[0].name, "nvme0n1");
+    CHECK_EQ(decoded.disks[0].readIops, 123.45);
+    CHECK_EQ(decoded.disks[0].readAwaitMs, 0.125);
+    CHECK_EQ(decoded.disks[0].busyPercent, 99.99);
+    CHECK_EQ(decoded.disks[0].inFlight, 3u);
+    CHECK(decoded.disks[1].kind == DiskStat::Kind::Stacked);
+    CHECK_EQ(decoded.temperatures.size(), 2u);
+    CHECK_EQ(decoded.temperatures[0].hwmon, "hwmon1");
+    CHECK_EQ(decoded.temperatures[0].label, "Package id 0");
+    CHECK(decoded.temperatures[0].crit == std::optional<double>(100.0));
+    CHECK_EQ(decoded.temperatures[1].celsius, 38.85);
+    CHECK(!decoded.temperatures[1].high);
+    CHECK(decoded.memRank == MemRank::Pss);
+    CHECK_EQ(decoded.topCpu.at(0).cmdline, "/usr/bin/java -jar app.jar");
+    CHECK_EQ(decoded.topCpu.at(0).cpuPercent, 250.5);
+    CHECK_EQ(decoded.topMem.at(0).pid, -1);
+    CHECK_EQ(decoded.topMem.at(0).memBytes, 1ull << 40);
+    CHECK_EQ(decoded.topDisk.at(0).readBytesPerSec, 1e9);
+    CHECK(decoded.groupBy == GroupBy::User);
+    CHECK_EQ(decoded.topCpuGroups.at(0).processes, 12u);
+    CHECK_EQ(decoded.topCpuGroups.at(0).cpuPercent, 75.25);
+    CHECK_EQ(decoded.topMemGroups.at(0).name, "www-data");
+    CHECK(decoded.topDiskGroups.empty());
+    CHECK_EQ(decoded.watched.size(), 1u);
+    CHECK(decoded.watched[0].hasIo && decoded.watched[0].exited);
+    CHECK_EQ(decoded.watched[0].points.size(), 2u);
+    CHECK(decoded.watched[0].points[0].time == original.watched[0].points[0].time);
+    CHECK_EQ(decoded.watched[0].points[1].writeBytesPerSec, 2000.0);
+}
+
+// 小数按固定精度取整：百分比0.01、速率1字节/秒、温度0.001℃
+TEST(snapshot_codec, precision) {
+    Snapshot snapshot;
+    snapshot.cpuPercent = 1.004;
+    snapshot.disks.push_back({"sda", DiskStat::Kind::Disk, 1.6, 0.4, 0, 0, 0, 0, 0, 0, 0});
+    snapshot.temperatures.push_back({"hwmon0", "acpitz", false, "temp1", -5.0004, std::nullopt, std::nullopt});
+    auto encoded = encode(snapshot);
+    std::string_view input = encoded;
+    auto decoded = decodeSnapshot(input);
+    CHECK_EQ(*decoded.cpuPercent, 1.0);
+    CHECK_EQ(decoded.disks[0].readBytesPerSec, 2.0);
+    CHECK_EQ(decoded.disks[0].writeBytesPerSec, 0.0);
+    CHECK_EQ(decoded.temperatures[0].celsius, -5.0);
+    CHECK(!Snapshot().cpuPercent);
+}
+
+// 一个批次中的多份快照依次解码
+TEST(snapshot_codec, sequence) {
+    std::string batch;
+    auto first = sampleSnapshot();
+    Snapshot second;
+    second.time = first.time + std::chrono::seconds(10);
+    encodeSnapshot(first, batch);
+    encodeSnapshot(second, batch);
+    std::string_view input = batch;
+    CHECK_EQ(decodeSnapshot(input).topCpu.size(), 1u);
+    CHECK(decodeSnapshot(input).time == second.time);
+    CHECK(input.empty());
+}
+
+TEST(snapshot_codec, truncated) {
+    auto encoded = encode(sampleSnapshot());
+    for (size_t size = 0; size < encoded.size(); ++size) {
+        std::string_view input = std::string_view(encoded).substr(0, size);
+        CHECK_THROWS(decodeSnapshot(input), std::runtime_error);
+    }
+
+    // 空快照中磁盘列表长度在第26字节、memRank在第28字节
+    auto empty = encode(Snapshot());
+    CHECK_EQ(empty[26], '\0');
+    auto hugeCount = empty.substr(0, 26) + "\xff\xff\xff\xff\x0f" + empty.substr(27);
+    std::string_view input = hugeCount;
+    CHECK_THROWS(decodeSnapshot(input), std::runtime_error);       // 长度超过剩余数据，分配之前就被拒绝
+    auto badEnum = empty;
+    badEnum[28] = 9;
+    input = badEnum;
+    CHECK_THROWS(decodeSnapshot(input), std::runtime_error);
+    auto badVarint = empty.substr(0, 26) + std::string(10, '\x80') + "\x01";
+    input = badVarint;
+    CHECK_THROWS(decodeSnapshot(input), std::runtime_error);
+}
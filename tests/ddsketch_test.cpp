@@ -0,0 +1,101 @@
+#include "test.h"
+#include "ddsketch.h"
+#include <deque>
+#include <random>
+
+namespace {
+
+constexpr double kQuantiles[] = {0, 0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.95, 0.99, 1};
+
+// 与排序后的参考值比较：排名为q * (count - 1)的值，相对误差不超过accuracy，零桶中的值估计为0
+void checkQuantiles(const DDSketch &sketch, std::vector<double> values, double accuracy, int line) {
+    std::sort(values.begin(), values.end());
+    if (sketch.count() != values.size()) {
+        testFailure(__FILE__, line, fmt::format("count {} != {}", sketch.count(), values.size()));
+        return;
+    }
+    for (double q : kQuantiles) {
+        double expected = values[static_cast<size_t>(q * (values.size() - 1))];
+        double actual = sketch.quantile(q);
+        bool ok = expected < DDSketch::kMinValue ? actual == 0
+                                                 : std::abs(actual - expected) <= accuracy * expected * (1 + 1e-9);
+        if (!ok) testFailure(__FILE__, line, fmt::format("q={}: {} vs exact {}", q, actual, expected));
+    }
+}
+
+// 跨越多个数量级的值，少量为0
+double randomValue(std::mt19937 &rng) {
+    if (rng() % 20 == 0) return 0;
+    return std::exp(std::uniform_real_distribution<double>(std::log(1e-2), std::log(1e9))(rng));
+}
+
+}
+
+TEST(ddsketch, empty) {
+    DDSketch sketch;
+    CHECK(sketch.empty());
+    CHECK_EQ(sketch.quantile(0.5), 0.0);
+    sketch.add(42);
+    CHECK_EQ(sketch.count(), 1u);
+    CHECK(std::abs(sketch.quantile(0.99) - 42) <= 0.42);
+    sketch.remove(42);
+    CHECK(sketch.empty());
+    CHECK_EQ(sketch.quantile(0.99), 0.0);
+}
+
+TEST(ddsketch, relative_error) {
+    for (double accuracy : {0.01, 0.05}) {
+        std::mt19937 rng(1);
+        DDSketch sketch(accuracy);
+        std::vector<double> values;
+        for (int i = 0; i < 50000; ++i) {
+            values.push_back(randomValue(rng));
+            sketch.add(values.back());
+        }
+        checkQuantiles(sketch, values, accuracy, __LINE__);
+    }
+}
+
+// 滑动窗口：移除离开窗口的值后，分位数与只含窗口内的值一致
+TEST(ddsketch, sliding_window) {
+    std::mt19937 rng(2);
+    DDSketch sketch;
+    std::deque<double> window;
+    for (int i = 0; i < 20000; ++i) {
+        // 前后两段的量级不同，窗口滑过后旧的范围应完全移除
+        double value = i < 10000 ? randomValue(rng) : 1e6 + rng() % 1000;
+        window.push_back(value);
+        sketch.add(value);
+        if (window.size() > 1000) {
+            sketch.remove(window.front());
+            window.pop_front();
+        }
+        if (i % 97 == 0) checkQuantiles(sketch, {window.begin(), window.end()}, 0.01, __LINE__);
+    }
+    CHECK(sketch.quantile(0) >= 1e6 * 0.99);
+    while (!window.empty()) {
+        sketch.remove(window.front());
+        window.pop_front();
+    }
+    CHECK(sketch.empty());
+    CHECK_EQ(sketch.quantile(0.5), 0.0);
+}
+
+// 移除是精确的：加入再移除一组值后，与从未加入过它们的草图完全相同
+TEST(ddsketch, exact_removal) {
+    std::mt19937 rng(3);
+    DDSketch kept, churned;
+    std::vector<double> values, transient;
+    for (int i = 0; i < 5000; ++i) {
+        values.push_back(randomValue(rng));
+        kept.add(values.back());
+        churned.add(values.back());
+        transient.push_back(randomValue(rng) * 1000);
+        churned.add(transient.back());
+    }
+    std::shuffle(transient.begin(), transient.end(), rng);
+    for (double value : transient) churned.remove(value);
+    CHECK_EQ(churned.count(), kept.count());
+    for (double q = 0; q <= 1; q += 0.001) CHECK_EQ(churned.quantile(q), kept.quantile(q));
+    checkQuantiles(churned, values, 0.01, __LINE__);
+}
@@ -0,0 +1,144 @@
+#include "test.h"
+#include "process_filter.h"
+#include <map>
+#include <regex>
+#include <set>
+#include <stdexcept>
+
+namespace {
+
+// 未设置的字段按尚未采集处理；记录读取过的字段，用于检查短路求值
+struct FakeSource : FilterSource {
+    ProcessFilter *filter = nullptr;
+    std::map<FilterField, double> numbers;
+    std::map<FilterField, std::string> texts;
+    std::optional<std::string> cmdline;
+    std::set<FilterField> read;
+
+    std::optional<double> number(FilterField field) override {
+        read.insert(field);
+        auto it = numbers.find(field);
+        return it == numbers.end() ? std::nullopt : std::optional<double>(it->second);
+    }
+    std::optional<std::string_view> text(FilterField field) override {
+        read.insert(field);
+        auto it = texts.find(field);
+        return it == texts.end() ? std::nullopt : std::optional<std::string_view>(it->second);
+    }
+    std::optional<bool> commandMatches(size_t index) override {
+        read.insert(FilterField::Cmd);
+        if (!cmdline) return std::nullopt;
+        return filter->matchCommand(index, *cmdline);
+    }
+};
+
+std::string evaluate(std::string_view expression, FakeSource source) {
+    ProcessFilter filter(expression);
+    source.filter = &filter;
+    switch (filter.evaluate(source)) {
+        case ProcessFilter::Result::False: return "false";
+        case ProcessFilter::Result::True: return "true";
+        case ProcessFilter::Result::Unknown: return "unknown";
+    }
+    return "?";
+}
+
+FakeSource process(double pid, double rss) {
+    FakeSource source;
+    source.numbers = {{FilterField::Pid, pid}, {FilterField::Rss, rss}};
+    return source;
+}
+
+}
+
+TEST(filter, numbers) {
+    auto p = process(42, 2.0 * 1024 * 1024 * 1024);
+    CHECK_EQ(evaluate("pid == 42", p), "true");
+    CHECK_EQ(evaluate("pid != 42", p), "false");
+    CHECK_EQ(evaluate("pid < 42", p), "false");
+    CHECK_EQ(evaluate("pid <= 42", p), "true");
+    CHECK_EQ(evaluate("rss > 1G", p), "true");
+    CHECK_EQ(evaluate("rss >= 2GB", p), "true");
+    CHECK_EQ(evaluate("rss > 2048M", p), "false");
+    CHECK_EQ(evaluate("rss < 0.5T", p), "true");
+    FakeSource cpu;
+    cpu.numbers[FilterField::Cpu] = 12.5;
+    CHECK_EQ(evaluate("cpu > 10%", cpu), "true");
+}
+
+TEST(filter, strings) {
+    FakeSource p;
+    p.texts = {{FilterField::Comm, "bash"}, {FilterField::User, "root"}};
+    p.cmdline = "/usr/bin/java -Xmx1g -jar a.b";
+    CHECK_EQ(evaluate("comm == \"bash\"", p), "true");
+    CHECK_EQ(evaluate("user != \"root\"", p), "false");
+    CHECK_EQ(evaluate("comm ~ \"^ba\"", p), "true");
+    CHECK_EQ(evaluate("comm !~ \"sh$\"", p), "false");
+    CHECK_EQ(evaluate("cmd ~ \"java\"", p), "true");
+    CHECK_EQ(evaluate("cmd !~ \"python\"", p), "true");
+    CHECK_EQ(evaluate("cmd == \"/usr/bin/java -Xmx1g -jar a.b\"", p), "true");
+    CHECK_EQ(evaluate("cmd == \"/usr/bin/java -Xmx1g -jar axb\"", p), "false");     // ==不是正则
+    CHECK_EQ(evaluate("cmd == \"java\"", p), "false");                              // ==是整串比较
+    CHECK_EQ(evaluate("cmd != \"java\"", p), "true");
+    CHECK_EQ(evaluate("cmd ~ \"a\\.b$\" && comm ~ \"\\\"\" ", p), "false");
+}
+
+// 缺少的字段为Unknown，按Kleene三值逻辑组合
+TEST(filter, three_valued) {
+    FakeSource p;
+    p.numbers[FilterField::Pid] = 1;
+    const std::pair<const char *, const char *> cases[] = {
+        {"rss > 0", "unknown"},
+        {"!(rss > 0)", "unknown"},
+        {"rss > 0 && pid == 1", "unknown"},
+        {"rss > 0 && pid == 2", "false"},
+        {"pid == 2 && rss > 0", "false"},
+        {"rss > 0 || pid == 1", "true"},
+        {"pid == 1 || rss > 0", "true"},
+        {"rss > 0 || pid == 2", "unknown"},
+        {"!(rss > 0 && pid == 2)", "true"},
+        {"!(rss > 0 || pid == 2)", "unknown"},
+        {"(rss > 0 || pid == 1) && (cpu > 1 || pid != 1)", "unknown"},
+        {"(rss > 0 || pid == 1) && !(cpu > 1 && pid != 1)", "true"},
+        {"cmd ~ \"x\" || comm == \"y\"", "unknown"},
+        {"cmd ~ \"x\" && pid == 2", "false"},
+        {"pid == 2 || pid == 1 && rss > 0", "unknown"},     // &&比||优先
+        {"pid == 1 || pid == 2 && rss > 0", "true"},
+        {"(pid == 1 || pid == 2) && rss > 0", "unknown"},
+    };
+    for (const auto &[expression, expected] : cases) {
+        auto result = evaluate(expression, p);
+        if (result != expected) testFailure(__FILE__, __LINE__, fmt::format("{}: {} != {}", expression, result, expected));
+    }
+}
+
+// 结果确定后不再读取右侧的字段
+TEST(filter, short_circuit) {
+    ProcessFilter filter("pid == 2 && (rss > 1G || cmd ~ \"java\")");
+    auto p = process(1, 0);
+    p.filter = &filter;
+    CHECK(filter.evaluate(p) == ProcessFilter::Result::False);
+    CHECK(p.read == std::set<FilterField>{FilterField::Pid});
+
+    ProcessFilter either("pid == 1 || rss > 1G");
+    auto q = process(1, 0);
+    CHECK(either.evaluate(q) == ProcessFilter::Result::True);
+    CHECK(q.read == std::set<FilterField>{FilterField::Pid});
+}
+
+TEST(filter, errors) {
+    for (const char *expression : {"", "pid", "pid >", "pid == 1 &&", "(pid == 1", "pid == 1)", "foo == 1",
+                                   "pid ~ \"1\"", "comm > \"a\"", "comm == bash", "comm == \"bash", "pid == x",
+                                   "cmd < \"a\"", "pid == 1 pid == 2"}) {
+        CHECK_THROWS(ProcessFilter(expression), std::invalid_argument);
+    }
+    CHECK_THROWS(ProcessFilter("cmd ~ \"(\""), std::regex_error);
+}
+
+TEST(filter, nesting_limit) {
+    CHECK_EQ(evaluate(std::string(64, '(') + "pid == 1" + std::string(64, ')'), process(1, 0)), "true");
+    CHECK_EQ(evaluate(std::string(64, '!') + "pid == 1", process(1, 0)), "true");
+    CHECK_THROWS(ProcessFilter(std::string(65, '(') + "pid == 1" + std::string(65, ')')), std::invalid_argument);
+    CHECK_THROWS(ProcessFilter(std::string(100000, '(')), std::invalid_argument);
+    CHECK_THROWS(ProcessFilter(std::string(100000, '!') + "pid == 1"), std::invalid_argument);
+}
@@ -0,0 +1,127 @@
+#include "test.h"
+#include "gzip.h"
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <unistd.h>
+
+namespace {
+
+// 测试进程专用的临时文件，析构时删除
+struct TempFile {
+    std::filesystem::path path;
+    explicit TempFile(std::string_view name)
+        : path(std::filesystem::temp_directory_path() / fmt::format("res_monitor_tests.{}.{}", ::getpid(), name)) {}
+    ~TempFile() { std::filesystem::remove(path); }
+};
+
+void writeFile(const std::filesystem::path &path, std::string_view data) {
+    std::ofstream out(path, std::ios::binary);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+// 用系统的gzip解压；截断的流（sync flush之后还没有结束）会报告意外结束，但已解出的内容照常输出
+std::string gunzip(std::string_view compressed) {
+    TempFile file("gz");
+    writeFile(file.path, compressed);
+    std::string result;
+    FILE *pipe = ::popen(fmt::format("gzip -dc '{}' 2>/dev/null", file.path.string()).c_str(), "r");
+    if (!pipe) throw std::runtime_error("popen gzip failed");
+    char buf[65536];
+    while (size_t n = std::fread(buf, 1, sizeof(buf), pipe)) result.append(buf, n);
+    ::pclose(pipe);
+    return result;
+}
+
+std::string compress(std::string_view input) {
+    GzipEncoder encoder;
+    std::string output;
+    encoder.write(input, output);
+    encoder.finish(output);
+    return output;
+}
+
+// 重复多的日志文本
+std::string logText(size_t lines) {
+    std::string text;
+    for (size_t i = 0; i < lines; ++i) {
+        text += fmt::format("[2024-05-01 12:{:02}:{:02}.{:03}] [multi_sink] [info] [main.cpp:83] CPU: {:.2f}%, PID: {}\n",
+                            i / 60 % 60, i % 60, i % 1000, (i * 37 % 10000) / 100.0, 1000 + i % 97);
+    }
+    return text;
+}
+
+std::string randomBytes(size_t size) {
+    std::mt19937 rng(42);
+    std::string bytes(size, '\0');
+    for (auto &c : bytes) c = static_cast<char>(rng());
+    return bytes;
+}
+
+}
+
+TEST(gzip, empty) {
+    CHECK_EQ(gunzip(compress("")), std::string());
+}
+
+TEST(gzip, round_trip) {
+    for (const auto &input : {std::string("a"), std::string("hello hello hello hello\n"), logText(5000),
+                              randomBytes(300 * 1024), logText(2000) + randomBytes(50000) + logText(2000)}) {
+        auto compressed = compress(input);
+        CHECK(gunzip(compressed) == input);
+        GzipEncoder encoder;
+        std::string output;
+        encoder.write(input, output);
+        CHECK_EQ(encoder.inputSize(), input.size());
+    }
+}
+
+TEST(gzip, compresses_logs) {
+    auto input = logText(20000);
+    auto compressed = compress(input);
+    CHECK(compressed.size() * 5 < input.size());
+    CHECK(compressed.size() < compress(randomBytes(input.size())).size());
+}
+
+// write之间的分割不影响输出
+TEST(gzip, split_writes) {
+    auto input = logText(4000);
+    std::string output;
+    GzipEncoder encoder;
+    for (size_t pos = 0, step = 1; pos < input.size(); pos += step, step = step * 7 % 9973 + 1) {
+        encoder.write(std::string_view(input).substr(pos, step), output);
+    }
+    encoder.finish(output);
+    CHECK(output == compress(input));
+}
+
+// 每次sync flush之后，已输出的字节就能解出此前写入的全部内容
+TEST(gzip, sync_flush) {
+    auto input = logText(3000) + randomBytes(40000) + logText(3000);
+    GzipEncoder encoder;
+    std::string output;
+    size_t written = 0;
+    for (size_t step : {1, 100, 5000, 70000, 200000, 0, 12345}) {
+        step = std::min(step, input.size() - written);
+        encoder.write(std::string_view(input).substr(written, step), output);
+        written += step;
+        encoder.flush(output);
+        CHECK(gunzip(output) == input.substr(0, written));
+        encoder.flush(output);      // 连续flush只追加空的存储块
+        CHECK(gunzip(output) == input.substr(0, written));
+    }
+    encoder.write(std::string_view(input).substr(written), output);
+    encoder.finish(output);
+    CHECK(gunzip(output) == input);
+}
+
+TEST(gzip, file) {
+    TempFile source("log"), target("log.gz");
+    auto input = logText(3000);
+    writeFile(source.path, input);
+    gzipFile(source.path, target.path);
+    std::ifstream in(target.path, std::ios::binary);
+    std::string compressed((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    CHECK(gunzip(compressed) == input);
+    CHECK_THROWS(gzipFile(source.path.string() + ".missing", target.path), std::runtime_error);
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <spdlog/fmt/fmt.h>
+
+// 最小的测试注册和断言，不依赖测试框架。
+// TEST(suite, name)定义一个用例；CHECK失败时记录文件行号并继续执行，用例结束后按失败数判定结果。
+// res_monitor_tests [suite]只运行指定的一组，ctest为每组注册一个测试
+
+struct TestCase {
+    const char *suite;
+    const char *name;
+    void (*run)();
+};
+
+std::vector<TestCase> &testCases();
+void testFailure(const char *file, int line, const std::string &message);
+
+struct TestRegistrar {
+    TestRegistrar(const char *suite, const char *name, void (*run)()) { testCases().push_back({suite, name, run}); }
+};
+
+#define TEST(suite, name)                                                                   \
+    static void test_##suite##_##name();                                                    \
+    static TestRegistrar registrar_##suite##_##name(#suite, #name, test_##suite##_##name);  \
+    static void test_##suite##_##name()
+
+#define CHECK(condition)                                                    \
+    do {                                                                    \
+        if (!(condition)) testFailure(__FILE__, __LINE__, #condition);      \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                                      \
+    do {                                                                                                \
+        const auto &actual_ = (actual);                                                                 \
+        const auto &expected_ = (expected);                                                             \
+        if (!(actual_ == expected_))                                                                    \
+            testFailure(__FILE__, __LINE__, fmt::format("{} == {}: {} != {}", #actual, #expected, actual_, expected_)); \
+    } while (0)
+
+#define CHECK_THROWS(expression, type)                                                  \
+    do {                                                                                \
+        bool thrown_ = false;                                                           \
+        try {                                                                           \
+            (void)(expression);                                                         \
+        } catch (const type &) {                                                        \
+            thrown_ = true;                                                             \
+        }                                                                               \
+        if (!thrown_) testFailure(__FILE__, __LINE__, #expression " did not throw " #type); \
+    } while (0)
@@ -0,0 +1,42 @@
+#include "test.h"
+#include <cstdio>
+#include <cstring>
+#include <exception>
+
+namespace {
+int failures = 0;
+}
+
+std::vector<TestCase> &testCases() {
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+void testFailure(const char *file, int line, const std::string &message) {
+    ++failures;
+    std::fprintf(stderr, "  %s:%d: %s\n", file, line, message.c_str());
+}
+
+int main(int argc, char **argv) {
+    const char *suite = argc > 1 ? argv[1] : nullptr;
+    int run = 0, failed = 0;
+    for (const auto &test : testCases()) {
+        if (suite && std::strcmp(suite, test.suite) != 0) continue;
+        int before = failures;
+        try {
+            test.run();
+        } catch (const std::exception &e) {
+            testFailure(__FILE__, __LINE__, fmt::format("unexpected exception: {}", e.what()));
+        }
+        ++run;
+        bool ok = failures == before;
+        if (!ok) ++failed;
+        std::printf("%s %s.%s\n", ok ? "PASS" : "FAIL", test.suite, test.name);
+    }
+    if (run == 0) {
+        std::fprintf(stderr, "no test in suite %s\n", suite ? suite : "(all)");
+        return 1;
+    }
+    std::printf("%d/%d passed\n", run - failed, run);
+    return failed == 0 ? 0 : 1;
+}
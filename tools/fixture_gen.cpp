@@ -0,0 +1,51 @@
+#include "fixture.h"
+#include <docopt.h>
+#include <iostream>
+#include <filesystem>
+
+static const char USAGE[] =
+R"(生成合成的procfs/sysfs目录树
+
+Usage:
+  res_monitor_fixture <root> [--pids <n>] [--sensors <n>] [--disks <n>] [--cpus <n>] [--tick <n>]
+  res_monitor_fixture (-h | --help)
+
+Options:
+  --pids <n>      进程数 [默认: 1000]
+  --sensors <n>   温度传感器数 [默认: 8]
+  --disks <n>     磁盘数 [默认: 2]
+  --cpus <n>      CPU数 [默认: 4]
+  --tick <n>      计数器所处的周期，大于0且目录已存在时只推进计数器 [默认: 0]
+  -h --help       显示帮助信息
+
+<root>下已有的proc、sys只在是此前生成的目录时才会被替换。
+生成后可通过 res_monitor --proc-root <root>/proc --sys-root <root>/sys 采集。
+)";
+
+int main(int argc, char** argv) {
+    auto args = docopt::docopt(USAGE, {argv + 1, argv + argc}, true);
+
+    FixtureOptions options;
+    uint64_t tick = 0;
+    try {
+        auto getInt = [&args](const std::string &key, auto *result) {
+            if (args[key].isString()) *result = std::stoull(args[key].asString());
+        };
+        getInt("--pids", &options.numPids);
+        getInt("--sensors", &options.numSensors);
+        getInt("--disks", &options.numDisks);
+        getInt("--cpus", &options.numCpus);
+        getInt("--tick", &tick);
+
+        const auto &root = args["<root>"].asString();
+        if (tick > 0 && std::filesystem::exists(std::filesystem::path(root) / "proc")) {
+            advanceFixture(root, options, tick);
+        } else {
+            generateFixture(root, options, tick);
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+// 读取res_monitor --shm导出的共享内存快照并打印，也是shm_snapshot.h的使用示例。
+// 只依赖shm_snapshot.h，不链接采集器
+#include "shm_snapshot.h"
+#include <cstdio>
+#include <cstring>
+#include <csignal>
+#include <string>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+static const char USAGE[] =
+R"(打印res_monitor --shm导出的最近一份快照
+
+Usage:
+  res_monitor_shm_cat [<name>] [--follow]
+
+  <name>      共享内存名，与--shm相同 [默认: /res_monitor]
+  --follow    持续打印每份新快照，直到写入方退出
+)";
+
+static void printProcesses(const char *title, const shm::Process *processes, uint32_t count) {
+    if (count == 0) return;
+    std::printf("%s:\n", title);
+    for (uint32_t i = 0; i < count; ++i) {
+        const auto &p = processes[i];
+        std::printf("  %7d  cpu %6.1f%%  mem %8.1fMB  r %8.1fKB/s  w %8.1fKB/s  %s\n",
+                    p.pid, p.cpuPercent, p.memBytes / 1048576.0,
+                    p.readBytesPerSec / 1024, p.writeBytesPerSec / 1024, p.command);
+    }
+}
+
+static void print(const shm::Snapshot &s) {
+    static const char *ranks[] = {"rss", "pss", "uss", "swap"};
+    std::printf("generation %llu  time %lld\n", (unsigned long long)s.generation, (long long)s.timeMs);
+    if (s.hasCpu) std::printf("cpu %.1f%%\n", s.cpuPercent);
+    std::printf("mem total %.1fMB used %.1fMB available %.1fMB swap %.1f/%.1fMB\n",
+                s.mem.total / 1048576.0, s.mem.used / 1048576.0, s.mem.available / 1048576.0,
+                (s.mem.swapTotal - s.mem.swapFree) / 1048576.0, s.mem.swapTotal / 1048576.0);
+    if (s.disksReady) {
+        for (uint32_t i = 0; i < s.diskCount; ++i) {
+            const auto &d = s.disks[i];
+            std::printf("disk %-10s r %8.1fKB/s  w %8.1fKB/s  util %5.1f%%\n",
+                        d.name, d.readBytesPerSec / 1024, d.writeBytesPerSec / 1024, d.busyPercent);
+        }
+    }
+    printProcesses("top cpu", s.topCpu, s.topCpuCount);
+    printProcesses(s.memRank < 4 ? (std::string("top mem (") + ranks[s.memRank] + ")").c_str() : "top mem",
+                   s.topMem, s.topMemCount);
+    printProcesses("top disk", s.topDisk, s.topDiskCount);
+    std::fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+    const char *name = shm::kDefaultName;
+    bool follow = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--follow") == 0) follow = true;
+        else if (argv[i][0] == '/') name = argv[i];
+        else {
+            std::fputs(USAGE, stderr);
+            return 1;
+        }
+    }
+
+    try {
+        shm::Reader reader(name);
+        auto snapshot = std::make_unique<shm::Snapshot>();
+        uint64_t last = 0;
+        do {
+            // 只比较序号，没有新快照时不拷贝
+            auto sequence = reader.sequence();
+            if (sequence != last && !(sequence & 1) && reader.read(*snapshot)) {
+                last = sequence;
+                print(*snapshot);
+                if (!follow) return 0;
+                std::printf("\n");
+            } else if (!follow && sequence == 0) {
+                std::fprintf(stderr, "%s: 还没有发布快照\n", name);
+                return 1;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        } while (::kill(reader.writerPid(), 0) == 0);
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}